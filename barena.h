@@ -5,30 +5,89 @@
 #	define _DEFAULT_SOURCE 1
 #endif
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifndef BARENA_API
 #define BARENA_API
 #endif
 
+#ifndef BARENA_HUGE_PAGE_SIZE
+// Size of a huge page on Linux, Windows queries GetLargePageMinimum
+#define BARENA_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+#endif
+
 typedef struct barena_chunk_s barena_chunk_t;
 
+typedef enum {
+	BARENA_PAGES_DEFAULT = 0,
+	// Ask for transparent huge pages (MADV_HUGEPAGE).
+	// Windows has no equivalent and uses default pages.
+	BARENA_PAGES_TRANSPARENT_HUGE,
+	// Explicit huge pages (MAP_HUGETLB, MEM_LARGE_PAGES).
+	// A chunk falls back to default pages when none are available.
+	BARENA_PAGES_HUGE,
+} barena_page_mode_t;
+
+typedef struct barena_pool_options_s {
+	barena_page_mode_t page_mode;
+	// Bind the chunks of the pool to the NUMA node numa_node
+	bool numa_bind;
+	unsigned numa_node;
+	// Allow arenas on different threads to share the pool
+	bool concurrent;
+	// Free chunks beyond this are returned to the OS, 0 means no limit
+	size_t max_free_chunks;
+} barena_pool_options_t;
+
 typedef struct barena_pool_s {
 	size_t chunk_size;
 	size_t os_page_size;
 	barena_chunk_t* free_chunks;
+	size_t num_free_chunks;
+	barena_pool_options_t options;
 } barena_pool_t;
 
+typedef struct barena_stats_s {
+	// Bytes handed out, including alignment padding
+	size_t bytes_used;
+	size_t peak_bytes_used;
+	// Size of all chunks held by the arena
+	size_t chunk_bytes;
+	size_t peak_chunk_bytes;
+} barena_stats_t;
+
 typedef struct barena_s {
 	barena_chunk_t* current_chunk;
 	barena_pool_t* pool;
+	barena_stats_t stats;
+	unsigned scope_depth;
 } barena_t;
 
 typedef char* barena_snapshot_t;
 
+typedef struct barena_scope_s {
+	barena_t* arena;
+	barena_snapshot_t snapshot;
+	unsigned depth;
+} barena_scope_t;
+
 BARENA_API void
 barena_pool_init(barena_pool_t* pool, size_t chunk_size);
 
+/**
+ * Initializes a pool with the given page options.
+ *
+ * With huge pages, chunk sizes are rounded up to whole huge pages.
+ */
+BARENA_API void
+barena_pool_init_ex(barena_pool_t* pool, size_t chunk_size, const barena_pool_options_t* options);
+
+/**
+ * Returns all free chunks to the OS.
+ *
+ * For a concurrent pool, no arena may be using the pool at the same time.
+ */
 BARENA_API void
 barena_pool_cleanup(barena_pool_t* pool);
 
@@ -50,6 +109,30 @@ barena_restore(barena_t* arena, barena_snapshot_t snapshot);
 BARENA_API void
 barena_reset(barena_t* arena);
 
+/**
+ * Resizes an allocation.
+ *
+ * When @ptr is the most recent allocation and the current chunk has room, it
+ * is resized in place.
+ * Otherwise a new block is allocated and the contents are copied, the old
+ * block is only reclaimed with the rest of the arena.
+ * A NULL @ptr behaves like barena_malloc.
+ */
+BARENA_API void*
+barena_realloc(barena_t* arena, void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * Starts a scratch scope: everything allocated until the matching
+ * barena_scope_end is released by it.
+ *
+ * Scopes can be nested but must be ended in reverse order.
+ */
+BARENA_API barena_scope_t
+barena_scope_begin(barena_t* arena);
+
+BARENA_API void
+barena_scope_end(barena_scope_t* scope);
+
 #endif
 
 #if defined(BLIB_IMPLEMENTATION) && !defined(BARENA_IMPLEMENTATION)
@@ -59,6 +142,8 @@ barena_reset(barena_t* arena);
 #ifdef BARENA_IMPLEMENTATION
 
 #include <stdint.h>
+#include <string.h>
+#include <assert.h>
 
 #ifdef _MSC_VER
 #	define MAX_ALIGN_TYPE double
@@ -67,10 +152,10 @@ barena_reset(barena_t* arena);
 #endif
 
 static inline size_t
-barena_os_page_size(void);
+barena_os_page_size(const barena_pool_options_t* options);
 
 static inline void*
-barena_os_page_alloc(size_t size);
+barena_os_page_alloc(barena_pool_t* pool, size_t size);
 
 static inline void
 barena_os_page_free(void* ptr, size_t size);
@@ -87,28 +172,166 @@ struct barena_chunk_s {
 	char begin[];
 };
 
+#ifdef _MSC_VER
+
+#include <intrin.h>
+
+static inline barena_chunk_t*
+barena_atomic_load_chunk(barena_chunk_t** ptr) {
+	return *(barena_chunk_t* volatile*)ptr;
+}
+
+static inline bool
+barena_atomic_cas_chunk(barena_chunk_t** ptr, barena_chunk_t* expected, barena_chunk_t* desired) {
+	return _InterlockedCompareExchangePointer((void* volatile*)ptr, desired, expected) == expected;
+}
+
+static inline barena_chunk_t*
+barena_atomic_exchange_chunk(barena_chunk_t** ptr, barena_chunk_t* value) {
+	return _InterlockedExchangePointer((void* volatile*)ptr, value);
+}
+
+static inline size_t
+barena_atomic_add(size_t* ptr, size_t value) {
+#ifdef _WIN64
+	return (size_t)_InterlockedExchangeAdd64((volatile __int64*)ptr, (__int64)value);
+#else
+	return (size_t)_InterlockedExchangeAdd((volatile long*)ptr, (long)value);
+#endif
+}
+
+#else
+
+static inline barena_chunk_t*
+barena_atomic_load_chunk(barena_chunk_t** ptr) {
+	return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+static inline bool
+barena_atomic_cas_chunk(barena_chunk_t** ptr, barena_chunk_t* expected, barena_chunk_t* desired) {
+	return __atomic_compare_exchange_n(
+		ptr, &expected, desired, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED
+	);
+}
+
+static inline barena_chunk_t*
+barena_atomic_exchange_chunk(barena_chunk_t** ptr, barena_chunk_t* value) {
+	return __atomic_exchange_n(ptr, value, __ATOMIC_ACQUIRE);
+}
+
+static inline size_t
+barena_atomic_add(size_t* ptr, size_t value) {
+	return __atomic_fetch_add(ptr, value, __ATOMIC_RELAXED);
+}
+
+#endif
+
+static inline size_t
+barena_chunk_size(barena_chunk_t* chunk) {
+	return (size_t)(chunk->end - (char*)chunk);
+}
+
+static inline size_t
+barena_pool_count(barena_pool_t* pool, size_t delta) {
+	if (pool->options.concurrent) {
+		return barena_atomic_add(&pool->num_free_chunks, delta);
+	} else {
+		size_t count = pool->num_free_chunks;
+		pool->num_free_chunks += delta;
+		return count;
+	}
+}
+
+static inline void
+barena_pool_push(barena_pool_t* pool, barena_chunk_t* first, barena_chunk_t* last) {
+	if (pool->options.concurrent) {
+		barena_chunk_t* head;
+		do {
+			head = barena_atomic_load_chunk(&pool->free_chunks);
+			last->next = head;
+		} while (!barena_atomic_cas_chunk(&pool->free_chunks, head, first));
+	} else {
+		last->next = pool->free_chunks;
+		pool->free_chunks = first;
+	}
+}
+
+static inline void
+barena_pool_release(barena_pool_t* pool, barena_chunk_t* chunk) {
+	size_t max_free_chunks = pool->options.max_free_chunks;
+	if (
+		barena_pool_count(pool, 1) >= max_free_chunks
+		&& max_free_chunks != 0
+	) {
+		barena_pool_count(pool, (size_t)-1);
+		barena_os_page_free(chunk, barena_chunk_size(chunk));
+	} else {
+		barena_pool_push(pool, chunk, chunk);
+	}
+}
+
+static inline barena_chunk_t*
+barena_pool_acquire(barena_pool_t* pool, size_t size) {
+	barena_chunk_t* chunk;
+	if (pool->options.concurrent) {
+		// Taking the whole stack avoids ABA: a chunk is only read once it is
+		// owned, the rest is pushed back.
+		barena_chunk_t* list = barena_atomic_exchange_chunk(&pool->free_chunks, NULL);
+		barena_chunk_t** itr = &list;
+		while (*itr != NULL && barena_chunk_size(*itr) < size) {
+			itr = &(*itr)->next;
+		}
+
+		chunk = *itr;
+		if (chunk != NULL) { *itr = chunk->next; }
+
+		if (list != NULL) {
+			barena_chunk_t* last = list;
+			while (last->next != NULL) { last = last->next; }
+			barena_pool_push(pool, list, last);
+		}
+	} else {
+		chunk = pool->free_chunks;
+		if (chunk == NULL || barena_chunk_size(chunk) < size) { return NULL; }
+		pool->free_chunks = chunk->next;
+	}
+
+	if (chunk != NULL) { barena_pool_count(pool, (size_t)-1); }
+	return chunk;
+}
+
 void
 barena_pool_init(barena_pool_t* pool, size_t chunk_size) {
-	size_t page_size = barena_os_page_size();
+	barena_pool_init_ex(pool, chunk_size, &(barena_pool_options_t){ 0 });
+}
+
+void
+barena_pool_init_ex(barena_pool_t* pool, size_t chunk_size, const barena_pool_options_t* options) {
+	size_t page_size = barena_os_page_size(options);
 	chunk_size = (size_t)barena_align_ptr((intptr_t)chunk_size, page_size);
 	*pool = (barena_pool_t){
 		.os_page_size = page_size,
 		.chunk_size = chunk_size,
+		.options = *options,
 	};
 }
 
 void
 barena_pool_cleanup(barena_pool_t* pool) {
+	barena_chunk_t* free_chunks = pool->options.concurrent
+		? barena_atomic_exchange_chunk(&pool->free_chunks, NULL)
+		: pool->free_chunks;
 	for (
-		barena_chunk_t* chunk_itr = pool->free_chunks;
+		barena_chunk_t* chunk_itr = free_chunks;
 		chunk_itr != NULL;
 	) {
 		barena_chunk_t* next = chunk_itr->next;
-		barena_os_page_free(chunk_itr, chunk_itr->end - (char*)chunk_itr);
+		barena_os_page_free(chunk_itr, barena_chunk_size(chunk_itr));
 		chunk_itr = next;
 	}
 
 	pool->free_chunks = NULL;
+	pool->num_free_chunks = 0;
 }
 
 void
@@ -136,13 +359,25 @@ barena_alloc_from_chunk(barena_chunk_t* chunk, size_t size, size_t alignment) {
 	return (void*)result;
 }
 
+static inline void
+barena_add_bytes_used(barena_t* arena, size_t size) {
+	arena->stats.bytes_used += size;
+	if (arena->stats.bytes_used > arena->stats.peak_bytes_used) {
+		arena->stats.peak_bytes_used = arena->stats.bytes_used;
+	}
+}
+
 void*
 barena_memalign(barena_t* arena, size_t size, size_t alignment) {
 	if (size == 0) { return NULL; }
 
 	barena_chunk_t* current_chunk = arena->current_chunk;
+	char* bump_ptr = current_chunk != NULL ? current_chunk->bump_ptr : NULL;
 	void* result = barena_alloc_from_chunk(current_chunk, size, alignment);
-	if (result != NULL) { return result; }
+	if (result != NULL) {
+		barena_add_bytes_used(arena, (size_t)(current_chunk->bump_ptr - bump_ptr));
+		return result;
+	}
 
 	// New chunk needed
 	barena_pool_t* pool = arena->pool;
@@ -153,15 +388,10 @@ barena_memalign(barena_t* arena, size_t size, size_t alignment) {
 	);
 	size_t alloc_size = chunk_size >= required_size ? chunk_size : required_size;
 
-	barena_chunk_t* new_chunk;
-	if (
-		pool->free_chunks != NULL
-		&& (size_t)(pool->free_chunks->end - (char*)pool->free_chunks) >= alloc_size
-	) {
-		new_chunk = pool->free_chunks;
-		pool->free_chunks = new_chunk->next;
-	} else {
-		new_chunk = barena_os_page_alloc(alloc_size);
+	barena_chunk_t* new_chunk = barena_pool_acquire(pool, alloc_size);
+	if (new_chunk == NULL) {
+		new_chunk = barena_os_page_alloc(pool, alloc_size);
+		if (new_chunk == NULL) { return NULL; }
 		new_chunk->end = (char*)new_chunk + alloc_size;
 	}
 
@@ -169,7 +399,14 @@ barena_memalign(barena_t* arena, size_t size, size_t alignment) {
 	new_chunk->next = arena->current_chunk;
 	arena->current_chunk = new_chunk;
 
-	return barena_alloc_from_chunk(new_chunk, size, alignment);
+	arena->stats.chunk_bytes += barena_chunk_size(new_chunk);
+	if (arena->stats.chunk_bytes > arena->stats.peak_chunk_bytes) {
+		arena->stats.peak_chunk_bytes = arena->stats.chunk_bytes;
+	}
+
+	result = barena_alloc_from_chunk(new_chunk, size, alignment);
+	barena_add_bytes_used(arena, (size_t)(new_chunk->bump_ptr - new_chunk->begin));
+	return result;
 }
 
 barena_snapshot_t
@@ -188,14 +425,14 @@ barena_restore(barena_t* arena, barena_snapshot_t snapshot) {
 		&& !(itr->begin <= snapshot && snapshot <= itr->end)
 	) {
 		barena_chunk_t* next = itr->next;
-
-		itr->next = pool->free_chunks;
-		pool->free_chunks = itr;
-
+		arena->stats.bytes_used -= (size_t)(itr->bump_ptr - itr->begin);
+		arena->stats.chunk_bytes -= barena_chunk_size(itr);
+		barena_pool_release(pool, itr);
 		itr = next;
 	}
 
 	if (snapshot != NULL) {
+		arena->stats.bytes_used -= (size_t)(itr->bump_ptr - snapshot);
 		itr->bump_ptr = snapshot;
 	}
 	arena->current_chunk = itr;
@@ -206,19 +443,93 @@ barena_reset(barena_t* arena) {
 	barena_restore(arena, NULL);
 }
 
+void*
+barena_realloc(barena_t* arena, void* ptr, size_t old_size, size_t new_size) {
+	if (ptr == NULL) { return barena_malloc(arena, new_size); }
+
+	barena_chunk_t* chunk = arena->current_chunk;
+	char* end = (char*)ptr + old_size;
+	if (
+		chunk != NULL
+		&& end == chunk->bump_ptr
+		&& new_size <= (size_t)(chunk->end - (char*)ptr)
+	) {
+		char* new_end = (char*)ptr + new_size;
+		if (new_end >= end) {
+			barena_add_bytes_used(arena, (size_t)(new_end - end));
+		} else {
+			arena->stats.bytes_used -= (size_t)(end - new_end);
+		}
+		chunk->bump_ptr = new_end;
+		return ptr;
+	}
+
+	if (new_size <= old_size) { return ptr; }
+
+	void* result = barena_malloc(arena, new_size);
+	if (result != NULL) { memcpy(result, ptr, old_size); }
+	return result;
+}
+
+barena_scope_t
+barena_scope_begin(barena_t* arena) {
+	return (barena_scope_t){
+		.arena = arena,
+		.snapshot = barena_snapshot(arena),
+		.depth = arena->scope_depth++,
+	};
+}
+
+void
+barena_scope_end(barena_scope_t* scope) {
+	barena_t* arena = scope->arena;
+	assert(arena->scope_depth == scope->depth + 1 && "scopes must end in reverse order");
+	arena->scope_depth = scope->depth;
+	barena_restore(arena, scope->snapshot);
+}
+
 #if defined(__linux__)
 
+#include <limits.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+
+// From linux/mempolicy.h
+#define BARENA_MPOL_BIND 2
 
 size_t
-barena_os_page_size(void) {
-	return (size_t)sysconf(_SC_PAGE_SIZE);
+barena_os_page_size(const barena_pool_options_t* options) {
+	return options->page_mode != BARENA_PAGES_DEFAULT
+		? BARENA_HUGE_PAGE_SIZE
+		: (size_t)sysconf(_SC_PAGE_SIZE);
 }
 
 void*
-barena_os_page_alloc(size_t size) {
-	return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+barena_os_page_alloc(barena_pool_t* pool, size_t size) {
+	const barena_pool_options_t* options = &pool->options;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void* ptr = MAP_FAILED;
+	if (options->page_mode == BARENA_PAGES_HUGE) {
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+	}
+	if (ptr == MAP_FAILED) {
+		ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+		if (ptr == MAP_FAILED) { return NULL; }
+		if (options->page_mode != BARENA_PAGES_DEFAULT) {
+			madvise(ptr, size, MADV_HUGEPAGE);
+		}
+	}
+
+	// Pages are not touched yet so the policy applies to all of them
+	if (options->numa_bind && options->numa_node < 16 * sizeof(unsigned long) * CHAR_BIT) {
+		unsigned long mask[16] = { 0 };
+		size_t bits = sizeof(unsigned long) * CHAR_BIT;
+		mask[options->numa_node / bits] = 1ul << (options->numa_node % bits);
+		syscall(SYS_mbind, ptr, size, BARENA_MPOL_BIND, mask, sizeof(mask) * CHAR_BIT + 1, 0);
+	}
+
+	return ptr;
 }
 
 void
@@ -235,15 +546,36 @@ barena_os_page_free(void* ptr, size_t size) {
 #include <Windows.h>
 
 size_t
-barena_os_page_size(void) {
+barena_os_page_size(const barena_pool_options_t* options) {
+	size_t large_page_size = GetLargePageMinimum();
+	if (options->page_mode == BARENA_PAGES_HUGE && large_page_size != 0) {
+		return large_page_size;
+	}
+
 	SYSTEM_INFO sys_info;
 	GetSystemInfo(&sys_info);
 	return sys_info.dwPageSize;
 }
 
+static inline void*
+barena_os_virtual_alloc(size_t size, DWORD type, const barena_pool_options_t* options) {
+	if (options->numa_bind) {
+		return VirtualAllocExNuma(GetCurrentProcess(), NULL, size, type, PAGE_READWRITE, options->numa_node);
+	} else {
+		return VirtualAlloc(NULL, size, type, PAGE_READWRITE);
+	}
+}
+
 void*
-barena_os_page_alloc(size_t size) {
-	return VirtualAlloc(NULL, size, MEM_COMMIT, PAGE_READWRITE);
+barena_os_page_alloc(barena_pool_t* pool, size_t size) {
+	void* ptr = NULL;
+	if (pool->options.page_mode == BARENA_PAGES_HUGE) {
+		ptr = barena_os_virtual_alloc(size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, &pool->options);
+	}
+	if (ptr == NULL) {
+		ptr = barena_os_virtual_alloc(size, MEM_RESERVE | MEM_COMMIT, &pool->options);
+	}
+	return ptr;
 }
 
 void
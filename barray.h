@@ -2,6 +2,15 @@
 #define BARRAY_H
 
 #include <stddef.h>
+#include <string.h>
+
+#ifndef BARRAY_ALIGN_TYPE
+#	ifdef _MSC_VER
+#		define BARRAY_ALIGN_TYPE long double
+#	else
+#		define BARRAY_ALIGN_TYPE max_align_t
+#	endif
+#endif
 
 #define barray(T) T*
 
@@ -12,6 +21,21 @@
 		array[barray__new_len - 1] = element; \
 	} while (0)
 
+// Append count elements copied from a pointer
+#define barray_push_n(array, elements, count, ctx) \
+	do { \
+		size_t barray__count = (count); \
+		size_t barray__old_len; \
+		(void)sizeof((array)[0] = (elements)[0]); \
+		array = barray__prepare_push_n(array, &barray__old_len, barray__count, sizeof(*(array)), ctx); \
+		if (barray__count > 0) { \
+			memcpy((array) + barray__old_len, (elements), barray__count * sizeof(*(array))); \
+		} \
+	} while (0)
+
+// Append all elements of another barray
+#define barray_extend(array, src, ctx) barray_push_n(array, src, barray_len(src), ctx)
+
 #define barray_reserve(array, new_capacity, ctx) \
 	do { \
 		array = barray__do_reserve(array, new_capacity, sizeof(*array), ctx); \
@@ -22,8 +46,25 @@
 		array = barray__do_resize(array, new_len, sizeof(*array), ctx); \
 	} while (0)
 
+// Release the unused capacity, an empty array is freed and becomes NULL
+#define barray_shrink_to_fit(array, ctx) \
+	do { \
+		array = barray__do_shrink(array, sizeof(*array), ctx); \
+	} while (0)
+
 #define barray_pop(array) (barray__do_pop(array), array[barray_len(array)])
 
+// When BARRAY_ALLOCATOR is defined, the ctx of every array is a pointer to
+// this, or NULL to use BARRAY_REALLOC.
+// This lets arrays be backed by different allocators.
+// old_size is 0 when the array is freed.
+typedef void* (*barray_realloc_fn_t)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+
+typedef struct barray_allocator_s {
+	barray_realloc_fn_t realloc;
+	void* ctx;
+} barray_allocator_t;
+
 size_t
 barray_len(void* array);
 
@@ -47,9 +88,64 @@ barray__do_reserve(void* array, size_t new_capacity, size_t elem_size, void* ctx
 void*
 barray__do_resize(void* array, size_t new_len, size_t elem_size, void* ctx) ;
 
+void*
+barray__prepare_push_n(void* array, size_t* old_len, size_t count, size_t elem_size, void* ctx);
+
+void*
+barray__do_shrink(void* array, size_t elem_size, void* ctx);
+
 void
 barray__do_pop(void* array);
 
+// Adapters, available when barena.h or tlsf.h is included before this
+
+#ifdef BARENA_H
+
+static inline void*
+barray__arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+	// The memory is only reclaimed with the arena
+	if (new_size == 0) { return NULL; }
+	return barena_realloc(ctx, ptr, old_size, new_size);
+}
+
+static inline barray_allocator_t
+barray_arena_allocator(barena_t* arena) {
+	return (barray_allocator_t){ .realloc = barray__arena_realloc, .ctx = arena };
+}
+
+#endif
+
+#ifdef TLSF_API
+
+static inline void*
+barray__tlsf_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size) {
+	(void)old_size;
+	if (new_size == 0) {
+		tlsf_free(ctx, ptr);
+		return NULL;
+	}
+
+	void* new_ptr = tlsf_realloc(ctx, ptr, new_size);
+	const size_t alignment = _Alignof(BARRAY_ALIGN_TYPE);
+	if (new_ptr == NULL || ((size_t)(uintptr_t)new_ptr & (alignment - 1)) == 0) {
+		return new_ptr;
+	}
+
+	// tlsf only guarantees pointer alignment and tlsf_aalloc wants whole
+	// multiples of the alignment
+	void* aligned_ptr = tlsf_aalloc(ctx, alignment, (new_size + alignment - 1) & ~(alignment - 1));
+	if (aligned_ptr != NULL) { memcpy(aligned_ptr, new_ptr, new_size); }
+	tlsf_free(ctx, new_ptr);
+	return aligned_ptr;
+}
+
+static inline barray_allocator_t
+barray_tlsf_allocator(tlsf_t* tlsf) {
+	return (barray_allocator_t){ .realloc = barray__tlsf_realloc, .ctx = tlsf };
+}
+
+#endif
+
 #endif
 
 #if defined(BLIB_IMPLEMENTATION) && !defined(BARRAY_IMPLEMENTATION)
@@ -58,12 +154,13 @@ barray__do_pop(void* array);
 
 #ifdef BARRAY_IMPLEMENTATION
 
-#ifndef BARRAY_ALIGN_TYPE
-#	ifdef _MSC_VER
-#		define BARRAY_ALIGN_TYPE long double
-#	else
-#		define BARRAY_ALIGN_TYPE max_align_t
-#	endif
+#ifndef BARRAY_MIN_CAPACITY
+#	define BARRAY_MIN_CAPACITY 2
+#endif
+
+// Capacity after growth in percent of the previous one
+#ifndef BARRAY_GROWTH_PERCENT
+#	define BARRAY_GROWTH_PERCENT 200
 #endif
 
 #ifndef BARRAY_REALLOC
@@ -119,11 +216,49 @@ barray_capacity(void* array) {
 	return header != NULL ? header->capacity : 0;
 }
 
+static inline size_t
+barray__block_size(size_t capacity, size_t elem_size) {
+	return sizeof(barray_header_t) + elem_size * capacity;
+}
+
+static inline void*
+barray__realloc(barray_header_t* header, size_t old_size, size_t new_size, void* ctx) {
+#ifdef BARRAY_ALLOCATOR
+	const barray_allocator_t* allocator = ctx;
+	if (allocator != NULL) {
+		return allocator->realloc(allocator->ctx, header, old_size, new_size);
+	}
+#endif
+	(void)old_size;
+	return BARRAY_REALLOC(header, new_size, ctx);
+}
+
+static size_t
+barray__grow_capacity(size_t capacity, size_t min_capacity) {
+	size_t new_capacity = capacity * BARRAY_GROWTH_PERCENT / 100;
+	if (new_capacity <= capacity) { new_capacity = capacity + 1; }
+	if (new_capacity < BARRAY_MIN_CAPACITY) { new_capacity = BARRAY_MIN_CAPACITY; }
+	if (new_capacity < min_capacity) { new_capacity = min_capacity; }
+	return new_capacity;
+}
+
+static barray_header_t*
+barray__set_capacity(void* array, size_t new_capacity, size_t elem_size, void* ctx) {
+	barray_header_t* header = barray__header_of(array);
+	size_t old_size = header != NULL ? barray__block_size(header->capacity, elem_size) : 0;
+	barray_header_t* new_header = barray__realloc(
+		header, old_size, barray__block_size(new_capacity, elem_size), ctx
+	);
+	if (header == NULL) { new_header->len = 0; }
+	new_header->capacity = new_capacity;
+	return new_header;
+}
+
 void
 barray_free(void* ctx, void* array) {
 	barray_header_t* header = barray__header_of(array);
 	if (header != NULL) {
-		BARRAY_REALLOC(header, 0, ctx);
+		barray__realloc(header, 0, 0, ctx);
 	}
 }
 
@@ -136,38 +271,36 @@ barray_clear(void* array) {
 }
 
 void*
-barray__prepare_push(void* array, size_t* new_len, size_t elem_size, void* ctx) {
+barray__prepare_push_n(void* array, size_t* old_len, size_t count, size_t elem_size, void* ctx) {
 	barray_header_t* header = barray__header_of(array);
 	size_t len = header != NULL ? header->len : 0;
 	size_t capacity = header != NULL ? header->capacity : 0;
+	*old_len = len;
+	if (count == 0) { return array; }
 
-	if (len < capacity) {
-		header->len = *new_len = len + 1;
-		return array;
-	} else {
-		size_t new_capacity = capacity > 0 ? capacity * 2 : 2;
-		barray_header_t* new_header = BARRAY_REALLOC(
-			header, sizeof(barray_header_t) + elem_size * new_capacity, ctx
-		);
-		new_header->capacity = new_capacity;
-		new_header->len = *new_len = len + 1;
-		return new_header->elems;
+	if (len + count > capacity) {
+		header = barray__set_capacity(array, barray__grow_capacity(capacity, len + count), elem_size, ctx);
 	}
+	header->len = len + count;
+	return header->elems;
+}
+
+void*
+barray__prepare_push(void* array, size_t* new_len, size_t elem_size, void* ctx) {
+	size_t old_len;
+	array = barray__prepare_push_n(array, &old_len, 1, elem_size, ctx);
+	*new_len = old_len + 1;
+	return array;
 }
 
 void*
 barray__do_reserve(void* array, size_t new_capacity, size_t elem_size, void* ctx) {
-	barray_header_t* header = barray__header_of(array);
-	size_t current_capacity = header != NULL ? header->capacity : 0;
+	size_t current_capacity = barray_capacity(array);
 	if (new_capacity <= current_capacity) {
 		return array;
 	}
 
-	barray_header_t* new_header = BARRAY_REALLOC(
-		header, sizeof(barray_header_t) + elem_size * new_capacity, ctx
-	);
-	new_header->capacity = new_capacity;
-	return new_header->elems;
+	return barray__set_capacity(array, new_capacity, elem_size, ctx)->elems;
 }
 
 void*
@@ -175,17 +308,31 @@ barray__do_resize(void* array, size_t new_len, size_t elem_size, void* ctx) {
 	barray_header_t* header = barray__header_of(array);
 	size_t current_capacity = header != NULL ? header->capacity : 0;
 
-	if (new_len <= current_capacity) {
-		header->len = new_len;
-		return array;
-	} else {
-		barray_header_t* new_header = BARRAY_REALLOC(
-			header, sizeof(barray_header_t) + elem_size * new_len, ctx
+	if (new_len > current_capacity) {
+		header = barray__set_capacity(
+			array, barray__grow_capacity(current_capacity, new_len), elem_size, ctx
 		);
-		new_header->capacity = new_len;
-		new_header->len = new_len;
-		return new_header->elems;
+	} else if (header == NULL) {
+		return array;
 	}
+
+	header->len = new_len;
+	return header->elems;
+}
+
+void*
+barray__do_shrink(void* array, size_t elem_size, void* ctx) {
+	barray_header_t* header = barray__header_of(array);
+	if (header == NULL || header->len == header->capacity) {
+		return array;
+	}
+
+	if (header->len == 0) {
+		barray__realloc(header, barray__block_size(header->capacity, elem_size), 0, ctx);
+		return NULL;
+	}
+
+	return barray__set_capacity(array, header->len, elem_size, ctx)->elems;
 }
 
 void
@@ -73,7 +73,7 @@
 	BCORO_VAR(bcoro_t*, bcoro__clone); \
 	if (bcoro__yielding) { bcoro__self->status = BCORO_SUSPENDED; return; } \
 	bcoro_t* bcoro__subcoro = bcoro__alloc(bcoro__sp, sizeof(bcoro_t), _Alignof(bcoro_t)); \
-	(void)bcoro__subcoro; \
+	bcoro__set_frame_end(bcoro__self, bcoro__subcoro->stack); \
 	switch (bcoro__self->resume_point) { case 0:
 
 /*! Mark the beginning of the cleanup section */
@@ -94,6 +94,7 @@
 		FN(bcoro__subcoro, __VA_ARGS__); \
 		bcoro__self->subcoro = bcoro__subcoro; \
 		BCORO_JOIN(bcoro__subcoro); \
+		bcoro__merge_frame(bcoro__self, bcoro__subcoro); \
 		bcoro__self->subcoro = NULL; \
 	} while (0)
 
@@ -143,11 +144,13 @@
  *
  * The fork will have a copy of the parent's states up to this point.
  * States are naively memcpy-ed.
+ * Only the part of the stack which is in use is copied, see
+ * @ref bcoro_frame_size.
  *
  * @param DEST The coroutine storage to copy to.
  *   This expression will only be evaluated once.
- * @param STACK_SIZE The stack size.
- *   This must be the same as the current stack size.
+ * @param STACK_SIZE The stack size of @p DEST.
+ *   It must be at least the current frame size.
  *
  * @remarks
  *   This will transfer control to the clone.
@@ -172,6 +175,47 @@
 		bcoro_resume(bcoro__clone); \
 	} else
 
+/**
+ * @brief Send an item to a channel, suspending while it is full.
+ *
+ * The producer only switches back once the whole ring buffer is filled so
+ * items are handed off in batches.
+ *
+ * @param CHAN A pointer to a @ref bcoro_chan_t.
+ * @param ITEM A pointer to the item.
+ *   It is evaluated again after every suspension so it should point to a
+ *   @ref BCORO_VAR or to memory which outlives the call.
+ */
+#define BCORO_CHAN_SEND(CHAN, ITEM) \
+	while (!bcoro_chan_push(CHAN, ITEM)) { \
+		BCORO_YIELD(); \
+	}
+
+/**
+ * @brief Receive an item from a channel, suspending while it is empty.
+ *
+ * @param CHAN A pointer to a @ref bcoro_chan_t.
+ * @param ITEM A pointer to where the item is stored.
+ * @param OK A bool lvalue, set to false once the channel is closed and drained.
+ */
+#define BCORO_CHAN_RECV(CHAN, ITEM, OK) \
+	while (!((OK) = bcoro_chan_pop(CHAN, ITEM)) && !bcoro_chan_is_closed(CHAN)) { \
+		BCORO_YIELD(); \
+	}
+
+/**
+ * @brief Receive up to @p MAX items from a channel at once.
+ *
+ * This suspends only while the channel is empty.
+ *
+ * @param COUNT A size_t lvalue, set to the number of items received.
+ *   It is 0 once the channel is closed and drained.
+ */
+#define BCORO_CHAN_RECV_N(CHAN, ITEMS, MAX, COUNT) \
+	while (((COUNT) = bcoro_chan_pop_n(CHAN, ITEMS, MAX)) == 0 && !bcoro_chan_is_closed(CHAN)) { \
+		BCORO_YIELD(); \
+	}
+
 /**
  * @brief The coroutine type.
  *
@@ -198,9 +242,69 @@ struct bcoro_s {
 	void* args;
 	void* vars;
 	void (*fn)(bcoro_t* self, void* args);
+	size_t frame_size;
+	size_t peak_frame_size;
 	char stack[];
 };
 
+#ifndef BCORO_POOL_MIN_FRAME
+//! Size of the smallest frame class in a @ref bcoro_pool_t, every following class doubles
+#define BCORO_POOL_MIN_FRAME 64
+#endif
+
+#ifndef BCORO_POOL_SLAB_SIZE
+//! A @ref bcoro_pool_t allocates frames in slabs of about this size
+#define BCORO_POOL_SLAB_SIZE (16 * 1024)
+#endif
+
+#define BCORO_POOL_NUM_CLASSES 16
+
+/**
+ * @brief A pool of coroutine frames in fixed size classes.
+ *
+ * Frames of the same class are carved out of shared slabs so that
+ * coroutines sized with @ref bcoro_peak_frame_size are packed tightly.
+ * The scheduler also allocates its task frames from such pools.
+ *
+ * A pool is not thread-safe.
+ */
+typedef struct bcoro_pool_s {
+	void* memctx;
+	void* slabs;
+	void* free_frames[BCORO_POOL_NUM_CLASSES];
+	unsigned num_free_frames[BCORO_POOL_NUM_CLASSES];
+} bcoro_pool_t;
+
+/**
+ * @brief A bounded channel: a ring buffer of fixed-size items.
+ *
+ * The storage is provided by the caller.
+ * A channel connects coroutines which are resumed from the same thread and is
+ * not thread-safe.
+ *
+ * @see BCORO_DEFINE_CHAN
+ */
+typedef struct bcoro_chan_s {
+	char* items;
+	size_t item_size;
+	size_t capacity;
+	size_t head;
+	size_t count;
+	bool closed;
+} bcoro_chan_t;
+
+/**
+ * @brief A stage of a pipeline.
+ *
+ * @see bcoro_pipeline_run
+ */
+typedef struct bcoro_pipeline_stage_s {
+	//! The coroutine of this stage.
+	bcoro_t* coro;
+	//! The channel it sends to, closed once it terminates. Can be `NULL`.
+	bcoro_chan_t* output;
+} bcoro_pipeline_stage_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -259,6 +363,436 @@ bcoro_status(bcoro_t* coro);
 BCORO_API void
 bcoro_noop(bcoro_t* coro);
 
+/**
+ * @brief Return the number of stack bytes currently used by a coroutine.
+ *
+ * This includes its arguments, its variables and the running
+ * @ref BCORO_YIELD_FROM subcoroutines.
+ */
+BCORO_API size_t
+bcoro_frame_size(const bcoro_t* coro);
+
+/**
+ * @brief Return the highest stack usage of a coroutine since it was spawned.
+ *
+ * This includes all the subcoroutines it has called so far.
+ * Running a coroutine through a representative workload with a generous stack
+ * gives the stack size to use for all its following instances.
+ */
+BCORO_API size_t
+bcoro_peak_frame_size(const bcoro_t* coro);
+
+/**
+ * @brief Initialize a frame pool.
+ *
+ * @param pool The pool to initialize.
+ * @param memctx Context passed to `BCORO_REALLOC`.
+ */
+BCORO_API void
+bcoro_pool_init(bcoro_pool_t* pool, void* memctx);
+
+/**
+ * @brief Return all the frames of a pool to the allocator.
+ */
+BCORO_API void
+bcoro_pool_cleanup(bcoro_pool_t* pool);
+
+/**
+ * @brief Allocate a coroutine with at least the given stack size.
+ *
+ * @return The coroutine storage or `NULL` if the stack size is too large or
+ *   the allocator failed.
+ */
+BCORO_API bcoro_t*
+bcoro_pool_alloc(bcoro_pool_t* pool, size_t stack_size);
+
+/**
+ * @brief Return a coroutine to its pool.
+ *
+ * @param stack_size The stack size it was allocated with.
+ */
+BCORO_API void
+bcoro_pool_free(bcoro_pool_t* pool, bcoro_t* coro, size_t stack_size);
+
+/**
+ * @brief Initialize a channel.
+ *
+ * @param chan The channel to initialize.
+ * @param items Storage for @p capacity items.
+ * @param item_size The size of an item.
+ * @param capacity The maximum number of buffered items, at least 1.
+ */
+BCORO_API void
+bcoro_chan_init(bcoro_chan_t* chan, void* items, size_t item_size, size_t capacity);
+
+/**
+ * @brief Push an item without suspending.
+ *
+ * @return Whether there was space for it.
+ */
+BCORO_API bool
+bcoro_chan_push(bcoro_chan_t* chan, const void* item);
+
+/**
+ * @brief Pop the oldest item without suspending.
+ *
+ * @return Whether there was an item.
+ */
+BCORO_API bool
+bcoro_chan_pop(bcoro_chan_t* chan, void* item);
+
+/**
+ * @brief Push as many of the given items as there is space for.
+ *
+ * @return The number of items pushed.
+ */
+BCORO_API size_t
+bcoro_chan_push_n(bcoro_chan_t* chan, const void* items, size_t count);
+
+/**
+ * @brief Pop up to @p max items.
+ *
+ * @return The number of items popped.
+ */
+BCORO_API size_t
+bcoro_chan_pop_n(bcoro_chan_t* chan, void* items, size_t max);
+
+/**
+ * @brief Mark the end of the stream.
+ *
+ * Buffered items can still be received.
+ * Pushing to a closed channel is not allowed.
+ */
+BCORO_API void
+bcoro_chan_close(bcoro_chan_t* chan);
+
+BCORO_API bool
+bcoro_chan_is_closed(const bcoro_chan_t* chan);
+
+/**
+ * @brief Return the number of buffered items.
+ */
+BCORO_API size_t
+bcoro_chan_count(const bcoro_chan_t* chan);
+
+/**
+ * @brief Take the next item of a generator.
+ *
+ * A generator is a coroutine which sends items to a channel.
+ * It is only resumed when the channel is empty, which refills it in one go.
+ * The channel is closed once the generator terminates.
+ *
+ * @param gen The generator coroutine.
+ * @param chan The channel it sends to.
+ * @param item Where the item is stored.
+ * @return Whether there was an item, false once the generator is exhausted.
+ */
+BCORO_API bool
+bcoro_gen_next(bcoro_t* gen, bcoro_chan_t* chan, void* item);
+
+/**
+ * @brief Resume every running stage of a pipeline once, in order.
+ *
+ * A stage which terminates has its output channel closed so that the next
+ * stage sees the end of the stream.
+ *
+ * @return Whether any stage is still running.
+ */
+BCORO_API bool
+bcoro_pipeline_step(bcoro_pipeline_stage_t* stages, size_t num_stages);
+
+/**
+ * @brief Run a pipeline until all of its stages have terminated.
+ *
+ * Each stage is expected to receive from the output of the previous one with
+ * @ref BCORO_CHAN_RECV or @ref BCORO_CHAN_RECV_N and to send with
+ * @ref BCORO_CHAN_SEND.
+ * As a stage only suspends when its input is empty or its output is full, every
+ * switch moves a whole batch of items.
+ */
+BCORO_API void
+bcoro_pipeline_run(bcoro_pipeline_stage_t* stages, size_t num_stages);
+
+/**
+ * @brief Define a typed channel.
+ *
+ * This defines `NAME_t` which wraps a @ref bcoro_chan_t as `base` and the
+ * following functions: `NAME_init`, `NAME_push`, `NAME_pop`, `NAME_push_n`,
+ * `NAME_pop_n` and `NAME_next`.
+ * They are the type-checked versions of the `bcoro_chan_*` functions and
+ * @ref bcoro_gen_next.
+ *
+ * @param NAME Prefix of the generated type and functions.
+ * @param T Item type.
+ */
+#define BCORO_DEFINE_CHAN(NAME, T) \
+	typedef struct { bcoro_chan_t base; } NAME##_t; \
+	static inline void \
+	NAME##_init(NAME##_t* chan, T* items, size_t capacity) { \
+		bcoro_chan_init(&chan->base, items, sizeof(T), capacity); \
+	} \
+	static inline bool \
+	NAME##_push(NAME##_t* chan, T item) { \
+		return bcoro_chan_push(&chan->base, &item); \
+	} \
+	static inline bool \
+	NAME##_pop(NAME##_t* chan, T* item) { \
+		return bcoro_chan_pop(&chan->base, item); \
+	} \
+	static inline size_t \
+	NAME##_push_n(NAME##_t* chan, const T* items, size_t count) { \
+		return bcoro_chan_push_n(&chan->base, items, count); \
+	} \
+	static inline size_t \
+	NAME##_pop_n(NAME##_t* chan, T* items, size_t max) { \
+		return bcoro_chan_pop_n(&chan->base, items, max); \
+	} \
+	static inline bool \
+	NAME##_next(bcoro_t* gen, NAME##_t* chan, T* item) { \
+		return bcoro_gen_next(gen, &chan->base, item); \
+	}
+
+#ifdef BCORO_SCHED
+
+/**
+ * @brief Wait for a scheduled task to terminate.
+ *
+ * The current task is parked until then instead of being resumed repeatedly.
+ * This can only be used in a coroutine run by a @ref bcoro_sched_t, including
+ * from inside a @ref BCORO_YIELD_FROM subcoroutine.
+ */
+#define BCORO_AWAIT(TASK) \
+	while (bcoro__task_await(TASK)) { \
+		BCORO_YIELD(); \
+	}
+
+/**
+ * @brief Suspend the current task until @ref bcoro_task_wake is called on it.
+ *
+ * A wake up that arrives before the task is suspended is not lost: the task
+ * is resumed again right away.
+ */
+#define BCORO_PARK() \
+	do { \
+		bcoro_sched_park(); \
+		BCORO_YIELD(); \
+	} while (0)
+
+/**
+ * @brief Suspend the current task for at least @p MS milliseconds.
+ *
+ * The scheduler must have been created with
+ * @ref bcoro_sched_config_t.reactor.
+ */
+#define BCORO_SLEEP(MS) \
+	do { \
+		if (bcoro__sleep(MS)) { BCORO_YIELD(); } \
+	} while (0)
+
+/**
+ * @brief Wait until @ref bcoro_event_set is called on @p EV.
+ *
+ * This returns immediately if the event is already set.
+ */
+#define BCORO_AWAIT_EVENT(EV) \
+	while (bcoro__event_await(EV)) { \
+		BCORO_YIELD(); \
+	}
+
+#ifndef _WIN32
+
+/**
+ * @brief Wait until a file descriptor is readable.
+ *
+ * The scheduler must have been created with
+ * @ref bcoro_sched_config_t.reactor.
+ * Only one task may wait on a given file descriptor at a time.
+ * Readiness can be spurious so non-blocking I/O should still be used.
+ *
+ * This is backed by epoll on Linux and kqueue on BSD and macOS.
+ * It is not available on Windows, where IOCP reports completions rather than
+ * readiness.
+ */
+#define BCORO_AWAIT_READABLE(FD) \
+	do { \
+		if (bcoro__await_fd(FD, false)) { BCORO_YIELD(); } \
+	} while (0)
+
+/**
+ * @brief Wait until a file descriptor is writable.
+ *
+ * @see BCORO_AWAIT_READABLE
+ */
+#define BCORO_AWAIT_WRITABLE(FD) \
+	do { \
+		if (bcoro__await_fd(FD, true)) { BCORO_YIELD(); } \
+	} while (0)
+
+#endif
+
+/**
+ * @brief Start a coroutine function in a task and submit it.
+ *
+ * @param TASK A task from @ref bcoro_task_alloc, evaluated twice.
+ */
+#define BCORO_SPAWN(TASK, FN, ...) \
+	do { \
+		FN(bcoro_task_coro(TASK), __VA_ARGS__); \
+		bcoro_task_submit(TASK); \
+	} while (0)
+
+/**
+ * @brief A pool of worker threads running coroutines.
+ *
+ * Each worker has its own run queue and steals from the others when it runs
+ * dry.
+ * Coroutine memory comes from slabs of size-classed frames which are cached
+ * per worker.
+ *
+ * This requires C11 threads and is enabled by defining `BCORO_SCHED`.
+ */
+typedef struct bcoro_sched_s bcoro_sched_t;
+
+/**
+ * @brief A coroutine owned by a @ref bcoro_sched_t.
+ */
+typedef struct bcoro_task_s bcoro_task_t;
+
+typedef struct bcoro_sched_config_s {
+	//! Number of worker threads, at least 1.
+	unsigned num_workers;
+	//! Context passed to `BCORO_REALLOC`.
+	void* memctx;
+	/**
+	 * @brief Start a reactor thread for @ref BCORO_SLEEP and file descriptor
+	 * waits.
+	 */
+	bool reactor;
+} bcoro_sched_config_t;
+
+/**
+ * @brief A manual-reset event.
+ *
+ * All tasks waiting on it are resumed when it is set and it stays set until it
+ * is reset.
+ */
+typedef struct bcoro_event_s {
+	void* waiters;
+} bcoro_event_t;
+
+/**
+ * @brief Create a scheduler and start its workers.
+ *
+ * @return The scheduler or `NULL` on failure.
+ */
+BCORO_API bcoro_sched_t*
+bcoro_sched_create(const bcoro_sched_config_t* config);
+
+/**
+ * @brief Stop the workers and release all memory.
+ *
+ * Tasks which are still alive are discarded without running their cleanup
+ * code, use @ref bcoro_sched_wait_idle first.
+ */
+BCORO_API void
+bcoro_sched_destroy(bcoro_sched_t* sched);
+
+/**
+ * @brief Block until every submitted task has terminated.
+ *
+ * This must not be called from a worker.
+ */
+BCORO_API void
+bcoro_sched_wait_idle(bcoro_sched_t* sched);
+
+/**
+ * @brief The task running on the calling thread or `NULL`.
+ */
+BCORO_API bcoro_task_t*
+bcoro_sched_current(void);
+
+/**
+ * @brief Do not reschedule the current task after its next yield.
+ *
+ * @see BCORO_PARK
+ */
+BCORO_API void
+bcoro_sched_park(void);
+
+/**
+ * @brief Allocate a task with the given stack size.
+ *
+ * The coroutine of the task is a noop until a coroutine function is called on
+ * @ref bcoro_task_coro.
+ * The caller holds a reference which must be dropped with
+ * @ref bcoro_task_release.
+ *
+ * @return The task or `NULL` when the stack size is too large or memory runs
+ *   out.
+ */
+BCORO_API bcoro_task_t*
+bcoro_task_alloc(bcoro_sched_t* sched, size_t stack_size);
+
+/**
+ * @brief The coroutine of a task.
+ */
+BCORO_API bcoro_t*
+bcoro_task_coro(bcoro_task_t* task);
+
+/**
+ * @brief Queue a task for execution, this must be called exactly once.
+ */
+BCORO_API void
+bcoro_task_submit(bcoro_task_t* task);
+
+/**
+ * @brief Resume a parked task.
+ *
+ * This can be called from any thread and has no effect on a task which is
+ * queued or terminated.
+ *
+ * Only wake tasks which parked themselves with @ref BCORO_PARK: every other
+ * wait expects exactly one wake up from its own source.
+ */
+BCORO_API void
+bcoro_task_wake(bcoro_task_t* task);
+
+/**
+ * @brief Check whether a task has terminated.
+ */
+BCORO_API bool
+bcoro_task_done(bcoro_task_t* task);
+
+BCORO_API void
+bcoro_event_init(bcoro_event_t* event);
+
+/**
+ * @brief Set an event and resume all of its waiters.
+ */
+BCORO_API void
+bcoro_event_set(bcoro_event_t* event);
+
+/**
+ * @brief Clear an event so that it can be waited on again.
+ *
+ * This has no effect on an event which is not set.
+ */
+BCORO_API void
+bcoro_event_reset(bcoro_event_t* event);
+
+BCORO_API bool
+bcoro_event_is_set(bcoro_event_t* event);
+
+/**
+ * @brief Drop the reference returned by @ref bcoro_task_alloc.
+ *
+ * The memory is recycled once the task has also terminated.
+ */
+BCORO_API void
+bcoro_task_release(bcoro_task_t* task);
+
+#endif
+
 #ifndef DOXYGEN
 
 // Private functions, should not be called directly.
@@ -285,23 +819,93 @@ bcoro__init_var(void* var) {
 	(void)var;
 }
 
-#endif
+static inline void
+bcoro__set_frame_end(bcoro_t* coro, char* end) {
+	coro->frame_size = (size_t)(end - coro->stack);
+	if (coro->frame_size > coro->peak_frame_size) {
+		coro->peak_frame_size = coro->frame_size;
+	}
+}
 
-#ifdef __cplusplus
+static inline void
+bcoro__merge_frame(bcoro_t* coro, const bcoro_t* subcoro) {
+	size_t size = (size_t)(subcoro->stack - coro->stack) + subcoro->peak_frame_size;
+	if (size > coro->peak_frame_size) { coro->peak_frame_size = size; }
 }
-#endif
 
-#endif
+#ifdef BCORO_SCHED
 
-#if defined(BLIB_IMPLEMENTATION) && !defined(BCORO_IMPLEMENTATION)
-#define BCORO_IMPLEMENTATION
-#endif
+BCORO_API bool
+bcoro__task_await(bcoro_task_t* task);
 
-#ifdef BCORO_IMPLEMENTATION
+BCORO_API bool
+bcoro__event_await(bcoro_event_t* event);
 
-#include <string.h>
+BCORO_API bool
+bcoro__sleep(uint32_t ms);
 
-size_t
+#ifndef _WIN32
+
+BCORO_API bool
+bcoro__await_fd(int fd, bool write);
+
+#endif
+
+#endif
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#if defined(BLIB_IMPLEMENTATION) && !defined(BCORO_IMPLEMENTATION)
+#define BCORO_IMPLEMENTATION
+#endif
+
+#ifdef BCORO_IMPLEMENTATION
+
+#include <string.h>
+#include <assert.h>
+
+#ifndef BCORO_REALLOC
+#	ifdef BLIB_REALLOC
+#		define BCORO_REALLOC BLIB_REALLOC
+#	else
+#		define BCORO_REALLOC(ptr, size, ctx) bcoro__libc_realloc(ptr, size, ctx)
+#		define BCORO_USE_LIBC
+#	endif
+#endif
+
+#ifdef BCORO_USE_LIBC
+
+#include <stdlib.h>
+
+static inline void*
+bcoro__libc_realloc(void* ptr, size_t size, void* ctx) {
+	(void)ctx;
+	if (size > 0) {
+		return realloc(ptr, size);
+	} else {
+		free(ptr);
+		return NULL;
+	}
+}
+
+#endif
+
+#ifdef _MSC_VER
+#	define BCORO__ALIGN_TYPE long double
+#else
+#	define BCORO__ALIGN_TYPE max_align_t
+#endif
+
+#define BCORO__ALIGN_SIZE(SIZE) \
+	(((SIZE) + _Alignof(BCORO__ALIGN_TYPE) - 1) / _Alignof(BCORO__ALIGN_TYPE) * _Alignof(BCORO__ALIGN_TYPE))
+
+size_t
 bcoro_mem_size(size_t stack_size) {
 	return sizeof(bcoro_t) + stack_size;
 }
@@ -321,6 +925,8 @@ bcoro__start(
 	coro->fn = fn;
 	coro->subcoro = NULL;
 	coro->status = BCORO_SUSPENDED;
+	coro->frame_size = (size_t)((char*)coro->vars - coro->stack);
+	coro->peak_frame_size = coro->frame_size;
 }
 
 bcoro_status_t
@@ -339,6 +945,7 @@ bcoro_resume(bcoro_t* coro) {
 
 	coro->status = BCORO_RUNNING;
 	coro->fn(coro, coro->args);
+	if (coro->subcoro != NULL) { bcoro__merge_frame(coro, coro->subcoro); }
 	return coro->status;
 }
 
@@ -362,6 +969,8 @@ bcoro_noop(bcoro_t* coro) {
 	coro->fn = bcoro__noop_fn;
 	coro->subcoro = NULL;
 	coro->status = BCORO_SUSPENDED;
+	coro->frame_size = 0;
+	coro->peak_frame_size = 0;
 }
 
 void
@@ -374,8 +983,1165 @@ bcoro__copy(bcoro_t* dest, const bcoro_t* src, size_t stack_size) {
 	dest->subcoro = NULL;
 	dest->fn = src->fn;
 	dest->status = src->status;
+	dest->frame_size = src->frame_size;
+	dest->peak_frame_size = src->frame_size;
+
+	// Anything past the frame is either unused or belongs to a subcoroutine,
+	// which the fork does not inherit
+	memcpy(dest->stack, src->stack, src->frame_size < stack_size ? src->frame_size : stack_size);
+}
+
+size_t
+bcoro_frame_size(const bcoro_t* coro) {
+	if (coro->subcoro != NULL) {
+		return (size_t)(coro->subcoro->stack - coro->stack) + bcoro_frame_size(coro->subcoro);
+	} else {
+		return coro->frame_size;
+	}
+}
+
+size_t
+bcoro_peak_frame_size(const bcoro_t* coro) {
+	return coro->peak_frame_size;
+}
+
+// Channels
+
+void
+bcoro_chan_init(bcoro_chan_t* chan, void* items, size_t item_size, size_t capacity) {
+	assert(capacity > 0 && "A channel needs space for at least one item");
+	*chan = (bcoro_chan_t){
+		.items = items,
+		.item_size = item_size,
+		.capacity = capacity,
+	};
+}
+
+bool
+bcoro_chan_push(bcoro_chan_t* chan, const void* item) {
+	return bcoro_chan_push_n(chan, item, 1) == 1;
+}
+
+bool
+bcoro_chan_pop(bcoro_chan_t* chan, void* item) {
+	return bcoro_chan_pop_n(chan, item, 1) == 1;
+}
+
+size_t
+bcoro_chan_push_n(bcoro_chan_t* chan, const void* items, size_t count) {
+	assert(!chan->closed && "Pushing to a closed channel");
+
+	size_t space = chan->capacity - chan->count;
+	if (count > space) { count = space; }
+	if (count == 0) { return 0; }
+
+	size_t tail = chan->head + chan->count;
+	if (tail >= chan->capacity) { tail -= chan->capacity; }
+
+	// Copy up to the end of the ring then wrap around
+	size_t first = chan->capacity - tail;
+	if (first > count) { first = count; }
+	memcpy(chan->items + tail * chan->item_size, items, first * chan->item_size);
+	memcpy(chan->items, (const char*)items + first * chan->item_size, (count - first) * chan->item_size);
+
+	chan->count += count;
+	return count;
+}
+
+size_t
+bcoro_chan_pop_n(bcoro_chan_t* chan, void* items, size_t max) {
+	size_t count = chan->count < max ? chan->count : max;
+	if (count == 0) { return 0; }
+
+	size_t first = chan->capacity - chan->head;
+	if (first > count) { first = count; }
+	memcpy(items, chan->items + chan->head * chan->item_size, first * chan->item_size);
+	memcpy((char*)items + first * chan->item_size, chan->items, (count - first) * chan->item_size);
+
+	chan->head += count;
+	if (chan->head >= chan->capacity) { chan->head -= chan->capacity; }
+	chan->count -= count;
+	return count;
+}
+
+void
+bcoro_chan_close(bcoro_chan_t* chan) {
+	chan->closed = true;
+}
+
+bool
+bcoro_chan_is_closed(const bcoro_chan_t* chan) {
+	return chan->closed;
+}
+
+size_t
+bcoro_chan_count(const bcoro_chan_t* chan) {
+	return chan->count;
+}
+
+bool
+bcoro_gen_next(bcoro_t* gen, bcoro_chan_t* chan, void* item) {
+	while (!bcoro_chan_pop(chan, item)) {
+		if (chan->closed) { return false; }
+
+		if (bcoro_resume(gen) == BCORO_TERMINATED) { chan->closed = true; }
+	}
+
+	return true;
+}
+
+bool
+bcoro_pipeline_step(bcoro_pipeline_stage_t* stages, size_t num_stages) {
+	bool running = false;
+	for (size_t i = 0; i < num_stages; ++i) {
+		bcoro_pipeline_stage_t* stage = &stages[i];
+		if (bcoro_resume(stage->coro) == BCORO_TERMINATED) {
+			if (stage->output != NULL) { stage->output->closed = true; }
+		} else {
+			running = true;
+		}
+	}
+
+	return running;
+}
+
+void
+bcoro_pipeline_run(bcoro_pipeline_stage_t* stages, size_t num_stages) {
+	while (bcoro_pipeline_step(stages, num_stages)) {}
+}
+
+// Frame pool
+
+typedef struct bcoro__pool_slab_s {
+	struct bcoro__pool_slab_s* next;
+} bcoro__pool_slab_t;
+
+typedef struct bcoro__pool_frame_s {
+	struct bcoro__pool_frame_s* next;
+} bcoro__pool_frame_t;
+
+static bool
+bcoro__pool_class(size_t frame_size, unsigned* size_class) {
+	unsigned index = 0;
+	while (((size_t)BCORO_POOL_MIN_FRAME << index) < frame_size) {
+		if (++index == BCORO_POOL_NUM_CLASSES) { return false; }
+	}
+
+	*size_class = index;
+	return true;
+}
+
+static inline void
+bcoro__pool_put(bcoro_pool_t* pool, unsigned size_class, void* mem) {
+	bcoro__pool_frame_t* frame = mem;
+	frame->next = pool->free_frames[size_class];
+	pool->free_frames[size_class] = frame;
+	++pool->num_free_frames[size_class];
+}
+
+static bool
+bcoro__pool_grow(bcoro_pool_t* pool, unsigned size_class) {
+	size_t frame_size = (size_t)BCORO_POOL_MIN_FRAME << size_class;
+	size_t num_frames = BCORO_POOL_SLAB_SIZE / frame_size;
+	if (num_frames == 0) { num_frames = 1; }
+
+	size_t header_size = BCORO__ALIGN_SIZE(sizeof(bcoro__pool_slab_t));
+	bcoro__pool_slab_t* slab = BCORO_REALLOC(NULL, header_size + frame_size * num_frames, pool->memctx);
+	if (slab == NULL) { return false; }
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+
+	// Push in reverse so that frames are handed out in address order
+	char* frames = (char*)slab + header_size;
+	for (size_t i = num_frames; i > 0; --i) {
+		bcoro__pool_put(pool, size_class, frames + frame_size * (i - 1));
+	}
+
+	return true;
+}
+
+// Pop a frame, growing the pool when the class is empty
+static inline void*
+bcoro__pool_take(bcoro_pool_t* pool, unsigned size_class) {
+	if (pool->free_frames[size_class] == NULL && !bcoro__pool_grow(pool, size_class)) {
+		return NULL;
+	}
+
+	bcoro__pool_frame_t* frame = pool->free_frames[size_class];
+	pool->free_frames[size_class] = frame->next;
+	--pool->num_free_frames[size_class];
+	return frame;
+}
+
+void
+bcoro_pool_init(bcoro_pool_t* pool, void* memctx) {
+	*pool = (bcoro_pool_t){ .memctx = memctx };
+}
+
+void
+bcoro_pool_cleanup(bcoro_pool_t* pool) {
+	for (bcoro__pool_slab_t* slab = pool->slabs; slab != NULL;) {
+		bcoro__pool_slab_t* next = slab->next;
+		BCORO_REALLOC(slab, 0, pool->memctx);
+		slab = next;
+	}
+
+	bcoro_pool_init(pool, pool->memctx);
+}
+
+bcoro_t*
+bcoro_pool_alloc(bcoro_pool_t* pool, size_t stack_size) {
+	unsigned size_class;
+	if (!bcoro__pool_class(bcoro_mem_size(stack_size), &size_class)) { return NULL; }
+
+	return bcoro__pool_take(pool, size_class);
+}
+
+void
+bcoro_pool_free(bcoro_pool_t* pool, bcoro_t* coro, size_t stack_size) {
+	if (coro == NULL) { return; }
+
+	unsigned size_class;
+	bool valid = bcoro__pool_class(bcoro_mem_size(stack_size), &size_class);
+	assert(valid && "The coroutine was not allocated from a pool");
+	if (!valid) { return; }
+
+	bcoro__pool_put(pool, size_class, coro);
+}
+
+#ifdef BCORO_SCHED
+
+#include <threads.h>
+#include <time.h>
+
+#if defined(__linux__)
+#	define BCORO__REACTOR_EPOLL
+#	include <errno.h>
+#	include <unistd.h>
+#	include <sys/epoll.h>
+#	include <sys/eventfd.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#	define BCORO__REACTOR_KQUEUE
+#	include <unistd.h>
+#	include <sys/types.h>
+#	include <sys/event.h>
+#	include <sys/time.h>
+#else
+// Timers only, the reactor waits on a condition variable
+#	define BCORO__REACTOR_COND
+#endif
+
+#ifndef BCORO_SCHED_BATCH
+//! Number of frames moved at once between a worker cache and the shared pool
+#define BCORO_SCHED_BATCH 32
+#endif
+
+#define BCORO__MAX_STEAL 32
+#define BCORO__MAX_EVENTS 64
+
+#ifdef _MSC_VER
+#	define BCORO__THREAD_LOCAL __declspec(thread)
+#else
+#	define BCORO__THREAD_LOCAL _Thread_local
+#endif
+
+#ifdef _MSC_VER
+
+#include <intrin.h>
+
+static inline int
+bcoro__atomic_load(int* ptr) {
+	return _InterlockedOr((volatile long*)ptr, 0);
+}
+
+static inline void
+bcoro__atomic_store(int* ptr, int value) {
+	_InterlockedExchange((volatile long*)ptr, value);
+}
+
+static inline int
+bcoro__atomic_add(int* ptr, int value) {
+	return _InterlockedExchangeAdd((volatile long*)ptr, value);
+}
+
+static inline int
+bcoro__atomic_exchange(int* ptr, int value) {
+	return _InterlockedExchange((volatile long*)ptr, value);
+}
+
+static inline bool
+bcoro__atomic_cas(int* ptr, int expected, int desired) {
+	return _InterlockedCompareExchange((volatile long*)ptr, desired, expected) == expected;
+}
+
+static inline void*
+bcoro__atomic_load_ptr(void** ptr) {
+	return _InterlockedCompareExchangePointer(ptr, NULL, NULL);
+}
+
+static inline bool
+bcoro__atomic_cas_ptr(void** ptr, void* expected, void* desired) {
+	return _InterlockedCompareExchangePointer(ptr, desired, expected) == expected;
+}
+
+static inline void*
+bcoro__atomic_exchange_ptr(void** ptr, void* value) {
+	return _InterlockedExchangePointer(ptr, value);
+}
+
+#else
+
+static inline int
+bcoro__atomic_load(int* ptr) {
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline void
+bcoro__atomic_store(int* ptr, int value) {
+	__atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+static inline int
+bcoro__atomic_add(int* ptr, int value) {
+	return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+static inline int
+bcoro__atomic_exchange(int* ptr, int value) {
+	return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool
+bcoro__atomic_cas(int* ptr, int expected, int desired) {
+	return __atomic_compare_exchange_n(
+		ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST
+	);
+}
+
+static inline void*
+bcoro__atomic_load_ptr(void** ptr) {
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline bool
+bcoro__atomic_cas_ptr(void** ptr, void* expected, void* desired) {
+	return __atomic_compare_exchange_n(
+		ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST
+	);
+}
+
+static inline void*
+bcoro__atomic_exchange_ptr(void** ptr, void* value) {
+	return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+#endif
+
+typedef enum bcoro__task_state_e {
+	//! Waiting for a call to bcoro_task_wake, this is also the initial state
+	BCORO__TASK_PARKED,
+	BCORO__TASK_QUEUED,
+	//! Woken up while queued, the next park will not suspend it
+	BCORO__TASK_QUEUED_NOTIFIED,
+	BCORO__TASK_RUNNING,
+	//! Woken up while running, it will be queued again after the resume
+	BCORO__TASK_NOTIFIED,
+	BCORO__TASK_DONE,
+} bcoro__task_state_t;
+
+struct bcoro_task_s {
+	// Links in a run queue or a free list
+	bcoro_task_t* prev;
+	bcoro_task_t* next;
+	// Link in the waiter list of another task
+	bcoro_task_t* next_waiter;
+	// Tasks awaiting this one or bcoro__closed_mark once it is done
+	void* waiters;
+	bcoro_sched_t* sched;
+	int state;
+	int refcount;
+	unsigned size_class;
+	bool park;
+};
+
+#define BCORO__TASK_HEADER_SIZE BCORO__ALIGN_SIZE(sizeof(bcoro_task_t))
+
+typedef struct bcoro__timer_s {
+	uint64_t deadline;
+	bcoro_task_t* task;
+} bcoro__timer_t;
+
+typedef struct bcoro__worker_s {
+	mtx_t mtx;
+	bcoro_task_t* head;
+	bcoro_task_t* tail;
+	int count;
+
+	bcoro_sched_t* sched;
+	thrd_t thread;
+	unsigned index;
+	// Never grows on its own, frames come from the shared pool
+	bcoro_pool_t cache;
+} bcoro__worker_t;
 
-	memcpy(dest->stack, src->stack, stack_size);
+struct bcoro_sched_s {
+	void* memctx;
+	unsigned num_workers;
+	unsigned num_started;
+
+	int stop;
+	int num_queued;
+	int num_sleeping;
+	int num_alive;
+	int next_worker;
+	mtx_t mtx;
+	cnd_t work_cnd;
+	cnd_t idle_cnd;
+
+	mtx_t pool_mtx;
+	// Owns all the slabs
+	bcoro_pool_t pool;
+
+	bool has_reactor;
+	thrd_t reactor_thread;
+	mtx_t reactor_mtx;
+	// A min-heap on the deadline
+	bcoro__timer_t* timers;
+	size_t num_timers;
+	size_t timer_capacity;
+#if defined(BCORO__REACTOR_EPOLL)
+	int epoll_fd;
+	int wake_fd;
+#elif defined(BCORO__REACTOR_KQUEUE)
+	int kqueue_fd;
+#else
+	cnd_t reactor_cnd;
+#endif
+
+	bcoro__worker_t workers[];
+};
+
+// Closes a waiter list: a finished task or a set event
+static char bcoro__closed_mark;
+static BCORO__THREAD_LOCAL bcoro__worker_t* bcoro__current_worker = NULL;
+static BCORO__THREAD_LOCAL bcoro_task_t* bcoro__current_task = NULL;
+
+static inline bcoro__worker_t*
+bcoro__local_worker(bcoro_sched_t* sched) {
+	bcoro__worker_t* worker = bcoro__current_worker;
+	return worker != NULL && worker->sched == sched ? worker : NULL;
+}
+
+// Frame pool
+
+// Move a batch of frames from the shared pool, which grows as needed
+static void
+bcoro__cache_refill(bcoro_sched_t* sched, bcoro_pool_t* cache, unsigned size_class) {
+	mtx_lock(&sched->pool_mtx);
+	for (unsigned i = 0; i < BCORO_SCHED_BATCH; ++i) {
+		void* frame = bcoro__pool_take(&sched->pool, size_class);
+		if (frame == NULL) { break; }
+		bcoro__pool_put(cache, size_class, frame);
+	}
+	mtx_unlock(&sched->pool_mtx);
+}
+
+// Move a batch of frames back to the shared pool
+static void
+bcoro__cache_flush(bcoro_sched_t* sched, bcoro_pool_t* cache, unsigned size_class) {
+	mtx_lock(&sched->pool_mtx);
+	for (unsigned i = 0; i < BCORO_SCHED_BATCH && cache->free_frames[size_class] != NULL; ++i) {
+		bcoro__pool_put(&sched->pool, size_class, bcoro__pool_take(cache, size_class));
+	}
+	mtx_unlock(&sched->pool_mtx);
+}
+
+static void
+bcoro__task_free(bcoro_task_t* task) {
+	bcoro_sched_t* sched = task->sched;
+	unsigned size_class = task->size_class;
+	bcoro__worker_t* worker = bcoro__local_worker(sched);
+	if (worker != NULL) {
+		bcoro__pool_put(&worker->cache, size_class, task);
+		if (worker->cache.num_free_frames[size_class] >= 2 * BCORO_SCHED_BATCH) {
+			bcoro__cache_flush(sched, &worker->cache, size_class);
+		}
+	} else {
+		mtx_lock(&sched->pool_mtx);
+		bcoro__pool_put(&sched->pool, size_class, task);
+		mtx_unlock(&sched->pool_mtx);
+	}
+}
+
+// Run queues
+
+// Returns the number of tasks which were already queued
+static int
+bcoro__queue_push(bcoro__worker_t* worker, bcoro_task_t* first, bcoro_task_t* last, int count) {
+	mtx_lock(&worker->mtx);
+	int queued = worker->count;
+	first->prev = worker->tail;
+	last->next = NULL;
+	if (worker->tail != NULL) {
+		worker->tail->next = first;
+	} else {
+		worker->head = first;
+	}
+	worker->tail = last;
+	worker->count += count;
+	mtx_unlock(&worker->mtx);
+	return queued;
+}
+
+static bcoro_task_t*
+bcoro__queue_pop(bcoro__worker_t* worker) {
+	mtx_lock(&worker->mtx);
+	bcoro_task_t* task = worker->head;
+	if (task != NULL) {
+		worker->head = task->next;
+		if (worker->head != NULL) {
+			worker->head->prev = NULL;
+		} else {
+			worker->tail = NULL;
+		}
+		--worker->count;
+	}
+	mtx_unlock(&worker->mtx);
+	return task;
+}
+
+// Take up to half of another worker's queue from its back.
+static bcoro_task_t*
+bcoro__queue_steal(bcoro__worker_t* thief) {
+	bcoro_sched_t* sched = thief->sched;
+	for (unsigned i = 1; i < sched->num_workers; ++i) {
+		bcoro__worker_t* victim = &sched->workers[(thief->index + i) % sched->num_workers];
+
+		mtx_lock(&victim->mtx);
+		int count = (victim->count + 1) / 2;
+		if (count > BCORO__MAX_STEAL) { count = BCORO__MAX_STEAL; }
+		if (count == 0) {
+			mtx_unlock(&victim->mtx);
+			continue;
+		}
+
+		bcoro_task_t* last = victim->tail;
+		bcoro_task_t* first = last;
+		for (int j = 1; j < count; ++j) { first = first->prev; }
+
+		victim->tail = first->prev;
+		if (victim->tail != NULL) {
+			victim->tail->next = NULL;
+		} else {
+			victim->head = NULL;
+		}
+		victim->count -= count;
+		mtx_unlock(&victim->mtx);
+
+		if (count > 1) {
+			first->next->prev = NULL;
+			bcoro__queue_push(thief, first->next, last, count - 1);
+		}
+		return first;
+	}
+
+	return NULL;
+}
+
+static void
+bcoro__sched_push(bcoro_sched_t* sched, bcoro_task_t* task, bool requeue) {
+	bcoro__worker_t* worker = bcoro__local_worker(sched);
+	if (worker == NULL) {
+		unsigned index = (unsigned)bcoro__atomic_add(&sched->next_worker, 1);
+		worker = &sched->workers[index % sched->num_workers];
+	}
+
+	int queued = bcoro__queue_push(worker, task, task, 1);
+	bcoro__atomic_add(&sched->num_queued, 1);
+
+	// A task yielding to an empty queue will run again right away
+	if ((!requeue || queued > 0) && bcoro__atomic_load(&sched->num_sleeping) > 0) {
+		mtx_lock(&sched->mtx);
+		cnd_signal(&sched->work_cnd);
+		mtx_unlock(&sched->mtx);
+	}
+}
+
+// Waiter lists
+
+// Adds the current task to a waiter list, returns false if it is closed
+static bool
+bcoro__waiters_push(void** waiters) {
+	bcoro_task_t* self = bcoro__current_task;
+	assert(self != NULL && "Only a scheduled task can wait");
+
+	for (;;) {
+		void* head = bcoro__atomic_load_ptr(waiters);
+		if (head == &bcoro__closed_mark) { return false; }
+
+		self->next_waiter = head;
+		if (bcoro__atomic_cas_ptr(waiters, head, self)) { break; }
+	}
+
+	self->park = true;
+	return true;
+}
+
+static void
+bcoro__waiters_close(void** waiters) {
+	bcoro_task_t* waiter = bcoro__atomic_exchange_ptr(waiters, &bcoro__closed_mark);
+	if ((void*)waiter == &bcoro__closed_mark) { return; }
+
+	while (waiter != NULL) {
+		// Read the link first: the waiter may run and wait again once woken
+		bcoro_task_t* next = waiter->next_waiter;
+		bcoro_task_wake(waiter);
+		waiter = next;
+	}
+}
+
+// Reactor
+
+static uint64_t
+bcoro__now_ns(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void
+bcoro__reactor_interrupt(bcoro_sched_t* sched) {
+#if defined(BCORO__REACTOR_EPOLL)
+	uint64_t one = 1;
+	ssize_t written = write(sched->wake_fd, &one, sizeof(one));
+	(void)written;
+#elif defined(BCORO__REACTOR_KQUEUE)
+	struct kevent change;
+	EV_SET(&change, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, NULL);
+	kevent(sched->kqueue_fd, &change, 1, NULL, 0, NULL);
+#else
+	cnd_signal(&sched->reactor_cnd);
+#endif
+}
+
+static void
+bcoro__timer_swap(bcoro__timer_t* timers, size_t a, size_t b) {
+	bcoro__timer_t tmp = timers[a];
+	timers[a] = timers[b];
+	timers[b] = tmp;
+}
+
+// Must be called with reactor_mtx held
+static bool
+bcoro__timer_push(bcoro_sched_t* sched, uint64_t deadline, bcoro_task_t* task) {
+	if (sched->num_timers == sched->timer_capacity) {
+		size_t capacity = sched->timer_capacity > 0 ? sched->timer_capacity * 2 : 64;
+		bcoro__timer_t* timers = BCORO_REALLOC(
+			sched->timers, sizeof(bcoro__timer_t) * capacity, sched->memctx
+		);
+		if (timers == NULL) { return false; }
+		sched->timers = timers;
+		sched->timer_capacity = capacity;
+	}
+
+	bcoro__timer_t* timers = sched->timers;
+	size_t index = sched->num_timers++;
+	timers[index] = (bcoro__timer_t){ .deadline = deadline, .task = task };
+	while (index > 0 && timers[(index - 1) / 2].deadline > timers[index].deadline) {
+		bcoro__timer_swap(timers, index, (index - 1) / 2);
+		index = (index - 1) / 2;
+	}
+
+	return true;
+}
+
+// Must be called with reactor_mtx held
+static bcoro_task_t*
+bcoro__timer_pop(bcoro_sched_t* sched) {
+	bcoro__timer_t* timers = sched->timers;
+	bcoro_task_t* task = timers[0].task;
+	timers[0] = timers[--sched->num_timers];
+
+	size_t index = 0;
+	for (;;) {
+		size_t smallest = index;
+		size_t left = index * 2 + 1;
+		size_t right = left + 1;
+		if (left < sched->num_timers && timers[left].deadline < timers[smallest].deadline) {
+			smallest = left;
+		}
+		if (right < sched->num_timers && timers[right].deadline < timers[smallest].deadline) {
+			smallest = right;
+		}
+		if (smallest == index) { break; }
+
+		bcoro__timer_swap(timers, index, smallest);
+		index = smallest;
+	}
+
+	return task;
+}
+
+static int
+bcoro__reactor_main(void* userdata) {
+	bcoro_sched_t* sched = userdata;
+
+	mtx_lock(&sched->reactor_mtx);
+	while (!bcoro__atomic_load(&sched->stop)) {
+		uint64_t now = bcoro__now_ns();
+		while (sched->num_timers > 0 && sched->timers[0].deadline <= now) {
+			bcoro_task_wake(bcoro__timer_pop(sched));
+		}
+
+		bool has_timeout = sched->num_timers > 0;
+		uint64_t timeout = has_timeout ? sched->timers[0].deadline - now : 0;
+
+#if defined(BCORO__REACTOR_COND)
+		if (has_timeout) {
+			uint64_t deadline = now + timeout;
+			struct timespec ts = {
+				.tv_sec = (time_t)(deadline / 1000000000u),
+				.tv_nsec = (long)(deadline % 1000000000u),
+			};
+			cnd_timedwait(&sched->reactor_cnd, &sched->reactor_mtx, &ts);
+		} else {
+			cnd_wait(&sched->reactor_cnd, &sched->reactor_mtx);
+		}
+#else
+		mtx_unlock(&sched->reactor_mtx);
+
+#	if defined(BCORO__REACTOR_EPOLL)
+		struct epoll_event events[BCORO__MAX_EVENTS];
+		// Round up so that timers never fire early
+		int timeout_ms = has_timeout ? (int)((timeout + 999999u) / 1000000u) : -1;
+		int num_events = epoll_wait(sched->epoll_fd, events, BCORO__MAX_EVENTS, timeout_ms);
+		for (int i = 0; i < num_events; ++i) {
+			if (events[i].data.ptr == NULL) {
+				uint64_t count;
+				ssize_t num_read = read(sched->wake_fd, &count, sizeof(count));
+				(void)num_read;
+			} else {
+				bcoro_task_wake(events[i].data.ptr);
+			}
+		}
+#	else
+		struct kevent events[BCORO__MAX_EVENTS];
+		struct timespec ts = {
+			.tv_sec = (time_t)(timeout / 1000000000u),
+			.tv_nsec = (long)(timeout % 1000000000u),
+		};
+		int num_events = kevent(
+			sched->kqueue_fd, NULL, 0, events, BCORO__MAX_EVENTS, has_timeout ? &ts : NULL
+		);
+		for (int i = 0; i < num_events; ++i) {
+			if (events[i].filter != EVFILT_USER) {
+				bcoro_task_wake(events[i].udata);
+			}
+		}
+#	endif
+
+		mtx_lock(&sched->reactor_mtx);
+#endif
+	}
+	mtx_unlock(&sched->reactor_mtx);
+
+	return 0;
+}
+
+static bool
+bcoro__reactor_init(bcoro_sched_t* sched) {
+#if defined(BCORO__REACTOR_EPOLL)
+	sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (sched->epoll_fd < 0) { return false; }
+
+	sched->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+	if (
+		sched->wake_fd < 0
+		|| epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, sched->wake_fd, &event) != 0
+	) {
+		if (sched->wake_fd >= 0) { close(sched->wake_fd); }
+		close(sched->epoll_fd);
+		return false;
+	}
+#elif defined(BCORO__REACTOR_KQUEUE)
+	sched->kqueue_fd = kqueue();
+	if (sched->kqueue_fd < 0) { return false; }
+
+	struct kevent change;
+	EV_SET(&change, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, NULL);
+	if (kevent(sched->kqueue_fd, &change, 1, NULL, 0, NULL) != 0) {
+		close(sched->kqueue_fd);
+		return false;
+	}
+#else
+	cnd_init(&sched->reactor_cnd);
+#endif
+
+	mtx_init(&sched->reactor_mtx, mtx_plain);
+	if (thrd_create(&sched->reactor_thread, bcoro__reactor_main, sched) != thrd_success) {
+		mtx_destroy(&sched->reactor_mtx);
+#if defined(BCORO__REACTOR_EPOLL)
+		close(sched->wake_fd);
+		close(sched->epoll_fd);
+#elif defined(BCORO__REACTOR_KQUEUE)
+		close(sched->kqueue_fd);
+#else
+		cnd_destroy(&sched->reactor_cnd);
+#endif
+		return false;
+	}
+
+	return true;
+}
+
+static void
+bcoro__reactor_cleanup(bcoro_sched_t* sched) {
+	mtx_lock(&sched->reactor_mtx);
+	bcoro__reactor_interrupt(sched);
+	mtx_unlock(&sched->reactor_mtx);
+	thrd_join(sched->reactor_thread, NULL);
+
+#if defined(BCORO__REACTOR_EPOLL)
+	close(sched->wake_fd);
+	close(sched->epoll_fd);
+#elif defined(BCORO__REACTOR_KQUEUE)
+	close(sched->kqueue_fd);
+#else
+	cnd_destroy(&sched->reactor_cnd);
+#endif
+	mtx_destroy(&sched->reactor_mtx);
+	BCORO_REALLOC(sched->timers, 0, sched->memctx);
+}
+
+// Execution
+
+static void
+bcoro__task_finish(bcoro_task_t* task) {
+	bcoro_sched_t* sched = task->sched;
+	bcoro__atomic_store(&task->state, BCORO__TASK_DONE);
+	bcoro__waiters_close(&task->waiters);
+
+	bcoro_task_release(task);
+
+	if (bcoro__atomic_add(&sched->num_alive, -1) == 1) {
+		mtx_lock(&sched->mtx);
+		cnd_broadcast(&sched->idle_cnd);
+		mtx_unlock(&sched->mtx);
+	}
+}
+
+static void
+bcoro__task_run(bcoro_task_t* task) {
+	if (bcoro__atomic_exchange(&task->state, BCORO__TASK_RUNNING) == BCORO__TASK_QUEUED_NOTIFIED) {
+		bcoro__atomic_store(&task->state, BCORO__TASK_NOTIFIED);
+	}
+	task->park = false;
+
+	bcoro__current_task = task;
+	bcoro_status_t status = bcoro_resume(bcoro_task_coro(task));
+	bcoro__current_task = NULL;
+
+	if (status == BCORO_TERMINATED) {
+		bcoro__task_finish(task);
+	} else if (
+		task->park
+		&& bcoro__atomic_cas(&task->state, BCORO__TASK_RUNNING, BCORO__TASK_PARKED)
+	) {
+		// Someone else will wake it up
+	} else {
+		bcoro__atomic_store(&task->state, BCORO__TASK_QUEUED);
+		bcoro__sched_push(task->sched, task, true);
+	}
+}
+
+static int
+bcoro__worker_main(void* userdata) {
+	bcoro__worker_t* worker = userdata;
+	bcoro_sched_t* sched = worker->sched;
+	bcoro__current_worker = worker;
+
+	while (!bcoro__atomic_load(&sched->stop)) {
+		bcoro_task_t* task = bcoro__queue_pop(worker);
+		if (task == NULL) { task = bcoro__queue_steal(worker); }
+
+		if (task != NULL) {
+			bcoro__atomic_add(&sched->num_queued, -1);
+			bcoro__task_run(task);
+			continue;
+		}
+
+		mtx_lock(&sched->mtx);
+		bcoro__atomic_add(&sched->num_sleeping, 1);
+		if (
+			bcoro__atomic_load(&sched->num_queued) == 0
+			&& !bcoro__atomic_load(&sched->stop)
+		) {
+			cnd_wait(&sched->work_cnd, &sched->mtx);
+		}
+		bcoro__atomic_add(&sched->num_sleeping, -1);
+		mtx_unlock(&sched->mtx);
+	}
+
+	bcoro__current_worker = NULL;
+	return 0;
+}
+
+// Public API
+
+bcoro_sched_t*
+bcoro_sched_create(const bcoro_sched_config_t* config) {
+	unsigned num_workers = config->num_workers > 0 ? config->num_workers : 1;
+	size_t size = sizeof(bcoro_sched_t) + sizeof(bcoro__worker_t) * num_workers;
+	bcoro_sched_t* sched = BCORO_REALLOC(NULL, size, config->memctx);
+	if (sched == NULL) { return NULL; }
+
+	memset(sched, 0, size);
+	sched->memctx = config->memctx;
+	sched->num_workers = num_workers;
+	mtx_init(&sched->mtx, mtx_plain);
+	cnd_init(&sched->work_cnd);
+	cnd_init(&sched->idle_cnd);
+	mtx_init(&sched->pool_mtx, mtx_plain);
+	bcoro_pool_init(&sched->pool, config->memctx);
+
+	for (unsigned i = 0; i < num_workers; ++i) {
+		bcoro__worker_t* worker = &sched->workers[i];
+		mtx_init(&worker->mtx, mtx_plain);
+		worker->sched = sched;
+		worker->index = i;
+		bcoro_pool_init(&worker->cache, config->memctx);
+	}
+
+	for (unsigned i = 0; i < num_workers; ++i) {
+		bcoro__worker_t* worker = &sched->workers[i];
+		if (thrd_create(&worker->thread, bcoro__worker_main, worker) != thrd_success) {
+			bcoro_sched_destroy(sched);
+			return NULL;
+		}
+		sched->num_started = i + 1;
+	}
+
+	if (config->reactor) {
+		if (!bcoro__reactor_init(sched)) {
+			bcoro_sched_destroy(sched);
+			return NULL;
+		}
+		sched->has_reactor = true;
+	}
+
+	return sched;
+}
+
+void
+bcoro_sched_destroy(bcoro_sched_t* sched) {
+	bcoro__atomic_store(&sched->stop, 1);
+	mtx_lock(&sched->mtx);
+	cnd_broadcast(&sched->work_cnd);
+	mtx_unlock(&sched->mtx);
+
+	for (unsigned i = 0; i < sched->num_started; ++i) {
+		thrd_join(sched->workers[i].thread, NULL);
+	}
+
+	if (sched->has_reactor) { bcoro__reactor_cleanup(sched); }
+
+	// Cached frames all live in the slabs of the shared pool
+	bcoro_pool_cleanup(&sched->pool);
+
+	for (unsigned i = 0; i < sched->num_workers; ++i) {
+		mtx_destroy(&sched->workers[i].mtx);
+	}
+	mtx_destroy(&sched->pool_mtx);
+	cnd_destroy(&sched->idle_cnd);
+	cnd_destroy(&sched->work_cnd);
+	mtx_destroy(&sched->mtx);
+
+	BCORO_REALLOC(sched, 0, sched->memctx);
+}
+
+void
+bcoro_sched_wait_idle(bcoro_sched_t* sched) {
+	assert(bcoro__local_worker(sched) == NULL && "Waiting from a worker would deadlock");
+
+	mtx_lock(&sched->mtx);
+	while (bcoro__atomic_load(&sched->num_alive) > 0) {
+		cnd_wait(&sched->idle_cnd, &sched->mtx);
+	}
+	mtx_unlock(&sched->mtx);
 }
 
+bcoro_task_t*
+bcoro_sched_current(void) {
+	return bcoro__current_task;
+}
+
+void
+bcoro_sched_park(void) {
+	assert(bcoro__current_task != NULL && "Only a scheduled task can park");
+	bcoro__current_task->park = true;
+}
+
+bcoro_task_t*
+bcoro_task_alloc(bcoro_sched_t* sched, size_t stack_size) {
+	size_t size = BCORO__TASK_HEADER_SIZE + bcoro_mem_size(stack_size);
+	unsigned size_class;
+	if (!bcoro__pool_class(size, &size_class)) { return NULL; }
+
+	bcoro_task_t* task;
+	bcoro__worker_t* worker = bcoro__local_worker(sched);
+	if (worker != NULL) {
+		bcoro_pool_t* cache = &worker->cache;
+		if (cache->free_frames[size_class] == NULL) {
+			bcoro__cache_refill(sched, cache, size_class);
+			if (cache->free_frames[size_class] == NULL) { return NULL; }
+		}
+		task = bcoro__pool_take(cache, size_class);
+	} else {
+		mtx_lock(&sched->pool_mtx);
+		task = bcoro__pool_take(&sched->pool, size_class);
+		mtx_unlock(&sched->pool_mtx);
+	}
+	if (task == NULL) { return NULL; }
+
+	*task = (bcoro_task_t){
+		.sched = sched,
+		.state = BCORO__TASK_PARKED,
+		// One for the caller and one for the scheduler
+		.refcount = 2,
+		.size_class = size_class,
+	};
+	bcoro_noop(bcoro_task_coro(task));
+	return task;
+}
+
+bcoro_t*
+bcoro_task_coro(bcoro_task_t* task) {
+	return (bcoro_t*)((char*)task + BCORO__TASK_HEADER_SIZE);
+}
+
+void
+bcoro_task_submit(bcoro_task_t* task) {
+	bcoro__atomic_add(&task->sched->num_alive, 1);
+	bcoro_task_wake(task);
+}
+
+void
+bcoro_task_wake(bcoro_task_t* task) {
+	for (;;) {
+		int state = bcoro__atomic_load(&task->state);
+		if (state == BCORO__TASK_PARKED) {
+			if (bcoro__atomic_cas(&task->state, state, BCORO__TASK_QUEUED)) {
+				bcoro__sched_push(task->sched, task, false);
+				return;
+			}
+		} else if (state == BCORO__TASK_QUEUED) {
+			if (bcoro__atomic_cas(&task->state, state, BCORO__TASK_QUEUED_NOTIFIED)) {
+				return;
+			}
+		} else if (state == BCORO__TASK_RUNNING) {
+			if (bcoro__atomic_cas(&task->state, state, BCORO__TASK_NOTIFIED)) {
+				return;
+			}
+		} else {
+			return;
+		}
+	}
+}
+
+bool
+bcoro_task_done(bcoro_task_t* task) {
+	return bcoro__atomic_load_ptr(&task->waiters) == &bcoro__closed_mark;
+}
+
+void
+bcoro_task_release(bcoro_task_t* task) {
+	if (bcoro__atomic_add(&task->refcount, -1) == 1) {
+		bcoro__task_free(task);
+	}
+}
+
+bool
+bcoro__task_await(bcoro_task_t* task) {
+	return bcoro__waiters_push(&task->waiters);
+}
+
+void
+bcoro_event_init(bcoro_event_t* event) {
+	event->waiters = NULL;
+}
+
+void
+bcoro_event_set(bcoro_event_t* event) {
+	bcoro__waiters_close(&event->waiters);
+}
+
+void
+bcoro_event_reset(bcoro_event_t* event) {
+	bcoro__atomic_cas_ptr(&event->waiters, &bcoro__closed_mark, NULL);
+}
+
+bool
+bcoro_event_is_set(bcoro_event_t* event) {
+	return bcoro__atomic_load_ptr(&event->waiters) == &bcoro__closed_mark;
+}
+
+bool
+bcoro__event_await(bcoro_event_t* event) {
+	return bcoro__waiters_push(&event->waiters);
+}
+
+bool
+bcoro__sleep(uint32_t ms) {
+	bcoro_task_t* self = bcoro__current_task;
+	assert(self != NULL && "Only a scheduled task can sleep");
+	bcoro_sched_t* sched = self->sched;
+	assert(sched->has_reactor && "The scheduler has no reactor");
+
+	uint64_t deadline = bcoro__now_ns() + (uint64_t)ms * 1000000u;
+	mtx_lock(&sched->reactor_mtx);
+	bool pushed = bcoro__timer_push(sched, deadline, self);
+	if (pushed && sched->timers[0].task == self) {
+		bcoro__reactor_interrupt(sched);
+	}
+	mtx_unlock(&sched->reactor_mtx);
+
+	self->park = pushed;
+	return pushed;
+}
+
+#ifndef _WIN32
+
+bool
+bcoro__await_fd(int fd, bool write) {
+	bcoro_task_t* self = bcoro__current_task;
+	assert(self != NULL && "Only a scheduled task can wait");
+	bcoro_sched_t* sched = self->sched;
+	assert(sched->has_reactor && "The scheduler has no reactor");
+
+#if defined(BCORO__REACTOR_EPOLL)
+	// One shot: the registration stays but is disarmed once it fires
+	struct epoll_event event = {
+		.events = (write ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT,
+		.data.ptr = self,
+	};
+	int result = epoll_ctl(sched->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+	if (result != 0 && errno == ENOENT) {
+		result = epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+	}
+#else
+	struct kevent change;
+	EV_SET(&change, fd, write ? EVFILT_WRITE : EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, self);
+	int result = kevent(sched->kqueue_fd, &change, 1, NULL, 0, NULL);
+#endif
+
+	self->park = result == 0;
+	return result == 0;
+}
+
+#endif
+
+#endif
+
 #endif
@@ -31,6 +31,16 @@ typedef BHASH_HASH_TYPE bhash_hash_t;
 typedef bhash_hash_t (*bhash_hash_fn_t)(const void* key, size_t size);
 typedef bool (*bhash_eq_fn_t)(const void* lhs, const void* rhs, size_t size);
 
+/**
+ * @brief Output function for @ref bhash_freeze.
+ *
+ * @param ctx The context given to @ref bhash_freeze.
+ * @param buf The buffer to write.
+ * @param size How many bytes to write.
+ * @return Number of bytes written.
+ */
+typedef size_t (*bhash_write_fn_t)(void* ctx, const void* buf, size_t size);
+
 /*! Configuration for a hash table */
 typedef struct bhash_config_s {
 	/*! Hash function */
@@ -63,6 +73,34 @@ typedef struct bhash_config_s {
 	/*! Whether the hashtable supports removal */
 	bool removable;
 
+	/**
+	 * @brief Whether to probe slots in groups using a control byte array.
+	 *
+	 * Each slot keeps a 7-bit tag of its hash in a separate byte array.
+	 * A whole group of 16 (SSE2, NEON) or 32 (AVX2) tags is compared at once
+	 * before touching the indices and hashes array, similar to a Swiss table.
+	 *
+	 * The minimum capacity of the table is raised to one group.
+	 */
+	bool group_probe;
+
+	/**
+	 * @brief Number of slots to migrate per operation when the index is rebuilt.
+	 *
+	 * When this is 0, the index is rebuilt at once when the table grows.
+	 *
+	 * Otherwise, the old index is kept alongside the new one and every
+	 * @ref bhash_alloc, @ref bhash_find and @ref bhash_remove moves this many
+	 * of its slots into the new index.
+	 * This bounds the latency of the operation which triggers a rehash.
+	 * The keys and values arrays are still reallocated at once.
+	 *
+	 * If the migration is still pending when another rehash is needed, it is
+	 * completed at once.
+	 * A value of at least `200 / load_percent` avoids that.
+	 */
+	bhash_index_t incremental_rehash;
+
 	/*! Context passed to allocator */
 	void* memctx;
 } bhash_config_t;
@@ -83,9 +121,17 @@ typedef struct bhash_base_s {
 	bhash_index_t* indices;
 	bhash_index_t* r_indices;
 	bhash_hash_t* hashes;
+	uint8_t* ctrl;
+	bhash_index_t* old_indices;
+	uint8_t* old_ctrl;
 	bhash_index_t len;
 	bhash_index_t free_space;
 	bhash_index_t exp;
+	bhash_index_t old_exp;
+	bhash_index_t migrate_pos;
+	bhash_index_t migrate_step;
+	void* block;
+	const void* image;
 } bhash_base_t;
 
 /*! Result of @ref bhash_alloc */
@@ -194,6 +240,57 @@ typedef struct {
 		config \
 	)
 
+/**
+ * @brief Initialize a hashtable from an array of distinct keys and values.
+ *
+ * The table is sized to fit all entries up front.
+ * Keys and values are copied with a single memcpy each and the index is filled
+ * in a single pass.
+ * When there are at least @ref BHASH_BUILD_SORT_MIN entries, they are inserted
+ * in the order of their slots to make writes to the index sequential.
+ *
+ * All arrays of the table live in a single allocation which is made with
+ * @ref bhash_config_t.memctx.
+ * This makes it possible to free the table at once, for example, by discarding
+ * an arena.
+ * The table is still usable as a regular table, it is moved into separate
+ * allocations when it needs to grow.
+ *
+ * @param table Address of the hashtable (defined with @ref BHASH_TABLE).
+ * @param key_array Array of keys.
+ *   The keys must be distinct.
+ * @param value_array Array of values.
+ * @param n Number of entries.
+ * @param config The configuration (@ref bhash_config_t).
+ *
+ * @remarks The indices of the entries will be the same as in the given arrays.
+ */
+#define bhash_build(table, key_array, value_array, n, config) \
+	( \
+		BHASH__TYPECHECK_EXP((table)->keys[0], (key_array)[0]), \
+		BHASH__TYPECHECK_EXP((table)->values[0], (value_array)[0]), \
+		bhash__do_build( \
+			&((table)->base), \
+			sizeof((table)->keys[0]), \
+			sizeof((table)->values[0]), \
+			(key_array), \
+			(value_array), \
+			(n), \
+			config \
+		) \
+	)
+
+/**
+ * @brief Initialize a hashset from an array of distinct keys.
+ *
+ * @see bhash_build
+ */
+#define bhash_build_set(table, key_array, n, config) \
+	( \
+		BHASH__TYPECHECK_EXP((table)->keys[0], (key_array)[0]), \
+		bhash__do_build(&((table)->base), sizeof((table)->keys[0]), 0, (key_array), NULL, (n), config) \
+	)
+
 /*! Clear a table */
 #define bhash_clear(table) bhash__do_clear(&((table)->base))
 
@@ -238,6 +335,22 @@ typedef struct {
 #define bhash_find(table, key) \
 	(BHASH__TYPECHECK_EXP((table)->keys[0], key), bhash__do_find(&((table)->base), &(key)))
 
+/**
+ * @brief Find multiple entries at once.
+ *
+ * All keys are hashed first and their slots are prefetched before any of them
+ * is resolved.
+ * This hides memory latency when looking up a large batch of keys.
+ *
+ * @param table The hashtable.
+ * @param key_array Pointer to an array of keys.
+ * @param n Number of keys.
+ * @param out_indices An array of at least @p n elements which will receive the
+ *   index of each key, as if returned by @ref bhash_find.
+ */
+#define bhash_find_many(table, key_array, n, out_indices) \
+	(BHASH__TYPECHECK_EXP((table)->keys[0], (key_array)[0]), bhash__do_find_many(&((table)->base), (key_array), (n), (out_indices)))
+
 /**
  * @brief Remove an entry.
  *
@@ -259,6 +372,71 @@ typedef struct {
 /*! Validate and assert when the table violates some invariants */
 #define bhash_validate(table) bhash__do_validate(&((table)->base))
 
+/**
+ * @brief Size of the image written by @ref bhash_freeze.
+ */
+#define bhash_frozen_size(table) bhash__do_frozen_size(&((table)->base))
+
+/**
+ * @brief Write a table as a flat image which can be loaded with @ref bhash_load_frozen.
+ *
+ * The image contains the index, the hashes, the keys and the values as they
+ * are laid out in memory, using only offsets relative to the start of the image.
+ * Keys and values are written as raw bytes so they must not contain pointers.
+ *
+ * The image uses the native byte order and integer sizes.
+ * It can only be loaded by a program which uses the same hash function.
+ *
+ * @param table The hashtable.
+ * @param write The output function (@ref bhash_write_fn_t).
+ * @param ctx Context for @p write.
+ *   For example: a `FILE*` or a `bserial_out_t*`.
+ * @return Whether all bytes were written.
+ * @remarks A pending incremental rehash is completed first.
+ */
+#define bhash_freeze(table, write, ctx) bhash__do_freeze(&((table)->base), (write), (ctx))
+
+/**
+ * @brief Initialize a hashtable on top of an image written by @ref bhash_freeze.
+ *
+ * No entry is copied or rehashed: the table points directly into @p image.
+ * Only the header is checked, which makes this suitable for a read-only `mmap`
+ * of a large file which can be shared between processes.
+ *
+ * The image must outlive the table and must be aligned to at least
+ * `alignof(max_align_t)`, which is the case for `malloc` and `mmap`.
+ * Whether the table is removable, whether it uses group probing and its load
+ * percentage are determined by the image, the rest is taken from @p config.
+ *
+ * @ref bhash_find and @ref bhash_find_many never write to the image.
+ * Any operation that modifies the table first copies it into regular allocations.
+ * @ref bhash_cleanup never frees the image.
+ *
+ * @param table Address of the hashtable (defined with @ref BHASH_TABLE).
+ * @param image The image.
+ * @param size Size of the image in bytes.
+ * @param config The configuration (@ref bhash_config_t).
+ * @return Whether the image is valid for this table.
+ *   When it is not, the table is initialized as an empty table.
+ */
+#define bhash_load_frozen(table, image, size, config) \
+	bhash__do_load_frozen( \
+		&((table)->base), \
+		sizeof((table)->keys[0]), \
+		sizeof((table)->values[0]), \
+		(image), \
+		(size), \
+		config \
+	)
+
+/**
+ * @brief Initialize a hashset on top of an image written by @ref bhash_freeze.
+ *
+ * @see bhash_load_frozen
+ */
+#define bhash_load_frozen_set(table, image, size, config) \
+	bhash__do_load_frozen(&((table)->base), sizeof((table)->keys[0]), 0, (image), (size), config)
+
 // small, fast 64 bit hash function.
 //
 // https://github.com/N-R-K/ChibiHash
@@ -348,6 +526,259 @@ bhash_config_default(void) {
 	};
 }
 
+/**
+ * @brief Default hash for @ref BHASH_DEFINE_TYPED.
+ *
+ * Same as @ref bhash_hash but with the key size known at compile time.
+ */
+#define BHASH_TYPED_HASH(key) bhash_hash(&(key), sizeof(key))
+
+/**
+ * @brief Default comparison for @ref BHASH_DEFINE_TYPED.
+ *
+ * Same as @ref bhash_eq but with the key size known at compile time.
+ */
+#define BHASH_TYPED_EQ(lhs, rhs) bhash_eq(&(lhs), &(rhs), sizeof(lhs))
+
+/**
+ * @brief Define a hashtable type with specialized functions.
+ *
+ * The hash and comparison are inlined into the lookup loops instead of being
+ * called through @ref bhash_config_t.hash and @ref bhash_config_t.eq.
+ * The key size is also fixed at compile time.
+ *
+ * This defines:
+ *
+ * * `NAME##_t`: The table type, same as `BHASH_TABLE(K, V)`.
+ * * `NAME##_init(NAME##_t* table, bhash_config_t config)`: Like @ref bhash_init.
+ *   The hash and eq of @p config are replaced.
+ * * `bhash_index_t NAME##_find(NAME##_t* table, K key)`: Like @ref bhash_find.
+ * * `bhash_alloc_result_t NAME##_alloc(NAME##_t* table, K key)`: Like @ref bhash_alloc.
+ * * `bhash_index_t NAME##_remove(NAME##_t* table, K key)`: Like @ref bhash_remove.
+ *
+ * All other functions such as @ref bhash_put or @ref bhash_cleanup can still be
+ * used on the table.
+ *
+ * @param NAME Prefix of the generated type and functions.
+ * @param K key type
+ * @param V value type
+ * @param HASH A function or macro called as `HASH(key)` with a `K` lvalue.
+ *   It must return a @ref bhash_hash_t.
+ *   @ref BHASH_TYPED_HASH can be used.
+ * @param EQ A function or macro called as `EQ(lhs, rhs)` with two `K` lvalues.
+ *   It must return a bool.
+ *   @ref BHASH_TYPED_EQ can be used.
+ */
+#define BHASH_DEFINE_TYPED(NAME, K, V, HASH, EQ) \
+	typedef BHASH_TABLE(K, V) NAME##_t; \
+	static inline bhash_hash_t \
+	NAME##__hash(const void* key, size_t size) { \
+		(void)size; \
+		return HASH(*(const K*)key); \
+	} \
+	static inline bool \
+	NAME##__eq(const void* lhs, const void* rhs, size_t size) { \
+		(void)size; \
+		return EQ(*(const K*)lhs, *(const K*)rhs); \
+	} \
+	static inline void \
+	NAME##_init(NAME##_t* table, bhash_config_t config) { \
+		config.hash = NAME##__hash; \
+		config.eq = NAME##__eq; \
+		bhash_init(table, config); \
+	} \
+	static inline bhash_index_t \
+	NAME##_find(NAME##_t* table, K key) { \
+		if (table->base.old_indices != NULL) { bhash__do_migrate(&table->base); } \
+		bhash_index_t data_index, hash_index; \
+		bhash__find_hashed(&table->base, &data_index, &hash_index, &key, HASH(key), sizeof(K), NAME##__eq); \
+		return data_index; \
+	} \
+	static inline bhash_alloc_result_t \
+	NAME##_alloc(NAME##_t* table, K key) { \
+		if (table->base.old_indices != NULL) { bhash__do_migrate(&table->base); } \
+		if (table->base.free_space <= 0) { bhash__do_maybe_grow(&table->base); } \
+		return bhash__alloc_hashed(&table->base, &key, HASH(key), sizeof(K), NAME##__eq); \
+	} \
+	static inline bhash_index_t \
+	NAME##_remove(NAME##_t* table, K key) { \
+		if (table->base.r_indices == NULL) { return -1; } \
+		if (table->base.old_indices != NULL) { bhash__do_migrate(&table->base); } \
+		bhash_index_t data_index, hash_index; \
+		bhash__find_hashed(&table->base, &data_index, &hash_index, &key, HASH(key), sizeof(K), NAME##__eq); \
+		if (data_index == -1) { return data_index; } \
+		return bhash__do_remove_at(&table->base, data_index, hash_index); \
+	}
+
+/**
+ * @brief Size of a cache line.
+ *
+ * Reader slots of a @ref BHASH_CONCURRENT_TABLE are padded to this size.
+ */
+#ifndef BHASH_CACHE_LINE_SIZE
+#define BHASH_CACHE_LINE_SIZE 64
+#endif
+
+/*! Per-reader state of a @ref BHASH_CONCURRENT_TABLE */
+typedef struct bhash_concurrent_reader_s {
+	uint64_t epoch;
+	char padding[BHASH_CACHE_LINE_SIZE - sizeof(uint64_t)];
+} bhash_concurrent_reader_t;
+
+struct bhash_concurrent_version_s;
+
+/**
+ * @brief The concurrent hashtable implementation details.
+ *
+ * Should be treated as opaque.
+ */
+typedef struct bhash_concurrent_base_s {
+	void* memctx;
+	bhash_hash_fn_t hash;
+	bhash_eq_fn_t eq;
+	bhash_index_t load_percent;
+	bhash_index_t tombstone_percent;
+	size_t key_size;
+	size_t value_size;
+	struct bhash_concurrent_version_s* version;
+	struct bhash_concurrent_version_s* retired;
+	void* readers_mem;
+	bhash_concurrent_reader_t* readers;
+	bhash_index_t num_readers;
+	bhash_index_t len;
+	uint64_t epoch;
+} bhash_concurrent_base_t;
+
+/**
+ * @brief Helper macro to define a concurrent hashtable type.
+ *
+ * The table has a single writer and any number of readers.
+ * Readers do not take any lock and may run in parallel with the writer.
+ *
+ * Entries are never modified in place:
+ *
+ * * Overwriting a key appends a new entry and atomically redirects its slot.
+ * * Removing a key atomically replaces its slot with a tombstone.
+ * * Growing the table builds a new version of it and atomically publishes it.
+ *
+ * A replaced version is only freed once no reader can still be using it.
+ * This is tracked with a per-reader epoch.
+ *
+ * Unlike @ref BHASH_TABLE, keys and values are not exposed as arrays.
+ * The group probing and incremental rehash modes are not supported.
+ *
+ * @param K key type
+ * @param V value type
+ */
+#define BHASH_CONCURRENT_TABLE(K, V) \
+	struct { \
+		bhash_concurrent_base_t base; \
+		K* key_type; \
+		V* value_type; \
+	}
+
+/**
+ * @brief Initialize a concurrent hashtable.
+ *
+ * @param table Address of the hashtable (defined with @ref BHASH_CONCURRENT_TABLE).
+ * @param config The configuration (@ref bhash_config_t).
+ * @param num_readers Maximum number of reader threads.
+ *   Each reader thread must use a distinct id in the range [0, num_readers).
+ */
+#define bhash_concurrent_init(table, config, num_readers) \
+	bhash__concurrent_init( \
+		&((table)->base), \
+		sizeof((table)->key_type[0]), \
+		sizeof((table)->value_type[0]), \
+		config, \
+		num_readers \
+	)
+
+/**
+ * @brief Free up all resources used by a concurrent hashtable.
+ *
+ * There must be no reader left.
+ */
+#define bhash_concurrent_cleanup(table) bhash__concurrent_cleanup(&((table)->base))
+
+/**
+ * @brief Add or overwrite an entry.
+ *
+ * Must only be called from the writer thread.
+ */
+#define bhash_concurrent_put(table, key, value) \
+	( \
+		BHASH__TYPECHECK_EXP((table)->key_type[0], key), \
+		BHASH__TYPECHECK_EXP((table)->value_type[0], value), \
+		bhash__concurrent_put(&((table)->base), &(key), &(value)) \
+	)
+
+/**
+ * @brief Remove an entry.
+ *
+ * Must only be called from the writer thread.
+ *
+ * @return Whether the entry was found.
+ */
+#define bhash_concurrent_remove(table, key) \
+	(BHASH__TYPECHECK_EXP((table)->key_type[0], key), bhash__concurrent_remove(&((table)->base), &(key)))
+
+/**
+ * @brief Free all replaced versions which are no longer used by any reader.
+ *
+ * This is already done whenever the table grows.
+ * Must only be called from the writer thread.
+ */
+#define bhash_concurrent_reclaim(table) bhash__concurrent_reclaim(&((table)->base))
+
+/**
+ * @brief Retrieve the number of entries.
+ *
+ * Must only be called from the writer thread.
+ */
+#define bhash_concurrent_len(table) ((table)->base.len)
+
+/**
+ * @brief Start a read section.
+ *
+ * The version of the table which is visible to the reader will not be freed
+ * until @ref bhash_concurrent_read_end.
+ * This is optional as @ref bhash_concurrent_get starts its own section.
+ * It is cheaper to do many lookups in a single section.
+ *
+ * @param table The hashtable.
+ * @param reader The reader id.
+ */
+#define bhash_concurrent_read_begin(table, reader) \
+	bhash__concurrent_read_begin(&((table)->base), reader)
+
+/*! End a read section */
+#define bhash_concurrent_read_end(table, reader) \
+	bhash__concurrent_read_end(&((table)->base), reader)
+
+/**
+ * @brief Find an entry and copy its value.
+ *
+ * Can be called from any reader thread, concurrently to the writer.
+ *
+ * @param table The hashtable.
+ * @param reader The reader id.
+ * @param key The key.
+ * @param out_value Address to copy the value to.
+ *
+ * @return Whether the entry was found.
+ */
+#define bhash_concurrent_get(table, reader, key, out_value) \
+	( \
+		BHASH__TYPECHECK_EXP((table)->key_type[0], key), \
+		BHASH__TYPECHECK_EXP((table)->value_type, out_value), \
+		bhash__concurrent_get(&((table)->base), reader, &(key), out_value) \
+	)
+
+/*! Check whether an entry exists from a reader thread */
+#define bhash_concurrent_contains(table, reader, key) \
+	(BHASH__TYPECHECK_EXP((table)->key_type[0], key), bhash__concurrent_get(&((table)->base), reader, &(key), NULL))
+
 // Private
 
 #ifndef DOXYGEN
@@ -395,12 +826,42 @@ bhash__do_init(bhash_base_t* bhash, size_t key_size, size_t value_size, bhash_co
 BHASH_API void
 bhash__do_reinit(bhash_base_t* bhash, size_t key_size, size_t value_size, bhash_config_t config);
 
+BHASH_API void
+bhash__do_build(
+	bhash_base_t* bhash,
+	size_t key_size,
+	size_t value_size,
+	const void* keys,
+	const void* values,
+	bhash_index_t n,
+	bhash_config_t config
+);
+
+BHASH_API size_t
+bhash__do_frozen_size(bhash_base_t* bhash);
+
+BHASH_API bool
+bhash__do_freeze(bhash_base_t* bhash, bhash_write_fn_t write, void* ctx);
+
+BHASH_API bool
+bhash__do_load_frozen(
+	bhash_base_t* bhash,
+	size_t key_size,
+	size_t value_size,
+	const void* image,
+	size_t size,
+	bhash_config_t config
+);
+
 BHASH_API bhash_alloc_result_t
 bhash__do_alloc(bhash_base_t* bhash, const void* key);
 
 BHASH_API bhash_index_t
 bhash__do_find(bhash_base_t* bhash, const void* key);
 
+BHASH_API void
+bhash__do_find_many(bhash_base_t* bhash, const void* keys, bhash_index_t n, bhash_index_t* out_indices);
+
 BHASH_API bhash_index_t
 bhash__do_remove(bhash_base_t* bhash, const void* key);
 
@@ -411,149 +872,260 @@ BHASH_API void
 bhash__do_cleanup(bhash_base_t* bhash);
 
 BHASH_API void
-bhash__do_clear(bhash_base_t* bhash);
+bhash__do_maybe_grow(bhash_base_t* bhash);
 
-#endif
+BHASH_API void
+bhash__do_migrate(bhash_base_t* bhash);
 
-#endif
+BHASH_API bhash_index_t
+bhash__do_remove_at(bhash_base_t* bhash, bhash_index_t remove_index, bhash_index_t remove_r_index);
 
-#if defined(BLIB_IMPLEMENTATION) && !defined(BHASH_IMPLEMENTATION)
-#define BHASH_IMPLEMENTATION
-#endif
+BHASH_API void
+bhash__do_clear(bhash_base_t* bhash);
 
-#ifdef BHASH_IMPLEMENTATION
+BHASH_API void
+bhash__concurrent_init(
+	bhash_concurrent_base_t* bhash,
+	size_t key_size,
+	size_t value_size,
+	bhash_config_t config,
+	bhash_index_t num_readers
+);
 
-#define BHASH_EMPTY ((bhash_index_t)0)
-#define BHASH_TOMBSTONE ((bhash_index_t)-1)
+BHASH_API void
+bhash__concurrent_cleanup(bhash_concurrent_base_t* bhash);
 
-#ifndef BHASH_REALLOC
-#	ifdef BLIB_REALLOC
-#		define BHASH_REALLOC BLIB_REALLOC
-#	else
-#		define BHASH_REALLOC(ptr, size, ctx) bhash__libc_realloc(ptr, size, ctx)
-#		define BHASH_USE_LIBC_REALLOC
-#	endif
-#endif
+BHASH_API void
+bhash__concurrent_put(bhash_concurrent_base_t* bhash, const void* key, const void* value);
 
-#ifdef BHASH_USE_LIBC_REALLOC
-#include <stdlib.h>
+BHASH_API bool
+bhash__concurrent_remove(bhash_concurrent_base_t* bhash, const void* key);
 
-static inline void*
-bhash__libc_realloc(void* ptr, size_t size, void* ctx) {
-	(void)ctx;
-	if (size > 0) {
-		return realloc(ptr, size);
-	} else {
-		free(ptr);
-		return NULL;
-	}
-}
+BHASH_API void
+bhash__concurrent_reclaim(bhash_concurrent_base_t* bhash);
 
-#endif
+BHASH_API void
+bhash__concurrent_read_begin(bhash_concurrent_base_t* bhash, bhash_index_t reader);
 
-#ifndef BHASH_ASSERT
-#include <stdio.h>
-#include <stdlib.h>
+BHASH_API void
+bhash__concurrent_read_end(bhash_concurrent_base_t* bhash, bhash_index_t reader);
 
-#define BHASH_ASSERT(COND, MSG, ...) \
-	if (!(COND)) { \
-		fprintf(stderr, __FILE__ "(" BHASH_STRINGIFY(__LINE__) "): " MSG "\n", #COND, __VA_ARGS__); \
-		abort(); \
-	}
-#define BHASH_STRINGIFY(X) BHASH_STRINGIFY2(X)
-#define BHASH_STRINGIFY2(X) #X
+BHASH_API bool
+bhash__concurrent_get(bhash_concurrent_base_t* bhash, bhash_index_t reader, const void* key, void* out_value);
+
+#define BHASH_EMPTY ((bhash_index_t)0)
+#define BHASH_TOMBSTONE ((bhash_index_t)-1)
 
+#if defined(__GNUC__) || defined(__clang__)
+#	define BHASH__FORCE_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#	define BHASH__FORCE_INLINE static __forceinline
+#else
+#	define BHASH__FORCE_INLINE static inline
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#	include <intrin.h>
 #endif
 
-typedef BHASH_TABLE(char, char) bhash_dummy_t;
+typedef BHASH_TABLE(char, char) bhash__dummy_t;
 
 static inline void**
-bhash_keys_ptr(bhash_base_t* bhash) {
-	return (void**)((char*)bhash + offsetof(bhash_dummy_t, keys) - offsetof(bhash_dummy_t, base));
+bhash__keys_ptr(bhash_base_t* bhash) {
+	return (void**)((char*)bhash + offsetof(bhash__dummy_t, keys) - offsetof(bhash__dummy_t, base));
 }
 
 static inline void**
-bhash_values_ptr(bhash_base_t* bhash) {
-	return (void**)((char*)bhash + offsetof(bhash_dummy_t, values) - offsetof(bhash_dummy_t, base));
+bhash__values_ptr(bhash_base_t* bhash) {
+	return (void**)((char*)bhash + offsetof(bhash__dummy_t, values) - offsetof(bhash__dummy_t, base));
 }
 
 static inline void*
-bhash_key_at(bhash_base_t* bhash, bhash_index_t index) {
-	return *(char**)bhash_keys_ptr(bhash) + index * bhash->key_size;
+bhash__key_at(bhash_base_t* bhash, bhash_index_t index) {
+	return *(char**)bhash__keys_ptr(bhash) + index * bhash->key_size;
 }
 
 static inline void*
-bhash_value_at(bhash_base_t* bhash, bhash_index_t index) {
-	return *(char**)bhash_values_ptr(bhash) + index * bhash->value_size;
+bhash__value_at(bhash_base_t* bhash, bhash_index_t index) {
+	return *(char**)bhash__values_ptr(bhash) + index * bhash->value_size;
 }
 
 // https://nullprogram.com/blog/2022/08/08/
 static inline bhash_index_t
-bhash_lookup_index(bhash_hash_t hash, bhash_index_t exp, bhash_index_t idx) {
+bhash__lookup_index(bhash_hash_t hash, bhash_index_t exp, bhash_index_t idx) {
 	uint32_t mask = ((uint32_t)1 << exp) - 1;
 	uint32_t step = (uint32_t)((hash >> (64 - exp)) | 1);
 	return (idx + step) & mask;
 }
 
-static inline void
-bhash_maybe_grow(bhash_base_t* bhash) {
-	if (bhash->free_space > 0) { return; }
+#define BHASH_CTRL_EMPTY ((uint8_t)0x80)
+#define BHASH_CTRL_DELETED ((uint8_t)0xFE)
+
+#if defined(__AVX2__)
+#	include <immintrin.h>
+#	define BHASH_GROUP_EXP 5
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define BHASH_GROUP_SSE2
+#	define BHASH_GROUP_EXP 4
+#elif (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#	include <arm_neon.h>
+#	define BHASH_GROUP_NEON
+#	define BHASH_GROUP_EXP 4
+#else
+#	define BHASH_GROUP_EXP 4
+#endif
 
-	bhash_index_t exp = bhash->exp;
-	bhash_index_t hash_capacity = 1 << exp;
-	bhash_index_t data_capacity = hash_capacity * bhash->load_percent / 100;
-	bhash_index_t num_tombstones = data_capacity - bhash->len;
-	// Grow if there are not too many tombstone. Otherwise, do in-place rehash
-	if (num_tombstones < data_capacity * bhash->tombstone_percent / 100) {
-		bhash->exp = exp += 1;
-		hash_capacity = 1 << exp;
-		data_capacity = hash_capacity * bhash->load_percent / 100;
-		bhash->indices = BHASH_REALLOC(bhash->indices, sizeof(bhash_index_t) * hash_capacity, bhash->memctx);
-		bhash->hashes = BHASH_REALLOC(bhash->hashes, sizeof(bhash_hash_t) * data_capacity, bhash->memctx);
-		if (bhash->r_indices) {
-			bhash->r_indices = BHASH_REALLOC(bhash->r_indices, sizeof(bhash_index_t) * data_capacity, bhash->memctx);
-		}
+#define BHASH_GROUP_WIDTH ((bhash_index_t)1 << BHASH_GROUP_EXP)
 
-		bhash_index_t extra_space = bhash->r_indices != NULL ? 1 : 0;
-		*bhash_keys_ptr(bhash) = BHASH_REALLOC(*bhash_keys_ptr(bhash), bhash->key_size * (data_capacity + extra_space), bhash->memctx);
-		if (bhash->value_size > 0) {
-			*bhash_values_ptr(bhash) = BHASH_REALLOC(*bhash_values_ptr(bhash), bhash->value_size * (data_capacity + extra_space), bhash->memctx);
-		}
-	}
+typedef uint32_t bhash__group_mask_t;
 
-	bhash_index_t len = bhash->len;
-	bhash_index_t* indices = bhash->indices;
-	bhash_index_t* r_indices = bhash->r_indices;
-	bhash_hash_t* hashes = bhash->hashes;
-	memset(bhash->indices, 0, sizeof(bhash_index_t) * hash_capacity);
-	for (bhash_index_t i = 0; i < len; ++i) {
-		bhash_hash_t hash = hashes[i];
-		for (bhash_index_t hash_index = (bhash_index_t)hash;;) {
-			hash_index = bhash_lookup_index(hash, exp, hash_index);
-			bhash_index_t data_index = indices[hash_index];
-			if (data_index == BHASH_EMPTY) {
-				indices[hash_index] = i + 1;
-				if (r_indices != NULL) { r_indices[i] = hash_index; }
-				break;
-			}
-		}
+static inline int
+bhash__ctz(bhash__group_mask_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// Bitmask of all slots in the group whose control byte is tag
+static inline bhash__group_mask_t
+bhash__group_match(const uint8_t* group, uint8_t tag) {
+#if defined(__AVX2__)
+	__m256i ctrl = _mm256_loadu_si256((const __m256i*)group);
+	return (bhash__group_mask_t)_mm256_movemask_epi8(
+		_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8((char)tag))
+	);
+#elif defined(BHASH_GROUP_SSE2)
+	__m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+	return (bhash__group_mask_t)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag))
+	);
+#elif defined(BHASH_GROUP_NEON)
+	static const uint8_t weights[16] = {
+		1, 2, 4, 8, 16, 32, 64, 128,
+		1, 2, 4, 8, 16, 32, 64, 128,
+	};
+	uint8x16_t match = vandq_u8(
+		vceqq_u8(vld1q_u8(group), vdupq_n_u8(tag)),
+		vld1q_u8(weights)
+	);
+	return (bhash__group_mask_t)vaddv_u8(vget_low_u8(match))
+		| ((bhash__group_mask_t)vaddv_u8(vget_high_u8(match)) << 8);
+#else
+	bhash__group_mask_t mask = 0;
+	for (bhash_index_t i = 0; i < BHASH_GROUP_WIDTH; ++i) {
+		mask |= (bhash__group_mask_t)(group[i] == tag) << i;
 	}
-	bhash->free_space = data_capacity - bhash->len;
+	return mask;
+#endif
 }
 
-static inline void
-bhash_find_impl(
+// Bitmask of all empty or deleted slots in the group.
+// Both have the high bit set while the tag of an occupied slot does not.
+static inline bhash__group_mask_t
+bhash__group_match_free(const uint8_t* group) {
+#if defined(__AVX2__)
+	return (bhash__group_mask_t)_mm256_movemask_epi8(
+		_mm256_loadu_si256((const __m256i*)group)
+	);
+#elif defined(BHASH_GROUP_SSE2)
+	return (bhash__group_mask_t)_mm_movemask_epi8(
+		_mm_loadu_si128((const __m128i*)group)
+	);
+#elif defined(BHASH_GROUP_NEON)
+	static const uint8_t weights[16] = {
+		1, 2, 4, 8, 16, 32, 64, 128,
+		1, 2, 4, 8, 16, 32, 64, 128,
+	};
+	uint8x16_t match = vandq_u8(
+		vtstq_u8(vld1q_u8(group), vdupq_n_u8(0x80)),
+		vld1q_u8(weights)
+	);
+	return (bhash__group_mask_t)vaddv_u8(vget_low_u8(match))
+		| ((bhash__group_mask_t)vaddv_u8(vget_high_u8(match)) << 8);
+#else
+	bhash__group_mask_t mask = 0;
+	for (bhash_index_t i = 0; i < BHASH_GROUP_WIDTH; ++i) {
+		mask |= (bhash__group_mask_t)(group[i] >> 7) << i;
+	}
+	return mask;
+#endif
+}
+
+static inline uint8_t
+bhash__group_tag(bhash_hash_t hash) {
+	return (uint8_t)(hash & 0x7f);
+}
+
+static inline bhash_index_t
+bhash__group_start(bhash_hash_t hash, bhash_index_t exp) {
+	uint32_t mask = ((uint32_t)1 << (exp - BHASH_GROUP_EXP)) - 1;
+	return (bhash_index_t)((hash >> 7) & mask);
+}
+
+// Triangular probing which visits every group since the count is a power of 2
+static inline bhash_index_t
+bhash__group_next(bhash_index_t group, bhash_index_t step, bhash_index_t exp) {
+	uint32_t mask = ((uint32_t)1 << (exp - BHASH_GROUP_EXP)) - 1;
+	return (bhash_index_t)(((uint32_t)group + (uint32_t)step) & mask);
+}
+
+// The probing loops are force-inlined so that a constant key_size and eq
+// (see BHASH_DEFINE_TYPED) get propagated into them.
+BHASH__FORCE_INLINE void
+bhash__find_in(
 	bhash_base_t* bhash,
+	const bhash_index_t* indices,
+	const uint8_t* ctrl,
+	bhash_index_t exp,
 	bhash_index_t* out_data_index,
 	bhash_index_t* out_hash_index,
-	const void* key
+	const void* key,
+	bhash_hash_t hash,
+	size_t key_size,
+	bhash_eq_fn_t eq
 ) {
-	bhash_hash_t hash = bhash->hash(key, bhash->key_size);
-	bhash_index_t* indices = bhash->indices;
-	bhash_index_t exp = bhash->exp;
 	bhash_hash_t* hashes = bhash->hashes;
+	const char* keys = *(char**)bhash__keys_ptr(bhash);
+
+	if (ctrl != NULL) {
+		uint8_t tag = bhash__group_tag(hash);
+		for (
+			bhash_index_t group = bhash__group_start(hash, exp), step = 1;
+			true;
+			group = bhash__group_next(group, step++, exp)
+		) {
+			const uint8_t* group_ctrl = ctrl + group * BHASH_GROUP_WIDTH;
+			for (
+				bhash__group_mask_t mask = bhash__group_match(group_ctrl, tag);
+				mask != 0;
+				mask &= mask - 1
+			) {
+				bhash_index_t hash_index = group * BHASH_GROUP_WIDTH + bhash__ctz(mask);
+				bhash_index_t data_index = indices[hash_index];
+				if (
+					hashes[data_index - 1] == hash
+					&& eq(key, keys + (data_index - 1) * key_size, key_size)
+				) {
+					*out_data_index = data_index - 1;
+					*out_hash_index = hash_index;
+					return;
+				}
+			}
+
+			if (bhash__group_match(group_ctrl, BHASH_CTRL_EMPTY) != 0) {
+				*out_data_index = *out_hash_index = -1;
+				return;
+			}
+		}
+	}
+
 	for (bhash_index_t hash_index = (bhash_index_t)hash;;) {
-		hash_index = bhash_lookup_index(hash, exp, hash_index);
+		hash_index = bhash__lookup_index(hash, exp, hash_index);
 		bhash_index_t data_index = indices[hash_index];
 		if (data_index == BHASH_EMPTY) {
 			*out_data_index = *out_hash_index = -1;
@@ -562,7 +1134,7 @@ bhash_find_impl(
 			continue;
 		} else if (
 			hashes[data_index - 1] == hash
-			&& bhash->eq(key, bhash_key_at(bhash, data_index - 1), bhash->key_size)
+			&& eq(key, keys + (data_index - 1) * key_size, key_size)
 		) {
 			*out_data_index = data_index - 1;
 			*out_hash_index = hash_index;
@@ -571,65 +1143,112 @@ bhash_find_impl(
 	}
 }
 
-void
-bhash__do_init(
+BHASH__FORCE_INLINE void
+bhash__find_hashed(
 	bhash_base_t* bhash,
+	bhash_index_t* out_data_index,
+	bhash_index_t* out_hash_index,
+	const void* key,
+	bhash_hash_t hash,
 	size_t key_size,
-	size_t value_size,
-	bhash_config_t config
+	bhash_eq_fn_t eq
 ) {
-	bhash_index_t hash_capacity = 1 << config.initial_exp;
-	bhash_index_t data_capacity = hash_capacity * config.load_percent / 100;
-	bhash_index_t extra_space = config.removable ? 1 : 0; // Extra temp space for swapping
-	(*bhash) = (bhash_base_t){
-		.memctx = config.memctx,
-		.hash = config.hash,
-		.eq = config.eq,
-		.load_percent = config.load_percent,
-		.tombstone_percent = config.tombstone_percent,
-		.key_size = key_size,
-		.value_size = value_size,
-		.indices = BHASH_REALLOC(NULL, sizeof(bhash_index_t) * hash_capacity, config.memctx),
-		.hashes = BHASH_REALLOC(NULL, sizeof(bhash_hash_t) * data_capacity, config.memctx),
-		.len = 0,
-		.exp = config.initial_exp,
-		.free_space = data_capacity,
-	};
-	memset(bhash->indices, 0, sizeof(bhash_index_t) * hash_capacity);
-
-	if (config.removable) {
-		bhash->r_indices = BHASH_REALLOC(NULL, sizeof(bhash_index_t) * data_capacity, config.memctx);
-	}
-
-	*bhash_keys_ptr(bhash) = BHASH_REALLOC(NULL, key_size * (data_capacity + extra_space), config.memctx);
-	if (value_size > 0) {
-		*bhash_values_ptr(bhash) = BHASH_REALLOC(NULL, value_size * (data_capacity + extra_space), config.memctx);
-	} else {
-		*bhash_values_ptr(bhash) = NULL;
+	bhash__find_in(
+		bhash, bhash->indices, bhash->ctrl, bhash->exp,
+		out_data_index, out_hash_index,
+		key, hash, key_size, eq
+	);
+
+	// Entries which are not yet migrated are only in the old index
+	if (*out_data_index == -1 && bhash->old_indices != NULL) {
+		bhash__find_in(
+			bhash, bhash->old_indices, bhash->old_ctrl, bhash->old_exp,
+			out_data_index, out_hash_index,
+			key, hash, key_size, eq
+		);
 	}
 }
 
-void
-bhash__do_reinit(bhash_base_t* bhash, size_t key_size, size_t value_size, bhash_config_t config) {
-	if (bhash->eq != NULL) {
-		bhash->eq = config.eq;
-		bhash->hash = config.hash;
-		bhash->memctx = config.memctx;
-	} else {
-		bhash__do_init(bhash, key_size, value_size, config);
+// The table must have been grown before calling this
+BHASH__FORCE_INLINE bhash_alloc_result_t
+bhash__alloc_hashed(
+	bhash_base_t* bhash,
+	const void* key,
+	bhash_hash_t hash,
+	size_t key_size,
+	bhash_eq_fn_t eq
+) {
+	if (bhash->old_indices != NULL) {
+		bhash_index_t data_index, hash_index;
+		bhash__find_in(
+			bhash, bhash->old_indices, bhash->old_ctrl, bhash->old_exp,
+			&data_index, &hash_index,
+			key, hash, key_size, eq
+		);
+		if (data_index != -1) {
+			return (bhash_alloc_result_t){
+				.index = data_index,
+				.is_new = false,
+			};
+		}
 	}
-}
 
-bhash_alloc_result_t
-bhash__do_alloc(bhash_base_t* bhash, const void* key) {
-	bhash_maybe_grow(bhash);
-	bhash_hash_t hash = bhash->hash(key, bhash->key_size);
 	bhash_index_t dest_slot = -1;
 	bhash_index_t exp = bhash->exp;
 	bhash_index_t* indices = bhash->indices;
 	bhash_hash_t* hashes = bhash->hashes;
+	const char* keys = *(char**)bhash__keys_ptr(bhash);
+
+	if (bhash->ctrl != NULL) {
+		uint8_t* ctrl = bhash->ctrl;
+		uint8_t tag = bhash__group_tag(hash);
+		for (
+			bhash_index_t group = bhash__group_start(hash, exp), step = 1;
+			true;
+			group = bhash__group_next(group, step++, exp)
+		) {
+			const uint8_t* group_ctrl = ctrl + group * BHASH_GROUP_WIDTH;
+			for (
+				bhash__group_mask_t mask = bhash__group_match(group_ctrl, tag);
+				mask != 0;
+				mask &= mask - 1
+			) {
+				bhash_index_t data_index = indices[group * BHASH_GROUP_WIDTH + bhash__ctz(mask)];
+				if (
+					hashes[data_index - 1] == hash
+					&& eq(key, keys + (data_index - 1) * key_size, key_size)
+				) {
+					return (bhash_alloc_result_t){
+						.index = data_index - 1,
+						.is_new = false,
+					};
+				}
+			}
+
+			if (dest_slot == -1) {
+				bhash__group_mask_t free_mask = bhash__group_match_free(group_ctrl);
+				if (free_mask != 0) {
+					dest_slot = group * BHASH_GROUP_WIDTH + bhash__ctz(free_mask);
+				}
+			}
+
+			if (bhash__group_match(group_ctrl, BHASH_CTRL_EMPTY) != 0) { break; }
+		}
+
+		bhash->free_space -= (ctrl[dest_slot] == BHASH_CTRL_EMPTY); // New empty slot allocated
+		bhash_index_t data_index = bhash->len++;
+		ctrl[dest_slot] = tag;
+		indices[dest_slot] = data_index + 1;
+		if (bhash->r_indices) { bhash->r_indices[data_index] = dest_slot; }
+		hashes[data_index] = hash;
+		return (bhash_alloc_result_t){
+			.index = data_index,
+			.is_new = true,
+		};
+	}
+
 	for (bhash_index_t hash_index = (bhash_index_t)hash;;) {
-		hash_index = bhash_lookup_index(hash, exp, hash_index);
+		hash_index = bhash__lookup_index(hash, exp, hash_index);
 		bhash_index_t data_index = indices[hash_index];
 		if (data_index == BHASH_EMPTY) {
 			bhash->free_space -= (dest_slot == -1); // New empty slot allocated
@@ -646,7 +1265,7 @@ bhash__do_alloc(bhash_base_t* bhash, const void* key) {
 			dest_slot = dest_slot == -1 ? hash_index : dest_slot;
 		} else if (
 			hashes[data_index - 1] == hash
-			&& bhash->eq(key, bhash_key_at(bhash, data_index - 1), bhash->key_size)
+			&& eq(key, keys + (data_index - 1) * key_size, key_size)
 		) {
 			return (bhash_alloc_result_t){
 				.index = data_index - 1,
@@ -656,101 +1275,1282 @@ bhash__do_alloc(bhash_base_t* bhash, const void* key) {
 	}
 }
 
-bhash_index_t
-bhash__do_find(bhash_base_t* bhash, const void* key) {
-	bhash_index_t data_index;
-	bhash_index_t hash_index;
-	bhash_find_impl(bhash, &data_index, &hash_index, key);
-	return data_index;
+#endif
+
+#endif
+
+#if defined(BLIB_IMPLEMENTATION) && !defined(BHASH_IMPLEMENTATION)
+#define BHASH_IMPLEMENTATION
+#endif
+
+#ifdef BHASH_IMPLEMENTATION
+
+#ifdef _MSC_VER
+#	define BHASH_MAX_ALIGN_TYPE double
+#else
+#	define BHASH_MAX_ALIGN_TYPE max_align_t
+#endif
+
+#include "mem_layout.h"
+
+/**
+ * @brief Minimum number of entries for @ref bhash_build to sort them by slot.
+ */
+#ifndef BHASH_BUILD_SORT_MIN
+#define BHASH_BUILD_SORT_MIN 65536
+#endif
+
+// bhash_build sorts by the highest bits of the slot
+#define BHASH_BUILD_SORT_BITS 11
+
+#ifndef BHASH_FIND_BATCH_SIZE
+#define BHASH_FIND_BATCH_SIZE 32
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#	if defined(_M_X64) || defined(_M_IX86)
+#		include <xmmintrin.h>
+#		define BHASH_PREFETCH(PTR) _mm_prefetch((const char*)(PTR), _MM_HINT_T0)
+#	else
+#		define BHASH_PREFETCH(PTR) __prefetch(PTR)
+#	endif
+#else
+#	define BHASH_PREFETCH(PTR) __builtin_prefetch(PTR)
+#endif
+
+#ifndef BHASH_REALLOC
+#	ifdef BLIB_REALLOC
+#		define BHASH_REALLOC BLIB_REALLOC
+#	else
+#		define BHASH_REALLOC(ptr, size, ctx) bhash__libc_realloc(ptr, size, ctx)
+#		define BHASH_USE_LIBC_REALLOC
+#	endif
+#endif
+
+#ifdef BHASH_USE_LIBC_REALLOC
+#include <stdlib.h>
+
+static inline void*
+bhash__libc_realloc(void* ptr, size_t size, void* ctx) {
+	(void)ctx;
+	if (size > 0) {
+		return realloc(ptr, size);
+	} else {
+		free(ptr);
+		return NULL;
+	}
 }
 
-bhash_index_t
-bhash__do_remove(bhash_base_t* bhash, const void* key) {
-	if (bhash->r_indices == NULL) { return -1; }
+#endif
 
-	bhash_index_t remove_index, remove_r_index;
-	bhash_index_t end_index = bhash->len;
-	bhash_index_t tail_index = end_index - 1;
-	bhash_find_impl(bhash, &remove_index, &remove_r_index, key);
-	if (remove_index == -1) { return remove_index; }
+#ifndef BHASH_ASSERT
+#include <stdio.h>
+#include <stdlib.h>
 
-	// Move the last element into the deleted slot and delete the last element
-	bhash_index_t tail_r_index = bhash->r_indices[tail_index];
-	bhash->indices[tail_r_index] = remove_index + 1;
-	bhash->indices[remove_r_index] = BHASH_TOMBSTONE;
-	bhash->r_indices[remove_index] = tail_r_index;
-	bhash->hashes[remove_index] = bhash->hashes[tail_index];
+#define BHASH_ASSERT(COND, MSG, ...) \
+	if (!(COND)) { \
+		fprintf(stderr, __FILE__ "(" BHASH_STRINGIFY(__LINE__) "): " MSG "\n", #COND, __VA_ARGS__); \
+		abort(); \
+	}
+#define BHASH_STRINGIFY(X) BHASH_STRINGIFY2(X)
+#define BHASH_STRINGIFY2(X) #X
 
-	// Rotate key and values then point user code to the temp position at the end
-	memcpy(bhash_key_at(bhash, end_index), bhash_key_at(bhash, remove_index), bhash->key_size);
-	memcpy(bhash_key_at(bhash, remove_index), bhash_key_at(bhash, tail_index), bhash->key_size);
-	if (bhash->value_size > 0) {
-		memcpy(bhash_value_at(bhash, end_index), bhash_value_at(bhash, remove_index), bhash->value_size);
-		memcpy(bhash_value_at(bhash, remove_index), bhash_value_at(bhash, tail_index), bhash->value_size);
+#endif
+
+// Insert an entry into the first free slot of the current index
+static inline void
+bhash_insert_index(bhash_base_t* bhash, bhash_index_t data_index) {
+	bhash_index_t exp = bhash->exp;
+	bhash_index_t* indices = bhash->indices;
+	uint8_t* ctrl = bhash->ctrl;
+	bhash_hash_t hash = bhash->hashes[data_index];
+	bhash_index_t hash_index;
+	if (ctrl != NULL) {
+		for (
+			bhash_index_t group = bhash__group_start(hash, exp), step = 1;
+			true;
+			group = bhash__group_next(group, step++, exp)
+		) {
+			bhash__group_mask_t free_mask = bhash__group_match_free(ctrl + group * BHASH_GROUP_WIDTH);
+			if (free_mask != 0) {
+				hash_index = group * BHASH_GROUP_WIDTH + bhash__ctz(free_mask);
+				ctrl[hash_index] = bhash__group_tag(hash);
+				break;
+			}
+		}
+	} else {
+		for (hash_index = (bhash_index_t)hash;;) {
+			hash_index = bhash__lookup_index(hash, exp, hash_index);
+			if (indices[hash_index] <= 0) { break; }
+		}
 	}
 
-	bhash->len -= 1;
-	return end_index;
+	// A tombstone is reused, the slot reserved for this entry is not needed
+	bhash->free_space += indices[hash_index] == BHASH_TOMBSTONE;
+	indices[hash_index] = data_index + 1;
+	if (bhash->r_indices != NULL) { bhash->r_indices[data_index] = hash_index; }
 }
 
-void
-bhash__do_validate(bhash_base_t* bhash) {
-	bhash_index_t len = bhash->len;
-	bhash_hash_t* hashes = bhash->hashes;
-	bhash_index_t* indices = bhash->indices;
-	bhash_index_t* r_indices = bhash->r_indices;
-	for (bhash_index_t i = 0; i < len; ++i) {
-		bhash_hash_t stored_hash = hashes[i];
-		bhash_hash_t computed_hash = bhash->hash(bhash_key_at(bhash, i), bhash->key_size);
-		BHASH_ASSERT(stored_hash == computed_hash, "%s: Hash mismatch at %d", i);
-		bhash_index_t r_index = r_indices[i];
-		bhash_index_t index = indices[r_index];
-		BHASH_ASSERT(index == i + 1, "%s: Index mismatch at %d", i);
+// Move entries from the old index into the current one
+static inline void
+bhash_migrate(bhash_base_t* bhash, bhash_index_t num_slots) {
+	bhash_index_t* old_indices = bhash->old_indices;
+	uint8_t* old_ctrl = bhash->old_ctrl;
+	bhash_index_t old_capacity = (bhash_index_t)1 << bhash->old_exp;
+	bhash_index_t end = old_capacity - bhash->migrate_pos > num_slots
+		? bhash->migrate_pos + num_slots
+		: old_capacity;
+	for (bhash_index_t i = bhash->migrate_pos; i < end; ++i) {
+		bhash_index_t data_index = old_indices[i];
+		if (data_index <= 0) { continue; }
+
+		// Leave a tombstone so that probe chains in the old index stay intact
+		old_indices[i] = BHASH_TOMBSTONE;
+		if (old_ctrl != NULL) { old_ctrl[i] = BHASH_CTRL_DELETED; }
+		bhash_insert_index(bhash, data_index - 1);
+	}
+	bhash->migrate_pos = end;
+
+	if (end == old_capacity) {
+		BHASH_REALLOC(bhash->old_indices, 0, bhash->memctx);
+		BHASH_REALLOC(bhash->old_ctrl, 0, bhash->memctx);
+		bhash->old_indices = NULL;
+		bhash->old_ctrl = NULL;
 	}
+}
+
+static inline void
+bhash_migrate_step(bhash_base_t* bhash) {
+	if (bhash->old_indices != NULL) { bhash_migrate(bhash, bhash->migrate_step); }
+}
+
+// Reinsert all entries into an empty index, optionally in the given order
+static inline void
+bhash_rebuild_index(bhash_base_t* bhash, const bhash_index_t* order) {
 	bhash_index_t hash_capacity = (bhash_index_t)1 << bhash->exp;
-	bhash_index_t data_capacity = hash_capacity * bhash->load_percent / 100;
-	BHASH_ASSERT(len <= data_capacity, "%s: Invalid length %d (max: %d)", len, data_capacity);
-	for (bhash_index_t i = 0; i < hash_capacity; ++i) {
-		bhash_index_t index = indices[i];
-		if (index <= 0) {
-			BHASH_ASSERT(
-				index == BHASH_EMPTY || index == BHASH_TOMBSTONE,
-				"%s: Invalid negative index %d",
-				index
-			);
-		} else {
-			BHASH_ASSERT(
-				(index - 1) <= len,
-				"%s: Invalid positive index %d",
-				index
-			);
-			bhash_index_t r_index = r_indices[index - 1];
-			BHASH_ASSERT(
-				i == r_index,
-				"%s: Index mismatch at %d",
-				i
-			);
-		}
+	memset(bhash->indices, 0, sizeof(bhash_index_t) * hash_capacity);
+	if (bhash->ctrl != NULL) { memset(bhash->ctrl, BHASH_CTRL_EMPTY, hash_capacity); }
+	for (bhash_index_t i = 0, len = bhash->len; i < len; ++i) {
+		bhash_insert_index(bhash, order != NULL ? order[i] : i);
 	}
 }
 
-void
-bhash__do_cleanup(bhash_base_t* bhash) {
-	BHASH_REALLOC(*bhash_keys_ptr(bhash), 0, bhash->memctx);
+#define BHASH_FROZEN_VERSION 1
+#define BHASH_FROZEN_REMOVABLE 1
+#define BHASH_FROZEN_GROUP_PROBE 2
+
+enum {
+	BHASH_FROZEN_INDICES,
+	BHASH_FROZEN_R_INDICES,
+	BHASH_FROZEN_HASHES,
+	BHASH_FROZEN_CTRL,
+	BHASH_FROZEN_KEYS,
+	BHASH_FROZEN_VALUES,
+	BHASH_FROZEN_NUM_SECTIONS,
+};
+
+// Header of a frozen image, all sections follow it at cache line boundaries
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint16_t index_size;
+	uint16_t hash_size;
+	uint32_t flags;
+	uint32_t group_width;
+	uint64_t key_size;
+	uint64_t value_size;
+	uint64_t image_size;
+	int64_t len;
+	int64_t exp;
+	int64_t free_space;
+	int64_t load_percent;
+} bhash_frozen_header_t;
+
+static const char bhash_frozen_magic[8] = "BHASHFZ";
+
+static inline void*
+bhash_clone_array(bhash_base_t* bhash, const void* ptr, size_t capacity, size_t size) {
+	if (ptr == NULL || capacity == 0) { return NULL; }
+
+	void* copy = BHASH_REALLOC(NULL, capacity, bhash->memctx);
+	memcpy(copy, ptr, size);
+	return copy;
+}
+
+// Move the arrays of a table created with bhash_build or bhash_load_frozen
+// into separate allocations so that they can be modified and resized
+static inline void
+bhash_unpack(bhash_base_t* bhash) {
+	bhash_index_t hash_capacity = (bhash_index_t)1 << bhash->exp;
+	bhash_index_t data_capacity = hash_capacity * bhash->load_percent / 100;
+	bhash_index_t extra_space = bhash->r_indices != NULL ? 1 : 0;
+	size_t len = (size_t)bhash->len;
+	bhash->indices = bhash_clone_array(
+		bhash, bhash->indices,
+		sizeof(bhash_index_t) * hash_capacity, sizeof(bhash_index_t) * hash_capacity
+	);
+	bhash->r_indices = bhash_clone_array(
+		bhash, bhash->r_indices,
+		sizeof(bhash_index_t) * data_capacity, sizeof(bhash_index_t) * len
+	);
+	bhash->hashes = bhash_clone_array(
+		bhash, bhash->hashes,
+		sizeof(bhash_hash_t) * data_capacity, sizeof(bhash_hash_t) * len
+	);
+	bhash->ctrl = bhash_clone_array(bhash, bhash->ctrl, hash_capacity, hash_capacity);
+	*bhash__keys_ptr(bhash) = bhash_clone_array(
+		bhash, *bhash__keys_ptr(bhash),
+		bhash->key_size * (data_capacity + extra_space), bhash->key_size * len
+	);
 	if (bhash->value_size > 0) {
-		BHASH_REALLOC(*bhash_values_ptr(bhash), 0, bhash->memctx);
+		*bhash__values_ptr(bhash) = bhash_clone_array(
+			bhash, *bhash__values_ptr(bhash),
+			bhash->value_size * (data_capacity + extra_space), bhash->value_size * len
+		);
+	}
+
+	if (bhash->block != NULL) {
+		BHASH_REALLOC(bhash->block, 0, bhash->memctx);
+		bhash->block = NULL;
+	}
+
+	if (bhash->image != NULL) {
+		bhash->free_space = (bhash_index_t)((const bhash_frozen_header_t*)bhash->image)->free_space;
+		bhash->image = NULL;
 	}
-	BHASH_REALLOC(bhash->indices, 0, bhash->memctx);
-	BHASH_REALLOC(bhash->r_indices, 0, bhash->memctx);
-	BHASH_REALLOC(bhash->hashes, 0, bhash->memctx);
+}
+
+static inline void
+bhash_maybe_grow(bhash_base_t* bhash) {
+	if (bhash->free_space > 0) { return; }
+
+	if (bhash->block != NULL || bhash->image != NULL) {
+		bhash_unpack(bhash);
+		if (bhash->free_space > 0) { return; }
+	}
+
+	// A pending migration must be completed before the index is rebuilt again
+	if (bhash->old_indices != NULL) {
+		bhash_migrate(bhash, (bhash_index_t)1 << bhash->old_exp);
+	}
+
+	bool incremental = bhash->migrate_step > 0;
+	bhash_index_t exp = bhash->exp;
+	bhash_index_t hash_capacity = 1 << exp;
+	bhash_index_t data_capacity = hash_capacity * bhash->load_percent / 100;
+	bhash_index_t num_tombstones = data_capacity - bhash->len;
+	if (incremental) {
+		bhash->old_indices = bhash->indices;
+		bhash->old_ctrl = bhash->ctrl;
+		bhash->old_exp = exp;
+		bhash->migrate_pos = 0;
+	}
+
+	// Grow if there are not too many tombstone. Otherwise, do in-place rehash
+	if (num_tombstones < data_capacity * bhash->tombstone_percent / 100) {
+		bhash->exp = exp += 1;
+		hash_capacity = 1 << exp;
+		data_capacity = hash_capacity * bhash->load_percent / 100;
+		if (!incremental) {
+			bhash->indices = BHASH_REALLOC(bhash->indices, sizeof(bhash_index_t) * hash_capacity, bhash->memctx);
+			if (bhash->ctrl) {
+				bhash->ctrl = BHASH_REALLOC(bhash->ctrl, hash_capacity, bhash->memctx);
+			}
+		}
+		bhash->hashes = BHASH_REALLOC(bhash->hashes, sizeof(bhash_hash_t) * data_capacity, bhash->memctx);
+		if (bhash->r_indices) {
+			bhash->r_indices = BHASH_REALLOC(bhash->r_indices, sizeof(bhash_index_t) * data_capacity, bhash->memctx);
+		}
+
+		bhash_index_t extra_space = bhash->r_indices != NULL ? 1 : 0;
+		*bhash__keys_ptr(bhash) = BHASH_REALLOC(*bhash__keys_ptr(bhash), bhash->key_size * (data_capacity + extra_space), bhash->memctx);
+		if (bhash->value_size > 0) {
+			*bhash__values_ptr(bhash) = BHASH_REALLOC(*bhash__values_ptr(bhash), bhash->value_size * (data_capacity + extra_space), bhash->memctx);
+		}
+	}
+
+	// Every entry reserves a slot in the new index, even before it is migrated
+	bhash->free_space = data_capacity - bhash->len;
+
+	if (incremental) {
+		// Entries will be reinserted from the old index in later operations
+		bhash->indices = BHASH_REALLOC(NULL, sizeof(bhash_index_t) * hash_capacity, bhash->memctx);
+		memset(bhash->indices, 0, sizeof(bhash_index_t) * hash_capacity);
+		if (bhash->old_ctrl != NULL) {
+			bhash->ctrl = BHASH_REALLOC(NULL, hash_capacity, bhash->memctx);
+			memset(bhash->ctrl, BHASH_CTRL_EMPTY, hash_capacity);
+		}
+		return;
+	}
+
+	bhash_rebuild_index(bhash, NULL);
+}
+
+// The index which currently holds a given entry
+static inline bhash_index_t*
+bhash_owner_indices(bhash_base_t* bhash, bhash_index_t data_index) {
+	if (
+		bhash->old_indices == NULL
+		|| bhash->indices[bhash->r_indices[data_index]] == data_index + 1
+	) {
+		return bhash->indices;
+	} else {
+		return bhash->old_indices;
+	}
+}
+
+static inline void
+bhash_find_hashed_impl(
+	bhash_base_t* bhash,
+	bhash_index_t* out_data_index,
+	bhash_index_t* out_hash_index,
+	const void* key,
+	bhash_hash_t hash
+) {
+	bhash__find_hashed(bhash, out_data_index, out_hash_index, key, hash, bhash->key_size, bhash->eq);
+}
+
+static inline void
+bhash_find_impl(
+	bhash_base_t* bhash,
+	bhash_index_t* out_data_index,
+	bhash_index_t* out_hash_index,
+	const void* key
+) {
+	bhash_hash_t hash = bhash->hash(key, bhash->key_size);
+	bhash_find_hashed_impl(bhash, out_data_index, out_hash_index, key, hash);
+}
+
+void
+bhash__do_init(
+	bhash_base_t* bhash,
+	size_t key_size,
+	size_t value_size,
+	bhash_config_t config
+) {
+	bhash_index_t exp = config.initial_exp;
+	if (config.group_probe && exp < BHASH_GROUP_EXP) { exp = BHASH_GROUP_EXP; }
+	bhash_index_t hash_capacity = 1 << exp;
+	bhash_index_t data_capacity = hash_capacity * config.load_percent / 100;
+	bhash_index_t extra_space = config.removable ? 1 : 0; // Extra temp space for swapping
+	(*bhash) = (bhash_base_t){
+		.memctx = config.memctx,
+		.hash = config.hash,
+		.eq = config.eq,
+		.load_percent = config.load_percent,
+		.tombstone_percent = config.tombstone_percent,
+		.key_size = key_size,
+		.value_size = value_size,
+		.indices = BHASH_REALLOC(NULL, sizeof(bhash_index_t) * hash_capacity, config.memctx),
+		.hashes = BHASH_REALLOC(NULL, sizeof(bhash_hash_t) * data_capacity, config.memctx),
+		.len = 0,
+		.exp = exp,
+		.free_space = data_capacity,
+		.migrate_step = config.incremental_rehash,
+	};
+	memset(bhash->indices, 0, sizeof(bhash_index_t) * hash_capacity);
+
+	if (config.group_probe) {
+		bhash->ctrl = BHASH_REALLOC(NULL, hash_capacity, config.memctx);
+		memset(bhash->ctrl, BHASH_CTRL_EMPTY, hash_capacity);
+	}
+
+	if (config.removable) {
+		bhash->r_indices = BHASH_REALLOC(NULL, sizeof(bhash_index_t) * data_capacity, config.memctx);
+	}
+
+	*bhash__keys_ptr(bhash) = BHASH_REALLOC(NULL, key_size * (data_capacity + extra_space), config.memctx);
+	if (value_size > 0) {
+		*bhash__values_ptr(bhash) = BHASH_REALLOC(NULL, value_size * (data_capacity + extra_space), config.memctx);
+	} else {
+		*bhash__values_ptr(bhash) = NULL;
+	}
+}
+
+void
+bhash__do_reinit(bhash_base_t* bhash, size_t key_size, size_t value_size, bhash_config_t config) {
+	if (bhash->eq != NULL) {
+		bhash->eq = config.eq;
+		bhash->hash = config.hash;
+		bhash->memctx = config.memctx;
+	} else {
+		bhash__do_init(bhash, key_size, value_size, config);
+	}
+}
+
+static inline bhash_index_t
+bhash_home_slot(bhash_base_t* bhash, bhash_hash_t hash) {
+	return bhash->ctrl != NULL
+		? bhash__group_start(hash, bhash->exp) * BHASH_GROUP_WIDTH
+		: bhash__lookup_index(hash, bhash->exp, (bhash_index_t)hash);
+}
+
+void
+bhash__do_build(
+	bhash_base_t* bhash,
+	size_t key_size,
+	size_t value_size,
+	const void* keys,
+	const void* values,
+	bhash_index_t n,
+	bhash_config_t config
+) {
+	bhash_index_t exp = config.initial_exp;
+	if (config.group_probe && exp < BHASH_GROUP_EXP) { exp = BHASH_GROUP_EXP; }
+	while (((bhash_index_t)1 << exp) * config.load_percent / 100 < n) { ++exp; }
+	bhash_index_t hash_capacity = 1 << exp;
+	bhash_index_t data_capacity = hash_capacity * config.load_percent / 100;
+	bhash_index_t extra_space = config.removable ? 1 : 0; // Extra temp space for swapping
+
+	mem_layout_t layout = { 0 };
+	ptrdiff_t indices = mem_layout_reserve(&layout, sizeof(bhash_index_t) * hash_capacity, _Alignof(bhash_index_t));
+	ptrdiff_t r_indices = mem_layout_reserve(&layout, sizeof(bhash_index_t) * data_capacity, _Alignof(bhash_index_t));
+	ptrdiff_t hashes = mem_layout_reserve(&layout, sizeof(bhash_hash_t) * data_capacity, _Alignof(bhash_hash_t));
+	ptrdiff_t ctrl = mem_layout_reserve(&layout, config.group_probe ? hash_capacity : 0, 1);
+	ptrdiff_t key_data = mem_layout_reserve(&layout, key_size * (data_capacity + extra_space), _Alignof(BHASH_MAX_ALIGN_TYPE));
+	ptrdiff_t value_data = mem_layout_reserve(&layout, value_size * (data_capacity + extra_space), _Alignof(BHASH_MAX_ALIGN_TYPE));
+	void* block = BHASH_REALLOC(NULL, mem_layout_size(&layout), config.memctx);
+
+	(*bhash) = (bhash_base_t){
+		.memctx = config.memctx,
+		.hash = config.hash,
+		.eq = config.eq,
+		.load_percent = config.load_percent,
+		.tombstone_percent = config.tombstone_percent,
+		.key_size = key_size,
+		.value_size = value_size,
+		.indices = mem_layout_locate(block, indices),
+		.r_indices = config.removable ? mem_layout_locate(block, r_indices) : NULL,
+		.hashes = mem_layout_locate(block, hashes),
+		.ctrl = config.group_probe ? mem_layout_locate(block, ctrl) : NULL,
+		.len = n,
+		.exp = exp,
+		.free_space = data_capacity - n,
+		.migrate_step = config.incremental_rehash,
+		.block = block,
+	};
+	*bhash__keys_ptr(bhash) = mem_layout_locate(block, key_data);
+	*bhash__values_ptr(bhash) = value_size > 0 ? mem_layout_locate(block, value_data) : NULL;
+
+	if (n == 0) {
+		bhash_rebuild_index(bhash, NULL);
+		return;
+	}
+
+	memcpy(*bhash__keys_ptr(bhash), keys, key_size * n);
+	if (value_size > 0) { memcpy(*bhash__values_ptr(bhash), values, value_size * n); }
+	for (bhash_index_t i = 0; i < n; ++i) {
+		bhash->hashes[i] = config.hash((const char*)keys + key_size * i, key_size);
+	}
+
+	if (n < BHASH_BUILD_SORT_MIN) {
+		bhash_rebuild_index(bhash, NULL);
+		return;
+	}
+
+	// Counting sort by the highest bits of each home slot
+	bhash_index_t shift = exp > BHASH_BUILD_SORT_BITS ? exp - BHASH_BUILD_SORT_BITS : 0;
+	bhash_index_t offsets[(1 << BHASH_BUILD_SORT_BITS) + 1] = { 0 };
+	for (bhash_index_t i = 0; i < n; ++i) {
+		offsets[(bhash_home_slot(bhash, bhash->hashes[i]) >> shift) + 1] += 1;
+	}
+	for (bhash_index_t i = 1; i <= (1 << BHASH_BUILD_SORT_BITS); ++i) {
+		offsets[i] += offsets[i - 1];
+	}
+	bhash_index_t* order = BHASH_REALLOC(NULL, sizeof(bhash_index_t) * n, config.memctx);
+	for (bhash_index_t i = 0; i < n; ++i) {
+		order[offsets[bhash_home_slot(bhash, bhash->hashes[i]) >> shift]++] = i;
+	}
+	bhash_rebuild_index(bhash, order);
+	BHASH_REALLOC(order, 0, config.memctx);
+}
+
+// Offsets of all sections in a frozen image, returns the size of the image
+static inline size_t
+bhash_frozen_layout(
+	const bhash_frozen_header_t* header,
+	ptrdiff_t offsets[BHASH_FROZEN_NUM_SECTIONS],
+	size_t sizes[BHASH_FROZEN_NUM_SECTIONS]
+) {
+	size_t hash_capacity = (size_t)1 << header->exp;
+	size_t len = (size_t)header->len;
+	sizes[BHASH_FROZEN_INDICES] = sizeof(bhash_index_t) * hash_capacity;
+	sizes[BHASH_FROZEN_R_INDICES] = header->flags & BHASH_FROZEN_REMOVABLE ? sizeof(bhash_index_t) * len : 0;
+	sizes[BHASH_FROZEN_HASHES] = sizeof(bhash_hash_t) * len;
+	sizes[BHASH_FROZEN_CTRL] = header->flags & BHASH_FROZEN_GROUP_PROBE ? hash_capacity : 0;
+	sizes[BHASH_FROZEN_KEYS] = (size_t)header->key_size * len;
+	sizes[BHASH_FROZEN_VALUES] = (size_t)header->value_size * len;
+
+	mem_layout_t layout = { 0 };
+	mem_layout_reserve(&layout, sizeof(bhash_frozen_header_t), 1);
+	for (int i = 0; i < BHASH_FROZEN_NUM_SECTIONS; ++i) {
+		offsets[i] = mem_layout_reserve(&layout, sizes[i], BHASH_CACHE_LINE_SIZE);
+	}
+	return mem_layout_size(&layout);
+}
+
+static inline bhash_frozen_header_t
+bhash_frozen_header(bhash_base_t* bhash) {
+	bhash_frozen_header_t header = {
+		.version = BHASH_FROZEN_VERSION,
+		.index_size = sizeof(bhash_index_t),
+		.hash_size = sizeof(bhash_hash_t),
+		.flags = (bhash->r_indices != NULL ? BHASH_FROZEN_REMOVABLE : 0)
+			| (bhash->ctrl != NULL ? BHASH_FROZEN_GROUP_PROBE : 0),
+		.group_width = BHASH_GROUP_WIDTH,
+		.key_size = bhash->key_size,
+		.value_size = bhash->value_size,
+		.len = bhash->len,
+		.exp = bhash->exp,
+		.free_space = bhash->free_space,
+		.load_percent = bhash->load_percent,
+	};
+	memcpy(header.magic, bhash_frozen_magic, sizeof(header.magic));
+	return header;
+}
+
+size_t
+bhash__do_frozen_size(bhash_base_t* bhash) {
+	bhash_frozen_header_t header = bhash_frozen_header(bhash);
+	ptrdiff_t offsets[BHASH_FROZEN_NUM_SECTIONS];
+	size_t sizes[BHASH_FROZEN_NUM_SECTIONS];
+	return bhash_frozen_layout(&header, offsets, sizes);
+}
+
+bool
+bhash__do_freeze(bhash_base_t* bhash, bhash_write_fn_t write, void* ctx) {
+	if (bhash->old_indices != NULL) {
+		bhash_migrate(bhash, (bhash_index_t)1 << bhash->old_exp);
+	}
+
+	bhash_frozen_header_t header = bhash_frozen_header(bhash);
+	ptrdiff_t offsets[BHASH_FROZEN_NUM_SECTIONS];
+	size_t sizes[BHASH_FROZEN_NUM_SECTIONS];
+	header.image_size = bhash_frozen_layout(&header, offsets, sizes);
+
+	const void* sections[BHASH_FROZEN_NUM_SECTIONS] = {
+		[BHASH_FROZEN_INDICES] = bhash->indices,
+		[BHASH_FROZEN_R_INDICES] = bhash->r_indices,
+		[BHASH_FROZEN_HASHES] = bhash->hashes,
+		[BHASH_FROZEN_CTRL] = bhash->ctrl,
+		[BHASH_FROZEN_KEYS] = *bhash__keys_ptr(bhash),
+		[BHASH_FROZEN_VALUES] = bhash->value_size > 0 ? *bhash__values_ptr(bhash) : NULL,
+	};
+
+	if (write(ctx, &header, sizeof(header)) != sizeof(header)) { return false; }
+	size_t pos = sizeof(header);
+	static const char padding[BHASH_CACHE_LINE_SIZE] = { 0 };
+	for (int i = 0; i < BHASH_FROZEN_NUM_SECTIONS; ++i) {
+		if (sizes[i] == 0) { continue; }
+
+		size_t padding_size = (size_t)offsets[i] - pos;
+		if (write(ctx, padding, padding_size) != padding_size) { return false; }
+		if (write(ctx, sections[i], sizes[i]) != sizes[i]) { return false; }
+		pos = (size_t)offsets[i] + sizes[i];
+	}
+
+	size_t padding_size = header.image_size - pos;
+	return write(ctx, padding, padding_size) == padding_size;
+}
+
+bool
+bhash__do_load_frozen(
+	bhash_base_t* bhash,
+	size_t key_size,
+	size_t value_size,
+	const void* image,
+	size_t size,
+	bhash_config_t config
+) {
+	const bhash_frozen_header_t* header = image;
+	bool valid = image != NULL
+		&& (uintptr_t)image % _Alignof(BHASH_MAX_ALIGN_TYPE) == 0
+		&& size >= sizeof(bhash_frozen_header_t)
+		&& memcmp(header->magic, bhash_frozen_magic, sizeof(header->magic)) == 0
+		&& header->version == BHASH_FROZEN_VERSION
+		&& header->index_size == sizeof(bhash_index_t)
+		&& header->hash_size == sizeof(bhash_hash_t)
+		&& (!(header->flags & BHASH_FROZEN_GROUP_PROBE) || header->group_width == BHASH_GROUP_WIDTH)
+		&& header->key_size == key_size
+		&& header->value_size == value_size
+		// The capacity is multiplied by load_percent in bhash_index_t
+		&& header->exp >= 0 && header->exp < (int64_t)sizeof(bhash_index_t) * 8 - 8
+		// Group probing starts from exp - BHASH_GROUP_EXP bits of the hash
+		&& (!(header->flags & BHASH_FROZEN_GROUP_PROBE) || header->exp >= BHASH_GROUP_EXP)
+		&& header->load_percent > 0 && header->load_percent < 100
+		&& header->len >= 0
+		&& header->len <= ((int64_t)1 << header->exp) * header->load_percent / 100
+		&& header->image_size <= size;
+
+	ptrdiff_t offsets[BHASH_FROZEN_NUM_SECTIONS];
+	size_t sizes[BHASH_FROZEN_NUM_SECTIONS];
+	if (!valid || bhash_frozen_layout(header, offsets, sizes) != header->image_size) {
+		bhash__do_init(bhash, key_size, value_size, config);
+		return false;
+	}
+
+	void* base = (void*)image;
+	(*bhash) = (bhash_base_t){
+		.memctx = config.memctx,
+		.hash = config.hash,
+		.eq = config.eq,
+		.load_percent = (bhash_index_t)header->load_percent,
+		.tombstone_percent = config.tombstone_percent,
+		.key_size = key_size,
+		.value_size = value_size,
+		.indices = mem_layout_locate(base, offsets[BHASH_FROZEN_INDICES]),
+		.r_indices = header->flags & BHASH_FROZEN_REMOVABLE
+			? mem_layout_locate(base, offsets[BHASH_FROZEN_R_INDICES])
+			: NULL,
+		.hashes = mem_layout_locate(base, offsets[BHASH_FROZEN_HASHES]),
+		.ctrl = header->flags & BHASH_FROZEN_GROUP_PROBE
+			? mem_layout_locate(base, offsets[BHASH_FROZEN_CTRL])
+			: NULL,
+		.len = (bhash_index_t)header->len,
+		.exp = (bhash_index_t)header->exp,
+		// Any attempt to insert goes through bhash_maybe_grow which copies the image
+		.free_space = 0,
+		.migrate_step = config.incremental_rehash,
+		.image = image,
+	};
+	*bhash__keys_ptr(bhash) = mem_layout_locate(base, offsets[BHASH_FROZEN_KEYS]);
+	if (value_size > 0) {
+		*bhash__values_ptr(bhash) = mem_layout_locate(base, offsets[BHASH_FROZEN_VALUES]);
+	}
+
+	return true;
+}
+
+bhash_alloc_result_t
+bhash__do_alloc(bhash_base_t* bhash, const void* key) {
+	bhash_migrate_step(bhash);
+	bhash_maybe_grow(bhash);
+	bhash_hash_t hash = bhash->hash(key, bhash->key_size);
+	return bhash__alloc_hashed(bhash, key, hash, bhash->key_size, bhash->eq);
+}
+
+void
+bhash__do_maybe_grow(bhash_base_t* bhash) {
+	bhash_maybe_grow(bhash);
+}
+
+void
+bhash__do_migrate(bhash_base_t* bhash) {
+	bhash_migrate_step(bhash);
+}
+
+bhash_index_t
+bhash__do_find(bhash_base_t* bhash, const void* key) {
+	bhash_migrate_step(bhash);
+	bhash_index_t data_index;
+	bhash_index_t hash_index;
+	bhash_find_impl(bhash, &data_index, &hash_index, key);
+	return data_index;
+}
+
+void
+bhash__do_find_many(
+	bhash_base_t* bhash,
+	const void* keys,
+	bhash_index_t n,
+	bhash_index_t* out_indices
+) {
+	bhash_migrate_step(bhash);
+	bhash_hash_t batch_hashes[BHASH_FIND_BATCH_SIZE];
+	bhash_index_t* indices = bhash->indices;
+	bhash_hash_t* hashes = bhash->hashes;
+	const uint8_t* ctrl = bhash->ctrl;
+	bhash_index_t exp = bhash->exp;
+	size_t key_size = bhash->key_size;
+
+	for (bhash_index_t batch_start = 0; batch_start < n; batch_start += BHASH_FIND_BATCH_SIZE) {
+		bhash_index_t batch_size = n - batch_start < BHASH_FIND_BATCH_SIZE
+			? n - batch_start
+			: BHASH_FIND_BATCH_SIZE;
+		const char* batch_keys = (const char*)keys + (size_t)batch_start * key_size;
+
+		// Hash all keys and prefetch their first probe location
+		for (bhash_index_t i = 0; i < batch_size; ++i) {
+			bhash_hash_t hash = bhash->hash(batch_keys + (size_t)i * key_size, key_size);
+			batch_hashes[i] = hash;
+			if (ctrl != NULL) {
+				bhash_index_t group = bhash__group_start(hash, exp);
+				BHASH_PREFETCH(ctrl + group * BHASH_GROUP_WIDTH);
+				BHASH_PREFETCH(indices + group * BHASH_GROUP_WIDTH);
+			} else {
+				BHASH_PREFETCH(indices + bhash__lookup_index(hash, exp, (bhash_index_t)hash));
+			}
+		}
+
+		// Prefetch the data of the first candidate of each key
+		for (bhash_index_t i = 0; i < batch_size; ++i) {
+			bhash_hash_t hash = batch_hashes[i];
+			bhash_index_t data_index;
+			if (ctrl != NULL) {
+				bhash_index_t group = bhash__group_start(hash, exp);
+				bhash__group_mask_t mask = bhash__group_match(
+					ctrl + group * BHASH_GROUP_WIDTH,
+					bhash__group_tag(hash)
+				);
+				data_index = mask != 0
+					? indices[group * BHASH_GROUP_WIDTH + bhash__ctz(mask)]
+					: BHASH_EMPTY;
+			} else {
+				data_index = indices[bhash__lookup_index(hash, exp, (bhash_index_t)hash)];
+			}
+
+			if (data_index > 0) {
+				BHASH_PREFETCH(hashes + data_index - 1);
+				BHASH_PREFETCH(bhash__key_at(bhash, data_index - 1));
+			}
+		}
+
+		// Resolve
+		for (bhash_index_t i = 0; i < batch_size; ++i) {
+			bhash_index_t hash_index;
+			bhash_find_hashed_impl(
+				bhash,
+				&out_indices[batch_start + i],
+				&hash_index,
+				batch_keys + (size_t)i * key_size,
+				batch_hashes[i]
+			);
+		}
+	}
+}
+
+bhash_index_t
+bhash__do_remove(bhash_base_t* bhash, const void* key) {
+	if (bhash->r_indices == NULL) { return -1; }
+
+	bhash_migrate_step(bhash);
+	bhash_index_t remove_index, remove_r_index;
+	bhash_find_impl(bhash, &remove_index, &remove_r_index, key);
+	if (remove_index == -1) { return remove_index; }
+
+	return bhash__do_remove_at(bhash, remove_index, remove_r_index);
+}
+
+bhash_index_t
+bhash__do_remove_at(bhash_base_t* bhash, bhash_index_t remove_index, bhash_index_t remove_r_index) {
+	if (bhash->image != NULL) { bhash_unpack(bhash); }
+
+	bhash_index_t end_index = bhash->len;
+	bhash_index_t tail_index = end_index - 1;
+
+	// During a migration, each entry can be in either the old or the new index
+	bhash_index_t* tail_indices = bhash_owner_indices(bhash, tail_index);
+	bhash_index_t* remove_indices = bhash_owner_indices(bhash, remove_index);
+	uint8_t* remove_ctrl = remove_indices == bhash->indices ? bhash->ctrl : bhash->old_ctrl;
+	// An entry removed before migration releases its reserved slot
+	bhash->free_space += remove_indices != bhash->indices;
+
+	// Move the last element into the deleted slot and delete the last element
+	bhash_index_t tail_r_index = bhash->r_indices[tail_index];
+	tail_indices[tail_r_index] = remove_index + 1;
+	remove_indices[remove_r_index] = BHASH_TOMBSTONE;
+	if (remove_ctrl != NULL) { remove_ctrl[remove_r_index] = BHASH_CTRL_DELETED; }
+	bhash->r_indices[remove_index] = tail_r_index;
+	bhash->hashes[remove_index] = bhash->hashes[tail_index];
+
+	// Rotate key and values then point user code to the temp position at the end
+	memcpy(bhash__key_at(bhash, end_index), bhash__key_at(bhash, remove_index), bhash->key_size);
+	memcpy(bhash__key_at(bhash, remove_index), bhash__key_at(bhash, tail_index), bhash->key_size);
+	if (bhash->value_size > 0) {
+		memcpy(bhash__value_at(bhash, end_index), bhash__value_at(bhash, remove_index), bhash->value_size);
+		memcpy(bhash__value_at(bhash, remove_index), bhash__value_at(bhash, tail_index), bhash->value_size);
+	}
+
+	bhash->len -= 1;
+	return end_index;
+}
+
+static inline void
+bhash_validate_index(
+	bhash_base_t* bhash,
+	const bhash_index_t* indices,
+	const uint8_t* ctrl,
+	bhash_index_t exp
+) {
+	bhash_index_t len = bhash->len;
+	bhash_hash_t* hashes = bhash->hashes;
+	bhash_index_t* r_indices = bhash->r_indices;
+	bhash_index_t hash_capacity = (bhash_index_t)1 << exp;
+	for (bhash_index_t i = 0; i < hash_capacity; ++i) {
+		bhash_index_t index = indices[i];
+		if (index <= 0) {
+			BHASH_ASSERT(
+				index == BHASH_EMPTY || index == BHASH_TOMBSTONE,
+				"%s: Invalid negative index %d",
+				index
+			);
+		} else {
+			BHASH_ASSERT(
+				(index - 1) <= len,
+				"%s: Invalid positive index %d",
+				index
+			);
+			bhash_index_t r_index = r_indices[index - 1];
+			BHASH_ASSERT(
+				i == r_index,
+				"%s: Index mismatch at %d",
+				i
+			);
+		}
+
+		if (ctrl != NULL) {
+			uint8_t expected_ctrl = index == BHASH_EMPTY
+				? BHASH_CTRL_EMPTY
+				: (index == BHASH_TOMBSTONE ? BHASH_CTRL_DELETED : bhash__group_tag(hashes[index - 1]));
+			BHASH_ASSERT(ctrl[i] == expected_ctrl, "%s: Control byte mismatch at %d", i);
+		}
+	}
+}
+
+void
+bhash__do_validate(bhash_base_t* bhash) {
+	bhash_index_t len = bhash->len;
+	bhash_hash_t* hashes = bhash->hashes;
+	bhash_index_t* r_indices = bhash->r_indices;
+	for (bhash_index_t i = 0; i < len; ++i) {
+		bhash_hash_t stored_hash = hashes[i];
+		bhash_hash_t computed_hash = bhash->hash(bhash__key_at(bhash, i), bhash->key_size);
+		BHASH_ASSERT(stored_hash == computed_hash, "%s: Hash mismatch at %d", i);
+		bhash_index_t r_index = r_indices[i];
+		bhash_index_t index = bhash_owner_indices(bhash, i)[r_index];
+		BHASH_ASSERT(index == i + 1, "%s: Index mismatch at %d", i);
+	}
+	bhash_index_t hash_capacity = (bhash_index_t)1 << bhash->exp;
+	bhash_index_t data_capacity = hash_capacity * bhash->load_percent / 100;
+	BHASH_ASSERT(len <= data_capacity, "%s: Invalid length %d (max: %d)", len, data_capacity);
+	bhash_validate_index(bhash, bhash->indices, bhash->ctrl, bhash->exp);
+	if (bhash->old_indices != NULL) {
+		bhash_validate_index(bhash, bhash->old_indices, bhash->old_ctrl, bhash->old_exp);
+	}
+}
+
+void
+bhash__do_cleanup(bhash_base_t* bhash) {
+	// The image is owned by user code
+	if (bhash->image != NULL) { return; }
+
+	if (bhash->block != NULL) {
+		BHASH_REALLOC(bhash->block, 0, bhash->memctx);
+		return;
+	}
+
+	BHASH_REALLOC(*bhash__keys_ptr(bhash), 0, bhash->memctx);
+	if (bhash->value_size > 0) {
+		BHASH_REALLOC(*bhash__values_ptr(bhash), 0, bhash->memctx);
+	}
+	BHASH_REALLOC(bhash->indices, 0, bhash->memctx);
+	BHASH_REALLOC(bhash->r_indices, 0, bhash->memctx);
+	BHASH_REALLOC(bhash->hashes, 0, bhash->memctx);
+	BHASH_REALLOC(bhash->ctrl, 0, bhash->memctx);
+	BHASH_REALLOC(bhash->old_indices, 0, bhash->memctx);
+	BHASH_REALLOC(bhash->old_ctrl, 0, bhash->memctx);
 }
 
 void
 bhash__do_clear(bhash_base_t* bhash) {
+	if (bhash->image != NULL) { bhash_unpack(bhash); }
+
 	bhash->len = 0;
+	BHASH_REALLOC(bhash->old_indices, 0, bhash->memctx);
+	BHASH_REALLOC(bhash->old_ctrl, 0, bhash->memctx);
+	bhash->old_indices = NULL;
+	bhash->old_ctrl = NULL;
 	bhash_index_t hash_capacity = 1 << bhash->exp;
 	memset(bhash->indices, 0, sizeof(bhash_index_t) * hash_capacity);
+	if (bhash->ctrl != NULL) { memset(bhash->ctrl, BHASH_CTRL_EMPTY, hash_capacity); }
 	bhash->free_space = hash_capacity * bhash->load_percent / 100;
 }
 
+// Concurrent table
+
+#if defined(_MSC_VER) && !defined(__clang__)
+
+// Volatile accesses have acquire/release semantics on x86 and x64
+#	if defined(_M_ARM64)
+#		define BHASH_ORDER_BARRIER() __dmb(_ARM64_BARRIER_ISH)
+#		define BHASH_FULL_BARRIER() __dmb(_ARM64_BARRIER_ISH)
+#	else
+#		define BHASH_ORDER_BARRIER() _ReadWriteBarrier()
+#		define BHASH_FULL_BARRIER() _mm_mfence()
+#	endif
+
+static inline bhash_index_t
+bhash_load_index(const bhash_index_t* ptr) {
+	bhash_index_t value = *(const volatile bhash_index_t*)ptr;
+	BHASH_ORDER_BARRIER();
+	return value;
+}
+
+static inline void
+bhash_store_index(bhash_index_t* ptr, bhash_index_t value) {
+	BHASH_ORDER_BARRIER();
+	*(volatile bhash_index_t*)ptr = value;
+}
+
+static inline void*
+bhash_load_ptr(void* const* ptr) {
+	void* value = *(void* const volatile*)ptr;
+	BHASH_ORDER_BARRIER();
+	return value;
+}
+
+static inline void
+bhash_store_ptr(void** ptr, void* value) {
+	BHASH_ORDER_BARRIER();
+	*(void* volatile*)ptr = value;
+}
+
+static inline uint64_t
+bhash_load_epoch(const uint64_t* ptr) {
+	uint64_t value = *(const volatile uint64_t*)ptr;
+	BHASH_ORDER_BARRIER();
+	return value;
+}
+
+static inline void
+bhash_store_epoch(uint64_t* ptr, uint64_t value) {
+	BHASH_ORDER_BARRIER();
+	*(volatile uint64_t*)ptr = value;
+}
+
+static inline void
+bhash_full_barrier(void) {
+	BHASH_FULL_BARRIER();
+}
+
+#else
+
+static inline bhash_index_t
+bhash_load_index(const bhash_index_t* ptr) {
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+bhash_store_index(bhash_index_t* ptr, bhash_index_t value) {
+	__atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+static inline void*
+bhash_load_ptr(void* const* ptr) {
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+bhash_store_ptr(void** ptr, void* value) {
+	__atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t
+bhash_load_epoch(const uint64_t* ptr) {
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void
+bhash_store_epoch(uint64_t* ptr, uint64_t value) {
+	__atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+static inline void
+bhash_full_barrier(void) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif
+
+// An immutable snapshot of the table layout.
+// Within a version, a slot only ever changes from empty to occupied, from one
+// entry to another or to a tombstone.
+// Data entries are append-only.
+struct bhash_concurrent_version_s {
+	struct bhash_concurrent_version_s* next;
+	uint64_t retire_epoch;
+	bhash_index_t exp;
+	bhash_index_t data_capacity;
+	bhash_index_t data_len;
+	bhash_index_t free_space;
+	bhash_index_t* indices;
+	bhash_hash_t* hashes;
+	char* keys;
+	char* values;
+};
+
+typedef struct bhash_concurrent_version_s bhash_version_t;
+
+static inline bhash_version_t*
+bhash_version_alloc(bhash_concurrent_base_t* bhash, bhash_index_t exp) {
+	bhash_index_t hash_capacity = (bhash_index_t)1 << exp;
+	bhash_index_t data_capacity = hash_capacity * bhash->load_percent / 100;
+
+	mem_layout_t layout = { 0 };
+	mem_layout_reserve(&layout, sizeof(bhash_version_t), _Alignof(bhash_version_t));
+	ptrdiff_t indices = mem_layout_reserve(&layout, sizeof(bhash_index_t) * hash_capacity, BHASH_CACHE_LINE_SIZE);
+	ptrdiff_t hashes = mem_layout_reserve(&layout, sizeof(bhash_hash_t) * data_capacity, _Alignof(bhash_hash_t));
+	ptrdiff_t keys = mem_layout_reserve(&layout, bhash->key_size * data_capacity, _Alignof(BHASH_MAX_ALIGN_TYPE));
+	ptrdiff_t values = mem_layout_reserve(&layout, bhash->value_size * data_capacity, _Alignof(BHASH_MAX_ALIGN_TYPE));
+
+	void* mem = BHASH_REALLOC(NULL, mem_layout_size(&layout), bhash->memctx);
+	bhash_version_t* version = mem;
+	*version = (bhash_version_t){
+		.exp = exp,
+		.data_capacity = data_capacity,
+		.free_space = data_capacity,
+		.indices = mem_layout_locate(mem, indices),
+		.hashes = mem_layout_locate(mem, hashes),
+		.keys = mem_layout_locate(mem, keys),
+		.values = mem_layout_locate(mem, values),
+	};
+	memset(version->indices, 0, sizeof(bhash_index_t) * hash_capacity);
+
+	return version;
+}
+
+// Writer-side lookup.
+// Returns the slot holding the key or -1.
+// out_free_slot receives the first reusable slot.
+static inline bhash_index_t
+bhash_version_probe(
+	bhash_concurrent_base_t* bhash,
+	bhash_version_t* version,
+	const void* key,
+	bhash_hash_t hash,
+	bhash_index_t* out_free_slot
+) {
+	bhash_index_t free_slot = -1;
+	for (bhash_index_t hash_index = (bhash_index_t)hash;;) {
+		hash_index = bhash__lookup_index(hash, version->exp, hash_index);
+		bhash_index_t data_index = version->indices[hash_index];
+		if (data_index == BHASH_EMPTY) {
+			*out_free_slot = free_slot == -1 ? hash_index : free_slot;
+			return -1;
+		} else if (data_index == BHASH_TOMBSTONE) {
+			free_slot = free_slot == -1 ? hash_index : free_slot;
+		} else if (
+			version->hashes[data_index - 1] == hash
+			&& bhash->eq(key, version->keys + (data_index - 1) * bhash->key_size, bhash->key_size)
+		) {
+			*out_free_slot = free_slot;
+			return hash_index;
+		}
+	}
+}
+
+// Append an entry to an unpublished version
+static inline void
+bhash_version_append(
+	bhash_concurrent_base_t* bhash,
+	bhash_version_t* version,
+	bhash_hash_t hash,
+	const void* key,
+	const void* value
+) {
+	bhash_index_t data_index = version->data_len++;
+	version->hashes[data_index] = hash;
+	memcpy(version->keys + data_index * bhash->key_size, key, bhash->key_size);
+	if (bhash->value_size > 0) {
+		memcpy(version->values + data_index * bhash->value_size, value, bhash->value_size);
+	}
+}
+
+static inline void
+bhash_concurrent_rebuild(bhash_concurrent_base_t* bhash) {
+	bhash_version_t* old_version = bhash->version;
+	bhash_index_t exp = old_version->exp;
+	bhash_index_t num_garbage = old_version->data_len - bhash->len;
+	// Grow if there are not too many dead entries. Otherwise, only compact.
+	if (num_garbage < old_version->data_capacity * bhash->tombstone_percent / 100) {
+		exp += 1;
+	}
+
+	bhash_version_t* new_version = bhash_version_alloc(bhash, exp);
+	bhash_index_t old_hash_capacity = (bhash_index_t)1 << old_version->exp;
+	for (bhash_index_t i = 0; i < old_hash_capacity; ++i) {
+		bhash_index_t data_index = old_version->indices[i];
+		if (data_index <= 0) { continue; }
+
+		bhash_hash_t hash = old_version->hashes[data_index - 1];
+		bhash_version_append(
+			bhash,
+			new_version,
+			hash,
+			old_version->keys + (data_index - 1) * bhash->key_size,
+			old_version->values + (data_index - 1) * bhash->value_size
+		);
+		for (bhash_index_t hash_index = (bhash_index_t)hash;;) {
+			hash_index = bhash__lookup_index(hash, exp, hash_index);
+			if (new_version->indices[hash_index] == BHASH_EMPTY) {
+				new_version->indices[hash_index] = new_version->data_len;
+				new_version->free_space -= 1;
+				break;
+			}
+		}
+	}
+
+	bhash_store_ptr((void**)&bhash->version, new_version);
+	// Any reader entering after the epoch is incremented will see the new version
+	bhash_full_barrier();
+	old_version->retire_epoch = bhash->epoch;
+	bhash_store_epoch(&bhash->epoch, bhash->epoch + 1);
+	old_version->next = bhash->retired;
+	bhash->retired = old_version;
+
+	bhash__concurrent_reclaim(bhash);
+}
+
+void
+bhash__concurrent_init(
+	bhash_concurrent_base_t* bhash,
+	size_t key_size,
+	size_t value_size,
+	bhash_config_t config,
+	bhash_index_t num_readers
+) {
+	*bhash = (bhash_concurrent_base_t){
+		.memctx = config.memctx,
+		.hash = config.hash,
+		.eq = config.eq,
+		.load_percent = config.load_percent,
+		.tombstone_percent = config.tombstone_percent,
+		.key_size = key_size,
+		.value_size = value_size,
+		.num_readers = num_readers,
+		.epoch = 1,
+	};
+
+	// Give each reader its own cache line
+	bhash->readers_mem = BHASH_REALLOC(
+		NULL,
+		sizeof(bhash_concurrent_reader_t) * num_readers + BHASH_CACHE_LINE_SIZE,
+		config.memctx
+	);
+	bhash->readers = (bhash_concurrent_reader_t*)mem_layout_align_ptr(
+		(intptr_t)bhash->readers_mem, BHASH_CACHE_LINE_SIZE
+	);
+	memset(bhash->readers, 0, sizeof(bhash_concurrent_reader_t) * num_readers);
+
+	bhash->version = bhash_version_alloc(bhash, config.initial_exp);
+}
+
+void
+bhash__concurrent_cleanup(bhash_concurrent_base_t* bhash) {
+	for (bhash_version_t* itr = bhash->retired; itr != NULL;) {
+		bhash_version_t* next = itr->next;
+		BHASH_REALLOC(itr, 0, bhash->memctx);
+		itr = next;
+	}
+	BHASH_REALLOC(bhash->version, 0, bhash->memctx);
+	BHASH_REALLOC(bhash->readers_mem, 0, bhash->memctx);
+}
+
+void
+bhash__concurrent_put(bhash_concurrent_base_t* bhash, const void* key, const void* value) {
+	bhash_version_t* version = bhash->version;
+	// Ensure both a data entry and an empty slot are available
+	if (version->data_len == version->data_capacity || version->free_space == 0) {
+		bhash_concurrent_rebuild(bhash);
+		version = bhash->version;
+	}
+
+	bhash_hash_t hash = bhash->hash(key, bhash->key_size);
+	bhash_index_t free_slot;
+	bhash_index_t existing_slot = bhash_version_probe(bhash, version, key, hash, &free_slot);
+	bhash_version_append(bhash, version, hash, key, value);
+
+	// Publish only after the entry is completely written
+	if (existing_slot != -1) {
+		bhash_store_index(&version->indices[existing_slot], version->data_len);
+	} else {
+		version->free_space -= (version->indices[free_slot] == BHASH_EMPTY);
+		bhash_store_index(&version->indices[free_slot], version->data_len);
+		bhash->len += 1;
+	}
+}
+
+bool
+bhash__concurrent_remove(bhash_concurrent_base_t* bhash, const void* key) {
+	bhash_version_t* version = bhash->version;
+	bhash_hash_t hash = bhash->hash(key, bhash->key_size);
+	bhash_index_t free_slot;
+	bhash_index_t slot = bhash_version_probe(bhash, version, key, hash, &free_slot);
+	if (slot == -1) { return false; }
+
+	bhash_store_index(&version->indices[slot], BHASH_TOMBSTONE);
+	bhash->len -= 1;
+	return true;
+}
+
+void
+bhash__concurrent_reclaim(bhash_concurrent_base_t* bhash) {
+	if (bhash->retired == NULL) { return; }
+
+	uint64_t min_epoch = UINT64_MAX;
+	for (bhash_index_t i = 0; i < bhash->num_readers; ++i) {
+		uint64_t epoch = bhash_load_epoch(&bhash->readers[i].epoch);
+		if (epoch != 0 && epoch < min_epoch) { min_epoch = epoch; }
+	}
+
+	// A version can be freed when all active readers entered after it was retired
+	for (bhash_version_t** itr = &bhash->retired; *itr != NULL;) {
+		bhash_version_t* version = *itr;
+		if (version->retire_epoch < min_epoch) {
+			*itr = version->next;
+			BHASH_REALLOC(version, 0, bhash->memctx);
+		} else {
+			itr = &version->next;
+		}
+	}
+}
+
+void
+bhash__concurrent_read_begin(bhash_concurrent_base_t* bhash, bhash_index_t reader) {
+	bhash_store_epoch(&bhash->readers[reader].epoch, bhash_load_epoch(&bhash->epoch));
+	// Make the epoch visible to the writer before reading the version
+	bhash_full_barrier();
+}
+
+void
+bhash__concurrent_read_end(bhash_concurrent_base_t* bhash, bhash_index_t reader) {
+	bhash_store_epoch(&bhash->readers[reader].epoch, 0);
+}
+
+bool
+bhash__concurrent_get(
+	bhash_concurrent_base_t* bhash,
+	bhash_index_t reader,
+	const void* key,
+	void* out_value
+) {
+	bool in_section = bhash->readers[reader].epoch != 0;
+	if (!in_section) { bhash__concurrent_read_begin(bhash, reader); }
+
+	bhash_version_t* version = bhash_load_ptr((void* const*)&bhash->version);
+	bhash_hash_t hash = bhash->hash(key, bhash->key_size);
+	bool found = false;
+	for (bhash_index_t hash_index = (bhash_index_t)hash;;) {
+		hash_index = bhash__lookup_index(hash, version->exp, hash_index);
+		bhash_index_t data_index = bhash_load_index(&version->indices[hash_index]);
+		if (data_index == BHASH_EMPTY) {
+			break;
+		} else if (data_index == BHASH_TOMBSTONE) {
+			continue;
+		} else if (
+			version->hashes[data_index - 1] == hash
+			&& bhash->eq(key, version->keys + (data_index - 1) * bhash->key_size, bhash->key_size)
+		) {
+			if (out_value != NULL && bhash->value_size > 0) {
+				memcpy(out_value, version->values + (data_index - 1) * bhash->value_size, bhash->value_size);
+			}
+			found = true;
+			break;
+		}
+	}
+
+	if (!in_section) { bhash__concurrent_read_end(bhash, reader); }
+	return found;
+}
+
 #endif
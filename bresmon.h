@@ -9,6 +9,14 @@
  *
  * Optionally, define BRESMON_REALLOC(ptr, size, ctx) to override the allocator.
  * By default, libc will be used.
+ *
+ * The implementation indexes watches with bhash.h so the implementation of
+ * bhash.h must also be compiled in one source file (`BHASH_IMPLEMENTATION` or
+ * `BLIB_IMPLEMENTATION`).
+ *
+ * Define `BRESMON_BACKGROUND` to be able to drain notifications on a background
+ * thread (@ref bresmon_config_t.background).
+ * This uses C11 threads.
  */
 
 #if defined(__linux__) && !defined(_DEFAULT_SOURCE)
@@ -31,12 +39,49 @@ typedef struct bresmon_watch_s bresmon_watch_t;
  * @brief The reload callback attached to a resource.
  *
  * @param file The same filename passed to the @ref bresmon_watch call.
+ *   For a tree watch, the full path of the changed file.
  * @param userdata Arbitrary userdata.
  *
  * @see bresmon_watch
+ * @see bresmon_watch_tree
  */
 typedef void (*bresmon_callback_t)(const char* file, void* userdata);
 
+/**
+ * @brief Configuration for @ref bresmon_create_ex.
+ */
+typedef struct bresmon_config_s {
+	//! Memory context passed to `BRESMON_REALLOC`.
+	void* memctx;
+	/**
+	 * @brief Skip the callback when the content of a file did not change.
+	 *
+	 * Files are hashed in @ref bresmon_reload so touching or saving a file
+	 * without modifying it does not trigger a reload.
+	 * Within a tree watch, the first change of each file is always reloaded
+	 * since its previous content is not known.
+	 */
+	bool content_hash;
+#ifdef BRESMON_BACKGROUND
+	/**
+	 * @brief Drain notifications continuously on a background thread.
+	 *
+	 * Changed files are handed to the thread calling @ref bresmon_should_reload
+	 * through a lock-free queue so polling never makes a syscall.
+	 * If the thread cannot be started, the monitor works as if this was false.
+	 */
+	bool background;
+	/**
+	 * @brief How long a file must stay quiet before it is reloaded.
+	 *
+	 * All notifications for a file within this window are coalesced into a
+	 * single reload.
+	 * This is only used in background mode.
+	 */
+	unsigned debounce_ms;
+#endif
+} bresmon_config_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -52,6 +97,14 @@ extern "C" {
 BRESMON_API bresmon_t*
 bresmon_create(void* memctx);
 
+/**
+ * @brief Create a new monitor context with extra options.
+ *
+ * @see bresmon_create
+ */
+BRESMON_API bresmon_t*
+bresmon_create_ex(const bresmon_config_t* config);
+
 /**
  * @brief Destroy the monitor context.
  *
@@ -79,6 +132,30 @@ bresmon_watch(
 	void* userdata
 );
 
+/**
+ * @brief Watch all files in a directory and its subdirectories.
+ *
+ * Subdirectories created or moved in later are watched automatically and
+ * those moved out are no longer watched.
+ * The callback receives the full path of each changed file.
+ *
+ * @param mon The monitor context.
+ * @param dir The path to the directory.
+ * @param callback The callback to be invoked when a file changes.
+ * @param userdata Passed verbatim to the callback.
+ *
+ * @return A watch context.
+ * @remarks The callback must not unwatch its own tree.
+ * @see bresmon_unwatch
+ */
+BRESMON_API bresmon_watch_t*
+bresmon_watch_tree(
+	bresmon_t* mon,
+	const char* dir,
+	bresmon_callback_t callback,
+	void* userdata
+);
+
 /**
  * @brief Replace the callback of an existing watch.
  *
@@ -104,9 +181,13 @@ bresmon_unwatch(bresmon_watch_t* watch);
  *   interactive application.
  *
  * @return The number of change events received since the last call.
+ *   In background mode, this is the number of files which are ready to be
+ *   reloaded.
  *
  * @remarks
  *   The callbacks will not be invoked until @ref bresmon_reload is called.
+ *   This, @ref bresmon_reload, @ref bresmon_watch and @ref bresmon_unwatch must
+ *   all be called from the same thread.
  *
  * @see bresmon_check
  * @see bresmon_watch
@@ -117,6 +198,8 @@ bresmon_should_reload(bresmon_t* mon, bool wait);
 /**
  * @brief Call the necessary reload callbacks.
  *
+ * Each changed file is reloaded once no matter how many notifications it got.
+ *
  * @param mon The monitor context.
  *
  * @return The number of reloaded resources.
@@ -202,11 +285,16 @@ bresmon_cleanup_watch(bresmon_watch_t** watch_ptr) {
 
 #include <sys/inotify.h>
 #include <sys/stat.h>
+#include <dirent.h>
 #include <linux/limits.h>
 #include <unistd.h>
 #include <libgen.h>
 #include <string.h>
 #include <poll.h>
+#include <time.h>
+#ifdef BRESMON_BACKGROUND
+#include <sys/eventfd.h>
+#endif
 
 #elif defined(_WIN32)
 
@@ -219,6 +307,42 @@ bresmon_cleanup_watch(bresmon_watch_t** watch_ptr) {
 #error Unsupported platform
 #endif
 
+#include <stdint.h>
+#include <stdio.h>
+#include "bhash.h"
+
+#ifdef BRESMON_BACKGROUND
+#include <threads.h>
+#endif
+
+#ifndef BRESMON_EVENT_BUFFER_SIZE
+/**
+ * @brief Size of the buffer that change notifications are read into.
+ *
+ * On Linux, there is a single buffer shared by all directories.
+ * On Windows, each watched directory has its own.
+ */
+#	if defined(__linux__)
+#		define BRESMON_EVENT_BUFFER_SIZE (64 * 1024)
+#	else
+#		define BRESMON_EVENT_BUFFER_SIZE (8 * 1024)
+#	endif
+#endif
+
+#if defined(__linux__)
+#	define BRESMON_MAX_PATH PATH_MAX
+#	define BRESMON_PATH_SEPARATOR "/"
+#elif defined(_WIN32)
+#	define BRESMON_MAX_PATH (MAX_PATH * 4)
+#	define BRESMON_PATH_SEPARATOR "\\"
+#endif
+
+typedef struct bresmon_ptr_array_s {
+	void** items;
+	size_t len;
+	size_t capacity;
+} bresmon_ptr_array_t;
+
 typedef struct bresmon_dirmon_link_s {
 	struct bresmon_dirmon_link_s* next;
 	struct bresmon_dirmon_link_s* prev;
@@ -233,27 +357,73 @@ typedef struct bresmon_dirmon_s {
 	bresmon_dirmon_link_t link;
 	bresmon_t* root;
 	bresmon_watch_link_t watches;
+	// Tree watches covering this directory
+	bresmon_ptr_array_t trees;
 
 #if defined(__linux__)
 	int watchd;
 #elif defined(_WIN32)
+	// Only used by tree watches
+	bool recursive;
 	HANDLE dir_handle;
 	OVERLAPPED overlapped;
-	_Alignas(FILE_NOTIFY_INFORMATION) char notification_buf[sizeof(FILE_NOTIFY_INFORMATION) + MAX_PATH];
+	_Alignas(FILE_NOTIFY_INFORMATION) char notification_buf[BRESMON_EVENT_BUFFER_SIZE];
 #endif
 	char path[];
 } bresmon_dirmon_t;
 
+typedef struct bresmon_tree_s {
+	// Watched directories of the tree, only the root on Windows
+	bresmon_ptr_array_t dirmons;
+	// Files changed since the last reload and the hash of their path, guarded by
+	// the lock
+	bresmon_ptr_array_t changed;
+	BHASH_SET(uint64_t) changed_set;
+	// Content hash of the reloaded files, keyed by path hash
+	BHASH_TABLE(uint64_t, uint64_t) content_hashes;
+} bresmon_tree_t;
+
+// Watches keyed by the hash of their directory and filename, colliding watches
+// are chained
+typedef BHASH_TABLE(uint64_t, bresmon_watch_t*) bresmon_watch_index_t;
+
 struct bresmon_s {
 	bresmon_dirmon_link_t dirmons;
 
 	void* memctx;
+	bool content_hash;
+
+	bresmon_watch_index_t watch_index;
+
+	// Watches to pass to their callback in the next bresmon_reload
+	bresmon_watch_link_t ready;
 
 #if defined(__linux__)
 	int inotifyfd;
+	BHASH_TABLE(int, bresmon_dirmon_t*) dirmon_index;
+	BHASH_TABLE(const char*, bresmon_dirmon_t*) dirmon_path_index;
+	char* event_buf;
 #elif defined(_WIN32)
 	HANDLE iocp;
 #endif
+
+#ifdef BRESMON_BACKGROUND
+	bool background;
+	bool stop;
+	unsigned debounce_ms;
+	thrd_t thread;
+	// Protects everything but the queue and the ready list while the watcher
+	// thread is running
+	mtx_t mtx;
+	cnd_t ready_cnd;
+	// Watches in their debounce window, owned by the watcher thread
+	bresmon_watch_link_t pending;
+	// Watches which are ready, pushed by the watcher thread
+	bresmon_watch_t* queue;
+#if defined(__linux__)
+	int wake_fd;
+#endif
+#endif
 };
 
 struct bresmon_watch_s {
@@ -262,7 +432,28 @@ struct bresmon_watch_s {
 	int current_version;
 	int latest_version;
 
+	bresmon_t* root;
+	// NULL for a tree watch
 	bresmon_dirmon_t* dirmon;
+	// NULL for a file watch
+	bresmon_tree_t* tree;
+
+	uint64_t content_hash;
+	bool has_content_hash;
+
+	uint64_t name_hash;
+	bresmon_watch_t* next_in_bucket;
+
+	bresmon_watch_link_t ready_link;
+	bool is_ready;
+
+#ifdef BRESMON_BACKGROUND
+	bresmon_watch_link_t pending_link;
+	bool is_pending;
+	uint64_t deadline;
+	int is_queued;
+	bresmon_watch_t* next_queued;
+#endif
 
 	char* orignal_path;
 
@@ -321,17 +512,339 @@ bresmon_strdup(const char* str, void* ctx) {
 	return dup;
 }
 
+static void
+bresmon_ptr_array_push(bresmon_ptr_array_t* array, void* item, void* memctx) {
+	if (array->len == array->capacity) {
+		size_t new_capacity = array->capacity > 0 ? array->capacity * 2 : 4;
+		array->items = BRESMON_REALLOC(array->items, new_capacity * sizeof(void*), memctx);
+		array->capacity = new_capacity;
+	}
+	array->items[array->len++] = item;
+}
+
+static bool
+bresmon_ptr_array_contains(const bresmon_ptr_array_t* array, const void* item) {
+	for (size_t i = 0; i < array->len; ++i) {
+		if (array->items[i] == item) { return true; }
+	}
+	return false;
+}
+
+static void
+bresmon_ptr_array_remove(bresmon_ptr_array_t* array, const void* item) {
+	for (size_t i = 0; i < array->len; ++i) {
+		if (array->items[i] == item) {
+			array->items[i] = array->items[--array->len];
+			return;
+		}
+	}
+}
+
+static inline bool
+bresmon_join_path(char* buf, size_t size, const char* dir, const char* name) {
+	int len = snprintf(buf, size, "%s" BRESMON_PATH_SEPARATOR "%s", dir, name);
+	return len >= 0 && (size_t)len < size;
+}
+
+// Chains chibihash over the file so it does not have to fit in memory
+static bool
+bresmon_hash_file(const char* path, uint64_t* hash_out) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) { return false; }
+
+	char buf[16 * 1024];
+	uint64_t hash = 0;
+	size_t num_bytes;
+	while ((num_bytes = fread(buf, 1, sizeof(buf), file)) > 0) {
+		hash = bhash__chibihash64(buf, (ptrdiff_t)num_bytes, hash);
+	}
+	bool hashed = !ferror(file);
+	fclose(file);
+
+	*hash_out = hash;
+	return hashed;
+}
+
+// Whether a watched file has to be reloaded, an unreadable file always is
+static bool
+bresmon_file_changed(bresmon_watch_t* watch) {
+	uint64_t hash = 0;
+	bool has_hash = bresmon_hash_file(watch->orignal_path, &hash);
+	bool changed = !has_hash || !watch->has_content_hash || hash != watch->content_hash;
+	watch->content_hash = hash;
+	watch->has_content_hash = has_hash;
+	return changed;
+}
+
+static bool
+bresmon_tree_file_changed(bresmon_tree_t* tree, const char* path) {
+	uint64_t path_hash = bhash_hash(path, strlen(path));
+	uint64_t hash;
+	if (!bresmon_hash_file(path, &hash)) {
+		bhash_remove(&tree->content_hashes, path_hash);
+		return true;
+	}
+
+	bhash_alloc_result_t result = bhash_alloc(&tree->content_hashes, path_hash);
+	bool changed = result.is_new || tree->content_hashes.values[result.index] != hash;
+	tree->content_hashes.keys[result.index] = path_hash;
+	tree->content_hashes.values[result.index] = hash;
+	return changed;
+}
+
+#if defined(__linux__)
+
+static bhash_hash_t
+bresmon_path_index_hash(const void* key, size_t size) {
+	(void)size;
+	const char* path = *(const char* const*)key;
+	return bhash_hash(path, strlen(path));
+}
+
+static bool
+bresmon_path_index_eq(const void* lhs, const void* rhs, size_t size) {
+	(void)size;
+	return strcmp(*(const char* const*)lhs, *(const char* const*)rhs) == 0;
+}
+
+#endif
+
+static inline uint64_t
+bresmon_name_hash(const bresmon_dirmon_t* dirmon, const void* name, size_t size) {
+	return (uint64_t)bhash_hash(name, size) ^ ((uint64_t)(uintptr_t)dirmon * UINT64_C(0x9E3779B97F4A7C15));
+}
+
+static inline bresmon_watch_t*
+bresmon_find_watches(bresmon_t* mon, uint64_t name_hash) {
+	bhash_index_t index = bhash_find(&mon->watch_index, name_hash);
+	return bhash_is_valid(index) ? mon->watch_index.values[index] : NULL;
+}
+
+static void
+bresmon_index_watch(bresmon_t* mon, bresmon_watch_t* watch) {
+	bhash_alloc_result_t result = bhash_alloc(&mon->watch_index, watch->name_hash);
+	if (result.is_new) {
+		mon->watch_index.keys[result.index] = watch->name_hash;
+		watch->next_in_bucket = NULL;
+	} else {
+		watch->next_in_bucket = mon->watch_index.values[result.index];
+	}
+	mon->watch_index.values[result.index] = watch;
+}
+
+static void
+bresmon_unindex_watch(bresmon_t* mon, bresmon_watch_t* watch) {
+	bhash_index_t index = bhash_find(&mon->watch_index, watch->name_hash);
+	if (!bhash_is_valid(index)) { return; }
+
+	bresmon_watch_t** itr = &mon->watch_index.values[index];
+	while (*itr != watch) { itr = &(*itr)->next_in_bucket; }
+	*itr = watch->next_in_bucket;
+
+	if (mon->watch_index.values[index] == NULL) {
+		bhash_remove(&mon->watch_index, watch->name_hash);
+	}
+}
+
+static inline void
+bresmon_link(bresmon_watch_link_t* list, bresmon_watch_link_t* link) {
+	link->next = list;
+	link->prev = list->prev;
+	list->prev->next = link;
+	list->prev = link;
+}
+
+static inline void
+bresmon_unlink(bresmon_watch_link_t* link) {
+	link->prev->next = link->next;
+	link->next->prev = link->prev;
+}
+
+static void
+bresmon_mark_ready(bresmon_t* mon, bresmon_watch_t* watch) {
+	++watch->latest_version;
+	if (!watch->is_ready) {
+		watch->is_ready = true;
+		bresmon_link(&mon->ready, &watch->ready_link);
+	}
+}
+
+static inline bool
+bresmon_is_background(bresmon_t* mon) {
+#ifdef BRESMON_BACKGROUND
+	return mon->background;
+#else
+	(void)mon;
+	return false;
+#endif
+}
+
+static inline void
+bresmon_lock(bresmon_t* mon) {
+#ifdef BRESMON_BACKGROUND
+	if (mon->background) { mtx_lock(&mon->mtx); }
+#else
+	(void)mon;
+#endif
+}
+
+static inline void
+bresmon_unlock(bresmon_t* mon) {
+#ifdef BRESMON_BACKGROUND
+	if (mon->background) { mtx_unlock(&mon->mtx); }
+#else
+	(void)mon;
+#endif
+}
+
+#if defined(_WIN32)
+
+static void
+bresmon_queue_read(bresmon_dirmon_t* dirmon) {
+	dirmon->overlapped = (OVERLAPPED){ 0 };
+	ReadDirectoryChangesW(
+		dirmon->dir_handle,
+		dirmon->notification_buf,
+		sizeof(dirmon->notification_buf),
+		dirmon->recursive,
+		FILE_NOTIFY_CHANGE_FILE_NAME
+		| FILE_NOTIFY_CHANGE_LAST_WRITE,
+		NULL,
+		&dirmon->overlapped,
+		NULL
+	);
+}
+
+#endif
+
+#ifdef BRESMON_BACKGROUND
+
+#ifdef _MSC_VER
+
+#include <intrin.h>
+
+static inline int
+bresmon_atomic_exchange(int* ptr, int value) {
+	return _InterlockedExchange((volatile long*)ptr, value);
+}
+
+static inline void*
+bresmon_atomic_load_ptr(void* ptr) {
+	return _InterlockedCompareExchangePointer((void* volatile*)ptr, NULL, NULL);
+}
+
+static inline bool
+bresmon_atomic_cas_ptr(void* ptr, void* expected, void* desired) {
+	return _InterlockedCompareExchangePointer((void* volatile*)ptr, desired, expected) == expected;
+}
+
+static inline void*
+bresmon_atomic_exchange_ptr(void* ptr, void* value) {
+	return _InterlockedExchangePointer((void* volatile*)ptr, value);
+}
+
+#else
+
+static inline int
+bresmon_atomic_exchange(int* ptr, int value) {
+	return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+}
+
+static inline void*
+bresmon_atomic_load_ptr(void* ptr) {
+	return __atomic_load_n((void**)ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline bool
+bresmon_atomic_cas_ptr(void* ptr, void* expected, void* desired) {
+	return __atomic_compare_exchange_n(
+		(void**)ptr, &expected, desired, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED
+	);
+}
+
+static inline void*
+bresmon_atomic_exchange_ptr(void* ptr, void* value) {
+	return __atomic_exchange_n((void**)ptr, value, __ATOMIC_ACQ_REL);
+}
+
+#endif
+
+static uint64_t
+bresmon_now_ms(void) {
+#if defined(__linux__)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+#elif defined(_WIN32)
+	return GetTickCount64();
+#endif
+}
+
+// Called by the watcher thread
+static void
+bresmon_queue_push(bresmon_t* mon, bresmon_watch_t* watch) {
+	bresmon_watch_t* head;
+	do {
+		head = bresmon_atomic_load_ptr(&mon->queue);
+		watch->next_queued = head;
+	} while (!bresmon_atomic_cas_ptr(&mon->queue, head, watch));
+}
+
+// Called by the thread which polls the monitor
+static int
+bresmon_drain_queue(bresmon_t* mon) {
+	bresmon_watch_t* watch = bresmon_atomic_exchange_ptr(&mon->queue, NULL);
+
+	// The queue is a stack, reverse it to keep the order of the changes
+	bresmon_watch_t* reversed = NULL;
+	while (watch != NULL) {
+		bresmon_watch_t* next = watch->next_queued;
+		watch->next_queued = reversed;
+		reversed = watch;
+		watch = next;
+	}
+
+	int num_ready = 0;
+	for (watch = reversed; watch != NULL;) {
+		// Read the link first: the watcher thread can queue it again right after
+		bresmon_watch_t* next = watch->next_queued;
+		bresmon_atomic_exchange(&watch->is_queued, 0);
+		bresmon_mark_ready(mon, watch);
+		++num_ready;
+		watch = next;
+	}
+
+	return num_ready;
+}
+
+static int
+bresmon_watcher_main(void* userdata);
+
+#endif
+
 bresmon_t*
 bresmon_create(void* memctx) {
+	return bresmon_create_ex(&(bresmon_config_t){ .memctx = memctx });
+}
+
+bresmon_t*
+bresmon_create_ex(const bresmon_config_t* config) {
+	void* memctx = config->memctx;
 	bresmon_t* mon = bresmon_malloc(sizeof(bresmon_t), memctx);
 	*mon = (bresmon_t){
 		.dirmons = {
 			.next = &mon->dirmons,
 			.prev = &mon->dirmons,
 		},
+		.ready = {
+			.next = &mon->ready,
+			.prev = &mon->ready,
+		},
 		.memctx = memctx,
+		.content_hash = config->content_hash,
 #if defined(__linux__)
 		.inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC),
+		.event_buf = bresmon_malloc(BRESMON_EVENT_BUFFER_SIZE, memctx),
 #elif defined(_WIN32)
 		.iocp = CreateIoCompletionPort(
 			INVALID_HANDLE_VALUE,
@@ -342,30 +855,294 @@ bresmon_create(void* memctx) {
 #endif
 	};
 
+	bhash_config_t index_config = bhash_config_default();
+	index_config.memctx = memctx;
+	bhash_init(&mon->watch_index, index_config);
+#if defined(__linux__)
+	bhash_init(&mon->dirmon_index, index_config);
+
+	bhash_config_t path_index_config = index_config;
+	path_index_config.hash = bresmon_path_index_hash;
+	path_index_config.eq = bresmon_path_index_eq;
+	bhash_init(&mon->dirmon_path_index, path_index_config);
+#endif
+
+#ifdef BRESMON_BACKGROUND
+	if (config->background) {
+		mon->debounce_ms = config->debounce_ms;
+		mon->pending = (bresmon_watch_link_t){
+			.next = &mon->pending,
+			.prev = &mon->pending,
+		};
+		mtx_init(&mon->mtx, mtx_plain);
+		cnd_init(&mon->ready_cnd);
+
+#if defined(__linux__)
+		mon->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		mon->background = mon->wake_fd >= 0;
+#else
+		mon->background = true;
+#endif
+
+		if (mon->background && thrd_create(&mon->thread, bresmon_watcher_main, mon) != thrd_success) {
+			mon->background = false;
+		}
+
+		if (!mon->background) {
+#if defined(__linux__)
+			if (mon->wake_fd >= 0) { close(mon->wake_fd); }
+#endif
+			cnd_destroy(&mon->ready_cnd);
+			mtx_destroy(&mon->mtx);
+		}
+	}
+#endif
+
 	return mon;
 }
 
 void
 bresmon_destroy(bresmon_t* mon) {
+#ifdef BRESMON_BACKGROUND
+	if (mon->background) {
+		mtx_lock(&mon->mtx);
+		mon->stop = true;
+		mtx_unlock(&mon->mtx);
+
+#if defined(__linux__)
+		uint64_t one = 1;
+		ssize_t num_bytes_written = write(mon->wake_fd, &one, sizeof(one));
+		(void)num_bytes_written;
+#elif defined(_WIN32)
+		PostQueuedCompletionStatus(mon->iocp, 0, 0, NULL);
+#endif
+		thrd_join(mon->thread, NULL);
+
+		// Everything is accessed from this thread from now on
+		bresmon_drain_queue(mon);
+		mon->background = false;
+#if defined(__linux__)
+		close(mon->wake_fd);
+#endif
+		cnd_destroy(&mon->ready_cnd);
+		mtx_destroy(&mon->mtx);
+	}
+#endif
+
 	while (mon->dirmons.next != &mon->dirmons) {
 		bresmon_dirmon_t* dirmon = (bresmon_dirmon_t*)((char*)mon->dirmons.next - offsetof(bresmon_dirmon_t, link));
 		if (dirmon->watches.next != &dirmon->watches) {
 			bresmon_watch_t* watch = (bresmon_watch_t*)((char*)dirmon->watches.next - offsetof(bresmon_watch_t, link));
 			bresmon_unwatch(watch);
+		} else if (dirmon->trees.len > 0) {
+			bresmon_unwatch(dirmon->trees.items[0]);
+		}
+#if defined(_WIN32)
+		else {
+			// Wait for the cancelled read to complete
+			OVERLAPPED_ENTRY overlapped_entries[16];
+			ULONG num_entries = bresmon_dequeue(mon, overlapped_entries, INFINITE);
+			bresmon_process_completions(mon, overlapped_entries, num_entries);
 		}
+#endif
 	}
 
 #if defined(__linux__)
 	close(mon->inotifyfd);
+	bresmon_free(mon->event_buf, mon->memctx);
+	bhash_cleanup(&mon->dirmon_index);
+	bhash_cleanup(&mon->dirmon_path_index);
 #elif defined(_WIN32)
 	CloseHandle(mon->iocp);
 #endif
 
+	bhash_cleanup(&mon->watch_index);
 	bresmon_free(mon, mon->memctx);
 }
 
-bresmon_watch_t*
-bresmon_watch(
+static void
+bresmon_notify_tree(bresmon_t* mon, bresmon_watch_t* watch, const char* path);
+
+#if defined(__linux__)
+
+// Find or start monitoring a directory given its real path
+static bresmon_dirmon_t*
+bresmon_get_dirmon(bresmon_t* mon, const char* dir_name) {
+	bhash_index_t index = bhash_find(&mon->dirmon_path_index, dir_name);
+	if (bhash_is_valid(index)) { return mon->dirmon_path_index.values[index]; }
+
+	// IN_CREATE and IN_MOVED_FROM are only used to track the subdirectories of
+	// trees
+	int watchd = inotify_add_watch(
+		mon->inotifyfd,
+		dir_name,
+		IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE
+	);
+	if (watchd < 0) { return NULL; }
+
+	// The same directory through a different path
+	index = bhash_find(&mon->dirmon_index, watchd);
+	if (bhash_is_valid(index)) { return mon->dirmon_index.values[index]; }
+
+	size_t dir_name_len = strlen(dir_name);
+	bresmon_dirmon_t* dirmon = bresmon_malloc(sizeof(bresmon_dirmon_t) + dir_name_len + 1, mon->memctx);
+	*dirmon = (bresmon_dirmon_t){
+		.root = mon,
+		.watchd = watchd,
+		.watches = {
+			.next = &dirmon->watches,
+			.prev = &dirmon->watches,
+		},
+	};
+	memcpy(dirmon->path, dir_name, dir_name_len + 1);
+
+	dirmon->link.next = mon->dirmons.next;
+	mon->dirmons.next->prev = &dirmon->link;
+	dirmon->link.prev = &mon->dirmons;
+	mon->dirmons.next = &dirmon->link;
+
+	const char* path = dirmon->path;
+	bhash_put(&mon->dirmon_index, watchd, dirmon);
+	bhash_put(&mon->dirmon_path_index, path, dirmon);
+
+	return dirmon;
+}
+
+static void
+bresmon_unindex_dirmon(bresmon_t* mon, bresmon_dirmon_t* dirmon) {
+	// A newer dirmon may have taken over the path
+	bhash_index_t index = bhash_find(&mon->dirmon_index, dirmon->watchd);
+	if (bhash_is_valid(index) && mon->dirmon_index.values[index] == dirmon) {
+		bhash_remove(&mon->dirmon_index, dirmon->watchd);
+	}
+
+	const char* path = dirmon->path;
+	index = bhash_find(&mon->dirmon_path_index, path);
+	if (bhash_is_valid(index) && mon->dirmon_path_index.values[index] == dirmon) {
+		bhash_remove(&mon->dirmon_path_index, path);
+	}
+}
+
+// Add a directory and all of its subdirectories to a tree.
+// Returns the number of files notified.
+static int
+bresmon_tree_add_dir(bresmon_t* mon, bresmon_watch_t* watch, const char* path, bool notify_files) {
+	bresmon_dirmon_t* dirmon = bresmon_get_dirmon(mon, path);
+	if (dirmon == NULL || bresmon_ptr_array_contains(&dirmon->trees, watch)) { return 0; }
+
+	bresmon_ptr_array_push(&dirmon->trees, watch, mon->memctx);
+	bresmon_ptr_array_push(&watch->tree->dirmons, dirmon, mon->memctx);
+
+	DIR* dir = opendir(path);
+	if (dir == NULL) { return 0; }
+
+	int num_events = 0;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) { continue; }
+
+		char child_path[BRESMON_MAX_PATH];
+		if (!bresmon_join_path(child_path, sizeof(child_path), path, entry->d_name)) { continue; }
+
+		// Symlinks are not followed
+		unsigned char type = entry->d_type;
+		if (type == DT_UNKNOWN) {
+			struct stat st;
+			if (lstat(child_path, &st) != 0) { continue; }
+			type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+		}
+
+		if (type == DT_DIR) {
+			num_events += bresmon_tree_add_dir(mon, watch, child_path, notify_files);
+		} else if (type == DT_REG && notify_files) {
+			bresmon_notify_tree(mon, watch, child_path);
+			++num_events;
+		}
+	}
+	closedir(dir);
+
+	return num_events;
+}
+
+#endif
+
+static void
+bresmon_free_dirmon(bresmon_t* mon, bresmon_dirmon_t* dirmon) {
+	dirmon->link.next->prev = dirmon->link.prev;
+	dirmon->link.prev->next = dirmon->link.next;
+	bresmon_free(dirmon->trees.items, mon->memctx);
+	bresmon_free(dirmon, mon->memctx);
+}
+
+// Stop monitoring a directory once nothing refers to it.
+// Returns whether the cancelled read has to be waited for.
+static bool
+bresmon_release_dirmon(bresmon_t* mon, bresmon_dirmon_t* dirmon) {
+	if (dirmon->watches.next != &dirmon->watches || dirmon->trees.len > 0) { return false; }
+
+#if defined(__linux__)
+	if (dirmon->watchd >= 0) {
+		inotify_rm_watch(mon->inotifyfd, dirmon->watchd);
+		bresmon_unindex_dirmon(mon, dirmon);
+	}
+	bresmon_free_dirmon(mon, dirmon);
+	return false;
+#elif defined(_WIN32)
+	// The dirmon is freed once the cancelled read completes
+	CancelIoEx(dirmon->dir_handle, NULL);
+	CloseHandle(dirmon->dir_handle);
+	dirmon->dir_handle = INVALID_HANDLE_VALUE;
+	return !bresmon_is_background(mon);
+#endif
+}
+
+#if defined(__linux__)
+
+// The directory was deleted or unmounted
+static void
+bresmon_remove_dirmon(bresmon_t* mon, int watchd) {
+	bhash_index_t index = bhash_find(&mon->dirmon_index, watchd);
+	if (!bhash_is_valid(index)) { return; }
+	bresmon_dirmon_t* dirmon = mon->dirmon_index.values[index];
+
+	bresmon_unindex_dirmon(mon, dirmon);
+	dirmon->watchd = -1;
+
+	for (size_t i = 0; i < dirmon->trees.len; ++i) {
+		bresmon_watch_t* tree_watch = dirmon->trees.items[i];
+		bresmon_ptr_array_remove(&tree_watch->tree->dirmons, dirmon);
+	}
+	dirmon->trees.len = 0;
+
+	// File watches keep it alive until they are unwatched
+	bresmon_release_dirmon(mon, dirmon);
+}
+
+// Remove a directory and all of its subdirectories from a tree
+static void
+bresmon_tree_remove_dir(bresmon_t* mon, bresmon_watch_t* watch, const char* path) {
+	bresmon_tree_t* tree = watch->tree;
+	size_t path_len = strlen(path);
+	// Removal moves the last item into the hole so iterate backward
+	for (size_t i = tree->dirmons.len; i > 0; --i) {
+		bresmon_dirmon_t* dirmon = tree->dirmons.items[i - 1];
+		if (
+			strncmp(dirmon->path, path, path_len) != 0
+			|| (dirmon->path[path_len] != '\0' && dirmon->path[path_len] != '/')
+		) {
+			continue;
+		}
+
+		bresmon_ptr_array_remove(&tree->dirmons, dirmon);
+		bresmon_ptr_array_remove(&dirmon->trees, watch);
+		bresmon_release_dirmon(mon, dirmon);
+	}
+}
+
+#endif
+
+static bresmon_watch_t*
+bresmon_add_watch(
 	bresmon_t* mon,
 	const char* original_path,
 	bresmon_callback_t callback,
@@ -381,50 +1158,11 @@ bresmon_watch(
 	char* real_path2 = bresmon_strdup(real_path, mon->memctx);
 
 	char* dir_name = dirname(real_path);
-	size_t dir_name_len = strlen(dir_name);
 
 	char* filename = basename(real_path2);
 	size_t filename_len = strlen(filename);
 
-	bresmon_dirmon_t* dirmon = NULL;
-	for (
-		bresmon_dirmon_link_t* itr = mon->dirmons.next;
-		itr != &mon->dirmons;
-		itr = itr->next
-	) {
-		bresmon_dirmon_t* dirmon_itr = (bresmon_dirmon_t*)((char*)itr - offsetof(bresmon_dirmon_t, link));
-		if (strcmp(dir_name, dirmon_itr->path) == 0) {
-			dirmon = dirmon_itr;
-			break;
-		}
-	}
-
-	if (dirmon == NULL) {
-		int watchd = inotify_add_watch(
-			mon->inotifyfd,
-			dir_name,
-			IN_CLOSE_WRITE | IN_MOVED_TO
-		);
-
-		if (watchd >= 0) {
-			dirmon = bresmon_malloc(sizeof(bresmon_dirmon_t) + dir_name_len + 1, mon->memctx);
-			*dirmon = (bresmon_dirmon_t){
-				.root = mon,
-				.watchd = watchd,
-				.watches = {
-					.next = &dirmon->watches,
-					.prev = &dirmon->watches,
-				},
-			};
-			memcpy(dirmon->path, dir_name, dir_name_len + 1);
-
-			dirmon->link.next = mon->dirmons.next;
-			mon->dirmons.next->prev = &dirmon->link;
-			dirmon->link.prev = &mon->dirmons;
-			mon->dirmons.next = &dirmon->link;
-		}
-	}
-
+	bresmon_dirmon_t* dirmon = bresmon_get_dirmon(mon, dir_name);
 	if (dirmon != NULL) {
 		watch = bresmon_malloc(
 			sizeof(bresmon_watch_t)
@@ -432,7 +1170,9 @@ bresmon_watch(
 			+ filename_len + 1,
 			mon->memctx
 		);
-		*watch = (bresmon_watch_t){ 0 };
+		*watch = (bresmon_watch_t){
+			.name_hash = bresmon_name_hash(dirmon, filename, filename_len),
+		};
 		memcpy(watch->filename, filename, filename_len + 1);
 		watch->orignal_path = watch->filename + filename_len + 1;
 		memcpy(watch->orignal_path, original_path, orignal_path_len + 1);
@@ -456,7 +1196,7 @@ bresmon_watch(
 		itr = itr->next
 	) {
 		bresmon_dirmon_t* dirmon_itr = (bresmon_dirmon_t*)((char*)itr - offsetof(bresmon_dirmon_t, link));
-		if (_stricmp(dir_name, dirmon_itr->path) == 0) {
+		if (!dirmon_itr->recursive && _stricmp(dir_name, dirmon_itr->path) == 0) {
 			dirmon = dirmon_itr;
 			break;
 		}
@@ -490,18 +1230,7 @@ bresmon_watch(
 
 			dirmon->dir_handle = dir_handle;
 			CreateIoCompletionPort(dirmon->dir_handle, mon->iocp, (ULONG_PTR)dirmon, 1);
-			dirmon->overlapped = (OVERLAPPED){ 0 };
-			ReadDirectoryChangesW(
-				dirmon->dir_handle,
-				dirmon->notification_buf,
-				sizeof(dirmon->notification_buf),
-				FALSE,
-				FILE_NOTIFY_CHANGE_FILE_NAME
-				| FILE_NOTIFY_CHANGE_LAST_WRITE,
-				NULL,
-				&dirmon->overlapped,
-				NULL
-			);
+			bresmon_queue_read(dirmon);
 		}
 	}
 
@@ -517,6 +1246,7 @@ bresmon_watch(
 		*watch = (bresmon_watch_t){ 0 };
 		MultiByteToWideChar(CP_UTF8, 0, filename, (int)(filename_len + 1), watch->filename, (int)wfilename_buf_len);
 		watch->filename_len = (int)(wfilename_buf_len - 1);
+		watch->name_hash = bresmon_name_hash(dirmon, watch->filename, watch->filename_len * sizeof(wchar_t));
 		watch->orignal_path = (char*)watch->filename + wfilename_buf_len * sizeof(wchar_t);
 		memcpy(watch->orignal_path, original_path, orignal_path_len + 1);
 	}
@@ -530,7 +1260,9 @@ bresmon_watch(
 		dirmon->watches.prev->next = &watch->link;
 		dirmon->watches.prev = &watch->link;
 
+		watch->root = mon;
 		watch->dirmon = dirmon;
+		bresmon_index_watch(mon, watch);
 		bresmon_set_watch_callback(watch, callback, userdata);
 
 		return watch;
@@ -539,6 +1271,131 @@ bresmon_watch(
 	}
 }
 
+bresmon_watch_t*
+bresmon_watch(
+	bresmon_t* mon,
+	const char* original_path,
+	bresmon_callback_t callback,
+	void* userdata
+) {
+	bresmon_lock(mon);
+	bresmon_watch_t* watch = bresmon_add_watch(mon, original_path, callback, userdata);
+	bresmon_unlock(mon);
+
+	// Only the polling thread touches the hash
+	if (watch != NULL && mon->content_hash) {
+		watch->has_content_hash = bresmon_hash_file(original_path, &watch->content_hash);
+	}
+
+	return watch;
+}
+
+static void
+bresmon_free_tree(bresmon_t* mon, bresmon_tree_t* tree) {
+	for (size_t i = 0; i < tree->changed.len; ++i) {
+		bresmon_free(tree->changed.items[i], mon->memctx);
+	}
+	bresmon_free(tree->changed.items, mon->memctx);
+	bresmon_free(tree->dirmons.items, mon->memctx);
+	bhash_cleanup(&tree->changed_set);
+	bhash_cleanup(&tree->content_hashes);
+	bresmon_free(tree, mon->memctx);
+}
+
+bresmon_watch_t*
+bresmon_watch_tree(
+	bresmon_t* mon,
+	const char* dir,
+	bresmon_callback_t callback,
+	void* userdata
+) {
+	size_t orignal_path_len = strlen(dir);
+	bresmon_watch_t* watch = bresmon_malloc(
+		sizeof(bresmon_watch_t)
+		+ sizeof(watch->filename[0])
+		+ orignal_path_len + 1,
+		mon->memctx
+	);
+	bresmon_tree_t* tree = bresmon_malloc(sizeof(bresmon_tree_t), mon->memctx);
+	*tree = (bresmon_tree_t){ 0 };
+	bhash_config_t index_config = bhash_config_default();
+	index_config.memctx = mon->memctx;
+	bhash_init_set(&tree->changed_set, index_config);
+	bhash_init(&tree->content_hashes, index_config);
+
+	*watch = (bresmon_watch_t){
+		.root = mon,
+		.tree = tree,
+		.callback = callback,
+		.userdata = userdata,
+	};
+	watch->filename[0] = 0;
+	watch->orignal_path = (char*)watch->filename + sizeof(watch->filename[0]);
+	memcpy(watch->orignal_path, dir, orignal_path_len + 1);
+
+#if defined(__linux__)
+	// This will always allocate with libc
+	char* real_path = realpath(dir, NULL);
+	if (real_path != NULL) {
+		bresmon_lock(mon);
+		bresmon_tree_add_dir(mon, watch, real_path, false);
+		bresmon_unlock(mon);
+		free(real_path);
+	}
+#elif defined(_WIN32)
+	size_t path_buf_size = GetFullPathNameA(dir, 0, NULL, NULL);
+	char* full_path = bresmon_malloc(path_buf_size + 1, mon->memctx);
+	size_t full_path_len = GetFullPathNameA(dir, (DWORD)path_buf_size, full_path, NULL);
+	if (full_path_len > 0 && (full_path[full_path_len - 1] == '\\' || full_path[full_path_len - 1] == '/')) {
+		full_path[--full_path_len] = '\0';
+	}
+
+	HANDLE dir_handle = CreateFileA(
+		full_path,
+		FILE_LIST_DIRECTORY,
+		FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+		NULL
+	);
+	if (dir_handle != INVALID_HANDLE_VALUE) {
+		bresmon_dirmon_t* dirmon = bresmon_malloc(sizeof(bresmon_dirmon_t) + full_path_len + 1, mon->memctx);
+		*dirmon = (bresmon_dirmon_t){
+			.root = mon,
+			.recursive = true,
+			.dir_handle = dir_handle,
+			.watches = {
+				.next = &dirmon->watches,
+				.prev = &dirmon->watches,
+			},
+		};
+		memcpy(dirmon->path, full_path, full_path_len + 1);
+		bresmon_ptr_array_push(&dirmon->trees, watch, mon->memctx);
+		bresmon_ptr_array_push(&tree->dirmons, dirmon, mon->memctx);
+
+		bresmon_lock(mon);
+		dirmon->link.next = mon->dirmons.next;
+		mon->dirmons.next->prev = &dirmon->link;
+		dirmon->link.prev = &mon->dirmons;
+		mon->dirmons.next = &dirmon->link;
+
+		CreateIoCompletionPort(dirmon->dir_handle, mon->iocp, (ULONG_PTR)dirmon, 1);
+		bresmon_queue_read(dirmon);
+		bresmon_unlock(mon);
+	}
+	bresmon_free(full_path, mon->memctx);
+#endif
+
+	if (tree->dirmons.len == 0) {
+		bresmon_free_tree(mon, tree);
+		bresmon_free(watch, mon->memctx);
+		return NULL;
+	}
+
+	return watch;
+}
+
 void
 bresmon_set_watch_callback(bresmon_watch_t* watch, bresmon_callback_t callback, void* userdata) {
 	if (watch == NULL) { return; }
@@ -551,46 +1408,198 @@ void
 bresmon_unwatch(bresmon_watch_t* watch) {
 	if (watch == NULL) { return; }
 
-	bresmon_t* mon = watch->dirmon->root;
-	watch->link.prev->next = watch->link.next;
-	watch->link.next->prev = watch->link.prev;
+	bresmon_t* mon = watch->root;
+	bresmon_lock(mon);
 
-	bresmon_dirmon_t* dirmon = watch->dirmon;
-	if (dirmon->watches.next == &dirmon->watches) {
-		dirmon->link.next->prev = dirmon->link.prev;
-		dirmon->link.prev->next = dirmon->link.next;
+	if (watch->tree == NULL) {
+		watch->link.prev->next = watch->link.next;
+		watch->link.next->prev = watch->link.prev;
+		bresmon_unindex_watch(mon, watch);
+	}
 
-#if defined(__linux__)
-		inotify_rm_watch(mon->inotifyfd, dirmon->watchd);
-#elif defined(_WIN32)
-		CancelIo(dirmon->dir_handle);
-		CloseHandle(dirmon->dir_handle);
-		bresmon_should_reload(mon, true);
+#ifdef BRESMON_BACKGROUND
+	if (watch->is_pending) { bresmon_unlink(&watch->pending_link); }
+	// The watcher thread cannot push while the lock is held so the queue can
+	// no longer refer to this watch after draining it
+	bresmon_drain_queue(mon);
 #endif
-
-		bresmon_free(dirmon, mon->memctx);
+	if (watch->is_ready) { bresmon_unlink(&watch->ready_link); }
+
+	bool drain = false;
+	if (watch->tree != NULL) {
+		bresmon_tree_t* tree = watch->tree;
+		for (size_t i = 0; i < tree->dirmons.len; ++i) {
+			bresmon_dirmon_t* dirmon = tree->dirmons.items[i];
+			bresmon_ptr_array_remove(&dirmon->trees, watch);
+			drain |= bresmon_release_dirmon(mon, dirmon);
+		}
+	} else {
+		drain = bresmon_release_dirmon(mon, watch->dirmon);
 	}
 
+	bresmon_unlock(mon);
+	if (watch->tree != NULL) { bresmon_free_tree(mon, watch->tree); }
 	bresmon_free(watch, mon->memctx);
+
+	if (drain) { bresmon_should_reload(mon, true); }
 }
 
-int
-bresmon_should_reload(bresmon_t* mon, bool wait) {
+// Called for every change notification of a watched file
+static void
+bresmon_notify(bresmon_t* mon, bresmon_watch_t* watch) {
+#ifdef BRESMON_BACKGROUND
+	if (mon->background) {
+		// Coalesce with the previous notifications until the window is quiet
+		watch->deadline = bresmon_now_ms() + mon->debounce_ms;
+		if (!watch->is_pending) {
+			watch->is_pending = true;
+			bresmon_link(&mon->pending, &watch->pending_link);
+		}
+		return;
+	}
+#endif
+
+	bresmon_mark_ready(mon, watch);
+}
+
+// Called for every change notification of a file within a tree
+static void
+bresmon_notify_tree(bresmon_t* mon, bresmon_watch_t* watch, const char* path) {
+	bresmon_tree_t* tree = watch->tree;
+	uint64_t path_hash = bhash_hash(path, strlen(path));
+	bhash_alloc_result_t result = bhash_alloc(&tree->changed_set, path_hash);
+	if (result.is_new) {
+		tree->changed_set.keys[result.index] = path_hash;
+		bresmon_ptr_array_push(&tree->changed, bresmon_strdup(path, mon->memctx), mon->memctx);
+	}
+
+	bresmon_notify(mon, watch);
+}
+
+// Used when the notification queue overflowed and events were lost
+static int
+bresmon_notify_all(bresmon_t* mon, bresmon_dirmon_t* dirmon) {
 	int num_events = 0;
+	for (
+		bresmon_watch_link_t* watch_itr = dirmon->watches.next;
+		watch_itr != &dirmon->watches;
+		watch_itr = watch_itr->next
+	) {
+		bresmon_watch_t* watch = (bresmon_watch_t*)((char*)watch_itr - offsetof(bresmon_watch_t, link));
+		bresmon_notify(mon, watch);
+		++num_events;
+	}
 
-#if defined(__linux__)
-	if (wait) {
-		struct pollfd pollfd = {
-			.fd = mon->inotifyfd,
-			.events = POLLIN,
-		};
-		poll(&pollfd, 1, -1);
+	return num_events;
+}
+
+#if defined(_WIN32)
+
+static ULONG
+bresmon_dequeue(bresmon_t* mon, OVERLAPPED_ENTRY* overlapped_entries, DWORD timeout) {
+	ULONG num_entries = 0;
+	BOOL dequeued = GetQueuedCompletionStatusEx(
+		mon->iocp,
+		overlapped_entries, 16,
+		&num_entries,
+		timeout,
+		TRUE
+	);
+
+	return dequeued ? num_entries : 0;
+}
+
+static int
+bresmon_process_completions(bresmon_t* mon, OVERLAPPED_ENTRY* overlapped_entries, ULONG num_entries) {
+	int num_events = 0;
+	for (ULONG i = 0; i < num_entries; ++i) {
+		OVERLAPPED_ENTRY* overlapped_entry = &overlapped_entries[i];
+		if (overlapped_entry->lpOverlapped == NULL) {
+			// Failed or woken up by bresmon_destroy
+			continue;
+		}
+
+		bresmon_dirmon_t* dirmon = (bresmon_dirmon_t *)overlapped_entry->lpCompletionKey;
+		if (dirmon->dir_handle == INVALID_HANDLE_VALUE) {
+			// Cancelled by bresmon_unwatch
+			bresmon_free_dirmon(mon, dirmon);
+			continue;
+		}
+
+		if (overlapped_entry->dwNumberOfBytesTransferred == 0) {
+			// The buffer overflowed and the notifications were dropped
+			num_events += bresmon_notify_all(mon, dirmon);
+		} else {
+			for (
+				FILE_NOTIFY_INFORMATION* notification_itr = (FILE_NOTIFY_INFORMATION*)dirmon->notification_buf;
+				notification_itr != NULL;
+				notification_itr = notification_itr->NextEntryOffset != 0
+					? (FILE_NOTIFY_INFORMATION*)((char*)notification_itr + notification_itr->NextEntryOffset)
+					: NULL
+			) {
+				if (notification_itr->Action == FILE_ACTION_RENAMED_OLD_NAME) { continue; }
+
+				DWORD filename_len = notification_itr->FileNameLength / sizeof(wchar_t);
+				uint64_t name_hash = bresmon_name_hash(dirmon, notification_itr->FileName, notification_itr->FileNameLength);
+				for (
+					bresmon_watch_t* watch = bresmon_find_watches(mon, name_hash);
+					watch != NULL;
+					watch = watch->next_in_bucket
+				) {
+					if (
+						watch->dirmon == dirmon
+						&& watch->filename_len == filename_len
+						&& wcsncmp(watch->filename, notification_itr->FileName, filename_len) == 0
+					) {
+						bresmon_notify(mon, watch);
+						++num_events;
+					}
+				}
+
+				if (dirmon->trees.len > 0) {
+					char name[BRESMON_MAX_PATH];
+					int name_len = WideCharToMultiByte(
+						CP_UTF8, 0,
+						notification_itr->FileName, (int)filename_len,
+						name, (int)sizeof(name) - 1,
+						NULL, NULL
+					);
+					if (name_len == 0) { continue; }
+					name[name_len] = '\0';
+
+					// Subdirectories are reported when their content changes
+					char path[BRESMON_MAX_PATH];
+					if (!bresmon_join_path(path, sizeof(path), dirmon->path, name)) { continue; }
+					DWORD attributes = GetFileAttributesA(path);
+					if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY)) { continue; }
+
+					for (size_t tree_index = 0; tree_index < dirmon->trees.len; ++tree_index) {
+						bresmon_notify_tree(mon, dirmon->trees.items[tree_index], path);
+						++num_events;
+					}
+				}
+			}
+		}
+
+		// Queue another read
+		bresmon_queue_read(dirmon);
 	}
 
-	_Alignas(struct inotify_event) char event_buf[sizeof(struct inotify_event) + NAME_MAX + 1];
+	return num_events;
+}
+
+#endif
+
+// Reads all available notifications without blocking
+static int
+bresmon_process_events(bresmon_t* mon) {
+	int num_events = 0;
+
+#if defined(__linux__)
+	char* event_buf = mon->event_buf;
 
 	while (true) {
-		ssize_t num_bytes_read = read(mon->inotifyfd, event_buf, sizeof(event_buf));
+		ssize_t num_bytes_read = read(mon->inotifyfd, event_buf, BRESMON_EVENT_BUFFER_SIZE);
 
 		if (num_bytes_read <= 0) {
 			break;
@@ -603,125 +1612,238 @@ bresmon_should_reload(bresmon_t* mon, bool wait) {
 			struct inotify_event* event = (struct inotify_event*)event_itr;
 			event_itr += sizeof(struct inotify_event) + event->len;
 
-			for (
-				bresmon_dirmon_link_t* itr = mon->dirmons.next;
-				itr != &mon->dirmons;
-				itr = itr->next
-			) {
-				bresmon_dirmon_t* dirmon = (bresmon_dirmon_t*)((char*)itr - offsetof(bresmon_dirmon_t, link));
+			if (event->mask & IN_Q_OVERFLOW) {
+				for (
+					bresmon_dirmon_link_t* itr = mon->dirmons.next;
+					itr != &mon->dirmons;
+					itr = itr->next
+				) {
+					bresmon_dirmon_t* dirmon = (bresmon_dirmon_t*)((char*)itr - offsetof(bresmon_dirmon_t, link));
+					num_events += bresmon_notify_all(mon, dirmon);
+				}
+				continue;
+			}
 
-				if (dirmon->watchd == event->wd) {
-					for (
-						bresmon_watch_link_t* watch_itr = dirmon->watches.next;
-						watch_itr != &dirmon->watches;
-						watch_itr = watch_itr->next
-					) {
-						bresmon_watch_t* watch = (bresmon_watch_t*)((char*)watch_itr - offsetof(bresmon_watch_t, link));
-						if (strcmp(watch->filename, event->name) == 0) {
-							++watch->latest_version;
-							++num_events;
-						}
+			if (event->mask & IN_IGNORED) {
+				bresmon_remove_dirmon(mon, event->wd);
+				continue;
+			}
+
+			if (event->len == 0) { continue; }
+
+			bhash_index_t dirmon_index = bhash_find(&mon->dirmon_index, event->wd);
+			if (!bhash_is_valid(dirmon_index)) { continue; }
+			bresmon_dirmon_t* dirmon = mon->dirmon_index.values[dirmon_index];
+
+			char path[BRESMON_MAX_PATH];
+			bool in_tree = dirmon->trees.len > 0
+				&& bresmon_join_path(path, sizeof(path), dirmon->path, event->name);
+
+			if (event->mask & IN_ISDIR) {
+				if (in_tree && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+					// Files could have been written before it was watched
+					for (size_t i = 0; i < dirmon->trees.len; ++i) {
+						num_events += bresmon_tree_add_dir(mon, dirmon->trees.items[i], path, true);
 					}
+				} else if (in_tree && (event->mask & IN_MOVED_FROM)) {
+					// The inotify watches follow the directory out of the tree
+					for (size_t i = 0; i < dirmon->trees.len; ++i) {
+						bresmon_tree_remove_dir(mon, dirmon->trees.items[i], path);
+					}
+				}
+				continue;
+			}
+
+			// Wait for the new file to be written, a file moved away is no change
+			if (event->mask & (IN_CREATE | IN_MOVED_FROM)) { continue; }
 
-					break;
+			uint64_t name_hash = bresmon_name_hash(dirmon, event->name, strlen(event->name));
+			for (
+				bresmon_watch_t* watch = bresmon_find_watches(mon, name_hash);
+				watch != NULL;
+				watch = watch->next_in_bucket
+			) {
+				if (watch->dirmon == dirmon && strcmp(watch->filename, event->name) == 0) {
+					bresmon_notify(mon, watch);
+					++num_events;
+				}
+			}
+
+			if (in_tree) {
+				for (size_t i = 0; i < dirmon->trees.len; ++i) {
+					bresmon_notify_tree(mon, dirmon->trees.items[i], path);
+					++num_events;
 				}
 			}
 		}
 	}
 #elif defined(_WIN32)
-	OVERLAPPED_ENTRY overlapped_entry;
-	ULONG num_entries = 0;
+	OVERLAPPED_ENTRY overlapped_entries[16];
+	ULONG num_entries;
+	while ((num_entries = bresmon_dequeue(mon, overlapped_entries, 0)) > 0) {
+		num_events += bresmon_process_completions(mon, overlapped_entries, num_entries);
+	}
+#endif
 
-	while (true) {
-		BOOL dequeued = GetQueuedCompletionStatusEx(
-			mon->iocp,
-			&overlapped_entry, 1,
-			&num_entries,
-			wait ? INFINITE : 0,
-			TRUE
-		);
-		wait = false;  // Only wait for the initial event
+	return num_events;
+}
 
-		if (!dequeued || num_entries == 0) {
-			// No event
-			break;
-		} else if (
-			overlapped_entry.lpOverlapped == NULL
-			|| overlapped_entry.dwNumberOfBytesTransferred == 0
-		) {
-			// Failed
-			continue;
-		}
+#if defined(__linux__)
 
-		bresmon_dirmon_t* dirmon = (bresmon_dirmon_t *)overlapped_entry.lpCompletionKey;
+// Blocks until a notification is available
+static void
+bresmon_wait_events(bresmon_t* mon, int timeout_ms) {
+	struct pollfd pollfds[2] = {
+		{ .fd = mon->inotifyfd, .events = POLLIN },
+#ifdef BRESMON_BACKGROUND
+		{ .fd = mon->wake_fd, .events = POLLIN },
+#endif
+	};
 
-		for (
-			FILE_NOTIFY_INFORMATION* notification_itr = (FILE_NOTIFY_INFORMATION*)dirmon->notification_buf;
-			notification_itr != NULL;
-			notification_itr = notification_itr->NextEntryOffset != 0
-				? (FILE_NOTIFY_INFORMATION*)((char*)notification_itr + notification_itr->NextEntryOffset)
-				: NULL
-		) {			
-			if (notification_itr->Action == FILE_ACTION_RENAMED_OLD_NAME) { continue; }
+#ifdef BRESMON_BACKGROUND
+	poll(pollfds, mon->background ? 2 : 1, timeout_ms);
+	if (pollfds[1].revents & POLLIN) {
+		uint64_t count;
+		ssize_t num_bytes_read = read(mon->wake_fd, &count, sizeof(count));
+		(void)num_bytes_read;
+	}
+#else
+	poll(pollfds, 1, timeout_ms);
+#endif
+}
 
-			for (
-				bresmon_watch_link_t* watch_itr = dirmon->watches.next;
-				watch_itr != &dirmon->watches;
-				watch_itr = watch_itr->next
-			) {
-				bresmon_watch_t* watch = (bresmon_watch_t*)((char*)watch_itr - offsetof(bresmon_watch_t, link));
-				if (
-					watch->filename_len == (notification_itr->FileNameLength / sizeof(wchar_t))
-					&& wcsncmp(watch->filename, notification_itr->FileName, watch->filename_len) == 0
-				) {
-					++watch->latest_version;
-					++num_events;
+#endif
+
+#ifdef BRESMON_BACKGROUND
+
+static int
+bresmon_watcher_main(void* userdata) {
+	bresmon_t* mon = userdata;
+
+	mtx_lock(&mon->mtx);
+	while (!mon->stop) {
+		// Hand over the watches whose debounce window is over
+		uint64_t now = bresmon_now_ms();
+		uint64_t next_deadline = UINT64_MAX;
+		bool pushed = false;
+		for (bresmon_watch_link_t* itr = mon->pending.next; itr != &mon->pending;) {
+			bresmon_watch_t* watch = (bresmon_watch_t*)((char*)itr - offsetof(bresmon_watch_t, pending_link));
+			itr = itr->next;
+
+			if (watch->deadline <= now) {
+				bresmon_unlink(&watch->pending_link);
+				watch->is_pending = false;
+				if (!bresmon_atomic_exchange(&watch->is_queued, 1)) {
+					bresmon_queue_push(mon, watch);
+					pushed = true;
 				}
+			} else if (watch->deadline < next_deadline) {
+				next_deadline = watch->deadline;
 			}
 		}
+		if (pushed) { cnd_broadcast(&mon->ready_cnd); }
 
-		// Queue another read
-		dirmon->overlapped = (OVERLAPPED){ 0 };
-		ReadDirectoryChangesW(
-			dirmon->dir_handle,
-			dirmon->notification_buf,
-			sizeof(dirmon->notification_buf),
-			FALSE,
-			FILE_NOTIFY_CHANGE_FILE_NAME
-			| FILE_NOTIFY_CHANGE_LAST_WRITE,
-			NULL,
-			&dirmon->overlapped,
-			NULL
-		);
+		int timeout_ms = next_deadline == UINT64_MAX ? -1 : (int)(next_deadline - now);
+		mtx_unlock(&mon->mtx);
+#if defined(__linux__)
+		bresmon_wait_events(mon, timeout_ms);
+		mtx_lock(&mon->mtx);
+#elif defined(_WIN32)
+		OVERLAPPED_ENTRY overlapped_entries[16];
+		ULONG num_entries = bresmon_dequeue(mon, overlapped_entries, timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms);
+		mtx_lock(&mon->mtx);
+		bresmon_process_completions(mon, overlapped_entries, num_entries);
+#endif
+
+		bresmon_process_events(mon);
 	}
+	mtx_unlock(&mon->mtx);
+
+	return 0;
+}
+
 #endif
 
-	return num_events;
+int
+bresmon_should_reload(bresmon_t* mon, bool wait) {
+#ifdef BRESMON_BACKGROUND
+	if (mon->background) {
+		if (wait) {
+			mtx_lock(&mon->mtx);
+			while (bresmon_atomic_load_ptr(&mon->queue) == NULL) {
+				cnd_wait(&mon->ready_cnd, &mon->mtx);
+			}
+			mtx_unlock(&mon->mtx);
+		}
+
+		return bresmon_drain_queue(mon);
+	}
+#endif
+
+	int num_events = 0;
+	if (wait) {
+#if defined(__linux__)
+		bresmon_wait_events(mon, -1);
+#elif defined(_WIN32)
+		OVERLAPPED_ENTRY overlapped_entries[16];
+		ULONG num_entries = bresmon_dequeue(mon, overlapped_entries, INFINITE);
+		num_events += bresmon_process_completions(mon, overlapped_entries, num_entries);
+#endif
+	}
+
+	return num_events + bresmon_process_events(mon);
+}
+
+static int
+bresmon_reload_tree(bresmon_t* mon, bresmon_watch_t* watch) {
+	bresmon_tree_t* tree = watch->tree;
+
+	bresmon_lock(mon);
+	bresmon_ptr_array_t changed = tree->changed;
+	tree->changed = (bresmon_ptr_array_t){ 0 };
+	bhash_clear(&tree->changed_set);
+	bresmon_unlock(mon);
+
+	int num_reloads = 0;
+	for (size_t i = 0; i < changed.len; ++i) {
+		char* path = changed.items[i];
+		if (!mon->content_hash || bresmon_tree_file_changed(tree, path)) {
+			++num_reloads;
+			if (watch->callback != NULL) {
+				watch->callback(path, watch->userdata);
+			}
+		}
+		bresmon_free(path, mon->memctx);
+	}
+	bresmon_free(changed.items, mon->memctx);
+
+	return num_reloads;
 }
 
 int
 bresmon_reload(bresmon_t* mon) {
+#ifdef BRESMON_BACKGROUND
+	if (mon->background) { bresmon_drain_queue(mon); }
+#endif
+
 	int num_reloads = 0;
-	for (
-		bresmon_dirmon_link_t* itr = mon->dirmons.next;
-		itr != &mon->dirmons;
-		itr = itr->next
-	) {
-		bresmon_dirmon_t* dirmon = (bresmon_dirmon_t*)((char*)itr - offsetof(bresmon_dirmon_t, link));
-		for (
-			bresmon_watch_link_t* watch_itr = dirmon->watches.next;
-			watch_itr != &dirmon->watches;
-			watch_itr = watch_itr->next
-		) {
-			bresmon_watch_t* watch = (bresmon_watch_t*)((char*)watch_itr - offsetof(bresmon_watch_t, link));
+	// Callbacks can watch and unwatch so the list is consumed one at a time
+	while (mon->ready.next != &mon->ready) {
+		bresmon_watch_t* watch = (bresmon_watch_t*)((char*)mon->ready.next - offsetof(bresmon_watch_t, ready_link));
+		bresmon_unlink(&watch->ready_link);
+		watch->is_ready = false;
+
+		watch->current_version = watch->latest_version;
+		if (watch->tree != NULL) {
+			num_reloads += bresmon_reload_tree(mon, watch);
+			continue;
+		}
 
-			if (watch->current_version != watch->latest_version) {
-				++num_reloads;
-				watch->current_version = watch->latest_version;
-				if (watch->callback != NULL) {
-					watch->callback(watch->orignal_path, watch->userdata);
-				}
-			}
+		if (mon->content_hash && !bresmon_file_changed(watch)) { continue; }
+
+		++num_reloads;
+		if (watch->callback != NULL) {
+			watch->callback(watch->orignal_path, watch->userdata);
 		}
 	}
 
@@ -12,20 +12,30 @@
  * * Stream implemenation:
  *   * BSERIAL_MEM: A memory stream.
  *   * BSERIAL_STDIO: Wrapper for FILE in stdio.h.
+ *   * BSERIAL_BLOCK: Block compression on top of another stream.
  * * Structured data: Read/write structured data with backward-compatibility.
  *   Keys in a record can be added/removed/reordered.
+ * * BSERIAL_THREADS: Decode an indexed stream on multiple threads using C11 threads.
  */
 
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#	define _DEFAULT_SOURCE 1
+#endif
+
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <string.h>
 
 #ifndef BSERIAL_API
 #define BSERIAL_API
 #endif
 
+/*! Number of values in each block of @ref bserial_uint_array */
+#define BSERIAL_UINT_BLOCK_SIZE 64
+
 /*! How many bytes to skip at a time */
 #ifndef BSERIAL_SKIP_BLKSIZE
 #define BSERIAL_SKIP_BLKSIZE 1024
@@ -48,7 +58,13 @@ typedef enum {
 	BSERIAL_MALFORMED,
 } bserial_status_t;
 
-/*! Abstract input stream */
+/**
+ * @brief Abstract input stream.
+ *
+ * A custom stream must be initialized with @ref bserial_init_in before its
+ * optional fields are set.
+ * Unused optional fields, including the buffer window, must be zero.
+ */
 typedef struct bserial_in_s {
 	/**
 	 * @brief Read from the stream.
@@ -68,9 +84,56 @@ typedef struct bserial_in_s {
 	 * @return Whether the operation was successful.
 	 */
 	bool (*skip)(struct bserial_in_s* in, size_t size);
+
+	/**
+	 * @brief Consume a number of bytes without copying them (optional).
+	 *
+	 * This is only possible when the whole stream is in memory.
+	 *
+	 * @param in The input stream.
+	 * @param size How many bytes to consume.
+	 * @return Pointer to the consumed bytes or NULL on error.
+	 *   It must remain valid for as long as the stream does.
+	 *
+	 * @see bserial_blob_view
+	 */
+	const void* (*borrow)(struct bserial_in_s* in, size_t size);
+
+	/**
+	 * @brief Move to an absolute position in the stream (optional).
+	 *
+	 * Any data buffered in [buf_cur, buf_end) must be discarded.
+	 *
+	 * @param in The input stream.
+	 * @param offset The position to move to.
+	 * @param from_end Whether @a offset is counted backward from the end of the
+	 *   stream instead of forward from its start.
+	 * @return Whether the operation was successful.
+	 *
+	 * @see bserial_seek
+	 */
+	bool (*seek)(struct bserial_in_s* in, uint64_t offset, bool from_end);
+
+	/**
+	 * @brief Start of the data buffered by the stream (optional).
+	 *
+	 * Bytes in [buf_cur, buf_end) are consumed directly by the library without
+	 * calling @ref read.
+	 * A buffered stream refills this window from its @ref read function.
+	 */
+	const char* buf_cur;
+
+	/*! End of the data buffered by the stream */
+	const char* buf_end;
 } bserial_in_t;
 
-/*! Abstract output stream */
+/**
+ * @brief Abstract output stream.
+ *
+ * A custom stream must be initialized with @ref bserial_init_out before its
+ * optional fields are set.
+ * Unused optional fields, including the buffer window, must be zero.
+ */
 typedef struct bserial_out_s {
 	/**
 	 * @brief Write to the stream.
@@ -81,6 +144,31 @@ typedef struct bserial_out_s {
 	 * @return Number of bytes written.
 	 */
 	size_t (*write)(struct bserial_out_s* out, const void* buf, size_t size);
+
+	/**
+	 * @brief Get the current position in the stream (optional).
+	 *
+	 * This must include the bytes still in [buf_cur, buf_end).
+	 *
+	 * @param out The out stream.
+	 * @param pos Will be set to the number of bytes written so far.
+	 * @return Whether the operation was successful.
+	 *
+	 * @see bserial_sync_point
+	 */
+	bool (*tell)(struct bserial_out_s* out, uint64_t* pos);
+
+	/**
+	 * @brief Start of the free space in the stream's buffer (optional).
+	 *
+	 * Bytes are written directly into [buf_cur, buf_end) by the library
+	 * without calling @ref write.
+	 * A buffered stream flushes this window from its @ref write function.
+	 */
+	char* buf_cur;
+
+	/*! End of the stream's buffer */
+	char* buf_end;
 } bserial_out_t;
 
 /**
@@ -150,9 +238,51 @@ extern "C" {
 
 // Stream utilities
 
+/**
+ * @brief Initialize an input stream.
+ *
+ * All optional fields are zeroed.
+ *
+ * @param in The input stream.
+ * @param read The read function.
+ * @return @a in.
+ */
+static inline bserial_in_t*
+bserial_init_in(bserial_in_t* in, size_t (*read)(bserial_in_t* in, void* buf, size_t size)) {
+	*in = (bserial_in_t){ .read = read };
+	return in;
+}
+
+/**
+ * @brief Initialize an output stream.
+ *
+ * All optional fields are zeroed.
+ *
+ * @param out The output stream.
+ * @param write The write function.
+ * @return @a out.
+ */
+static inline bserial_out_t*
+bserial_init_out(bserial_out_t* out, size_t (*write)(bserial_out_t* out, const void* buf, size_t size)) {
+	*out = (bserial_out_t){ .write = write };
+	return out;
+}
+
 static inline bserial_status_t
 bserial_read(bserial_in_t* in, void* buf, size_t size) {
 	char* cbuf = buf;
+	size_t buffered = (size_t)(in->buf_end - in->buf_cur);
+	if (buffered >= size && buffered > 0) {
+		memcpy(cbuf, in->buf_cur, size);
+		in->buf_cur += size;
+		return BSERIAL_OK;
+	} else if (buffered > 0) {
+		memcpy(cbuf, in->buf_cur, buffered);
+		in->buf_cur += buffered;
+		cbuf += buffered;
+		size -= buffered;
+	}
+
 	while (size > 0) {
 		size_t bytes_read = in->read(in, cbuf, size);
 		if (bytes_read == 0) { return BSERIAL_IO_ERROR; }
@@ -165,12 +295,21 @@ bserial_read(bserial_in_t* in, void* buf, size_t size) {
 
 static inline bserial_status_t
 bserial_skip(bserial_in_t* in, size_t size) {
+	size_t buffered = (size_t)(in->buf_end - in->buf_cur);
+	if (size <= buffered) {
+		in->buf_cur += size;
+		return BSERIAL_OK;
+	} else {
+		in->buf_cur += buffered;
+		size -= buffered;
+	}
+
 	if (in->skip) {
 		return in->skip(in, size) ? BSERIAL_OK : BSERIAL_IO_ERROR;
 	} else {
 		char buf[BSERIAL_SKIP_BLKSIZE];
 		while (size > 0) {
-			size_t read_size = BSERIAL_SKIP_BLKSIZE > size ? BSERIAL_SKIP_BLKSIZE : size;
+			size_t read_size = BSERIAL_SKIP_BLKSIZE < size ? BSERIAL_SKIP_BLKSIZE : size;
 			BSERIAL_CHECK_STATUS(bserial_read(in, buf, read_size));
 			size -= read_size;
 		}
@@ -181,6 +320,13 @@ bserial_skip(bserial_in_t* in, size_t size) {
 static inline bserial_status_t
 bserial_write(bserial_out_t* out, const void* buf, size_t size) {
 	const char* cbuf = buf;
+	size_t space = (size_t)(out->buf_end - out->buf_cur);
+	if (space >= size && space > 0) {
+		memcpy(out->buf_cur, cbuf, size);
+		out->buf_cur += size;
+		return BSERIAL_OK;
+	}
+
 	while (size > 0) {
 		size_t bytes_written = out->write(out, cbuf, size);
 		if (bytes_written == 0) { return BSERIAL_IO_ERROR; }
@@ -366,6 +512,60 @@ bserial_blob_header(bserial_ctx_t* ctx, uint64_t* len);
 BSERIAL_API bserial_status_t
 bserial_blob_body(bserial_ctx_t* ctx, char* buf);
 
+/**
+ * @brief Read/write a binary blob without copying it on read.
+ *
+ * When reading, @a buf will point directly into the input stream instead of
+ * a caller-provided buffer.
+ * This requires an input stream which supports @ref bserial_in_t.borrow, such
+ * as a memory stream (@ref bserial_mem_init_in) over a memory-mapped file.
+ * Otherwise, @ref BSERIAL_IO_ERROR is returned.
+ *
+ * When writing, this is the same as @ref bserial_blob.
+ *
+ * @param buf Pointer to the blob.
+ *   On read, it will be set to point into the input stream.
+ * @param len Size of the blob.
+ *   On read, it will be set to the actual size.
+ */
+BSERIAL_API bserial_status_t
+bserial_blob_view(bserial_ctx_t* ctx, const char** buf, uint64_t* len);
+
+/**
+ * @brief Read/write a packed array of unsigned integers
+ *
+ * This is more compact and much faster than an @ref bserial_array of
+ * @ref bserial_uint since there is a single marker for the whole array.
+ * The values are encoded in blocks of @ref BSERIAL_UINT_BLOCK_SIZE, each with
+ * a 4-bit byte count per value followed by the value bytes.
+ * Decoding a block does not branch on individual values.
+ *
+ * Instead of combining into one step, one can also use:
+ * @ref bserial_uint_array_header and @ref bserial_uint_array_body.
+ *
+ * @param values The array to read/write.
+ * @param len Number of elements in @a values. Will be set to the actual number.
+ */
+BSERIAL_API bserial_status_t
+bserial_uint_array(bserial_ctx_t* ctx, uint64_t* values, uint64_t* len);
+
+/**
+ * @brief Read/write a packed array's header
+ *
+ * @param len Number of elements. Will be set to the actual number on read.
+ * @see bserial_uint_array
+ */
+BSERIAL_API bserial_status_t
+bserial_uint_array_header(bserial_ctx_t* ctx, uint64_t* len);
+
+/**
+ * @brief Read/write a packed array's body
+ *
+ * @see bserial_uint_array
+ */
+BSERIAL_API bserial_status_t
+bserial_uint_array_body(bserial_ctx_t* ctx, uint64_t* values);
+
 /**
  * @brief Read/write a symbol.
  *
@@ -384,6 +584,92 @@ bserial_blob_body(bserial_ctx_t* ctx, char* buf);
 BSERIAL_API bserial_status_t
 bserial_symbol(bserial_ctx_t* ctx, const char** buf, uint64_t* len);
 
+/**
+ * @brief Pre-declare a dictionary of symbols.
+ *
+ * The symbols are interned without being written to the stream.
+ * Writing them later only costs a reference.
+ * A sync point (@ref bserial_sync_point) resets the symbol table back to
+ * the dictionary instead of emptying it.
+ *
+ * This must be called right after @ref bserial_make_ctx, with exactly the same
+ * symbols in the same order for both the writer and all readers.
+ *
+ * @param symbols Null-terminated symbols.
+ * @param num_symbols Number of symbols.
+ */
+BSERIAL_API bserial_status_t
+bserial_symbol_dict(bserial_ctx_t* ctx, const char* const* symbols, uint32_t num_symbols);
+
+/*! Encoding of a column */
+typedef enum {
+	/*! Packed unsigned integers, same as @ref bserial_uint_array */
+	BSERIAL_COLUMN_UINT       = 0,
+	/*! Packed zigzag-encoded signed integers */
+	BSERIAL_COLUMN_SINT       = 1,
+	/*! Packed zigzag-encoded differences between consecutive signed integers */
+	BSERIAL_COLUMN_SINT_DELTA = 2,
+	/*! Little-endian 32-bit floats */
+	BSERIAL_COLUMN_F32        = 3,
+	/*! Little-endian 64-bit floats */
+	BSERIAL_COLUMN_F64        = 4,
+} bserial_column_encoding_t;
+
+/**
+ * @brief Read/write a column of unsigned integers.
+ *
+ * A column is a contiguous run of values of the same type, prefixed with its
+ * size in bytes.
+ * A table can be stored column by column by serializing a record where each
+ * key is a column:
+ *
+ * @code
+ * BSERIAL_RECORD(ctx, telemetry) {
+ *     BSERIAL_KEY(ctx, timestamp) {
+ *         uint64_t len = telemetry->num_rows;
+ *         BSERIAL_CHECK_STATUS(bserial_sint_column(ctx, telemetry->timestamps, &len, true));
+ *     }
+ *     // ...
+ * }
+ * @endcode
+ *
+ * Columns that are not read are skipped with a single @ref bserial_in_t.skip.
+ *
+ * @param values The values to read/write.
+ * @param len Number of elements in @a values. Will be set to the actual number.
+ */
+BSERIAL_API bserial_status_t
+bserial_uint_column(bserial_ctx_t* ctx, uint64_t* values, uint64_t* len);
+
+/**
+ * @brief Read/write a column of signed integers.
+ *
+ * @param values The values to read/write.
+ * @param len Number of elements in @a values. Will be set to the actual number.
+ * @param delta Whether to encode differences between consecutive values.
+ *   This is more compact for sorted or slowly changing values such as timestamps.
+ *   It is ignored when reading.
+ * @see bserial_uint_column
+ */
+BSERIAL_API bserial_status_t
+bserial_sint_column(bserial_ctx_t* ctx, int64_t* values, uint64_t* len, bool delta);
+
+/**
+ * @brief Read/write a column of 32-bit floats.
+ *
+ * @see bserial_uint_column
+ */
+BSERIAL_API bserial_status_t
+bserial_f32_column(bserial_ctx_t* ctx, float* values, uint64_t* len);
+
+/**
+ * @brief Read/write a column of 64-bit floats.
+ *
+ * @see bserial_uint_column
+ */
+BSERIAL_API bserial_status_t
+bserial_f64_column(bserial_ctx_t* ctx, double* values, uint64_t* len);
+
 /**
  * @brief Read/write an array.
  *
@@ -460,10 +746,194 @@ bserial_key(bserial_ctx_t* ctx, const char* name, uint64_t len);
  */
 #define BSERIAL_KEY(ctx, name) if (bserial_key(ctx, #name, sizeof(#name) - 1))
 
+// Random access
+
+/**
+ * @brief Mark a position that a reader can seek to.
+ *
+ * This must be called right before a value: at the root, before an element of
+ * an array or before the value of a key in a record.
+ * Rows of a table cannot be marked since only the first row carries the
+ * table's schema.
+ *
+ * The symbol table is reset so the following values do not refer to any
+ * symbol that was written before.
+ * This costs a redefinition of every symbol used after the mark.
+ *
+ * A reader which does not seek also resets its symbol table when it passes
+ * the mark.
+ * Thus, symbols previously returned by @ref bserial_symbol become invalid.
+ *
+ * The offsets are typically collected into an index with
+ * @ref bserial_write_index:
+ *
+ * @code
+ * BSERIAL_CHECK_STATUS(bserial_array(ctx, &len));
+ * for (uint64_t i = 0; i < len; ++i) {
+ *     BSERIAL_CHECK_STATUS(bserial_sync_point(ctx, &offsets[i]));
+ *     BSERIAL_CHECK_STATUS(serialize_event(ctx, &events[i]));
+ * }
+ * BSERIAL_CHECK_STATUS(bserial_write_index(ctx, offsets, len));
+ * @endcode
+ *
+ * This does nothing when reading.
+ *
+ * @param offset Will be set to the position of the mark in the stream.
+ * @remarks This requires an output stream with @ref bserial_out_t.tell.
+ *   Otherwise, @ref BSERIAL_IO_ERROR is returned.
+ */
+BSERIAL_API bserial_status_t
+bserial_sync_point(bserial_ctx_t* ctx, uint64_t* offset);
+
+/**
+ * @brief Move a reading context to a position marked by @ref bserial_sync_point.
+ *
+ * The context is reset to the root so the marked value can be read as if it
+ * was the only value in the stream.
+ * Any previous error is cleared.
+ *
+ * @param offset The position returned by @ref bserial_sync_point.
+ * @remarks This requires an input stream with @ref bserial_in_t.seek.
+ *   Otherwise, @ref BSERIAL_IO_ERROR is returned.
+ */
+BSERIAL_API bserial_status_t
+bserial_seek(bserial_ctx_t* ctx, uint64_t offset);
+
+/**
+ * @brief Write an index of offsets as the trailer of the stream.
+ *
+ * This must be the last thing written to the stream.
+ * The index is stored as fixed-width offsets followed by a fixed-size footer so
+ * it can be found from the end of the stream with @ref bserial_read_index.
+ *
+ * @param offsets Offsets returned by @ref bserial_sync_point.
+ * @param len Number of offsets.
+ */
+BSERIAL_API bserial_status_t
+bserial_write_index(bserial_ctx_t* ctx, const uint64_t* offsets, uint64_t len);
+
+/**
+ * @brief Read the index written by @ref bserial_write_index.
+ *
+ * The stream must be repositioned with @ref bserial_seek afterward.
+ *
+ * @param offsets The buffer to read into.
+ *   When it is NULL, only the number of offsets is read.
+ * @param len Size of the buffer. Will be set to the number of offsets.
+ * @remarks This requires an input stream with @ref bserial_in_t.seek.
+ *   Otherwise, @ref BSERIAL_IO_ERROR is returned.
+ */
+BSERIAL_API bserial_status_t
+bserial_read_index(bserial_ctx_t* ctx, uint64_t* offsets, uint64_t* len);
+
 /*! Trace the error context during serialization */
 BSERIAL_API void
 bserial_trace(bserial_ctx_t* ctx, bserial_tracer_t tracer, void* userdata);
 
+#ifdef BSERIAL_THREADS
+
+/**
+ * @brief Options for @ref bserial_decode_chunks
+ *
+ * A chunk is the value following a sync point (@ref bserial_sync_point) whose
+ * offset is listed in the index (@ref bserial_write_index).
+ * Since sync points reset the symbol table, chunks can be decoded
+ * independently.
+ * A chunk is typically an array of records:
+ *
+ * @code
+ * for (uint64_t i = 0; i < num_chunks; ++i) {
+ *     uint64_t len = chunk_len(i);
+ *     BSERIAL_CHECK_STATUS(bserial_sync_point(ctx, &offsets[i]));
+ *     BSERIAL_CHECK_STATUS(bserial_array(ctx, &len));
+ *     for (uint64_t j = 0; j < len; ++j) {
+ *         BSERIAL_CHECK_STATUS(serialize_event(ctx, &events[i][j]));
+ *     }
+ * }
+ * BSERIAL_CHECK_STATUS(bserial_write_index(ctx, offsets, num_chunks));
+ * @endcode
+ */
+typedef struct {
+	/*! Number of decoding threads, at least 1 */
+	uint32_t num_threads;
+
+	/*! Configuration for the context of each thread */
+	bserial_ctx_config_t ctx_config;
+
+	/**
+	 * @brief Input stream of each thread.
+	 *
+	 * There must be @ref num_threads streams over the same data.
+	 * Each stream must support @ref bserial_in_t.seek.
+	 * For example: memory streams (@ref bserial_mem_init_in) over the same
+	 * memory-mapped file.
+	 */
+	bserial_in_t** streams;
+
+	/*! (Optional) Symbol dictionary, see @ref bserial_symbol_dict */
+	const char* const* symbols;
+
+	/*! Number of symbols in @ref symbols */
+	uint32_t num_symbols;
+
+	/**
+	 * @brief Decode a chunk.
+	 *
+	 * This is called on a decoding thread with @a ctx positioned at the start
+	 * of the chunk.
+	 * The decoded data should be stored in a buffer dedicated to
+	 * @a thread_index.
+	 * It will not be called again for the same thread until the chunk is
+	 * delivered.
+	 */
+	bserial_status_t (*decode)(
+		bserial_ctx_t* ctx,
+		uint32_t thread_index,
+		uint64_t chunk_index,
+		void* userdata
+	);
+
+	/**
+	 * @brief Consume a decoded chunk.
+	 *
+	 * This is called on the calling thread of @ref bserial_decode_chunks in
+	 * chunk order.
+	 */
+	bserial_status_t (*deliver)(uint32_t thread_index, uint64_t chunk_index, void* userdata);
+
+	/*! Arbitrary userdata passed to the callbacks */
+	void* userdata;
+} bserial_decode_chunks_options_t;
+
+/*! How much memory is required for @ref bserial_decode_chunks */
+BSERIAL_API size_t
+bserial_decode_chunks_mem_size(uint32_t num_threads, bserial_ctx_config_t ctx_config);
+
+/**
+ * @brief Decode chunks on multiple threads and deliver them in order.
+ *
+ * Chunk i is decoded by thread `i % num_threads` while the calling thread
+ * delivers the earlier chunks.
+ * This stops at the first error.
+ *
+ * @param mem Memory for the contexts.
+ *   Must have at least as many bytes as returned by @ref bserial_decode_chunks_mem_size.
+ * @param options Decoding options.
+ * @param offsets Offsets of the chunks, see @ref bserial_read_index.
+ * @param num_chunks Number of chunks.
+ * @return The first error from any thread or callback.
+ *   @ref BSERIAL_IO_ERROR if @ref bserial_decode_chunks_options_t.num_threads is 0.
+ */
+BSERIAL_API bserial_status_t
+bserial_decode_chunks(
+	void* mem,
+	const bserial_decode_chunks_options_t* options,
+	const uint64_t* offsets,
+	uint64_t num_chunks
+);
+
+#endif
+
 #ifdef BSERIAL_STDIO
 
 #include <stdio.h>
@@ -472,12 +942,16 @@ bserial_trace(bserial_ctx_t* ctx, bserial_tracer_t tracer, void* userdata);
 typedef struct bserial_stdio_in_s {
 	bserial_in_t bserial;
 	FILE* file;
+	char* buffer;
+	size_t buffer_size;
 } bserial_stdio_in_t;
 
 /*! stdio output stream */
 typedef struct bserial_stdio_out_s {
 	bserial_out_t bserial;
 	FILE* file;
+	char* buffer;
+	size_t buffer_size;
 } bserial_stdio_out_t;
 
 /*! Wrap a stdio FILE into an input stream */
@@ -488,6 +962,53 @@ bserial_stdio_init_in(bserial_stdio_in_t* bserial_stdio, FILE* file);
 BSERIAL_API bserial_out_t*
 bserial_stdio_init_out(bserial_stdio_out_t* bserial_stdio, FILE* file);
 
+/**
+ * @brief Wrap a stdio FILE into a buffered input stream
+ *
+ * The file is read in blocks of @a buffer_size bytes.
+ * Small reads such as markers and varints are served directly from the buffer.
+ * Reads at least as large as the buffer bypass it.
+ *
+ * @param buffer The buffer.
+ *   It must remain valid for as long as the stream.
+ * @param buffer_size Size of the buffer.
+ * @remarks The file position is ahead of the stream by up to @a buffer_size bytes.
+ */
+BSERIAL_API bserial_in_t*
+bserial_stdio_init_buffered_in(
+	bserial_stdio_in_t* bserial_stdio,
+	FILE* file,
+	void* buffer,
+	size_t buffer_size
+);
+
+/**
+ * @brief Wrap a stdio FILE into a buffered output stream
+ *
+ * Writes are accumulated into @a buffer and only passed to `fwrite` when it
+ * is full.
+ *
+ * @param buffer The buffer.
+ *   It must remain valid for as long as the stream.
+ * @param buffer_size Size of the buffer.
+ * @remarks @ref bserial_stdio_flush must be called before closing the file.
+ */
+BSERIAL_API bserial_out_t*
+bserial_stdio_init_buffered_out(
+	bserial_stdio_out_t* bserial_stdio,
+	FILE* file,
+	void* buffer,
+	size_t buffer_size
+);
+
+/**
+ * @brief Write all buffered data of an output stream to its file
+ *
+ * This does nothing for an unbuffered stream.
+ */
+BSERIAL_API bserial_status_t
+bserial_stdio_flush(bserial_stdio_out_t* bserial_stdio);
+
 #endif
 
 #ifdef BSERIAL_MEM
@@ -495,6 +1016,7 @@ bserial_stdio_init_out(bserial_stdio_out_t* bserial_stdio, FILE* file);
 /*! Memory input stream */
 typedef struct bserial_mem_in_s {
 	bserial_in_t bserial;
+	char* begin;
 	char* cur;
 	char* end;
 } bserial_mem_in_t;
@@ -516,6 +1038,11 @@ typedef struct bserial_mem_out_s {
 
 /**
  * @brief Create a memory input stream
+ *
+ * The stream supports @ref bserial_in_t.borrow so @ref bserial_blob_view can
+ * point directly into @a mem.
+ * It can be used on top of a memory-mapped file.
+ *
  * @param mem The backing memory.
  * @param size Size of the backing memory.
  * @return An input stream.
@@ -536,6 +1063,138 @@ bserial_mem_init_out(bserial_mem_out_t* bserial_mem, void* memctx);
 
 #endif
 
+#ifdef BSERIAL_BLOCK
+
+/**
+ * @brief Compression codec for block streams
+ *
+ * @see bserial_block_lz_codec
+ */
+typedef struct {
+	/**
+	 * @brief Compress a block.
+	 *
+	 * @param userdata @ref bserial_block_codec_t.userdata
+	 * @param src The data to compress.
+	 * @param src_size Size of @a src.
+	 * @param dst The buffer to compress into.
+	 * @param dst_capacity Size of @a dst.
+	 * @return Size of the compressed data or 0 if it does not fit in @a dst.
+	 *   In the latter case, the block is stored uncompressed.
+	 */
+	size_t (*compress)(
+		void* userdata,
+		const void* src, size_t src_size,
+		void* dst, size_t dst_capacity
+	);
+
+	/**
+	 * @brief Decompress a block.
+	 *
+	 * @param userdata @ref bserial_block_codec_t.userdata
+	 * @param src The compressed data.
+	 * @param src_size Size of @a src.
+	 * @param dst The buffer to decompress into.
+	 * @param dst_size Size of @a dst, which is the exact decompressed size.
+	 * @return Size of the decompressed data or 0 on error.
+	 */
+	size_t (*decompress)(
+		void* userdata,
+		const void* src, size_t src_size,
+		void* dst, size_t dst_size
+	);
+
+	/*! Arbitrary userdata passed to the callbacks */
+	void* userdata;
+} bserial_block_codec_t;
+
+/*! Block compression input stream */
+typedef struct bserial_block_in_s {
+	bserial_in_t bserial;
+	bserial_in_t* inner;
+	bserial_block_codec_t codec;
+	char* block;
+	char* packed;
+	size_t block_size;
+} bserial_block_in_t;
+
+/*! Block compression output stream */
+typedef struct bserial_block_out_s {
+	bserial_out_t bserial;
+	bserial_out_t* inner;
+	bserial_block_codec_t codec;
+	char* block;
+	char* packed;
+	size_t block_size;
+} bserial_block_out_t;
+
+/**
+ * @brief Built-in LZ77 codec.
+ *
+ * It favours speed over ratio, in the spirit of LZ4.
+ */
+BSERIAL_API bserial_block_codec_t
+bserial_block_lz_codec(void);
+
+/*! How big the buffer of a block stream must be */
+BSERIAL_API size_t
+bserial_block_buffer_size(size_t block_size);
+
+/**
+ * @brief Wrap an input stream to decompress blocks written by a @ref bserial_block_out_t
+ *
+ * Skipping over whole blocks does not decompress them.
+ *
+ * @param inner The stream to read compressed blocks from.
+ * @param codec The compression codec.
+ * @param buffer The buffer.
+ *   It must have at least @ref bserial_block_buffer_size bytes and remain
+ *   valid for as long as the stream.
+ * @param block_size Maximum size of a block.
+ *   It must be at least the one used for writing.
+ */
+BSERIAL_API bserial_in_t*
+bserial_block_init_in(
+	bserial_block_in_t* bserial_block,
+	bserial_in_t* inner,
+	bserial_block_codec_t codec,
+	void* buffer,
+	size_t block_size
+);
+
+/**
+ * @brief Wrap an output stream to compress data in blocks
+ *
+ * Each block is compressed independently.
+ * Blocks which do not compress are stored as-is.
+ *
+ * @param inner The stream to write compressed blocks to.
+ * @param codec The compression codec.
+ * @param buffer The buffer.
+ *   It must have at least @ref bserial_block_buffer_size bytes and remain
+ *   valid for as long as the stream.
+ * @param block_size Size of a block.
+ * @remarks @ref bserial_block_flush must be called after the last write.
+ */
+BSERIAL_API bserial_out_t*
+bserial_block_init_out(
+	bserial_block_out_t* bserial_block,
+	bserial_out_t* inner,
+	bserial_block_codec_t codec,
+	void* buffer,
+	size_t block_size
+);
+
+/**
+ * @brief Compress and write the pending block
+ *
+ * This does not flush the inner stream.
+ */
+BSERIAL_API bserial_status_t
+bserial_block_flush(bserial_block_out_t* bserial_block);
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -554,7 +1213,10 @@ bserial_mem_init_out(bserial_mem_out_t* bserial_mem, void* memctx);
 
 bserial_status_t
 bserial_write_uint(uint64_t x, bserial_out_t* out) {
-    char buf[10];
+	// Encode directly into the stream's buffer when there is enough space
+	char* buf = out->buf_end - out->buf_cur >= 10 ? out->buf_cur : NULL;
+	char tmp_buf[10];
+	if (buf == NULL) { buf = tmp_buf; }
     size_t n = 0;
 
 	for (int i = 0; i < 10; ++i) {
@@ -566,7 +1228,12 @@ bserial_write_uint(uint64_t x, bserial_out_t* out) {
     buf[n] ^= 0x80;
 	n += 1;
 
-	return bserial_write(out, buf, n);
+	if (buf != tmp_buf) {
+		out->buf_cur += n;
+		return BSERIAL_OK;
+	} else {
+		return bserial_write(out, buf, n);
+	}
 }
 
 bserial_status_t
@@ -582,6 +1249,22 @@ bserial_read_uint(uint64_t* x, bserial_in_t* in) {
 	char c;
 	uint64_t tmp = 0;
 
+	// Decode directly from the stream's buffer when a whole varint fits
+	if (in->buf_end - in->buf_cur >= 10) {
+		const uint8_t* bytes = (const uint8_t*)in->buf_cur;
+		for (int i = 0; i < 10; ++i) {
+			b = bytes[i];
+			tmp |= (b & 0x7f) << (7 * i);
+			if (b < 0x80) {
+				in->buf_cur += i + 1;
+				*x = tmp;
+				return BSERIAL_OK;
+			}
+		}
+
+		return BSERIAL_MALFORMED;
+	}
+
 	for (int i = 0; i < 10; ++i) {
 		BSERIAL_CHECK_STATUS(bserial_read(in, &c, 1));
 
@@ -700,6 +1383,9 @@ typedef enum {
 	BSERIAL_ARRAY        =  8,
 	BSERIAL_TABLE        =  9,
 	BSERIAL_RECORD       = 10,
+	BSERIAL_UINT_ARRAY   = 11,
+	BSERIAL_COLUMN       = 12,
+	BSERIAL_SYM_RESET    = 13,
 } bserial_marker_t;
 
 typedef enum {
@@ -708,6 +1394,7 @@ typedef enum {
 	BSERIAL_SCOPE_ARRAY,
 	BSERIAL_SCOPE_TABLE,
 	BSERIAL_SCOPE_RECORD,
+	BSERIAL_SCOPE_UINT_ARRAY,
 } bserial_scope_type_t;
 
 typedef enum {
@@ -717,6 +1404,8 @@ typedef enum {
 	BSERIAL_OP_TABLE,
 	BSERIAL_OP_ARRAY,
 	BSERIAL_OP_RECORD,
+	BSERIAL_OP_UINT_ARRAY,
+	BSERIAL_OP_COLUMN,
 } bserial_op_type_t;
 
 typedef enum {
@@ -725,15 +1414,21 @@ typedef enum {
 	BSERIAL_RECORD_VALUE_IO,
 } bserial_record_mode_t;
 
+#define BSERIAL_NO_FIELD UINT32_MAX
+
 typedef struct {
 	char* buf;
 	uint64_t len;
+	// Last field of the most recently read schema with this symbol as its key
+	uint32_t field_index;
 } bserial_symbol_t;
 
 typedef struct {
 	const char* symbol;
 	uint64_t symbol_len;
 	const char* field_name;
+	// Previous field in the same schema with the same key
+	uint32_t prev_field;
 } bserial_record_mapping_t;
 
 typedef struct {
@@ -761,12 +1456,16 @@ struct bserial_ctx_s {
 	int32_t* symtab_index;
 	int32_t symtab_exp;
 	char* strpool;
+	char* strpool_first;
+	uint32_t num_dict_symbols;
+	char* strpool_dict;
 
 	int32_t key_exp;
 	bserial_scope_t* scope_first;
 	bserial_scope_t* scope;
 	bserial_scope_t* scope_last;
 	bserial_record_mapping_t* schema_pool;
+	bserial_record_mapping_t* schema_pool_first;
 };
 
 static inline size_t
@@ -821,8 +1520,8 @@ bserial_ctx_mem_layout(void* mem, bserial_ctx_config_t config) {
 		ctx->scope->type = BSERIAL_SCOPE_ROOT;
 		ctx->scope->prev_schema_pool = ctx->schema_pool;
 
-		ctx->strpool = mem_layout_locate(mem, strpool);
-		ctx->schema_pool = mem_layout_locate(mem, schema_pool);
+		ctx->strpool = ctx->strpool_first = ctx->strpool_dict = mem_layout_locate(mem, strpool);
+		ctx->schema_pool = ctx->schema_pool_first = mem_layout_locate(mem, schema_pool);
 		ctx->marker_buf = UINT8_MAX;
 	}
 
@@ -909,7 +1608,7 @@ bserial_begin_op(bserial_ctx_t* ctx, bserial_op_type_t op) {
 	bserial_scope_type_t scope_type = scope->type;
 
 	// Can't do anything before filling the blob
-	if (scope_type == BSERIAL_SCOPE_BLOB) {
+	if (scope_type == BSERIAL_SCOPE_BLOB || scope_type == BSERIAL_SCOPE_UINT_ARRAY) {
 		return bserial_malformed(ctx);
 	}
 
@@ -930,6 +1629,8 @@ bserial_begin_op(bserial_ctx_t* ctx, bserial_op_type_t op) {
 
 	if (op == BSERIAL_OP_BLOB) {
 		BSERIAL_CHECK_STATUS(bserial_push_scope(ctx, BSERIAL_SCOPE_BLOB));
+	} else if (op == BSERIAL_OP_UINT_ARRAY) {
+		BSERIAL_CHECK_STATUS(bserial_push_scope(ctx, BSERIAL_SCOPE_UINT_ARRAY));
 	} else if (op == BSERIAL_OP_ARRAY) {
 		BSERIAL_CHECK_STATUS(bserial_push_scope(ctx, BSERIAL_SCOPE_ARRAY));
 	} else if (op == BSERIAL_OP_TABLE) {
@@ -949,6 +1650,7 @@ bserial_end_op(bserial_ctx_t* ctx, bserial_op_type_t op) {
 	// bserial_end_op that ends its own op should pop the scope.
 	if (
 		(ctx->scope->type == BSERIAL_SCOPE_BLOB && op == BSERIAL_OP_BLOB)
+		|| (ctx->scope->type == BSERIAL_SCOPE_UINT_ARRAY && op == BSERIAL_OP_UINT_ARRAY)
 		|| (ctx->scope->type == BSERIAL_SCOPE_RECORD && op == BSERIAL_OP_RECORD)
 	) {
 		BSERIAL_CHECK_STATUS(bserial_pop_scope(ctx));
@@ -968,27 +1670,155 @@ bserial_end_op(bserial_ctx_t* ctx, bserial_op_type_t op) {
 	return BSERIAL_OK;
 }
 
+// Part of the file format, must not change along with the hash
+static inline uint64_t
+bserial__load_u64le(const uint8_t *p) {
+	return (uint64_t)p[0] <<  0 | (uint64_t)p[1] <<  8 |
+	       (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+	       (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 |
+	       (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+// small, fast 64 bit hash function.
+//
+// https://github.com/N-R-K/ChibiHash
+// https://nrk.neocities.org/articles/chibihash
+//
+// This is free and unencumbered software released into the public domain.
+// For more information, please refer to <https://unlicense.org/>
+
+static inline uint64_t
+bserial__chibihash64(const void *keyIn, ptrdiff_t len, uint64_t seed) {
+	const uint8_t *k = (const uint8_t *)keyIn;
+	ptrdiff_t l = len;
+
+	const uint64_t P1 = UINT64_C(0x2B7E151628AED2A5);
+	const uint64_t P2 = UINT64_C(0x9E3793492EEDC3F7);
+	const uint64_t P3 = UINT64_C(0x3243F6A8885A308C);
+
+	uint64_t h[4] = { P1, P2, P3, seed };
+
+	for (; l >= 32; l -= 32) {
+		for (int i = 0; i < 4; ++i, k += 8) {
+			uint64_t lane = bserial__load_u64le(k);
+			h[i] ^= lane;
+			h[i] *= P1;
+			h[(i+1)&3] ^= ((lane << 40) | (lane >> 24));
+		}
+	}
+
+	h[0] += ((uint64_t)len << 32) | ((uint64_t)len >> 32);
+	if (l & 1) {
+		h[0] ^= k[0];
+		--l, ++k;
+	}
+	h[0] *= P2; h[0] ^= h[0] >> 31;
+
+	for (int i = 1; l >= 8; l -= 8, k += 8, ++i) {
+		h[i] ^= bserial__load_u64le(k);
+		h[i] *= P2; h[i] ^= h[i] >> 31;
+	}
+
+	for (int i = 0; l > 0; l -= 2, k += 2, ++i) {
+		h[i] ^= (k[0] | ((uint64_t)k[1] << 8));
+		h[i] *= P3; h[i] ^= h[i] >> 31;
+	}
+
+	uint64_t x = seed;
+	x ^= h[0] * ((h[2] >> 32)|1);
+	x ^= h[1] * ((h[3] >> 32)|1);
+	x ^= h[2] * ((h[0] >> 32)|1);
+	x ^= h[3] * ((h[1] >> 32)|1);
+
+	// moremur: https://mostlymangling.blogspot.com/2019/12/stronger-better-morer-moremur-better.html
+	x ^= x >> 27; x *= UINT64_C(0x3C79AC492BA7B653);
+	x ^= x >> 33; x *= UINT64_C(0x1C69B3F74AC4AE35);
+	x ^= x >> 27;
+
+	return x;
+}
+
+static inline uint64_t
+bserial_hash(const void* data, size_t len) {
+	return bserial__chibihash64(data, (ptrdiff_t)len, 0);
+}
+
+// https://nullprogram.com/blog/2022/08/08/
+static inline int32_t
+bserial_lookup_index(uint64_t hash, int32_t exp, int32_t idx) {
+	uint32_t mask = ((uint32_t)1 << exp) - 1;
+	uint32_t step = (uint32_t)((hash >> (64 - exp)) | 1);
+	return (idx + step) & mask;
+}
+
 #define BSERIAL_NO_MARKER ((uint8_t)UINT8_MAX)
 
+// Returns the id + 1 of an interned symbol or 0 if it is not found.
+// In the latter case, slot is set to where it should be inserted in symtab_index.
+static inline int32_t
+bserial_find_symbol(bserial_ctx_t* ctx, const char* buf, uint64_t len, int32_t* slot) {
+	uint64_t symbol_hash = bserial_hash(buf, len);
+	for (int32_t i = (int32_t)symbol_hash;;) {
+		i = bserial_lookup_index(symbol_hash, ctx->symtab_exp, i);
+		int32_t index = ctx->symtab_index[i];
+		if (
+			index == 0
+			|| (ctx->symtab[index - 1].len == len && memcmp(ctx->symtab[index - 1].buf, buf, len) == 0)
+		) {
+			*slot = i;
+			return index;
+		}
+	}
+}
+
+// Reverts the symbol table to the dictionary
+static inline void
+bserial_reset_symbols(bserial_ctx_t* ctx) {
+	memset(ctx->symtab_index, 0, sizeof(*ctx->symtab_index) << ctx->symtab_exp);
+	ctx->num_symbols = ctx->num_dict_symbols;
+	ctx->strpool = ctx->strpool_dict;
+
+	for (uint32_t i = 0; i < ctx->num_dict_symbols; ++i) {
+		int32_t slot;
+		bserial_find_symbol(ctx, ctx->symtab[i].buf, ctx->symtab[i].len, &slot);
+		ctx->symtab_index[slot] = (int32_t)i + 1;
+	}
+}
+
 static inline bserial_status_t
-bserial_peek_marker(bserial_ctx_t* ctx, uint8_t* marker) {
-	if (ctx->marker_buf == BSERIAL_NO_MARKER) {
-		BSERIAL_CHECK_STATUS(ctx->status = bserial_read(ctx->in, &ctx->marker_buf, sizeof(uint8_t)));
+bserial_fill_marker_buf(bserial_ctx_t* ctx) {
+	while (ctx->marker_buf == BSERIAL_NO_MARKER) {
+		uint8_t marker;
+		BSERIAL_CHECK_STATUS(ctx->status = bserial_read(ctx->in, &marker, sizeof(marker)));
+
+		if (marker == BSERIAL_SYM_RESET) {
+			// A sync point is transparent to the values around it
+			bserial_reset_symbols(ctx);
+		} else if (marker == BSERIAL_NO_MARKER) {
+			return bserial_malformed(ctx);
+		} else {
+			ctx->marker_buf = marker;
+		}
 	}
 
+	return BSERIAL_OK;
+}
+
+static inline bserial_status_t
+bserial_peek_marker(bserial_ctx_t* ctx, uint8_t* marker) {
+	BSERIAL_CHECK_STATUS(bserial_fill_marker_buf(ctx));
+
 	*marker = ctx->marker_buf;
 	return BSERIAL_OK;
 }
 
 static inline bserial_status_t
 bserial_read_marker(bserial_ctx_t* ctx, uint8_t* marker) {
-	if (ctx->marker_buf == BSERIAL_NO_MARKER) {
-		return ctx->status = bserial_read(ctx->in, marker, sizeof(uint8_t));
-	} else {
-		*marker = ctx->marker_buf;
-		ctx->marker_buf = BSERIAL_NO_MARKER;
-		return BSERIAL_OK;
-	}
+	BSERIAL_CHECK_STATUS(bserial_fill_marker_buf(ctx));
+
+	*marker = ctx->marker_buf;
+	ctx->marker_buf = BSERIAL_NO_MARKER;
+	return BSERIAL_OK;
 }
 
 static inline void
@@ -1169,7 +1999,7 @@ bserial_marker_and_length(bserial_ctx_t* ctx, uint8_t marker, uint64_t* length)
 
 	if (bserial_mode(ctx) == BSERIAL_MODE_READ) {
 		uint8_t actual_marker;
-		BSERIAL_CHECK_STATUS(ctx->status = bserial_read(ctx->in, &actual_marker, sizeof(actual_marker)));
+		BSERIAL_CHECK_STATUS(bserial_read_marker(ctx, &actual_marker));
 		if (actual_marker != marker) { return bserial_malformed(ctx); }
 
 		BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(length, ctx->in));
@@ -1222,108 +2052,436 @@ bserial_blob_body(bserial_ctx_t* ctx, char* buf) {
 	return bserial_end_op(ctx, BSERIAL_OP_BLOB);
 }
 
-// small, fast 64 bit hash function.
-//
-// https://github.com/N-R-K/ChibiHash
-// https://nrk.neocities.org/articles/chibihash
-//
-// This is free and unencumbered software released into the public domain.
-// For more information, please refer to <https://unlicense.org/>
-static inline uint64_t
-bserial__chibihash64__load64le(const uint8_t *p) {
-	return (uint64_t)p[0] <<  0 | (uint64_t)p[1] <<  8 |
-	       (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
-	       (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 |
-	       (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+bserial_status_t
+bserial_blob_view(bserial_ctx_t* ctx, const char** buf, uint64_t* len) {
+	if (bserial_mode(ctx) == BSERIAL_MODE_WRITE) {
+		// Writing never modifies the buffer
+		return bserial_blob(ctx, (char*)*buf, len);
+	}
+
+	BSERIAL_CHECK_STATUS(ctx->status);
+	if (ctx->in->borrow == NULL) { return ctx->status = BSERIAL_IO_ERROR; }
+
+	BSERIAL_CHECK_STATUS(bserial_blob_header(ctx, len));
+	if (*len > SIZE_MAX) { return bserial_malformed(ctx); }
+
+	const void* view = ctx->in->borrow(ctx->in, (size_t)*len);
+	if (view == NULL) { return ctx->status = BSERIAL_IO_ERROR; }
+	*buf = view;
+
+	return bserial_end_op(ctx, BSERIAL_OP_BLOB);
 }
 
-static inline uint64_t
-bserial__chibihash64(const void *keyIn, ptrdiff_t len, uint64_t seed) {
-	const uint8_t *k = (const uint8_t *)keyIn;
-	ptrdiff_t l = len;
+// Largest encoded size of a block in bserial_uint_array
+#define BSERIAL_UINT_BLOCK_CTRL_SIZE (BSERIAL_UINT_BLOCK_SIZE / 2)
+#define BSERIAL_UINT_BLOCK_DATA_SIZE (BSERIAL_UINT_BLOCK_SIZE * sizeof(uint64_t))
 
-	const uint64_t P1 = UINT64_C(0x2B7E151628AED2A5);
-	const uint64_t P2 = UINT64_C(0x9E3793492EEDC3F7);
-	const uint64_t P3 = UINT64_C(0x3243F6A8885A308C);
+static inline void
+bserial_store64le(uint8_t* p, uint64_t x) {
+	for (int i = 0; i < 8; ++i) {
+		p[i] = (uint8_t)(x >> (i * 8));
+	}
+}
 
-	uint64_t h[4] = { P1, P2, P3, seed };
+// Number of bytes needed for a value, at least 1
+static inline int
+bserial_uint_width(uint64_t x) {
+	return 1
+		+ (x > UINT64_C(0xff))
+		+ (x > UINT64_C(0xffff))
+		+ (x > UINT64_C(0xffffff))
+		+ (x > UINT64_C(0xffffffff))
+		+ (x > UINT64_C(0xffffffffff))
+		+ (x > UINT64_C(0xffffffffffff))
+		+ (x > UINT64_C(0xffffffffffffff));
+}
 
-	for (; l >= 32; l -= 32) {
-		for (int i = 0; i < 4; ++i, k += 8) {
-			uint64_t lane = bserial__chibihash64__load64le(k);
-			h[i] ^= lane;
-			h[i] *= P1;
-			h[(i+1)&3] ^= ((lane << 40) | (lane >> 24));
-		}
+static inline bserial_status_t
+bserial_write_uint_block(bserial_out_t* out, const uint64_t* values, size_t count) {
+	uint8_t ctrl[BSERIAL_UINT_BLOCK_CTRL_SIZE] = { 0 };
+	// Each value is stored as 8 bytes and then overwritten by the next one
+	uint8_t data[BSERIAL_UINT_BLOCK_DATA_SIZE];
+	size_t data_size = 0;
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t value = values[i];
+		int width = bserial_uint_width(value);
+		ctrl[i / 2] |= (uint8_t)((width - 1) << ((i & 1) * 4));
+		bserial_store64le(data + data_size, value);
+		data_size += (size_t)width;
 	}
 
-	h[0] += ((uint64_t)len << 32) | ((uint64_t)len >> 32);
-	if (l & 1) {
-		h[0] ^= k[0];
-		--l, ++k;
+	BSERIAL_CHECK_STATUS(bserial_write(out, ctrl, (count + 1) / 2));
+	return bserial_write(out, data, data_size);
+}
+
+// Read the control bytes of a block and return the size of its data
+static inline bserial_status_t
+bserial_read_uint_block_ctrl(bserial_in_t* in, uint8_t* ctrl, size_t count, size_t* data_size) {
+	size_t ctrl_size = (count + 1) / 2;
+	BSERIAL_CHECK_STATUS(bserial_read(in, ctrl, ctrl_size));
+
+	uint8_t invalid_bits = 0;
+	size_t size = count;
+	for (size_t i = 0; i < ctrl_size; ++i) {
+		invalid_bits |= ctrl[i] & 0x88;
+		size += (size_t)(ctrl[i] & 0x07) + (size_t)((ctrl[i] >> 4) & 0x07);
 	}
-	h[0] *= P2; h[0] ^= h[0] >> 31;
+	// The unused half of the last byte must be empty
+	if (count & 1) { invalid_bits |= ctrl[ctrl_size - 1] & 0xf0; }
+	if (invalid_bits != 0) { return BSERIAL_MALFORMED; }
 
-	for (int i = 1; l >= 8; l -= 8, k += 8, ++i) {
-		h[i] ^= bserial__chibihash64__load64le(k);
-		h[i] *= P2; h[i] ^= h[i] >> 31;
+	*data_size = size;
+	return BSERIAL_OK;
+}
+
+static inline bserial_status_t
+bserial_read_uint_block(bserial_in_t* in, uint64_t* values, size_t count, size_t* block_size) {
+	static const uint64_t masks[8] = {
+		UINT64_C(0xff),
+		UINT64_C(0xffff),
+		UINT64_C(0xffffff),
+		UINT64_C(0xffffffff),
+		UINT64_C(0xffffffffff),
+		UINT64_C(0xffffffffffff),
+		UINT64_C(0xffffffffffffff),
+		UINT64_C(0xffffffffffffffff),
+	};
+
+	uint8_t ctrl[BSERIAL_UINT_BLOCK_CTRL_SIZE];
+	size_t data_size;
+	BSERIAL_CHECK_STATUS(bserial_read_uint_block_ctrl(in, ctrl, count, &data_size));
+
+	// Every value is loaded as 8 bytes so there must be 7 bytes of slack at the end.
+	// Decode straight from the stream's buffer when possible.
+	uint8_t data[BSERIAL_UINT_BLOCK_DATA_SIZE + 7];
+	const uint8_t* src;
+	bool buffered = (size_t)(in->buf_end - in->buf_cur) >= data_size + 7;
+	if (buffered) {
+		src = (const uint8_t*)in->buf_cur;
+	} else {
+		BSERIAL_CHECK_STATUS(bserial_read(in, data, data_size));
+		src = data;
 	}
 
-	for (int i = 0; l > 0; l -= 2, k += 2, ++i) {
-		h[i] ^= (k[0] | ((uint64_t)k[1] << 8));
-		h[i] *= P3; h[i] ^= h[i] >> 31;
+	for (size_t i = 0; i < count; ++i) {
+		int width_index = (ctrl[i / 2] >> ((i & 1) * 4)) & 0x07;
+		values[i] = bserial__load_u64le(src) & masks[width_index];
+		src += width_index + 1;
 	}
 
-	uint64_t x = seed;
-	x ^= h[0] * ((h[2] >> 32)|1);
-	x ^= h[1] * ((h[3] >> 32)|1);
-	x ^= h[2] * ((h[0] >> 32)|1);
-	x ^= h[3] * ((h[1] >> 32)|1);
+	if (buffered) { in->buf_cur += data_size; }
+	*block_size = (count + 1) / 2 + data_size;
+	return BSERIAL_OK;
+}
 
-	// moremur: https://mostlymangling.blogspot.com/2019/12/stronger-better-morer-moremur-better.html
-	x ^= x >> 27; x *= UINT64_C(0x3C79AC492BA7B653);
-	x ^= x >> 33; x *= UINT64_C(0x1C69B3F74AC4AE35);
-	x ^= x >> 27;
+static inline size_t
+bserial_uint_block_size(const uint64_t* values, size_t count) {
+	size_t size = (count + 1) / 2;
+	for (size_t i = 0; i < count; ++i) {
+		size += (size_t)bserial_uint_width(values[i]);
+	}
+	return size;
+}
 
-	return x;
+static inline bserial_status_t
+bserial_skip_uint_array(bserial_in_t* in, uint64_t len) {
+	uint8_t ctrl[BSERIAL_UINT_BLOCK_CTRL_SIZE];
+	for (uint64_t i = 0; i < len; i += BSERIAL_UINT_BLOCK_SIZE) {
+		size_t count = len - i < BSERIAL_UINT_BLOCK_SIZE ? (size_t)(len - i) : BSERIAL_UINT_BLOCK_SIZE;
+		size_t data_size;
+		BSERIAL_CHECK_STATUS(bserial_read_uint_block_ctrl(in, ctrl, count, &data_size));
+		BSERIAL_CHECK_STATUS(bserial_skip(in, data_size));
+	}
+
+	return BSERIAL_OK;
 }
 
-static inline uint64_t
-bserial_hash(const void* data, size_t len) {
-	return bserial__chibihash64(data, (ptrdiff_t)len, 0);
+bserial_status_t
+bserial_uint_array(bserial_ctx_t* ctx, uint64_t* values, uint64_t* len) {
+	uint64_t actual_len = *len;
+	BSERIAL_CHECK_STATUS(bserial_uint_array_header(ctx, &actual_len));
+	if (actual_len > *len) { return bserial_malformed(ctx); }
+	*len = actual_len;
+
+	return bserial_uint_array_body(ctx, values);
 }
 
-// https://nullprogram.com/blog/2022/08/08/
-static inline int32_t
-bserial_lookup_index(uint64_t hash, int32_t exp, int32_t idx) {
-	uint32_t mask = ((uint32_t)1 << exp) - 1;
-	uint32_t step = (uint32_t)((hash >> (64 - exp)) | 1);
-	return (idx + step) & mask;
+bserial_status_t
+bserial_uint_array_header(bserial_ctx_t* ctx, uint64_t* len) {
+	BSERIAL_CHECK_STATUS(bserial_begin_op(ctx, BSERIAL_OP_UINT_ARRAY));
+
+	if (bserial_mode(ctx) == BSERIAL_MODE_READ) {
+		uint8_t marker;
+		BSERIAL_CHECK_STATUS(bserial_read_marker(ctx, &marker));
+		if (marker != BSERIAL_UINT_ARRAY) { return bserial_malformed(ctx); }
+
+		BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(len, ctx->in));
+	} else {
+		uint8_t marker = BSERIAL_UINT_ARRAY;
+		BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, &marker, sizeof(marker)));
+		BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint(*len, ctx->out));
+	}
+
+	ctx->scope->len = *len;
+
+	return BSERIAL_OK;
 }
 
-static inline bserial_status_t
-bserial_skip_next(bserial_ctx_t* ctx, uint32_t depth) {
-	uint8_t marker;
-	BSERIAL_CHECK_STATUS(bserial_peek_marker(ctx, &marker));
+bserial_status_t
+bserial_uint_array_body(bserial_ctx_t* ctx, uint64_t* values) {
+	BSERIAL_CHECK_STATUS(ctx->status);
 
-	switch ((bserial_marker_t)marker) {
-		case BSERIAL_UINT:
-			{
-				uint64_t u64;
-				BSERIAL_CHECK_STATUS(bserial_uint(ctx, &u64));
+	if (ctx->scope->type != BSERIAL_SCOPE_UINT_ARRAY) {
+		return bserial_malformed(ctx);
+	}
+
+	uint64_t len = ctx->scope->len;
+	bool reading = bserial_mode(ctx) == BSERIAL_MODE_READ;
+	for (uint64_t i = 0; i < len; i += BSERIAL_UINT_BLOCK_SIZE) {
+		size_t count = len - i < BSERIAL_UINT_BLOCK_SIZE ? (size_t)(len - i) : BSERIAL_UINT_BLOCK_SIZE;
+		if (reading) {
+			size_t block_size;
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint_block(ctx->in, values + i, count, &block_size));
+		} else {
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint_block(ctx->out, values + i, count));
+		}
+	}
+
+	return bserial_end_op(ctx, BSERIAL_OP_UINT_ARRAY);
+}
+
+static inline uint64_t
+bserial_zigzag(int64_t x) {
+	uint64_t ux = (uint64_t)x << 1;
+	return x < 0 ? ~ux : ux;
+}
+
+static inline int64_t
+bserial_unzigzag(uint64_t ux) {
+	int64_t x = (int64_t)(ux >> 1);
+	return (ux & 1) != 0 ? ~x : x;
+}
+
+// Integers of a block in the form they are packed
+static inline void
+bserial_column_pack(
+	bserial_column_encoding_t encoding,
+	const void* values,
+	uint64_t start,
+	size_t count,
+	uint64_t* out
+) {
+	const uint64_t* uvalues = (const uint64_t*)values + start;
+	const int64_t* svalues = (const int64_t*)values + start;
+	switch (encoding) {
+		case BSERIAL_COLUMN_SINT:
+			for (size_t i = 0; i < count; ++i) {
+				out[i] = bserial_zigzag(svalues[i]);
 			}
 			break;
-		case BSERIAL_SINT:
-			{
-				int64_t s64;
-				BSERIAL_CHECK_STATUS(bserial_sint(ctx, &s64));
+		case BSERIAL_COLUMN_SINT_DELTA:
+			for (size_t i = 0; i < count; ++i) {
+				uint64_t prev = start + i > 0 ? uvalues[(ptrdiff_t)i - 1] : 0;
+				out[i] = bserial_zigzag((int64_t)(uvalues[i] - prev));
 			}
 			break;
-		case BSERIAL_F32:
-			{
-				bserial_discard_marker(ctx);
-				BSERIAL_CHECK_STATUS(ctx->status = bserial_skip(ctx->in, sizeof(float)));
-			}
+		default:
+			memcpy(out, uvalues, sizeof(uint64_t) * count);
+			break;
+	}
+}
+
+static inline bserial_status_t
+bserial_read_column_header(
+	bserial_ctx_t* ctx,
+	uint8_t* encoding,
+	uint64_t* len,
+	uint64_t* size
+) {
+	uint8_t marker;
+	BSERIAL_CHECK_STATUS(bserial_read_marker(ctx, &marker));
+	if (marker != BSERIAL_COLUMN) { return bserial_malformed(ctx); }
+
+	BSERIAL_CHECK_STATUS(ctx->status = bserial_read(ctx->in, encoding, sizeof(*encoding)));
+	BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(len, ctx->in));
+	BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(size, ctx->in));
+	return BSERIAL_OK;
+}
+
+static inline bserial_status_t
+bserial_write_column_header(
+	bserial_ctx_t* ctx,
+	uint8_t encoding,
+	uint64_t len,
+	uint64_t size
+) {
+	uint8_t header[2] = { BSERIAL_COLUMN, encoding };
+	BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, header, sizeof(header)));
+	BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint(len, ctx->out));
+	BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint(size, ctx->out));
+	return BSERIAL_OK;
+}
+
+static inline bserial_status_t
+bserial_int_column(
+	bserial_ctx_t* ctx,
+	uint64_t* values,
+	uint64_t* len,
+	bserial_column_encoding_t encoding
+) {
+	BSERIAL_CHECK_STATUS(bserial_begin_op(ctx, BSERIAL_OP_COLUMN));
+
+	uint64_t block[BSERIAL_UINT_BLOCK_SIZE];
+	if (bserial_mode(ctx) == BSERIAL_MODE_READ) {
+		uint8_t actual_encoding;
+		uint64_t actual_len;
+		uint64_t size;
+		BSERIAL_CHECK_STATUS(bserial_read_column_header(ctx, &actual_encoding, &actual_len, &size));
+		bool compatible = encoding == BSERIAL_COLUMN_UINT
+			? actual_encoding == BSERIAL_COLUMN_UINT
+			: actual_encoding == BSERIAL_COLUMN_SINT || actual_encoding == BSERIAL_COLUMN_SINT_DELTA;
+		if (!compatible || actual_len > *len) { return bserial_malformed(ctx); }
+		*len = actual_len;
+
+		uint64_t actual_size = 0;
+		for (uint64_t i = 0; i < actual_len; i += BSERIAL_UINT_BLOCK_SIZE) {
+			size_t count = actual_len - i < BSERIAL_UINT_BLOCK_SIZE ? (size_t)(actual_len - i) : BSERIAL_UINT_BLOCK_SIZE;
+			size_t block_size;
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint_block(ctx->in, values + i, count, &block_size));
+			actual_size += block_size;
+		}
+		if (actual_size != size) { return bserial_malformed(ctx); }
+
+		if (actual_encoding == BSERIAL_COLUMN_SINT) {
+			for (uint64_t i = 0; i < actual_len; ++i) {
+				values[i] = (uint64_t)bserial_unzigzag(values[i]);
+			}
+		} else if (actual_encoding == BSERIAL_COLUMN_SINT_DELTA) {
+			uint64_t prev = 0;
+			for (uint64_t i = 0; i < actual_len; ++i) {
+				values[i] = prev += (uint64_t)bserial_unzigzag(values[i]);
+			}
+		}
+	} else {
+		// The size must be known before the data so blocks are packed twice
+		uint64_t size = 0;
+		for (uint64_t i = 0; i < *len; i += BSERIAL_UINT_BLOCK_SIZE) {
+			size_t count = *len - i < BSERIAL_UINT_BLOCK_SIZE ? (size_t)(*len - i) : BSERIAL_UINT_BLOCK_SIZE;
+			bserial_column_pack(encoding, values, i, count, block);
+			size += bserial_uint_block_size(block, count);
+		}
+
+		BSERIAL_CHECK_STATUS(bserial_write_column_header(ctx, (uint8_t)encoding, *len, size));
+		for (uint64_t i = 0; i < *len; i += BSERIAL_UINT_BLOCK_SIZE) {
+			size_t count = *len - i < BSERIAL_UINT_BLOCK_SIZE ? (size_t)(*len - i) : BSERIAL_UINT_BLOCK_SIZE;
+			bserial_column_pack(encoding, values, i, count, block);
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint_block(ctx->out, block, count));
+		}
+	}
+
+	return bserial_end_op(ctx, BSERIAL_OP_COLUMN);
+}
+
+bserial_status_t
+bserial_uint_column(bserial_ctx_t* ctx, uint64_t* values, uint64_t* len) {
+	return bserial_int_column(ctx, values, len, BSERIAL_COLUMN_UINT);
+}
+
+bserial_status_t
+bserial_sint_column(bserial_ctx_t* ctx, int64_t* values, uint64_t* len, bool delta) {
+	return bserial_int_column(
+		ctx,
+		(uint64_t*)values,
+		len,
+		delta ? BSERIAL_COLUMN_SINT_DELTA : BSERIAL_COLUMN_SINT
+	);
+}
+
+bserial_status_t
+bserial_f32_column(bserial_ctx_t* ctx, float* values, uint64_t* len) {
+	BSERIAL_CHECK_STATUS(bserial_begin_op(ctx, BSERIAL_OP_COLUMN));
+
+	if (bserial_mode(ctx) == BSERIAL_MODE_READ) {
+		uint8_t encoding;
+		uint64_t actual_len;
+		uint64_t size;
+		BSERIAL_CHECK_STATUS(bserial_read_column_header(ctx, &encoding, &actual_len, &size));
+		if (
+			encoding != BSERIAL_COLUMN_F32
+			|| actual_len > *len
+			|| size != actual_len * sizeof(float)
+		) {
+			return bserial_malformed(ctx);
+		}
+		*len = actual_len;
+
+		for (uint64_t i = 0; i < actual_len; ++i) {
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_read_f32(&values[i], ctx->in));
+		}
+	} else {
+		BSERIAL_CHECK_STATUS(bserial_write_column_header(ctx, BSERIAL_COLUMN_F32, *len, *len * sizeof(float)));
+		for (uint64_t i = 0; i < *len; ++i) {
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write_f32(values[i], ctx->out));
+		}
+	}
+
+	return bserial_end_op(ctx, BSERIAL_OP_COLUMN);
+}
+
+bserial_status_t
+bserial_f64_column(bserial_ctx_t* ctx, double* values, uint64_t* len) {
+	BSERIAL_CHECK_STATUS(bserial_begin_op(ctx, BSERIAL_OP_COLUMN));
+
+	if (bserial_mode(ctx) == BSERIAL_MODE_READ) {
+		uint8_t encoding;
+		uint64_t actual_len;
+		uint64_t size;
+		BSERIAL_CHECK_STATUS(bserial_read_column_header(ctx, &encoding, &actual_len, &size));
+		if (
+			encoding != BSERIAL_COLUMN_F64
+			|| actual_len > *len
+			|| size != actual_len * sizeof(double)
+		) {
+			return bserial_malformed(ctx);
+		}
+		*len = actual_len;
+
+		for (uint64_t i = 0; i < actual_len; ++i) {
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_read_f64(&values[i], ctx->in));
+		}
+	} else {
+		BSERIAL_CHECK_STATUS(bserial_write_column_header(ctx, BSERIAL_COLUMN_F64, *len, *len * sizeof(double)));
+		for (uint64_t i = 0; i < *len; ++i) {
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write_f64(values[i], ctx->out));
+		}
+	}
+
+	return bserial_end_op(ctx, BSERIAL_OP_COLUMN);
+}
+
+static inline bserial_status_t
+bserial_skip_next(bserial_ctx_t* ctx, uint32_t depth) {
+	uint8_t marker;
+	BSERIAL_CHECK_STATUS(bserial_peek_marker(ctx, &marker));
+
+	switch ((bserial_marker_t)marker) {
+		case BSERIAL_UINT:
+			{
+				uint64_t u64;
+				BSERIAL_CHECK_STATUS(bserial_uint(ctx, &u64));
+			}
+			break;
+		case BSERIAL_SINT:
+			{
+				int64_t s64;
+				BSERIAL_CHECK_STATUS(bserial_sint(ctx, &s64));
+			}
+			break;
+		case BSERIAL_F32:
+			{
+				bserial_discard_marker(ctx);
+				BSERIAL_CHECK_STATUS(ctx->status = bserial_skip(ctx->in, sizeof(float)));
+			}
 			break;
 		case BSERIAL_F64:
 			{
@@ -1339,6 +2497,23 @@ bserial_skip_next(bserial_ctx_t* ctx, uint32_t depth) {
 				BSERIAL_CHECK_STATUS(ctx->status = bserial_skip(ctx->in, len));
 			}
 			break;
+		case BSERIAL_UINT_ARRAY:
+			{
+				bserial_discard_marker(ctx);
+				uint64_t len;
+				BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(&len, ctx->in));
+				BSERIAL_CHECK_STATUS(ctx->status = bserial_skip_uint_array(ctx->in, len));
+			}
+			break;
+		case BSERIAL_COLUMN:
+			{
+				uint8_t encoding;
+				uint64_t len;
+				uint64_t size;
+				BSERIAL_CHECK_STATUS(bserial_read_column_header(ctx, &encoding, &len, &size));
+				BSERIAL_CHECK_STATUS(ctx->status = bserial_skip(ctx->in, size));
+			}
+			break;
 		case BSERIAL_SYM_DEF:
 		case BSERIAL_SYM_REF:
 			{
@@ -1435,87 +2610,121 @@ bserial_probe_next_record_field(bserial_ctx_t* ctx) {
 	return false;
 }
 
+static inline bserial_status_t
+bserial_read_symbol(bserial_ctx_t* ctx, const char** buf, uint64_t* len, uint32_t* id) {
+	uint8_t marker;
+	BSERIAL_CHECK_STATUS(bserial_read_marker(ctx, &marker));
+
+	if (marker == BSERIAL_SYM_DEF) {
+		if (ctx->num_symbols >= ctx->config.max_num_symbols) { return bserial_malformed(ctx); }
+
+		uint64_t symbol_len;
+		BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(&symbol_len, ctx->in));
+		if (symbol_len > ctx->config.max_symbol_len) { return bserial_malformed(ctx); }
+
+		BSERIAL_CHECK_STATUS(ctx->status = bserial_read(ctx->in, ctx->strpool, symbol_len));
+		ctx->strpool[symbol_len] = '\0';
+
+		// Index it so that bserial_key can find it by name
+		int32_t slot;
+		if (bserial_find_symbol(ctx, ctx->strpool, symbol_len, &slot) == 0) {
+			ctx->symtab_index[slot] = ctx->num_symbols + 1;
+		}
+
+		ctx->symtab[ctx->num_symbols] = (bserial_symbol_t){
+			.buf = ctx->strpool,
+			.len = symbol_len,
+			.field_index = BSERIAL_NO_FIELD,
+		};
+
+		*buf = ctx->strpool;
+		*len = symbol_len;
+		*id = ctx->num_symbols;
+
+		ctx->num_symbols += 1;
+		ctx->strpool += (symbol_len + 1);
+	} else if (marker == BSERIAL_SYM_REF) {
+		uint64_t symbol_id;
+		BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(&symbol_id, ctx->in));
+		if (symbol_id >= ctx->num_symbols) { return bserial_malformed(ctx); }
+
+		*buf = ctx->symtab[symbol_id].buf;
+		*len = ctx->symtab[symbol_id].len;
+		*id = (uint32_t)symbol_id;
+	} else {
+		return bserial_malformed(ctx);
+	}
+
+	return BSERIAL_OK;
+}
+
 bserial_status_t
 bserial_symbol(bserial_ctx_t* ctx, const char** buf, uint64_t* len) {
 	BSERIAL_CHECK_STATUS(bserial_begin_op(ctx, BSERIAL_OP_SYMBOL));
 
 	if (bserial_mode(ctx) == BSERIAL_MODE_READ) {
-		uint8_t marker;
-		BSERIAL_CHECK_STATUS(bserial_read_marker(ctx, &marker));
-
-		if (marker == BSERIAL_SYM_DEF) {
-			if (ctx->num_symbols >= ctx->config.max_num_symbols) { return bserial_malformed(ctx); }
-
-			uint64_t symbol_len;
-			BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(&symbol_len, ctx->in));
-			if (symbol_len > ctx->config.max_symbol_len) { return bserial_malformed(ctx); }
+		uint32_t id;
+		BSERIAL_CHECK_STATUS(bserial_read_symbol(ctx, buf, len, &id));
+	} else {
+		uint64_t symbol_len = *len;
+		if (symbol_len > ctx->config.max_symbol_len) { return bserial_malformed(ctx); }
 
-			BSERIAL_CHECK_STATUS(ctx->status = bserial_read(ctx->in, ctx->strpool, symbol_len));
+		int32_t slot;
+		int32_t index = bserial_find_symbol(ctx, *buf, symbol_len, &slot);
+		if (index == 0) {
+			if (ctx->num_symbols >= ctx->config.max_num_symbols) {
+				return bserial_malformed(ctx);
+			}
+			memcpy(ctx->strpool, *buf, symbol_len);
 			ctx->strpool[symbol_len] = '\0';
 
 			ctx->symtab[ctx->num_symbols] = (bserial_symbol_t){
 				.buf = ctx->strpool,
 				.len = symbol_len,
 			};
-
-			*buf = ctx->strpool;
-			*len = symbol_len;
-
+			ctx->symtab_index[slot] = ctx->num_symbols + 1;
 			ctx->num_symbols += 1;
 			ctx->strpool += (symbol_len + 1);
-		} else if (marker == BSERIAL_SYM_REF) {
-			uint64_t symbol_id;
-			BSERIAL_CHECK_STATUS(ctx->status = bserial_read_uint(&symbol_id, ctx->in));
-			if (symbol_id >= ctx->num_symbols) { return bserial_malformed(ctx); }
 
-			*buf = ctx->symtab[symbol_id].buf;
-			*len = ctx->symtab[symbol_id].len;
+			uint8_t marker = BSERIAL_SYM_DEF;
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, &marker, sizeof(marker)));
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint(symbol_len, ctx->out));
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, *buf, symbol_len));
 		} else {
-			return bserial_malformed(ctx);
+			uint8_t marker = BSERIAL_SYM_REF;
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, &marker, sizeof(marker)));
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint((uint64_t)index - 1, ctx->out));
 		}
-	} else {
-		uint64_t symbol_len = *len;
-		if (symbol_len > ctx->config.max_symbol_len) { return bserial_malformed(ctx); }
+	}
 
-		uint64_t symbol_hash = bserial_hash(*buf, symbol_len);
-		for (int32_t i = (int32_t)symbol_hash;;) {
-			i = bserial_lookup_index(symbol_hash, ctx->symtab_exp, i);
-			int32_t index = ctx->symtab_index[i];
-			if (index == 0) {
-				if (ctx->num_symbols >= ctx->config.max_num_symbols) {
-					return bserial_malformed(ctx);
-				}
-				memcpy(ctx->strpool, *buf, symbol_len);
-				ctx->strpool[symbol_len] = '\0';
-
-				ctx->symtab[ctx->num_symbols] = (bserial_symbol_t){
-					.buf = ctx->strpool,
-					.len = symbol_len,
-				};
-				ctx->symtab_index[i] = ctx->num_symbols + 1;
-				ctx->num_symbols += 1;
-				ctx->strpool += (symbol_len + 1);
-
-				uint8_t marker = BSERIAL_SYM_DEF;
-				BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, &marker, sizeof(marker)));
-				BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint(symbol_len, ctx->out));
-				BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, *buf, symbol_len));
+	return bserial_end_op(ctx, BSERIAL_OP_SYMBOL);
+}
 
-				break;
-			} else if (
-				ctx->symtab[index - 1].len == symbol_len
-				&& memcmp(ctx->symtab[index - 1].buf, *buf, symbol_len) == 0
-			) {
-				uint8_t marker = BSERIAL_SYM_REF;
-				BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, &marker, sizeof(marker)));
-				BSERIAL_CHECK_STATUS(ctx->status = bserial_write_uint((uint64_t)index - 1, ctx->out));
+bserial_status_t
+bserial_symbol_dict(bserial_ctx_t* ctx, const char* const* symbols, uint32_t num_symbols) {
+	BSERIAL_CHECK_STATUS(ctx->status);
+	if (ctx->num_symbols > 0 || num_symbols > ctx->config.max_num_symbols) {
+		return bserial_malformed(ctx);
+	}
 
-				break;
-			}
-		}
+	for (uint32_t i = 0; i < num_symbols; ++i) {
+		size_t symbol_len = strlen(symbols[i]);
+		if (symbol_len > ctx->config.max_symbol_len) { return bserial_malformed(ctx); }
+
+		memcpy(ctx->strpool, symbols[i], symbol_len + 1);
+		ctx->symtab[i] = (bserial_symbol_t){
+			.buf = ctx->strpool,
+			.len = symbol_len,
+			.field_index = BSERIAL_NO_FIELD,
+		};
+		ctx->strpool += symbol_len + 1;
 	}
 
-	return bserial_end_op(ctx, BSERIAL_OP_SYMBOL);
+	ctx->num_dict_symbols = num_symbols;
+	ctx->strpool_dict = ctx->strpool;
+	bserial_reset_symbols(ctx);
+
+	return BSERIAL_OK;
 }
 
 bserial_status_t
@@ -1614,13 +2823,24 @@ bserial_record(bserial_ctx_t* ctx, void* record) {
 				for (uint64_t i = 0; i < num_fields; ++i) {
 					const char* symbol;
 					uint64_t symbol_len;
+					uint32_t symbol_id;
 					scope->iterator = i;
-					if (bserial_symbol(ctx, &symbol, &symbol_len) != BSERIAL_OK) {
+					if (bserial_read_symbol(ctx, &symbol, &symbol_len, &symbol_id) != BSERIAL_OK) {
 						return false;
 					}
 
+					// Link the symbol to this field so bserial_key does not
+					// have to search the schema.
+					// field_index may be left over from another schema.
+					uint32_t prev_field = ctx->symtab[symbol_id].field_index;
+					if (prev_field >= i || schema_scope->record_schema[prev_field].symbol != symbol) {
+						prev_field = BSERIAL_NO_FIELD;
+					}
+					ctx->symtab[symbol_id].field_index = (uint32_t)i;
+
 					schema_scope->record_schema[i].symbol = symbol;
 					schema_scope->record_schema[i].symbol_len = symbol_len;
+					schema_scope->record_schema[i].prev_field = prev_field;
 				}
 				scope->iterator = 0;
 			} else {
@@ -1694,12 +2914,18 @@ bserial_key(bserial_ctx_t* ctx, const char* name, uint64_t len) {
 	if (bserial_mode(ctx) == BSERIAL_MODE_READ) {
 		switch (scope->record_mode) {
 			case BSERIAL_RECORD_KEY_IO:
-				for (uint64_t i = 0; i < scope->len; ++i) {
-					if (
-						scope->record_schema[i].symbol_len == len
-						&& strncmp(scope->record_schema[i].symbol, name, len) == 0
-					) {
-						scope->record_schema[i].field_name = name;
+				{
+					int32_t slot;
+					int32_t index = bserial_find_symbol(ctx, name, len, &slot);
+					if (index != 0) {
+						const bserial_symbol_t* symbol = &ctx->symtab[index - 1];
+						for (
+							uint32_t i = symbol->field_index;
+							i < scope->len && scope->record_schema[i].symbol == symbol->buf;
+							i = scope->record_schema[i].prev_field
+						) {
+							scope->record_schema[i].field_name = name;
+						}
 					}
 				}
 				++scope->iterator;
@@ -1734,6 +2960,100 @@ bserial_key(bserial_ctx_t* ctx, const char* name, uint64_t len) {
 	}
 }
 
+#define BSERIAL_INDEX_MAGIC "BSERIDX"
+#define BSERIAL_INDEX_FOOTER_SIZE (sizeof(uint64_t) + sizeof(BSERIAL_INDEX_MAGIC))
+
+bserial_status_t
+bserial_sync_point(bserial_ctx_t* ctx, uint64_t* offset) {
+	BSERIAL_CHECK_STATUS(ctx->status);
+
+	bserial_scope_t* scope = ctx->scope;
+	if (
+		!(scope->type == BSERIAL_SCOPE_ROOT
+		  || scope->type == BSERIAL_SCOPE_ARRAY
+		  || (scope->type == BSERIAL_SCOPE_RECORD && scope->record_mode == BSERIAL_RECORD_VALUE_IO))
+	) {
+		return bserial_malformed(ctx);
+	}
+
+	// The reader resets its symbol table upon reading the marker
+	if (bserial_mode(ctx) == BSERIAL_MODE_READ) { return BSERIAL_OK; }
+
+	if (ctx->out->tell == NULL || !ctx->out->tell(ctx->out, offset)) {
+		return ctx->status = BSERIAL_IO_ERROR;
+	}
+
+	uint8_t marker = BSERIAL_SYM_RESET;
+	BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, &marker, sizeof(marker)));
+	bserial_reset_symbols(ctx);
+
+	return BSERIAL_OK;
+}
+
+bserial_status_t
+bserial_seek(bserial_ctx_t* ctx, uint64_t offset) {
+	if (bserial_mode(ctx) != BSERIAL_MODE_READ) { return bserial_malformed(ctx); }
+	if (ctx->in->seek == NULL) { return ctx->status = BSERIAL_IO_ERROR; }
+
+	ctx->status = BSERIAL_OK;
+	ctx->scope = ctx->scope_first;
+	ctx->schema_pool = ctx->schema_pool_first;
+	ctx->marker_buf = BSERIAL_NO_MARKER;
+	bserial_reset_symbols(ctx);
+
+	return ctx->status = ctx->in->seek(ctx->in, offset, false) ? BSERIAL_OK : BSERIAL_IO_ERROR;
+}
+
+bserial_status_t
+bserial_write_index(bserial_ctx_t* ctx, const uint64_t* offsets, uint64_t len) {
+	BSERIAL_CHECK_STATUS(ctx->status);
+	if (bserial_mode(ctx) != BSERIAL_MODE_WRITE) { return bserial_malformed(ctx); }
+	if (ctx->scope->type != BSERIAL_SCOPE_ROOT) { return bserial_malformed(ctx); }
+
+	uint8_t buf[BSERIAL_INDEX_FOOTER_SIZE];
+	for (uint64_t i = 0; i < len; ++i) {
+		bserial_store64le(buf, offsets[i]);
+		BSERIAL_CHECK_STATUS(ctx->status = bserial_write(ctx->out, buf, sizeof(uint64_t)));
+	}
+
+	bserial_store64le(buf, len);
+	memcpy(buf + sizeof(uint64_t), BSERIAL_INDEX_MAGIC, sizeof(BSERIAL_INDEX_MAGIC));
+	return ctx->status = bserial_write(ctx->out, buf, sizeof(buf));
+}
+
+bserial_status_t
+bserial_read_index(bserial_ctx_t* ctx, uint64_t* offsets, uint64_t* len) {
+	BSERIAL_CHECK_STATUS(ctx->status);
+	if (bserial_mode(ctx) != BSERIAL_MODE_READ) { return bserial_malformed(ctx); }
+	if (ctx->in->seek == NULL) { return ctx->status = BSERIAL_IO_ERROR; }
+
+	uint8_t buf[BSERIAL_INDEX_FOOTER_SIZE];
+	if (!ctx->in->seek(ctx->in, sizeof(buf), true)) { return ctx->status = BSERIAL_IO_ERROR; }
+	BSERIAL_CHECK_STATUS(ctx->status = bserial_read(ctx->in, buf, sizeof(buf)));
+	if (memcmp(buf + sizeof(uint64_t), BSERIAL_INDEX_MAGIC, sizeof(BSERIAL_INDEX_MAGIC)) != 0) {
+		return bserial_malformed(ctx);
+	}
+
+	uint64_t num_offsets = bserial__load_u64le(buf);
+	if (num_offsets > (UINT64_MAX - sizeof(buf)) / sizeof(uint64_t)) {
+		return bserial_malformed(ctx);
+	}
+
+	if (offsets != NULL) {
+		if (num_offsets > *len) { return bserial_malformed(ctx); }
+
+		uint64_t index_size = num_offsets * sizeof(uint64_t) + sizeof(buf);
+		if (!ctx->in->seek(ctx->in, index_size, true)) { return ctx->status = BSERIAL_IO_ERROR; }
+		for (uint64_t i = 0; i < num_offsets; ++i) {
+			BSERIAL_CHECK_STATUS(ctx->status = bserial_read(ctx->in, buf, sizeof(uint64_t)));
+			offsets[i] = bserial__load_u64le(buf);
+		}
+	}
+
+	*len = num_offsets;
+	return BSERIAL_OK;
+}
+
 #if defined(__GNUC__) || defined(__clang__)
 __attribute__((format(printf, 4, 5)))
 #endif
@@ -1775,12 +3095,212 @@ bserial_trace(bserial_ctx_t* ctx, bserial_tracer_t tracer, void* userdata) {
 			case BSERIAL_SCOPE_BLOB:
 				bserial_tracef(tracer, userdata, depth, "Blob(%" PRIu64 ")", scope->len);
 				break;
+			case BSERIAL_SCOPE_UINT_ARRAY:
+				bserial_tracef(tracer, userdata, depth, "UintArray(%" PRIu64 ")", scope->len);
+				break;
+		}
+	}
+}
+
+#ifdef BSERIAL_THREADS
+
+#include <threads.h>
+
+typedef struct {
+	const bserial_decode_chunks_options_t* options;
+	const uint64_t* offsets;
+	uint64_t num_chunks;
+
+	uint32_t index;
+	bserial_ctx_t* ctx;
+	thrd_t thread;
+	mtx_t mtx;
+	cnd_t cnd;
+
+	// Guarded by mtx
+	bool ready;
+	bool stop;
+	bserial_status_t status;
+} bserial_decode_worker_t;
+
+static inline size_t
+bserial_decode_chunks_mem_layout(
+	void* mem,
+	uint32_t num_threads,
+	bserial_ctx_config_t ctx_config,
+	bserial_decode_worker_t** workers
+) {
+	mem_layout_t layout = { 0 };
+	ptrdiff_t workers_offset = mem_layout_reserve(
+		&layout,
+		sizeof(bserial_decode_worker_t) * num_threads,
+		_Alignof(bserial_decode_worker_t)
+	);
+	if (mem) {
+		*workers = mem_layout_locate(mem, workers_offset);
+	}
+
+	size_t ctx_size = bserial_ctx_mem_size(ctx_config);
+	for (uint32_t i = 0; i < num_threads; ++i) {
+		ptrdiff_t ctx = mem_layout_reserve(&layout, ctx_size, _Alignof(max_align_t));
+
+		if (mem) {
+			(*workers)[i].ctx = mem_layout_locate(mem, ctx);
 		}
 	}
+
+	return mem_layout_size(&layout);
+}
+
+static int
+bserial_decode_worker(void* userdata) {
+	bserial_decode_worker_t* worker = userdata;
+	const bserial_decode_chunks_options_t* options = worker->options;
+
+	for (
+		uint64_t chunk = worker->index;
+		chunk < worker->num_chunks;
+		chunk += options->num_threads
+	) {
+		bserial_status_t status = bserial_seek(worker->ctx, worker->offsets[chunk]);
+		if (status == BSERIAL_OK) {
+			status = options->decode(worker->ctx, worker->index, chunk, options->userdata);
+		}
+
+		// Wait for the chunk to be delivered since its data is in a buffer
+		// dedicated to this thread
+		mtx_lock(&worker->mtx);
+		worker->status = status;
+		worker->ready = true;
+		cnd_signal(&worker->cnd);
+		while (worker->ready && !worker->stop) {
+			cnd_wait(&worker->cnd, &worker->mtx);
+		}
+		bool stop = worker->stop;
+		mtx_unlock(&worker->mtx);
+
+		if (stop || status != BSERIAL_OK) { break; }
+	}
+
+	return 0;
+}
+
+size_t
+bserial_decode_chunks_mem_size(uint32_t num_threads, bserial_ctx_config_t ctx_config) {
+	return bserial_decode_chunks_mem_layout(NULL, num_threads, ctx_config, NULL);
+}
+
+bserial_status_t
+bserial_decode_chunks(
+	void* mem,
+	const bserial_decode_chunks_options_t* options,
+	const uint64_t* offsets,
+	uint64_t num_chunks
+) {
+	uint32_t num_threads = options->num_threads;
+	if (num_threads == 0) { return BSERIAL_IO_ERROR; }
+
+	bserial_decode_worker_t* workers = NULL;
+	bserial_decode_chunks_mem_layout(mem, num_threads, options->ctx_config, &workers);
+
+	bserial_status_t status = BSERIAL_OK;
+	uint32_t num_started = 0;
+	for (; num_started < num_threads; ++num_started) {
+		bserial_decode_worker_t* worker = &workers[num_started];
+		worker->options = options;
+		worker->offsets = offsets;
+		worker->num_chunks = num_chunks;
+		worker->index = num_started;
+		worker->ready = false;
+		worker->stop = false;
+		worker->status = BSERIAL_OK;
+		worker->ctx = bserial_make_ctx(
+			worker->ctx,
+			options->ctx_config,
+			options->streams[num_started],
+			NULL
+		);
+		if (options->num_symbols > 0) {
+			status = bserial_symbol_dict(worker->ctx, options->symbols, options->num_symbols);
+			if (status != BSERIAL_OK) { break; }
+		}
+
+		if (mtx_init(&worker->mtx, mtx_plain) != thrd_success) {
+			status = BSERIAL_IO_ERROR;
+			break;
+		}
+		if (cnd_init(&worker->cnd) != thrd_success) {
+			mtx_destroy(&worker->mtx);
+			status = BSERIAL_IO_ERROR;
+			break;
+		}
+		if (thrd_create(&worker->thread, bserial_decode_worker, worker) != thrd_success) {
+			cnd_destroy(&worker->cnd);
+			mtx_destroy(&worker->mtx);
+			status = BSERIAL_IO_ERROR;
+			break;
+		}
+	}
+
+	for (uint64_t chunk = 0; status == BSERIAL_OK && chunk < num_chunks; ++chunk) {
+		bserial_decode_worker_t* worker = &workers[chunk % num_threads];
+
+		mtx_lock(&worker->mtx);
+		while (!worker->ready) {
+			cnd_wait(&worker->cnd, &worker->mtx);
+		}
+		status = worker->status;
+		mtx_unlock(&worker->mtx);
+
+		if (status == BSERIAL_OK) {
+			status = options->deliver(worker->index, chunk, options->userdata);
+		}
+
+		mtx_lock(&worker->mtx);
+		worker->ready = false;
+		cnd_signal(&worker->cnd);
+		mtx_unlock(&worker->mtx);
+	}
+
+	for (uint32_t i = 0; i < num_started; ++i) {
+		bserial_decode_worker_t* worker = &workers[i];
+
+		mtx_lock(&worker->mtx);
+		worker->stop = true;
+		cnd_signal(&worker->cnd);
+		mtx_unlock(&worker->mtx);
+
+		thrd_join(worker->thread, NULL);
+		cnd_destroy(&worker->cnd);
+		mtx_destroy(&worker->mtx);
+	}
+
+	return status;
 }
 
+#endif
+
 #ifdef BSERIAL_STDIO
 
+#if defined(_WIN32)
+#	define BSERIAL_OFF_T int64_t
+#	define BSERIAL_FSEEK(file, offset, origin) _fseeki64(file, offset, origin)
+#	define BSERIAL_FTELL(file) _ftelli64(file)
+#else
+#	include <sys/types.h>
+// off_t is only 64 bits on 32-bit platforms with _FILE_OFFSET_BITS=64
+#	define BSERIAL_OFF_T off_t
+#	define BSERIAL_FSEEK(file, offset, origin) fseeko(file, offset, origin)
+#	define BSERIAL_FTELL(file) ftello(file)
+#endif
+
+static inline bool
+bserial_stdio_fseek(FILE* file, int64_t offset, int origin) {
+	if ((int64_t)(BSERIAL_OFF_T)offset != offset) { return false; }
+
+	return BSERIAL_FSEEK(file, (BSERIAL_OFF_T)offset, origin) == 0;
+}
+
 static inline size_t
 bserial_stdio_read(bserial_in_t* in, void* buf, size_t size) {
 	return fread(buf, size, 1, ((bserial_stdio_in_t*)in)->file) == 1 ? size : 0;
@@ -1788,7 +3308,21 @@ bserial_stdio_read(bserial_in_t* in, void* buf, size_t size) {
 
 static inline bool
 bserial_stdio_skip(bserial_in_t* in, size_t size) {
-	return fseek(((bserial_stdio_in_t*)in)->file, (long)size, SEEK_CUR) == 0;
+	if ((uint64_t)size > (uint64_t)INT64_MAX) { return false; }
+
+	return bserial_stdio_fseek(((bserial_stdio_in_t*)in)->file, (int64_t)size, SEEK_CUR);
+}
+
+static inline bool
+bserial_stdio_seek(bserial_in_t* in, uint64_t offset, bool from_end) {
+	if (offset > (uint64_t)INT64_MAX) { return false; }
+
+	in->buf_cur = in->buf_end = NULL;
+	return bserial_stdio_fseek(
+		((bserial_stdio_in_t*)in)->file,
+		from_end ? -(int64_t)offset : (int64_t)offset,
+		from_end ? SEEK_END : SEEK_SET
+	);
 }
 
 static inline size_t
@@ -1796,25 +3330,137 @@ bserial_stdio_write(bserial_out_t* out, const void* buf, size_t size) {
 	return fwrite(buf, size, 1, ((bserial_stdio_out_t*)out)->file) == 1 ? size : 0;
 }
 
+static inline size_t
+bserial_stdio_buffered_read(bserial_in_t* in, void* buf, size_t size) {
+	bserial_stdio_in_t* stdio_in = (bserial_stdio_in_t*)in;
+
+	// Whatever is left in the buffer comes first
+	size_t buffered = (size_t)(in->buf_end - in->buf_cur);
+	if (buffered > 0) {
+		size_t copy_size = buffered < size ? buffered : size;
+		memcpy(buf, in->buf_cur, copy_size);
+		in->buf_cur += copy_size;
+		return copy_size;
+	}
+
+	if (size >= stdio_in->buffer_size) {
+		return fread(buf, 1, size, stdio_in->file);
+	}
+
+	size_t bytes_read = fread(stdio_in->buffer, 1, stdio_in->buffer_size, stdio_in->file);
+	size_t copy_size = bytes_read < size ? bytes_read : size;
+	memcpy(buf, stdio_in->buffer, copy_size);
+	in->buf_cur = stdio_in->buffer + copy_size;
+	in->buf_end = stdio_in->buffer + bytes_read;
+	return copy_size;
+}
+
+static inline bool
+bserial_stdio_buffered_skip(bserial_in_t* in, size_t size) {
+	// bserial_skip has already consumed the buffer
+	in->buf_cur = in->buf_end;
+	return bserial_stdio_skip(in, size);
+}
+
+static inline bool
+bserial_stdio_tell(bserial_out_t* out, uint64_t* pos) {
+	bserial_stdio_out_t* stdio_out = (bserial_stdio_out_t*)out;
+
+	int64_t file_pos = BSERIAL_FTELL(stdio_out->file);
+	if (file_pos < 0) { return false; }
+
+	*pos = (uint64_t)file_pos;
+	if (stdio_out->buffer != NULL) {
+		*pos += (uint64_t)(out->buf_cur - stdio_out->buffer);
+	}
+	return true;
+}
+
+static inline bool
+bserial_stdio_flush_buffer(bserial_stdio_out_t* stdio_out) {
+	size_t pending = (size_t)(stdio_out->bserial.buf_cur - stdio_out->buffer);
+	stdio_out->bserial.buf_cur = stdio_out->buffer;
+	return pending == 0 || fwrite(stdio_out->buffer, pending, 1, stdio_out->file) == 1;
+}
+
+static inline size_t
+bserial_stdio_buffered_write(bserial_out_t* out, const void* buf, size_t size) {
+	bserial_stdio_out_t* stdio_out = (bserial_stdio_out_t*)out;
+
+	if (!bserial_stdio_flush_buffer(stdio_out)) { return 0; }
+
+	if (size >= stdio_out->buffer_size) {
+		return bserial_stdio_write(out, buf, size);
+	}
+
+	memcpy(out->buf_cur, buf, size);
+	out->buf_cur += size;
+	return size;
+}
+
 bserial_in_t*
 bserial_stdio_init_in(bserial_stdio_in_t* bserial_stdio, FILE* file) {
 	*bserial_stdio = (bserial_stdio_in_t) {
-		.bserial = {
-			.read = bserial_stdio_read,
-			.skip = bserial_stdio_skip,
-		},
 		.file = file,
 	};
-	return &bserial_stdio->bserial;
+	bserial_in_t* in = bserial_init_in(&bserial_stdio->bserial, bserial_stdio_read);
+	in->skip = bserial_stdio_skip;
+	in->seek = bserial_stdio_seek;
+	return in;
 }
 
 bserial_out_t*
 bserial_stdio_init_out(bserial_stdio_out_t* bserial_stdio, FILE* file) {
 	*bserial_stdio = (bserial_stdio_out_t) {
-		.bserial.write = bserial_stdio_write,
 		.file = file,
 	};
-	return &bserial_stdio->bserial;
+	bserial_out_t* out = bserial_init_out(&bserial_stdio->bserial, bserial_stdio_write);
+	out->tell = bserial_stdio_tell;
+	return out;
+}
+
+bserial_in_t*
+bserial_stdio_init_buffered_in(
+	bserial_stdio_in_t* bserial_stdio,
+	FILE* file,
+	void* buffer,
+	size_t buffer_size
+) {
+	*bserial_stdio = (bserial_stdio_in_t) {
+		.file = file,
+		.buffer = buffer,
+		.buffer_size = buffer_size,
+	};
+	bserial_in_t* in = bserial_init_in(&bserial_stdio->bserial, bserial_stdio_buffered_read);
+	in->skip = bserial_stdio_buffered_skip;
+	in->seek = bserial_stdio_seek;
+	return in;
+}
+
+bserial_out_t*
+bserial_stdio_init_buffered_out(
+	bserial_stdio_out_t* bserial_stdio,
+	FILE* file,
+	void* buffer,
+	size_t buffer_size
+) {
+	*bserial_stdio = (bserial_stdio_out_t) {
+		.file = file,
+		.buffer = buffer,
+		.buffer_size = buffer_size,
+	};
+	bserial_out_t* out = bserial_init_out(&bserial_stdio->bserial, bserial_stdio_buffered_write);
+	out->tell = bserial_stdio_tell;
+	out->buf_cur = buffer;
+	out->buf_end = (char*)buffer + buffer_size;
+	return out;
+}
+
+bserial_status_t
+bserial_stdio_flush(bserial_stdio_out_t* bserial_stdio) {
+	if (bserial_stdio->buffer == NULL) { return BSERIAL_OK; }
+
+	return bserial_stdio_flush_buffer(bserial_stdio) ? BSERIAL_OK : BSERIAL_IO_ERROR;
 }
 
 #endif
@@ -1871,6 +3517,31 @@ bserial_mem_skip(bserial_in_t* in, size_t size) {
 	}
 }
 
+static inline const void*
+bserial_mem_borrow(bserial_in_t* in, size_t size) {
+	bserial_mem_in_t* mem_in = (bserial_mem_in_t*)in;
+
+	if (size <= (size_t)(mem_in->end - mem_in->cur)) {
+		const void* view = mem_in->cur;
+		mem_in->cur += size;
+		return view;
+	} else {
+		return NULL;
+	}
+}
+
+static inline bool
+bserial_mem_seek(bserial_in_t* in, uint64_t offset, bool from_end) {
+	bserial_mem_in_t* mem_in = (bserial_mem_in_t*)in;
+
+	if (offset <= (uint64_t)(mem_in->end - mem_in->begin)) {
+		mem_in->cur = from_end ? mem_in->end - offset : mem_in->begin + offset;
+		return true;
+	} else {
+		return false;
+	}
+}
+
 static inline size_t
 bserial_mem_write(bserial_out_t* out, const void* buf, size_t size) {
 	bserial_mem_out_t* mem_out = (bserial_mem_out_t*)out;
@@ -1894,29 +3565,375 @@ bserial_mem_write(bserial_out_t* out, const void* buf, size_t size) {
 	return size;
 }
 
+static inline bool
+bserial_mem_tell(bserial_out_t* out, uint64_t* pos) {
+	*pos = ((bserial_mem_out_t*)out)->len;
+	return true;
+}
+
 bserial_in_t*
 bserial_mem_init_in(bserial_mem_in_t* bserial_mem, void* mem, size_t size) {
 	*bserial_mem = (bserial_mem_in_t){
-		.bserial = {
-			.read = bserial_mem_read,
-			.skip = bserial_mem_skip,
-		},
+		.begin = mem,
 		.cur = mem,
 		.end = (char*)mem + size,
 	};
-	return &bserial_mem->bserial;
+	bserial_in_t* in = bserial_init_in(&bserial_mem->bserial, bserial_mem_read);
+	in->skip = bserial_mem_skip;
+	in->borrow = bserial_mem_borrow;
+	in->seek = bserial_mem_seek;
+	return in;
 }
 
 bserial_out_t*
 bserial_mem_init_out(bserial_mem_out_t* bserial_mem, void* memctx) {
 	*bserial_mem = (bserial_mem_out_t){
-		.bserial.write = bserial_mem_write,
 		.len = 0,
 		.capacity = 0,
 		.mem = NULL,
 		.memctx = memctx,
 	};
-	return &bserial_mem->bserial;
+	bserial_out_t* out = bserial_init_out(&bserial_mem->bserial, bserial_mem_write);
+	out->tell = bserial_mem_tell;
+	return out;
+}
+
+#endif
+
+#ifdef BSERIAL_BLOCK
+
+#define BSERIAL_LZ_HASH_EXP 12
+#define BSERIAL_LZ_MIN_MATCH 4
+#define BSERIAL_LZ_MAX_OFFSET 65535
+
+static inline uint32_t
+bserial_lz_load32(const uint8_t* p) {
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint8_t*
+bserial_lz_write_len(uint8_t* op, uint8_t* op_end, size_t len) {
+	for (; len >= 255; len -= 255) {
+		if (op == op_end) { return NULL; }
+		*op++ = 255;
+	}
+
+	if (op == op_end) { return NULL; }
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+// A sequence is: a token with the literal length and match length in each
+// nibble, the literals, a 2-byte offset and the match length extension.
+// The last sequence only has literals.
+static inline uint8_t*
+bserial_lz_write_sequence(
+	uint8_t* op, uint8_t* op_end,
+	const uint8_t* literals, size_t num_literals,
+	size_t offset, size_t match_len
+) {
+	if (op == op_end) { return NULL; }
+	uint8_t* token = op++;
+	*token = (uint8_t)((num_literals < 15 ? num_literals : 15) << 4);
+	if (num_literals >= 15 && (op = bserial_lz_write_len(op, op_end, num_literals - 15)) == NULL) {
+		return NULL;
+	}
+
+	if ((size_t)(op_end - op) < num_literals) { return NULL; }
+	memcpy(op, literals, num_literals);
+	op += num_literals;
+
+	if (match_len > 0) {
+		size_t extra_len = match_len - BSERIAL_LZ_MIN_MATCH;
+		*token |= (uint8_t)(extra_len < 15 ? extra_len : 15);
+
+		if (op_end - op < 2) { return NULL; }
+		*op++ = (uint8_t)offset;
+		*op++ = (uint8_t)(offset >> 8);
+
+		if (extra_len >= 15 && (op = bserial_lz_write_len(op, op_end, extra_len - 15)) == NULL) {
+			return NULL;
+		}
+	}
+
+	return op;
+}
+
+static inline bool
+bserial_lz_read_len(const uint8_t** ip, const uint8_t* ip_end, size_t* len) {
+	uint8_t byte;
+	do {
+		if (*ip == ip_end) { return false; }
+		byte = *(*ip)++;
+		*len += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+static size_t
+bserial_lz_compress(
+	void* userdata,
+	const void* src, size_t src_size,
+	void* dst, size_t dst_capacity
+) {
+	(void)userdata;
+	if (src_size > UINT32_MAX) { return 0; }
+
+	const uint8_t* in = src;
+	const uint8_t* in_end = in + src_size;
+	const uint8_t* ip = in;
+	const uint8_t* anchor = in;
+	uint8_t* op = dst;
+	uint8_t* op_end = op + dst_capacity;
+	uint32_t table[1 << BSERIAL_LZ_HASH_EXP] = { 0 };
+
+	while (in_end - ip >= BSERIAL_LZ_MIN_MATCH) {
+		uint32_t seq = bserial_lz_load32(ip);
+		uint32_t hash = (seq * UINT32_C(2654435761)) >> (32 - BSERIAL_LZ_HASH_EXP);
+		const uint8_t* candidate = in + table[hash];
+		table[hash] = (uint32_t)(ip - in);
+
+		if (
+			candidate < ip
+			&& ip - candidate <= BSERIAL_LZ_MAX_OFFSET
+			&& bserial_lz_load32(candidate) == seq
+		) {
+			const uint8_t* match_end = ip + BSERIAL_LZ_MIN_MATCH;
+			candidate += BSERIAL_LZ_MIN_MATCH;
+			while (match_end < in_end && *match_end == *candidate) {
+				++match_end;
+				++candidate;
+			}
+
+			op = bserial_lz_write_sequence(
+				op, op_end,
+				anchor, (size_t)(ip - anchor),
+				(size_t)(match_end - candidate), (size_t)(match_end - ip)
+			);
+			if (op == NULL) { return 0; }
+
+			ip = anchor = match_end;
+		} else {
+			++ip;
+		}
+	}
+
+	op = bserial_lz_write_sequence(op, op_end, anchor, (size_t)(in_end - anchor), 0, 0);
+	return op != NULL ? (size_t)(op - (uint8_t*)dst) : 0;
+}
+
+static size_t
+bserial_lz_decompress(
+	void* userdata,
+	const void* src, size_t src_size,
+	void* dst, size_t dst_size
+) {
+	(void)userdata;
+
+	const uint8_t* ip = src;
+	const uint8_t* ip_end = ip + src_size;
+	uint8_t* op = dst;
+	uint8_t* op_end = op + dst_size;
+
+	while (ip < ip_end) {
+		uint8_t token = *ip++;
+
+		size_t num_literals = token >> 4;
+		if (num_literals == 15 && !bserial_lz_read_len(&ip, ip_end, &num_literals)) { return 0; }
+		if (num_literals > (size_t)(ip_end - ip) || num_literals > (size_t)(op_end - op)) {
+			return 0;
+		}
+		memcpy(op, ip, num_literals);
+		ip += num_literals;
+		op += num_literals;
+
+		// Last sequence
+		if (ip == ip_end) { break; }
+
+		if (ip_end - ip < 2) { return 0; }
+		size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - (uint8_t*)dst)) { return 0; }
+
+		size_t match_len = token & 15;
+		if (match_len == 15 && !bserial_lz_read_len(&ip, ip_end, &match_len)) { return 0; }
+		match_len += BSERIAL_LZ_MIN_MATCH;
+		if (match_len > (size_t)(op_end - op)) { return 0; }
+
+		const uint8_t* match = op - offset;
+		if (offset >= match_len) {
+			memcpy(op, match, match_len);
+		} else {
+			// Overlapping match repeats the last offset bytes
+			for (size_t i = 0; i < match_len; ++i) { op[i] = match[i]; }
+		}
+		op += match_len;
+	}
+
+	return (size_t)(op - (uint8_t*)dst);
+}
+
+bserial_block_codec_t
+bserial_block_lz_codec(void) {
+	return (bserial_block_codec_t){
+		.compress = bserial_lz_compress,
+		.decompress = bserial_lz_decompress,
+	};
+}
+
+size_t
+bserial_block_buffer_size(size_t block_size) {
+	return block_size * 2;
+}
+
+// A block is: its decompressed size, its compressed size and the compressed data.
+// When both sizes are equal, the data is stored uncompressed.
+static inline bool
+bserial_block_read_header(bserial_block_in_t* block_in, uint64_t* raw_size, uint64_t* packed_size) {
+	return bserial_read_uint(raw_size, block_in->inner) == BSERIAL_OK
+		&& bserial_read_uint(packed_size, block_in->inner) == BSERIAL_OK
+		&& 0 < *raw_size && *raw_size <= block_in->block_size
+		&& *packed_size <= *raw_size;
+}
+
+static inline bool
+bserial_block_read_body(bserial_block_in_t* block_in, uint64_t raw_size, uint64_t packed_size) {
+	if (packed_size == raw_size) {
+		if (bserial_read(block_in->inner, block_in->block, raw_size) != BSERIAL_OK) { return false; }
+	} else {
+		if (bserial_read(block_in->inner, block_in->packed, packed_size) != BSERIAL_OK) { return false; }
+
+		size_t size = block_in->codec.decompress(
+			block_in->codec.userdata,
+			block_in->packed, packed_size,
+			block_in->block, raw_size
+		);
+		if (size != raw_size) { return false; }
+	}
+
+	block_in->bserial.buf_cur = block_in->block;
+	block_in->bserial.buf_end = block_in->block + raw_size;
+	return true;
+}
+
+static inline size_t
+bserial_block_read(bserial_in_t* in, void* buf, size_t size) {
+	bserial_block_in_t* block_in = (bserial_block_in_t*)in;
+
+	if (in->buf_cur == in->buf_end) {
+		uint64_t raw_size, packed_size;
+		if (
+			!bserial_block_read_header(block_in, &raw_size, &packed_size)
+			|| !bserial_block_read_body(block_in, raw_size, packed_size)
+		) {
+			return 0;
+		}
+	}
+
+	size_t buffered = (size_t)(in->buf_end - in->buf_cur);
+	size_t copy_size = buffered < size ? buffered : size;
+	memcpy(buf, in->buf_cur, copy_size);
+	in->buf_cur += copy_size;
+	return copy_size;
+}
+
+static inline bool
+bserial_block_skip(bserial_in_t* in, size_t size) {
+	bserial_block_in_t* block_in = (bserial_block_in_t*)in;
+
+	// bserial_skip has already consumed the current block
+	while (size > 0) {
+		uint64_t raw_size, packed_size;
+		if (!bserial_block_read_header(block_in, &raw_size, &packed_size)) { return false; }
+
+		if (size >= raw_size) {
+			if (bserial_skip(block_in->inner, packed_size) != BSERIAL_OK) { return false; }
+			size -= raw_size;
+		} else {
+			if (!bserial_block_read_body(block_in, raw_size, packed_size)) { return false; }
+			in->buf_cur += size;
+			size = 0;
+		}
+	}
+
+	return true;
+}
+
+static inline size_t
+bserial_block_write(bserial_out_t* out, const void* buf, size_t size) {
+	bserial_block_out_t* block_out = (bserial_block_out_t*)out;
+
+	if (out->buf_cur == out->buf_end && bserial_block_flush(block_out) != BSERIAL_OK) {
+		return 0;
+	}
+
+	size_t space = (size_t)(out->buf_end - out->buf_cur);
+	size_t copy_size = space < size ? space : size;
+	memcpy(out->buf_cur, buf, copy_size);
+	out->buf_cur += copy_size;
+	return copy_size;
+}
+
+bserial_in_t*
+bserial_block_init_in(
+	bserial_block_in_t* bserial_block,
+	bserial_in_t* inner,
+	bserial_block_codec_t codec,
+	void* buffer,
+	size_t block_size
+) {
+	*bserial_block = (bserial_block_in_t){
+		.inner = inner,
+		.codec = codec,
+		.block = buffer,
+		.packed = (char*)buffer + block_size,
+		.block_size = block_size,
+	};
+	bserial_in_t* in = bserial_init_in(&bserial_block->bserial, bserial_block_read);
+	in->skip = bserial_block_skip;
+	return in;
+}
+
+bserial_out_t*
+bserial_block_init_out(
+	bserial_block_out_t* bserial_block,
+	bserial_out_t* inner,
+	bserial_block_codec_t codec,
+	void* buffer,
+	size_t block_size
+) {
+	*bserial_block = (bserial_block_out_t){
+		.inner = inner,
+		.codec = codec,
+		.block = buffer,
+		.packed = (char*)buffer + block_size,
+		.block_size = block_size,
+	};
+	bserial_out_t* out = bserial_init_out(&bserial_block->bserial, bserial_block_write);
+	out->buf_cur = buffer;
+	out->buf_end = (char*)buffer + block_size;
+	return out;
+}
+
+bserial_status_t
+bserial_block_flush(bserial_block_out_t* bserial_block) {
+	size_t raw_size = (size_t)(bserial_block->bserial.buf_cur - bserial_block->block);
+	if (raw_size == 0) { return BSERIAL_OK; }
+	bserial_block->bserial.buf_cur = bserial_block->block;
+
+	// Only keep the compressed data if it is smaller
+	size_t packed_size = bserial_block->codec.compress(
+		bserial_block->codec.userdata,
+		bserial_block->block, raw_size,
+		bserial_block->packed, raw_size - 1
+	);
+	const char* data = packed_size > 0 ? bserial_block->packed : bserial_block->block;
+	if (packed_size == 0) { packed_size = raw_size; }
+
+	BSERIAL_CHECK_STATUS(bserial_write_uint(raw_size, bserial_block->inner));
+	BSERIAL_CHECK_STATUS(bserial_write_uint(packed_size, bserial_block->inner));
+	return bserial_write(bserial_block->inner, data, packed_size);
 }
 
 #endif
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 typedef intptr_t mem_layout_t;
 
@@ -33,4 +35,231 @@ mem_layout_locate(void* mem, ptrdiff_t offset) {
 	return (void*)((intptr_t)mem + offset);
 }
 
+// Structure of arrays: columns sharing a capacity, kept in a single block
+
+#ifndef MEM_LAYOUT_REALLOC
+#	ifdef BLIB_REALLOC
+#		define MEM_LAYOUT_REALLOC BLIB_REALLOC
+#	else
+#		define MEM_LAYOUT_REALLOC(ptr, size, ctx) mem_layout_libc_realloc(ptr, size, ctx)
+#		define MEM_LAYOUT_USE_LIBC_REALLOC
+#	endif
+#endif
+
+// Alignment of the blocks returned by MEM_LAYOUT_REALLOC
+#ifndef MEM_LAYOUT_MAX_ALIGN_TYPE
+#	ifdef _MSC_VER
+#		define MEM_LAYOUT_MAX_ALIGN_TYPE double
+#	else
+#		define MEM_LAYOUT_MAX_ALIGN_TYPE max_align_t
+#	endif
+#endif
+
+#ifndef MEM_LAYOUT_CACHE_LINE_SIZE
+#	define MEM_LAYOUT_CACHE_LINE_SIZE 64
+#endif
+
+#ifdef MEM_LAYOUT_USE_LIBC_REALLOC
+
+#include <stdlib.h>
+
+static inline void*
+mem_layout_libc_realloc(void* ptr, size_t size, void* ctx) {
+	(void)ctx;
+	if (size > 0) {
+		return realloc(ptr, size);
+	} else {
+		free(ptr);
+		return NULL;
+	}
+}
+
+#endif
+
+typedef struct mem_layout_column_s {
+	size_t elem_size;
+	size_t alignment;
+	// Written by mem_layout_reserve_columns and mem_layout_soa_resize
+	ptrdiff_t offset;
+} mem_layout_column_t;
+
+#define MEM_LAYOUT_COLUMN(T) { .elem_size = sizeof(T), .alignment = _Alignof(T) }
+
+typedef struct mem_layout_soa_s {
+	mem_layout_column_t* columns;
+	size_t num_columns;
+	// Minimum alignment of every column, e.g: a cache line or a SIMD register
+	size_t alignment;
+	size_t capacity;
+	size_t size;
+	void* block;
+	void* base;
+	void* memctx;
+} mem_layout_soa_t;
+
+static inline size_t
+mem_layout_column_alignment(const mem_layout_column_t* column, size_t alignment) {
+	return column->alignment > alignment ? column->alignment : alignment;
+}
+
+// Reserve capacity elements for every column, this can be mixed with other
+// reservations to put a struct and its columns in one allocation
+static inline void
+mem_layout_reserve_columns(
+	mem_layout_t* layout,
+	mem_layout_column_t* columns,
+	size_t num_columns,
+	size_t capacity,
+	size_t alignment
+) {
+	for (size_t i = 0; i < num_columns; ++i) {
+		columns[i].offset = mem_layout_reserve(
+			layout,
+			columns[i].elem_size * capacity,
+			mem_layout_column_alignment(&columns[i], alignment)
+		);
+	}
+}
+
+static inline ptrdiff_t
+mem_layout_column_offset(
+	const mem_layout_column_t* columns,
+	size_t index,
+	size_t capacity,
+	size_t alignment
+) {
+	mem_layout_t layout = 0;
+	ptrdiff_t offset = 0;
+	for (size_t i = 0; i <= index; ++i) {
+		offset = mem_layout_reserve(
+			&layout,
+			columns[i].elem_size * capacity,
+			mem_layout_column_alignment(&columns[i], alignment)
+		);
+	}
+	return offset;
+}
+
+static inline void
+mem_layout_soa_init(
+	mem_layout_soa_t* soa,
+	mem_layout_column_t* columns,
+	size_t num_columns,
+	size_t alignment,
+	void* memctx
+) {
+	for (size_t i = 0; i < num_columns; ++i) {
+		columns[i].offset = 0;
+	}
+
+	*soa = (mem_layout_soa_t){
+		.columns = columns,
+		.num_columns = num_columns,
+		.alignment = alignment > 0 ? alignment : 1,
+		.memctx = memctx,
+	};
+}
+
+static inline void
+mem_layout_soa_cleanup(mem_layout_soa_t* soa) {
+	MEM_LAYOUT_REALLOC(soa->block, 0, soa->memctx);
+	soa->block = soa->base = NULL;
+	soa->capacity = soa->size = 0;
+}
+
+static inline void*
+mem_layout_soa_column(const mem_layout_soa_t* soa, size_t index) {
+	return soa->base != NULL
+		? mem_layout_locate(soa->base, soa->columns[index].offset)
+		: NULL;
+}
+
+// Change the capacity of every column with a single reallocation.
+// The first len elements of each column are kept.
+// Returns false on allocation failure, the columns are left untouched.
+static inline bool
+mem_layout_soa_resize(mem_layout_soa_t* soa, size_t new_capacity, size_t len) {
+	if (new_capacity == soa->capacity) { return true; }
+	if (new_capacity == 0) {
+		mem_layout_soa_cleanup(soa);
+		return true;
+	}
+
+	mem_layout_column_t* columns = soa->columns;
+	size_t num_columns = soa->num_columns;
+	size_t alignment = soa->alignment;
+	if (len > soa->capacity) { len = soa->capacity; }
+	if (len > new_capacity) { len = new_capacity; }
+
+	// Blocks are only aligned for MEM_LAYOUT_MAX_ALIGN_TYPE, over-allocate to
+	// align the base
+	size_t base_alignment = alignment;
+	for (size_t i = 0; i < num_columns; ++i) {
+		base_alignment = mem_layout_column_alignment(&columns[i], base_alignment);
+	}
+	size_t extra = base_alignment > _Alignof(MEM_LAYOUT_MAX_ALIGN_TYPE)
+		? base_alignment - _Alignof(MEM_LAYOUT_MAX_ALIGN_TYPE)
+		: 0;
+
+	mem_layout_t layout = 0;
+	for (size_t i = 0; i < num_columns; ++i) {
+		mem_layout_reserve(
+			&layout,
+			columns[i].elem_size * new_capacity,
+			mem_layout_column_alignment(&columns[i], alignment)
+		);
+	}
+	size_t new_size = mem_layout_size(&layout);
+
+	char* old_base = soa->base;
+	size_t old_pad = soa->block != NULL ? (size_t)(old_base - (char*)soa->block) : 0;
+	bool grow = new_capacity > soa->capacity;
+	char* block;
+	size_t num_bytes_used;
+	if (grow) {
+		block = MEM_LAYOUT_REALLOC(soa->block, new_size + extra, soa->memctx);
+		if (block == NULL) { return false; }
+		num_bytes_used = soa->size;
+	} else {
+		// Compact first so nothing is cut off by the smaller block, columns only
+		// move down
+		for (size_t i = 0; i < num_columns; ++i) {
+			memmove(
+				old_base + mem_layout_column_offset(columns, i, new_capacity, alignment),
+				old_base + columns[i].offset,
+				columns[i].elem_size * len
+			);
+		}
+		block = MEM_LAYOUT_REALLOC(soa->block, new_size + extra, soa->memctx);
+		// The old block is still large enough
+		if (block == NULL) { block = soa->block; }
+		num_bytes_used = new_size;
+	}
+
+	// The realloc may have changed the padding in front of the base
+	char* base = (char*)mem_layout_align_ptr((intptr_t)block, base_alignment);
+	if (base != block + old_pad) {
+		memmove(base, block + old_pad, num_bytes_used);
+	}
+
+	if (grow) {
+		// Columns only move up, start from the last one
+		for (size_t i = num_columns; i > 0; --i) {
+			memmove(
+				base + mem_layout_column_offset(columns, i - 1, new_capacity, alignment),
+				base + columns[i - 1].offset,
+				columns[i - 1].elem_size * len
+			);
+		}
+	}
+
+	layout = 0;
+	mem_layout_reserve_columns(&layout, columns, num_columns, new_capacity, alignment);
+	soa->capacity = new_capacity;
+	soa->size = new_size;
+	soa->block = block;
+	soa->base = base;
+	return true;
+}
+
 #endif
@@ -56,8 +56,10 @@ make_project "autolist"
 make_project "xincbin"
 make_project "mem_layout"
 make_project "barena"
+make_project "barray"
 make_project "tlsf"
 make_project "bresmon"
 make_project "bhash"
 make_project "bcoro"
 make_project "bserial"
+make_project "bench"
@@ -2,6 +2,11 @@
 #include "../../barena.h"
 #include <stdio.h>
 #include <string.h>
+#include <assert.h>
+
+#ifndef __STDC_NO_THREADS__
+#include <threads.h>
+#endif
 
 static inline void
 prompt(const char* line) {
@@ -9,10 +14,128 @@ prompt(const char* line) {
 	getc(stdin);
 }
 
+#define NUM_THREADS 4
+#define NUM_REQUESTS 2000
+
+static int
+request_thread(void* userdata) {
+	barena_pool_t* pool = userdata;
+	for (int i = 0; i < NUM_REQUESTS; ++i) {
+		barena_t arena;
+		barena_init(&arena, pool);
+		for (int j = 0; j < 8; ++j) {
+			size_t size = (size_t)(i % 7 + 1) * 3000;
+			char* mem = barena_malloc(&arena, size);
+			assert(mem != NULL);
+			memset(mem, j, size);
+			assert(mem[size - 1] == j);
+		}
+		barena_reset(&arena);
+	}
+
+	return 0;
+}
+
+static void
+concurrent_test(void) {
+	barena_pool_t pool;
+	barena_pool_init_ex(&pool, 4096ull * 2, &(barena_pool_options_t){
+		.concurrent = true,
+		.max_free_chunks = 16,
+	});
+
+#ifndef __STDC_NO_THREADS__
+	thrd_t threads[NUM_THREADS];
+	for (int i = 0; i < NUM_THREADS; ++i) {
+		int result = thrd_create(&threads[i], request_thread, &pool);
+		assert(result == thrd_success);
+		(void)result;
+	}
+	for (int i = 0; i < NUM_THREADS; ++i) {
+		thrd_join(threads[i], NULL);
+	}
+#else
+	request_thread(&pool);
+#endif
+
+	assert(pool.num_free_chunks <= 16);
+	size_t num_free_chunks = 0;
+	for (barena_chunk_t* itr = pool.free_chunks; itr != NULL; itr = itr->next) {
+		++num_free_chunks;
+	}
+	assert(num_free_chunks == pool.num_free_chunks);
+
+	barena_pool_cleanup(&pool);
+	assert(pool.free_chunks == NULL);
+}
+
+static void
+realloc_scope_test(void) {
+	barena_pool_t pool;
+	barena_pool_init(&pool, 4096ull * 2);
+
+	barena_t arena;
+	barena_init(&arena, &pool);
+
+	// Growing the last allocation stays in place
+	char* buf = barena_realloc(&arena, NULL, 0, 100);
+	memset(buf, 'a', 100);
+	size_t used = arena.stats.bytes_used;
+	assert(used >= 100);
+	char* grown = barena_realloc(&arena, buf, 100, 1000);
+	assert(grown == buf);
+	assert(arena.stats.bytes_used == used + 900);
+
+	// Shrinking gives the space back
+	grown = barena_realloc(&arena, buf, 1000, 200);
+	assert(grown == buf);
+	assert(arena.stats.bytes_used == used + 100);
+
+	// Not the last allocation anymore: copy
+	char* other = barena_malloc(&arena, 16);
+	assert(other != NULL);
+	grown = barena_realloc(&arena, buf, 200, 300);
+	assert(grown != buf);
+	for (int i = 0; i < 100; ++i) { assert(grown[i] == 'a'); }
+
+	// Too large for the chunk: copy into a new one
+	char* big = barena_realloc(&arena, grown, 300, 64 * 1024);
+	assert(big != grown);
+	assert(big[0] == 'a');
+	assert(arena.stats.chunk_bytes >= 64 * 1024 + 4096ull * 2);
+
+	// Nested scopes
+	used = arena.stats.bytes_used;
+	barena_scope_t outer = barena_scope_begin(&arena);
+	barena_malloc(&arena, 5000);
+	barena_scope_t inner = barena_scope_begin(&arena);
+	barena_malloc(&arena, 50000);
+	size_t peak = arena.stats.bytes_used;
+	barena_scope_end(&inner);
+	assert(arena.stats.bytes_used < peak);
+	barena_scope_end(&outer);
+	assert(arena.stats.bytes_used == used);
+	assert(arena.stats.peak_bytes_used >= peak);
+	assert(arena.stats.peak_chunk_bytes >= arena.stats.chunk_bytes);
+
+	barena_reset(&arena);
+	assert(arena.stats.bytes_used == 0);
+	assert(arena.stats.chunk_bytes == 0);
+	(void)used;
+	(void)other;
+	(void)big;
+	(void)peak;
+
+	barena_pool_cleanup(&pool);
+}
+
 int main(int argc, const char* argv[]) {
 	(void)argc;
 	(void)argv;
 
+	concurrent_test();
+	realloc_scope_test();
+
 	barena_pool_t pool;
 	barena_pool_init(&pool, 4096ull * 2);
 
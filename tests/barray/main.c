@@ -0,0 +1,223 @@
+#define BLIB_IMPLEMENTATION
+#define BARRAY_ALLOCATOR
+#include "../../barena.h"
+#include "../../tlsf.h"
+#include "../../barray.h"
+#include <stdint.h>
+#include <assert.h>
+
+static inline bool
+is_aligned(const void* ptr) {
+	return ((uintptr_t)ptr & (_Alignof(BARRAY_ALIGN_TYPE) - 1)) == 0;
+}
+
+static void
+push_test(void) {
+	barray(int) array = NULL;
+	int items[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+	// Nothing to push keeps the array NULL
+	barray_push_n(array, items, 0, NULL);
+	assert(array == NULL);
+
+	// Grows from NULL
+	barray_push_n(array, items, 3, NULL);
+	assert(barray_len(array) == 3);
+	assert(barray_capacity(array) >= 3);
+	for (int i = 0; i < 3; ++i) { assert(array[i] == i); }
+
+	// Fits into the remaining capacity without a realloc
+	barray_reserve(array, 16, NULL);
+	assert(barray_capacity(array) == 16);
+	int* before = array;
+	barray_push_n(array, items + 3, 7, NULL);
+	assert(array == before);
+	assert(barray_len(array) == 10);
+	for (int i = 0; i < 10; ++i) { assert(array[i] == i); }
+
+	// Needs more than the growth policy alone would give
+	barray(int) big = NULL;
+	int many[100];
+	for (int i = 0; i < 100; ++i) { many[i] = i * 2; }
+	barray_push(big, -1, NULL);
+	barray_push_n(big, many, 100, NULL);
+	assert(barray_len(big) == 101);
+	assert(barray_capacity(big) >= 101);
+	assert(big[0] == -1);
+	for (int i = 0; i < 100; ++i) { assert(big[i + 1] == i * 2); }
+
+	// Extend appends a whole barray
+	barray_extend(array, big, NULL);
+	assert(barray_len(array) == 111);
+	for (int i = 0; i < 10; ++i) { assert(array[i] == i); }
+	assert(array[10] == -1);
+	for (int i = 0; i < 100; ++i) { assert(array[i + 11] == i * 2); }
+
+	// Extending with a NULL array is a no-op
+	barray(int) empty = NULL;
+	barray_extend(array, empty, NULL);
+	assert(barray_len(array) == 111);
+
+	int popped = barray_pop(array);
+	assert(popped == 198);
+	assert(barray_len(array) == 110);
+	(void)popped;
+	(void)before;
+
+	barray_free(NULL, big);
+	barray_free(NULL, array);
+}
+
+static void
+shrink_test(void) {
+	barray(int) array = NULL;
+
+	// Shrinking NULL stays NULL
+	barray_shrink_to_fit(array, NULL);
+	assert(array == NULL);
+
+	for (int i = 0; i < 5; ++i) { barray_push(array, i, NULL); }
+	barray_reserve(array, 64, NULL);
+	assert(barray_capacity(array) == 64);
+
+	// To the length, contents are preserved
+	barray_shrink_to_fit(array, NULL);
+	assert(barray_capacity(array) == 5);
+	assert(barray_len(array) == 5);
+	for (int i = 0; i < 5; ++i) { assert(array[i] == i); }
+
+	// Already tight
+	int* before = array;
+	barray_shrink_to_fit(array, NULL);
+	assert(array == before);
+	(void)before;
+
+	// An empty array is freed
+	barray_clear(array);
+	barray_shrink_to_fit(array, NULL);
+	assert(array == NULL);
+	assert(barray_len(array) == 0);
+	assert(barray_capacity(array) == 0);
+}
+
+static void
+null_array_test(void) {
+	barray(int) array = NULL;
+
+	barray_reserve(array, 0, NULL);
+	assert(array == NULL);
+	barray_resize(array, 0, NULL);
+	assert(array == NULL);
+
+	barray_reserve(array, 10, NULL);
+	assert(array != NULL);
+	assert(barray_len(array) == 0);
+	assert(barray_capacity(array) == 10);
+	barray_free(NULL, array);
+
+	array = NULL;
+	barray_resize(array, 7, NULL);
+	assert(array != NULL);
+	assert(barray_len(array) == 7);
+	assert(barray_capacity(array) >= 7);
+	for (int i = 0; i < 7; ++i) { array[i] = i; }
+
+	// Resizing within the capacity keeps the contents
+	barray_resize(array, 3, NULL);
+	assert(barray_len(array) == 3);
+	assert(array[2] == 2);
+	barray_free(NULL, array);
+}
+
+static void
+arena_allocator_test(void) {
+	barena_pool_t pool;
+	barena_pool_init(&pool, 4096);
+	barena_t arena;
+	barena_init(&arena, &pool);
+	barray_allocator_t allocator = barray_arena_allocator(&arena);
+
+	barray(double) array = NULL;
+	for (int i = 0; i < 1000; ++i) {
+		barray_push(array, (double)i, &allocator);
+		assert(is_aligned(array));
+	}
+	assert(barray_len(array) == 1000);
+	for (int i = 0; i < 1000; ++i) { assert(array[i] == (double)i); }
+
+	double more[3] = { 1.5, 2.5, 3.5 };
+	barray_push_n(array, more, 3, &allocator);
+	assert(barray_len(array) == 1003);
+	assert(array[1002] == 3.5);
+
+	barray_shrink_to_fit(array, &allocator);
+	assert(barray_capacity(array) == 1003);
+	assert(array[0] == 0.0 && array[1002] == 3.5);
+
+	// Only reclaimed along with the arena
+	barray_free(&allocator, array);
+
+	barena_reset(&arena);
+	barena_pool_cleanup(&pool);
+}
+
+static void
+tlsf_allocator_test(void) {
+	tlsf_t tlsf;
+	tlsf_init(&tlsf, 16 * 1024 * 1024);
+	barray_allocator_t allocator = barray_tlsf_allocator(&tlsf);
+
+	// Interleave with unaligned blocks so the adapter has to realign: tlsf
+	// only guarantees pointer alignment
+	void* spacers[64];
+	barray(long double) arrays[4] = { NULL };
+	for (int i = 0; i < 64; ++i) {
+		spacers[i] = tlsf_malloc(&tlsf, sizeof(void*) * (size_t)(i % 3 + 1));
+		assert(spacers[i] != NULL);
+
+		for (int j = 0; j < 4; ++j) {
+			barray_push(arrays[j], (long double)(i * 4 + j), &allocator);
+			assert(is_aligned(arrays[j]));
+		}
+	}
+
+	long double more[5] = { 1, 2, 3, 4, 5 };
+	for (int j = 0; j < 4; ++j) {
+		barray_push_n(arrays[j], more, 5, &allocator);
+		assert(is_aligned(arrays[j]));
+		assert(barray_len(arrays[j]) == 69);
+		for (int i = 0; i < 64; ++i) { assert(arrays[j][i] == (long double)(i * 4 + j)); }
+		assert(arrays[j][68] == 5);
+
+		barray_shrink_to_fit(arrays[j], &allocator);
+		assert(is_aligned(arrays[j]));
+		assert(barray_capacity(arrays[j]) == 69);
+		assert(arrays[j][0] == (long double)j);
+
+		barray_clear(arrays[j]);
+		barray_shrink_to_fit(arrays[j], &allocator);
+		assert(arrays[j] == NULL);
+	}
+
+	for (int i = 0; i < 64; ++i) { tlsf_free(&tlsf, spacers[i]); }
+
+	// Everything went back to the heap
+	tlsf_stats_t stats;
+	tlsf_stats(&tlsf, &stats);
+	assert(stats.used_size == 0);
+
+	tlsf_cleanup(&tlsf);
+}
+
+int main(int argc, const char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	push_test();
+	shrink_test();
+	null_array_test();
+	arena_allocator_test();
+	tlsf_allocator_test();
+
+	return 0;
+}
@@ -0,0 +1,174 @@
+#include "../../bcoro.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_RECORDS 1000
+#define CHAN_CAPACITY 16
+#define STAGE_STACK_SIZE 512
+
+BCORO_DEFINE_CHAN(int_chan, int)
+
+typedef struct {
+	int_chan_t* output;
+	int count;
+	int* switches;
+} range_args_t;
+
+// Counts its own switches instead of using BCORO_CHAN_SEND
+BCORO(range, range_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(int, i);
+
+	BCORO_SECTION_BODY
+	for (i = 0; i < BCORO_ARG.count;) {
+		if (int_chan_push(BCORO_ARG.output, i)) {
+			++i;
+		} else {
+			*BCORO_ARG.switches += 1;
+			BCORO_YIELD();
+		}
+	}
+
+	BCORO_SECTION_CLEANUP
+}
+
+typedef struct {
+	int_chan_t* input;
+	int_chan_t* output;
+} map_args_t;
+
+// One item at a time
+BCORO(square, map_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(int, item);
+	bool ok;
+
+	BCORO_SECTION_BODY
+	for (;;) {
+		BCORO_CHAN_RECV(&BCORO_ARG.input->base, &item, ok);
+		if (!ok) { break; }
+
+		item *= item;
+		BCORO_CHAN_SEND(&BCORO_ARG.output->base, &item);
+	}
+
+	BCORO_SECTION_CLEANUP
+}
+
+typedef struct {
+	int_chan_t* input;
+	long long* sum;
+	int* count;
+} sum_args_t;
+
+// A whole batch at a time
+BCORO(sum, sum_args_t) {
+	BCORO_SECTION_VARS
+	int batch[CHAN_CAPACITY];
+	size_t count;
+
+	BCORO_SECTION_BODY
+	for (;;) {
+		BCORO_CHAN_RECV_N(&BCORO_ARG.input->base, batch, CHAN_CAPACITY, count);
+		if (count == 0) { break; }
+
+		for (size_t i = 0; i < count; ++i) { *BCORO_ARG.sum += batch[i]; }
+		*BCORO_ARG.count += (int)count;
+	}
+
+	BCORO_SECTION_CLEANUP
+}
+
+void
+chan_test(void) {
+	// Ring buffer
+	int storage[4];
+	int_chan_t chan;
+	int_chan_init(&chan, storage, 4);
+	int items[6] = { 1, 2, 3, 4, 5, 6 };
+	size_t num_pushed = int_chan_push_n(&chan, items, 3);
+	assert(num_pushed == 3);
+	int item = 0;
+	bool popped = int_chan_pop(&chan, &item);
+	assert(popped && item == 1);
+	popped = int_chan_pop(&chan, &item);
+	assert(popped && item == 2);
+	// Wraps around
+	num_pushed = int_chan_push_n(&chan, items + 3, 3);
+	assert(num_pushed == 3);
+	bool pushed = int_chan_push(&chan, 7);
+	assert(!pushed);
+	int out[6] = { 0 };
+	size_t num_popped = int_chan_pop_n(&chan, out, 6);
+	assert(num_popped == 4);
+	assert(out[0] == 3 && out[1] == 4 && out[2] == 5 && out[3] == 6);
+	popped = int_chan_pop(&chan, &item);
+	assert(!popped);
+	assert(bcoro_chan_count(&chan.base) == 0);
+	(void)num_pushed;
+	(void)num_popped;
+	(void)pushed;
+	(void)popped;
+
+	bcoro_pool_t pool;
+	bcoro_pool_init(&pool, NULL);
+
+	// Generator
+	int switches = 0;
+	int gen_storage[CHAN_CAPACITY];
+	int_chan_t gen_chan;
+	int_chan_init(&gen_chan, gen_storage, CHAN_CAPACITY);
+	bcoro_t* gen = bcoro_pool_alloc(&pool, STAGE_STACK_SIZE);
+	range(gen, (range_args_t){
+		.output = &gen_chan,
+		.count = NUM_RECORDS,
+		.switches = &switches,
+	});
+	int expected = 0;
+	while (int_chan_next(gen, &gen_chan, &item)) {
+		assert(item == expected);
+		++expected;
+	}
+	assert(expected == NUM_RECORDS);
+	assert(bcoro_chan_is_closed(&gen_chan.base));
+	// One switch per batch
+	assert(switches <= NUM_RECORDS / CHAN_CAPACITY);
+
+	// Pipeline
+	int decoded_storage[CHAN_CAPACITY];
+	int transformed_storage[CHAN_CAPACITY];
+	int_chan_t decoded, transformed;
+	int_chan_init(&decoded, decoded_storage, CHAN_CAPACITY);
+	int_chan_init(&transformed, transformed_storage, CHAN_CAPACITY);
+
+	bcoro_t* decode = bcoro_pool_alloc(&pool, STAGE_STACK_SIZE);
+	bcoro_t* transform = bcoro_pool_alloc(&pool, STAGE_STACK_SIZE);
+	bcoro_t* encode = bcoro_pool_alloc(&pool, STAGE_STACK_SIZE);
+	switches = 0;
+	long long total = 0;
+	int count = 0;
+	range(decode, (range_args_t){
+		.output = &decoded,
+		.count = NUM_RECORDS,
+		.switches = &switches,
+	});
+	square(transform, (map_args_t){ .input = &decoded, .output = &transformed });
+	sum(encode, (sum_args_t){ .input = &transformed, .sum = &total, .count = &count });
+
+	bcoro_pipeline_stage_t stages[] = {
+		{ .coro = decode, .output = &decoded.base },
+		{ .coro = transform, .output = &transformed.base },
+		{ .coro = encode },
+	};
+	bcoro_pipeline_run(stages, sizeof(stages) / sizeof(stages[0]));
+
+	long long expected_total = 0;
+	for (long long i = 0; i < NUM_RECORDS; ++i) { expected_total += i * i; }
+	assert(count == NUM_RECORDS);
+	assert(total == expected_total);
+	assert(switches <= NUM_RECORDS / CHAN_CAPACITY + 1);
+
+	bcoro_pool_cleanup(&pool);
+	printf("chan OK\n");
+}
@@ -0,0 +1,157 @@
+#include "../../bcoro.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LARGE_STACK_SIZE (1024 * 4)
+
+typedef struct {
+	int* output;
+} frame_args_t;
+
+typedef struct {
+	char data[200];
+} buffer_t;
+
+BCORO(leaf, frame_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(buffer_t, buffer);
+
+	BCORO_SECTION_BODY
+	buffer.data[0] = 1;
+	BCORO_YIELD();
+	*BCORO_ARG.output += buffer.data[0];
+
+	BCORO_SECTION_CLEANUP
+}
+
+BCORO(nested, frame_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(int, i);
+
+	BCORO_SECTION_BODY
+	for (i = 0; i < 3; ++i) {
+		BCORO_YIELD_FROM(leaf, BCORO_ARG);
+	}
+
+	BCORO_SECTION_CLEANUP
+}
+
+typedef struct {
+	bcoro_t* clone;
+	size_t clone_stack_size;
+	int* output;
+} fork_args_t;
+
+BCORO(forking, fork_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(int, value);
+
+	BCORO_SECTION_BODY
+	value = 1;
+	BCORO_FORK(BCORO_ARG.clone, BCORO_ARG.clone_stack_size) {
+		value = 2;
+		BCORO_YIELD();
+	}
+
+	*BCORO_ARG.output += value;
+
+	BCORO_SECTION_CLEANUP
+}
+
+void
+frame_test(void) {
+	// Measure with a generous stack
+	int output = 0;
+	bcoro_t* coro = malloc(bcoro_mem_size(LARGE_STACK_SIZE));
+	assert(coro != NULL);
+	nested(coro, (frame_args_t){ .output = &output });
+	size_t outer_size = 0;
+	while (bcoro_resume(coro) != BCORO_TERMINATED) {
+		// Suspended in the leaf
+		assert(bcoro_frame_size(coro) > 200);
+		if (outer_size == 0) { outer_size = coro->frame_size; }
+	}
+	assert(output == 3);
+	assert(outer_size > 0 && outer_size < 200);
+	assert(bcoro_frame_size(coro) == outer_size);
+	size_t peak = bcoro_peak_frame_size(coro);
+	assert(peak > outer_size + 200);
+	free(coro);
+
+	// The peak is enough to run it again
+	output = 0;
+	coro = malloc(bcoro_mem_size(peak));
+	assert(coro != NULL);
+	nested(coro, (frame_args_t){ .output = &output });
+	while (bcoro_resume(coro) != BCORO_TERMINATED) {}
+	assert(output == 3);
+	assert(bcoro_peak_frame_size(coro) == peak);
+	free(coro);
+
+	// Forking copies only the frame
+	output = 0;
+	coro = malloc(bcoro_mem_size(LARGE_STACK_SIZE));
+	assert(coro != NULL);
+	bcoro_t* clone = malloc(bcoro_mem_size(LARGE_STACK_SIZE));
+	assert(clone != NULL);
+	forking(coro, (fork_args_t){
+		.clone = clone,
+		.clone_stack_size = LARGE_STACK_SIZE,
+		.output = &output,
+	});
+	while (bcoro_resume(coro) != BCORO_TERMINATED) {}
+	while (bcoro_resume(clone) != BCORO_TERMINATED) {}
+	assert(output == 3);
+	size_t fork_size = bcoro_peak_frame_size(coro);
+	free(clone);
+
+	output = 0;
+	clone = malloc(bcoro_mem_size(fork_size));
+	assert(clone != NULL);
+	forking(coro, (fork_args_t){
+		.clone = clone,
+		.clone_stack_size = fork_size,
+		.output = &output,
+	});
+	while (bcoro_resume(coro) != BCORO_TERMINATED) {}
+	while (bcoro_resume(clone) != BCORO_TERMINATED) {}
+	assert(output == 3);
+	free(clone);
+	free(coro);
+
+	// Pooled frames
+	bcoro_pool_t pool;
+	bcoro_pool_init(&pool, NULL);
+	bcoro_t* frames[64];
+	for (int i = 0; i < 64; ++i) {
+		frames[i] = bcoro_pool_alloc(&pool, peak);
+		assert(frames[i] != NULL);
+		for (int j = 0; j < i; ++j) { assert(frames[i] != frames[j]); }
+	}
+	// Frames from the same slab are contiguous
+	assert((size_t)((char*)frames[1] - (char*)frames[0]) >= bcoro_mem_size(peak));
+	assert((size_t)((char*)frames[1] - (char*)frames[0]) < 2 * bcoro_mem_size(peak));
+
+	output = 0;
+	for (int i = 0; i < 64; ++i) {
+		nested(frames[i], (frame_args_t){ .output = &output });
+	}
+	for (int i = 0; i < 64; ++i) {
+		while (bcoro_resume(frames[i]) != BCORO_TERMINATED) {}
+	}
+	assert(output == 64 * 3);
+
+	bcoro_pool_free(&pool, frames[10], peak);
+	bcoro_t* reused = bcoro_pool_alloc(&pool, peak);
+	assert(reused == frames[10]);
+	for (int i = 0; i < 64; ++i) { bcoro_pool_free(&pool, frames[i], peak); }
+
+	bcoro_t* too_large = bcoro_pool_alloc(&pool, (size_t)1 << 30);
+	assert(too_large == NULL);
+	(void)reused;
+	(void)too_large;
+	bcoro_pool_cleanup(&pool);
+
+	printf("frame OK\n");
+}
@@ -1,4 +1,5 @@
 #define BCORO_IMPLEMENTATION
+#define BCORO_SCHED
 #include "../../bcoro.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -112,11 +113,23 @@ BCORO(coro_fork, fork_args) {
 	printf("coro_fork(%p) terminated\n", (void*)BCORO_SELF);
 }
 
+void
+sched_test(void);
+
+void
+frame_test(void);
+
+void
+chan_test(void);
 
 int main(int argc, const char* argv[]) {
 	(void)argc;
 	(void)argv;
 
+	sched_test();
+	frame_test();
+	chan_test();
+
 	bcoro_t* coro = malloc(bcoro_mem_size(STACK_SIZE));
 	int out;
 	foo(coro, (args){ .input = 4, .output = &out });
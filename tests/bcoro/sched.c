@@ -0,0 +1,314 @@
+#define BCORO_SCHED
+#include "../../bcoro.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define NUM_TASKS 20000
+#define NUM_STEPS 10
+#define NUM_CHILDREN 100
+#define TASK_STACK_SIZE 512
+
+typedef struct {
+	int* output;
+	int steps;
+} count_args_t;
+
+BCORO(count_steps, count_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(int, i);
+
+	BCORO_SECTION_BODY
+	for (i = 0; i < BCORO_ARG.steps; ++i) {
+		*BCORO_ARG.output += 1;
+		BCORO_YIELD();
+	}
+
+	BCORO_SECTION_CLEANUP
+}
+
+typedef struct {
+	bcoro_task_t* task;
+	int* output;
+} await_args_t;
+
+// Awaits from inside a subcoroutine
+BCORO(await_child, await_args_t) {
+	BCORO_SECTION_VARS
+
+	BCORO_SECTION_BODY
+	BCORO_AWAIT(BCORO_ARG.task);
+	*BCORO_ARG.output += 1000;
+
+	BCORO_SECTION_CLEANUP
+}
+
+typedef struct {
+	bcoro_sched_t* sched;
+	bcoro_task_t** children;
+	int* results;
+	int* output;
+} fan_args_t;
+
+BCORO(fan_in, fan_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(int, i);
+	BCORO_VAR(int, sum);
+
+	BCORO_SECTION_BODY
+	for (i = 0; i < NUM_CHILDREN; ++i) {
+		BCORO_ARG.results[i] = 0;
+		BCORO_ARG.children[i] = bcoro_task_alloc(BCORO_ARG.sched, TASK_STACK_SIZE);
+		assert(BCORO_ARG.children[i] != NULL);
+		BCORO_SPAWN(BCORO_ARG.children[i], count_steps, ((count_args_t){
+			.output = &BCORO_ARG.results[i],
+			.steps = i % 5 + 1,
+		}));
+	}
+
+	sum = 0;
+	for (i = 0; i < NUM_CHILDREN; ++i) {
+		if (i % 2 == 0) {
+			BCORO_AWAIT(BCORO_ARG.children[i]);
+		} else {
+			BCORO_YIELD_FROM(await_child, ((await_args_t){
+				.task = BCORO_ARG.children[i],
+				.output = &sum,
+			}));
+			sum -= 1000;
+		}
+
+		assert(bcoro_task_done(BCORO_ARG.children[i]));
+		sum += BCORO_ARG.results[i];
+		bcoro_task_release(BCORO_ARG.children[i]);
+	}
+
+	*BCORO_ARG.output = sum;
+
+	BCORO_SECTION_CLEANUP
+}
+
+typedef struct {
+	int* woken;
+} park_args_t;
+
+BCORO(park_once, park_args_t) {
+	BCORO_SECTION_VARS
+
+	BCORO_SECTION_BODY
+	BCORO_PARK();
+	*BCORO_ARG.woken = 1;
+
+	BCORO_SECTION_CLEANUP
+}
+
+typedef struct {
+	uint32_t ms;
+	double* elapsed;
+} sleep_args_t;
+
+static double
+now_ms(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+BCORO(sleep_for, sleep_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(double, start);
+
+	BCORO_SECTION_BODY
+	start = now_ms();
+	BCORO_SLEEP(BCORO_ARG.ms);
+	*BCORO_ARG.elapsed = now_ms() - start;
+
+	BCORO_SECTION_CLEANUP
+}
+
+typedef struct {
+	bcoro_event_t* event;
+	int* woken;
+} event_args_t;
+
+BCORO(wait_event, event_args_t) {
+	BCORO_SECTION_VARS
+
+	BCORO_SECTION_BODY
+	BCORO_AWAIT_EVENT(BCORO_ARG.event);
+	*BCORO_ARG.woken = 1;
+
+	BCORO_SECTION_CLEANUP
+}
+
+#ifndef _WIN32
+
+typedef struct {
+	int fd;
+	char* output;
+} read_args_t;
+
+BCORO(read_byte, read_args_t) {
+	BCORO_SECTION_VARS
+
+	BCORO_SECTION_BODY
+	BCORO_AWAIT_READABLE(BCORO_ARG.fd);
+	{
+		ssize_t num_read = read(BCORO_ARG.fd, BCORO_ARG.output, 1);
+		assert(num_read == 1);
+		(void)num_read;
+	}
+
+	BCORO_SECTION_CLEANUP
+}
+
+#endif
+
+static void
+reactor_test(void) {
+	bcoro_sched_t* sched = bcoro_sched_create(&(bcoro_sched_config_t){
+		.num_workers = 2,
+		.reactor = true,
+	});
+	assert(sched != NULL);
+
+	// Timers resume in deadline order and never early
+	double elapsed[3] = { 0 };
+	uint32_t delays[3] = { 30, 10, 20 };
+	for (int i = 0; i < 3; ++i) {
+		bcoro_task_t* task = bcoro_task_alloc(sched, TASK_STACK_SIZE);
+		assert(task != NULL);
+		BCORO_SPAWN(task, sleep_for, ((sleep_args_t){
+			.ms = delays[i],
+			.elapsed = &elapsed[i],
+		}));
+		bcoro_task_release(task);
+	}
+	bcoro_sched_wait_idle(sched);
+	for (int i = 0; i < 3; ++i) {
+		assert(elapsed[i] >= (double)delays[i]);
+	}
+
+	// An event resumes all of its waiters
+	bcoro_event_t event;
+	bcoro_event_init(&event);
+	int woken[9] = { 0 };
+	bcoro_task_t* waiters[8];
+	for (int i = 0; i < 8; ++i) {
+		waiters[i] = bcoro_task_alloc(sched, TASK_STACK_SIZE);
+		assert(waiters[i] != NULL);
+		BCORO_SPAWN(waiters[i], wait_event, ((event_args_t){
+			.event = &event,
+			.woken = &woken[i],
+		}));
+	}
+	assert(!bcoro_event_is_set(&event));
+	bcoro_event_set(&event);
+	bcoro_sched_wait_idle(sched);
+	for (int i = 0; i < 8; ++i) {
+		assert(woken[i] == 1);
+		bcoro_task_release(waiters[i]);
+	}
+
+	// Waiting on a set event does not suspend
+	bcoro_task_t* late = bcoro_task_alloc(sched, TASK_STACK_SIZE);
+	BCORO_SPAWN(late, wait_event, ((event_args_t){ .event = &event, .woken = &woken[8] }));
+	bcoro_sched_wait_idle(sched);
+	assert(woken[8] == 1);
+	bcoro_task_release(late);
+
+	bcoro_event_reset(&event);
+	assert(!bcoro_event_is_set(&event));
+
+#ifndef _WIN32
+	// File descriptor readiness
+	int fds[2];
+	int pipe_result = pipe(fds);
+	assert(pipe_result == 0);
+	(void)pipe_result;
+	char byte = 0;
+	bcoro_task_t* reader = bcoro_task_alloc(sched, TASK_STACK_SIZE);
+	BCORO_SPAWN(reader, read_byte, ((read_args_t){ .fd = fds[0], .output = &byte }));
+	struct timespec delay = { .tv_nsec = 10 * 1000000 };
+	thrd_sleep(&delay, NULL);
+	assert(!bcoro_task_done(reader));
+	ssize_t num_written = write(fds[1], "x", 1);
+	assert(num_written == 1);
+	(void)num_written;
+	bcoro_sched_wait_idle(sched);
+	assert(byte == 'x');
+	bcoro_task_release(reader);
+	close(fds[0]);
+	close(fds[1]);
+#endif
+
+	bcoro_sched_destroy(sched);
+}
+
+void
+sched_test(void) {
+	bcoro_sched_t* sched = bcoro_sched_create(&(bcoro_sched_config_t){
+		.num_workers = 4,
+	});
+	assert(sched != NULL);
+
+	// Many concurrent tasks
+	int* outputs = calloc(NUM_TASKS, sizeof(int));
+	assert(outputs != NULL);
+	for (int i = 0; i < NUM_TASKS; ++i) {
+		bcoro_task_t* task = bcoro_task_alloc(sched, TASK_STACK_SIZE);
+		assert(task != NULL);
+		BCORO_SPAWN(task, count_steps, ((count_args_t){
+			.output = &outputs[i],
+			.steps = NUM_STEPS,
+		}));
+		bcoro_task_release(task);
+	}
+	bcoro_sched_wait_idle(sched);
+	for (int i = 0; i < NUM_TASKS; ++i) {
+		assert(outputs[i] == NUM_STEPS);
+	}
+	free(outputs);
+
+	// Fan out and join
+	bcoro_task_t* children[NUM_CHILDREN];
+	int results[NUM_CHILDREN];
+	int sum = -1;
+	bcoro_task_t* parent = bcoro_task_alloc(sched, TASK_STACK_SIZE);
+	assert(parent != NULL);
+	BCORO_SPAWN(parent, fan_in, ((fan_args_t){
+		.sched = sched,
+		.children = children,
+		.results = results,
+		.output = &sum,
+	}));
+	bcoro_sched_wait_idle(sched);
+	assert(bcoro_task_done(parent));
+	bcoro_task_release(parent);
+
+	int expected = 0;
+	for (int i = 0; i < NUM_CHILDREN; ++i) { expected += i % 5 + 1; }
+	assert(sum == expected);
+
+	// Parking and waking from outside
+	int woken = 0;
+	bcoro_task_t* parked = bcoro_task_alloc(sched, TASK_STACK_SIZE);
+	BCORO_SPAWN(parked, park_once, ((park_args_t){ .woken = &woken }));
+	bcoro_task_wake(parked);
+	bcoro_sched_wait_idle(sched);
+	assert(woken == 1);
+	bcoro_task_release(parked);
+
+	// Too large
+	assert(bcoro_task_alloc(sched, (size_t)1 << 30) == NULL);
+
+	bcoro_sched_destroy(sched);
+
+	reactor_test();
+	printf("sched OK\n");
+}
@@ -0,0 +1,180 @@
+#include "bench.h"
+#include "../../tlsf.h"
+#include "../../barena.h"
+#include "../tlsf/rnd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALLOC_NUM_OPS 200000
+#define ALLOC_NUM_SLOTS 1024
+#define ALLOC_ARENA_RESET_INTERVAL 1024
+
+// The same sequence of operations is replayed against every allocator.
+// Each operation picks a slot: a free slot is allocated and a live one is
+// freed.
+typedef struct {
+	uint32_t slot;
+	uint32_t size;
+} alloc_op_t;
+
+typedef struct {
+	alloc_op_t ops[ALLOC_NUM_OPS];
+	void* slots[ALLOC_NUM_SLOTS];
+	uint32_t alloc_samples[ALLOC_NUM_OPS];
+	uint32_t free_samples[ALLOC_NUM_OPS];
+} alloc_workload_t;
+
+typedef struct {
+	const char* name;
+	void* (*alloc)(void* ctx, size_t size);
+	void (*release)(void* ctx, void* ptr);
+	void* ctx;
+} alloc_impl_t;
+
+static void*
+alloc_tlsf_malloc(void* ctx, size_t size) {
+	return tlsf_malloc(ctx, size);
+}
+
+static void
+alloc_tlsf_free(void* ctx, void* ptr) {
+	tlsf_free(ctx, ptr);
+}
+
+static void*
+alloc_libc_malloc(void* ctx, size_t size) {
+	(void)ctx;
+	return malloc(size);
+}
+
+static void
+alloc_libc_free(void* ctx, void* ptr) {
+	(void)ctx;
+	free(ptr);
+}
+
+static void
+alloc_init_workload(alloc_workload_t* workload, uint32_t max_size) {
+	// Same generator as the tlsf random test
+	rnd_well_t rnd;
+	rnd_well_seed(&rnd, 42);
+	for (size_t i = 0; i < ALLOC_NUM_OPS; ++i) {
+		workload->ops[i] = (alloc_op_t){
+			.slot = rnd_well_next(&rnd) % ALLOC_NUM_SLOTS,
+			.size = rnd_well_next(&rnd) % max_size + 1,
+		};
+	}
+}
+
+static void
+alloc_run(alloc_workload_t* workload, const alloc_impl_t* impl, const char* param) {
+	size_t num_allocs = 0;
+	size_t num_frees = 0;
+	memset(workload->slots, 0, sizeof(workload->slots));
+
+	for (size_t i = 0; i < ALLOC_NUM_OPS; ++i) {
+		alloc_op_t op = workload->ops[i];
+		void** slot = &workload->slots[op.slot];
+
+		if (*slot == NULL) {
+			uint64_t start = bench_now();
+			*slot = impl->alloc(impl->ctx, op.size);
+			workload->alloc_samples[num_allocs++] = (uint32_t)(bench_now() - start);
+
+			if (*slot == NULL) {
+				fprintf(stderr, "%s: Could not allocate %u bytes\n", impl->name, op.size);
+				abort();
+			}
+			// Touch the memory so that the cost is not deferred to the next op
+			*(char*)*slot = (char)i;
+		} else {
+			bench_sink += (uint64_t)*(char*)*slot;
+
+			uint64_t start = bench_now();
+			impl->release(impl->ctx, *slot);
+			workload->free_samples[num_frees++] = (uint32_t)(bench_now() - start);
+
+			*slot = NULL;
+		}
+	}
+
+	for (size_t i = 0; i < ALLOC_NUM_SLOTS; ++i) {
+		if (workload->slots[i] != NULL) {
+			impl->release(impl->ctx, workload->slots[i]);
+		}
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "%s.malloc", impl->name);
+	bench_report_percentiles(name, param, workload->alloc_samples, num_allocs);
+	snprintf(name, sizeof(name), "%s.free", impl->name);
+	bench_report_percentiles(name, param, workload->free_samples, num_frees);
+}
+
+// An arena can only free everything at once so frees are skipped and the
+// arena is reset periodically instead
+static void
+alloc_run_arena(alloc_workload_t* workload, const char* param) {
+	barena_pool_t pool;
+	barena_pool_init(&pool, 1024 * 1024);
+	barena_t arena;
+	barena_init(&arena, &pool);
+
+	size_t num_allocs = 0;
+	for (size_t i = 0; i < ALLOC_NUM_OPS; ++i) {
+		alloc_op_t op = workload->ops[i];
+
+		uint64_t start = bench_now();
+		char* ptr = barena_malloc(&arena, op.size);
+		workload->alloc_samples[num_allocs++] = (uint32_t)(bench_now() - start);
+
+		*ptr = (char)i;
+		bench_sink += (uint64_t)*ptr;
+
+		if (num_allocs % ALLOC_ARENA_RESET_INTERVAL == 0) {
+			barena_reset(&arena);
+		}
+	}
+
+	barena_reset(&arena);
+	barena_pool_cleanup(&pool);
+
+	bench_report_percentiles("barena.malloc", param, workload->alloc_samples, num_allocs);
+}
+
+BENCH(alloc) {
+	alloc_workload_t* workload = malloc(sizeof(alloc_workload_t));
+	const uint32_t max_sizes[] = { 256, 4096, 65536 };
+	char param[64];
+
+	tlsf_t tlsf;
+	tlsf_init(&tlsf, (size_t)1 << 30);
+
+	const alloc_impl_t impls[] = {
+		{
+			.name = "tlsf",
+			.alloc = alloc_tlsf_malloc,
+			.release = alloc_tlsf_free,
+			.ctx = &tlsf,
+		},
+		{
+			.name = "libc",
+			.alloc = alloc_libc_malloc,
+			.release = alloc_libc_free,
+		},
+	};
+
+	for (size_t i = 0; i < sizeof(max_sizes) / sizeof(max_sizes[0]); ++i) {
+		alloc_init_workload(workload, max_sizes[i]);
+		snprintf(param, sizeof(param), "max_size=%u slots=%d", max_sizes[i], ALLOC_NUM_SLOTS);
+
+		for (size_t j = 0; j < sizeof(impls) / sizeof(impls[0]); ++j) {
+			alloc_run(workload, &impls[j], param);
+		}
+		alloc_run_arena(workload, param);
+	}
+
+	tlsf_cleanup(&tlsf);
+	free(workload);
+}
@@ -0,0 +1,46 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "../../autolist.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of times each throughput measurement is repeated.
+// The median is reported.
+#define BENCH_RUNS 5
+
+typedef struct {
+	const char* name;
+	void (*run)(void);
+} bench_t;
+
+#define BENCH(NAME) \
+	static void bench_##NAME(void); \
+	AUTOLIST_ENTRY(bench, bench_t, bench_entry_##NAME) = { \
+		.name = #NAME, \
+		.run = bench_##NAME, \
+	}; \
+	static void bench_##NAME(void)
+
+// Prevents the compiler from discarding a computation
+extern volatile uint64_t bench_sink;
+
+// Monotonic time in nanoseconds
+uint64_t
+bench_now(void);
+
+// Prints a result as a single line JSON object:
+//
+//     {"name":"bhash.find_hit","param":"load_percent=50","metric":"ns_per_op","value":12.345}
+void
+bench_report(const char* name, const char* param, const char* metric, double value);
+
+// Sorts the samples in place and returns the median
+double
+bench_median(double* samples, size_t count);
+
+// Sorts the samples in place and reports p50, p90, p99 and p999 in ns
+void
+bench_report_percentiles(const char* name, const char* param, uint32_t* samples_ns, size_t count);
+
+#endif
@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "../../bcoro.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CORO_NUM_RESUMES 1000000
+#define CORO_NUM_STARTS 100000
+#define CORO_STACK_SIZE (1024 * 16)
+
+typedef struct {
+	int depth;
+	int num_yields;
+} coro_args_t;
+
+// Yields num_yields times from the innermost of depth nested calls
+BCORO(coro_yield, coro_args_t) {
+	BCORO_SECTION_VARS
+	BCORO_VAR(int, i);
+
+	BCORO_SECTION_BODY
+	if (BCORO_ARG.depth > 0) {
+		BCORO_YIELD_FROM(coro_yield, ((coro_args_t){
+			.depth = BCORO_ARG.depth - 1,
+			.num_yields = BCORO_ARG.num_yields,
+		}));
+	} else {
+		for (i = 0; i < BCORO_ARG.num_yields; ++i) {
+			BCORO_YIELD();
+		}
+	}
+
+	BCORO_SECTION_CLEANUP
+}
+
+BENCH(bcoro) {
+	bcoro_t* coro = malloc(bcoro_mem_size(CORO_STACK_SIZE));
+	const int depths[] = { 0, 1, 4, 16 };
+	char param[64];
+
+	for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); ++i) {
+		double samples[BENCH_RUNS];
+		for (int run = 0; run < BENCH_RUNS; ++run) {
+			coro_yield(coro, (coro_args_t){ .depth = depths[i], .num_yields = CORO_NUM_RESUMES });
+
+			uint64_t num_resumes = 0;
+			uint64_t start = bench_now();
+			while (bcoro_resume(coro) != BCORO_TERMINATED) {
+				++num_resumes;
+			}
+			samples[run] = (double)(bench_now() - start) / (double)num_resumes;
+		}
+
+		snprintf(param, sizeof(param), "depth=%d", depths[i]);
+		bench_report("bcoro.resume", param, "ns_per_op", bench_median(samples, BENCH_RUNS));
+	}
+
+	// Starting and running a coroutine to completion
+	{
+		double samples[BENCH_RUNS];
+		for (int run = 0; run < BENCH_RUNS; ++run) {
+			uint64_t start = bench_now();
+			for (int j = 0; j < CORO_NUM_STARTS; ++j) {
+				coro_yield(coro, (coro_args_t){ .depth = 0, .num_yields = 0 });
+				while (bcoro_resume(coro) != BCORO_TERMINATED) { }
+			}
+			samples[run] = (double)(bench_now() - start) / (double)CORO_NUM_STARTS;
+		}
+
+		bench_report("bcoro.start", "", "ns_per_op", bench_median(samples, BENCH_RUNS));
+	}
+
+	free(coro);
+}
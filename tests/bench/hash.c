@@ -0,0 +1,296 @@
+#include "bench.h"
+#include "../../bhash.h"
+#include "../tlsf/rnd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef BHASH_TABLE(uint32_t, uint32_t) generic_table_t;
+
+BHASH_DEFINE_TYPED(typed_table, uint32_t, uint32_t, BHASH_TYPED_HASH, BHASH_TYPED_EQ)
+
+enum {
+	HASH_OP_INSERT,
+	HASH_OP_FIND_HIT,
+	HASH_OP_FIND_MISS,
+	HASH_OP_FIND_MANY,
+	HASH_OP_REMOVE,
+	HASH_OP_COUNT,
+};
+
+static const char* hash_op_names[HASH_OP_COUNT] = {
+	"insert",
+	"find_hit",
+	"find_miss",
+	"find_many",
+	"remove",
+};
+
+typedef struct {
+	uint32_t* keys;
+	uint32_t* misses;
+	bhash_index_t* indices;
+	size_t n;
+	double samples[HASH_OP_COUNT][BENCH_RUNS];
+} hash_workload_t;
+
+// Multiplying by an odd constant is a bijection so the keys are unique and
+// never 0.
+static inline uint32_t
+hash_key(size_t i) {
+	return (uint32_t)(i + 1) * 2654435761u;
+}
+
+static void
+hash_shuffle(uint32_t* keys, size_t n, rnd_pcg_t* rnd) {
+	for (size_t i = n - 1; i > 0; --i) {
+		size_t j = rnd_pcg_next(rnd) % (i + 1);
+		uint32_t tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+}
+
+static void
+hash_init_workload(hash_workload_t* workload, size_t n) {
+	workload->n = n;
+	workload->keys = malloc(sizeof(uint32_t) * n);
+	workload->misses = malloc(sizeof(uint32_t) * n);
+	workload->indices = malloc(sizeof(bhash_index_t) * n);
+	for (size_t i = 0; i < n; ++i) {
+		workload->keys[i] = hash_key(i);
+		workload->misses[i] = hash_key(n + i);
+	}
+
+	// Lookups are done in a different order than insertions so that the keys
+	// array is not walked sequentially
+	rnd_pcg_t rnd;
+	rnd_pcg_seed(&rnd, 42);
+	hash_shuffle(workload->misses, n, &rnd);
+}
+
+static void
+hash_cleanup_workload(hash_workload_t* workload) {
+	free(workload->keys);
+	free(workload->misses);
+	free(workload->indices);
+}
+
+static void
+hash_report(const hash_workload_t* workload, const char* name, const char* param) {
+	char metric_name[64];
+	for (int op = 0; op < HASH_OP_COUNT; ++op) {
+		double samples[BENCH_RUNS];
+		memcpy(samples, workload->samples[op], sizeof(samples));
+		if (samples[0] < 0.0) { continue; }
+
+		snprintf(metric_name, sizeof(metric_name), "%s.%s", name, hash_op_names[op]);
+		bench_report(metric_name, param, "ns_per_op", bench_median(samples, BENCH_RUNS));
+	}
+}
+
+static void
+hash_run_generic(hash_workload_t* workload, bhash_config_t config, int run) {
+	uint32_t* keys = workload->keys;
+	uint32_t* misses = workload->misses;
+	size_t n = workload->n;
+	uint64_t sum = 0;
+	uint64_t start;
+
+	generic_table_t table;
+	bhash_init(&table, config);
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		uint32_t value = (uint32_t)i;
+		bhash_put(&table, keys[i], value);
+	}
+	workload->samples[HASH_OP_INSERT][run] = (double)(bench_now() - start) / (double)n;
+
+	rnd_pcg_t rnd;
+	rnd_pcg_seed(&rnd, (RND_U32)run);
+	hash_shuffle(keys, n, &rnd);
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		sum += (uint64_t)bhash_find(&table, keys[i]);
+	}
+	workload->samples[HASH_OP_FIND_HIT][run] = (double)(bench_now() - start) / (double)n;
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		sum += (uint64_t)bhash_find(&table, misses[i]);
+	}
+	workload->samples[HASH_OP_FIND_MISS][run] = (double)(bench_now() - start) / (double)n;
+
+	start = bench_now();
+	bhash_find_many(&table, keys, (bhash_index_t)n, workload->indices);
+	workload->samples[HASH_OP_FIND_MANY][run] = (double)(bench_now() - start) / (double)n;
+	sum += (uint64_t)workload->indices[n / 2];
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		sum += (uint64_t)bhash_remove(&table, keys[i]);
+	}
+	workload->samples[HASH_OP_REMOVE][run] = (double)(bench_now() - start) / (double)n;
+
+	bhash_cleanup(&table);
+	bench_sink += sum;
+}
+
+static void
+hash_run_typed(hash_workload_t* workload, bhash_config_t config, int run) {
+	uint32_t* keys = workload->keys;
+	uint32_t* misses = workload->misses;
+	size_t n = workload->n;
+	uint64_t sum = 0;
+	uint64_t start;
+
+	typed_table_t table;
+	typed_table_init(&table, config);
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		bhash_index_t index = typed_table_alloc(&table, keys[i]).index;
+		table.keys[index] = keys[i];
+		table.values[index] = (uint32_t)i;
+	}
+	workload->samples[HASH_OP_INSERT][run] = (double)(bench_now() - start) / (double)n;
+
+	rnd_pcg_t rnd;
+	rnd_pcg_seed(&rnd, (RND_U32)run);
+	hash_shuffle(keys, n, &rnd);
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		sum += (uint64_t)typed_table_find(&table, keys[i]);
+	}
+	workload->samples[HASH_OP_FIND_HIT][run] = (double)(bench_now() - start) / (double)n;
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		sum += (uint64_t)typed_table_find(&table, misses[i]);
+	}
+	workload->samples[HASH_OP_FIND_MISS][run] = (double)(bench_now() - start) / (double)n;
+
+	// There is no typed batch lookup
+	workload->samples[HASH_OP_FIND_MANY][0] = -1.0;
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		sum += (uint64_t)typed_table_remove(&table, keys[i]);
+	}
+	workload->samples[HASH_OP_REMOVE][run] = (double)(bench_now() - start) / (double)n;
+
+	bhash_cleanup(&table);
+	bench_sink += sum;
+}
+
+// A minimal fixed-size linear probing table as a point of reference.
+// It never grows and does not support removal.
+static void
+hash_run_baseline(hash_workload_t* workload, bhash_index_t exp, int run) {
+	uint32_t* keys = workload->keys;
+	uint32_t* misses = workload->misses;
+	size_t n = workload->n;
+	size_t capacity = (size_t)1 << exp;
+	size_t mask = capacity - 1;
+	int shift = 64 - exp;
+	uint64_t sum = 0;
+	uint64_t start;
+
+	// A key of 0 marks an empty slot
+	uint32_t* slot_keys = calloc(capacity, sizeof(uint32_t));
+	uint32_t* slot_values = malloc(capacity * sizeof(uint32_t));
+
+	start = bench_now();
+	for (size_t i = 0; i < n; ++i) {
+		uint32_t key = keys[i];
+		size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> shift);
+		while (slot_keys[slot] != 0 && slot_keys[slot] != key) {
+			slot = (slot + 1) & mask;
+		}
+		slot_keys[slot] = key;
+		slot_values[slot] = (uint32_t)i;
+	}
+	workload->samples[HASH_OP_INSERT][run] = (double)(bench_now() - start) / (double)n;
+
+	rnd_pcg_t rnd;
+	rnd_pcg_seed(&rnd, (RND_U32)run);
+	hash_shuffle(keys, n, &rnd);
+
+	for (int op = HASH_OP_FIND_HIT; op <= HASH_OP_FIND_MISS; ++op) {
+		const uint32_t* lookups = op == HASH_OP_FIND_HIT ? keys : misses;
+
+		start = bench_now();
+		for (size_t i = 0; i < n; ++i) {
+			uint32_t key = lookups[i];
+			size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> shift);
+			while (slot_keys[slot] != 0 && slot_keys[slot] != key) {
+				slot = (slot + 1) & mask;
+			}
+			sum += slot_keys[slot] != 0 ? slot_values[slot] : 0;
+		}
+		workload->samples[op][run] = (double)(bench_now() - start) / (double)n;
+	}
+
+	workload->samples[HASH_OP_FIND_MANY][0] = -1.0;
+	workload->samples[HASH_OP_REMOVE][0] = -1.0;
+
+	free(slot_keys);
+	free(slot_values);
+	bench_sink += sum;
+}
+
+BENCH(bhash) {
+	const bhash_index_t exps[] = { 16, 20 };
+	const bhash_index_t load_percents[] = { 25, 50, 75, 90 };
+	char param[128];
+
+	for (size_t i = 0; i < sizeof(exps) / sizeof(exps[0]); ++i) {
+		for (size_t j = 0; j < sizeof(load_percents) / sizeof(load_percents[0]); ++j) {
+			bhash_index_t exp = exps[i];
+			bhash_index_t load_percent = load_percents[j];
+
+			// The table starts small and grows to exactly 2^exp slots filled up
+			// to load_percent
+			size_t n = ((size_t)1 << exp) * (size_t)load_percent / 100;
+			hash_workload_t workload;
+			hash_init_workload(&workload, n);
+
+			for (int group_probe = 0; group_probe <= 1; ++group_probe) {
+				bhash_config_t config = bhash_config_default();
+				config.load_percent = load_percent;
+				config.group_probe = group_probe;
+
+				snprintf(
+					param, sizeof(param),
+					"slots=%zu load_percent=%d group_probe=%d",
+					(size_t)1 << exp, (int)load_percent, group_probe
+				);
+
+				for (int run = 0; run < BENCH_RUNS; ++run) {
+					hash_run_generic(&workload, config, run);
+				}
+				hash_report(&workload, "bhash", param);
+
+				for (int run = 0; run < BENCH_RUNS; ++run) {
+					hash_run_typed(&workload, config, run);
+				}
+				hash_report(&workload, "bhash_typed", param);
+			}
+
+			snprintf(
+				param, sizeof(param),
+				"slots=%zu load_percent=%d",
+				(size_t)1 << exp, (int)load_percent
+			);
+			for (int run = 0; run < BENCH_RUNS; ++run) {
+				hash_run_baseline(&workload, exp, run);
+			}
+			hash_report(&workload, "baseline_linear_probe", param);
+
+			hash_cleanup_workload(&workload);
+		}
+	}
+}
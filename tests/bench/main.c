@@ -0,0 +1,120 @@
+#define BSERIAL_MEM
+#define BLIB_IMPLEMENTATION
+#include "bench.h"
+#include "../../bhash.h"
+#include "../../bserial.h"
+#include "../../barena.h"
+#include "../../tlsf.h"
+#include "../../bcoro.h"
+#define RND_IMPLEMENTATION
+#include "../tlsf/rnd.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+AUTOLIST_DECLARE(bench)
+
+volatile uint64_t bench_sink = 0;
+
+uint64_t
+bench_now(void) {
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = { 0 };
+	if (frequency.QuadPart == 0) { QueryPerformanceFrequency(&frequency); }
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull
+		+ (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / (uint64_t)frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void
+bench_report(const char* name, const char* param, const char* metric, double value) {
+	printf(
+		"{\"name\":\"%s\",\"param\":\"%s\",\"metric\":\"%s\",\"value\":%.3f}\n",
+		name, param, metric, value
+	);
+	fflush(stdout);
+}
+
+static int
+bench_cmp_double(const void* lhs, const void* rhs) {
+	double a = *(const double*)lhs;
+	double b = *(const double*)rhs;
+	return (a > b) - (a < b);
+}
+
+static int
+bench_cmp_u32(const void* lhs, const void* rhs) {
+	uint32_t a = *(const uint32_t*)lhs;
+	uint32_t b = *(const uint32_t*)rhs;
+	return (a > b) - (a < b);
+}
+
+double
+bench_median(double* samples, size_t count) {
+	qsort(samples, count, sizeof(samples[0]), bench_cmp_double);
+	return count % 2 == 1
+		? samples[count / 2]
+		: (samples[count / 2 - 1] + samples[count / 2]) * 0.5;
+}
+
+void
+bench_report_percentiles(const char* name, const char* param, uint32_t* samples_ns, size_t count) {
+	qsort(samples_ns, count, sizeof(samples_ns[0]), bench_cmp_u32);
+	bench_report(name, param, "p50_ns", samples_ns[count * 50 / 100]);
+	bench_report(name, param, "p90_ns", samples_ns[count * 90 / 100]);
+	bench_report(name, param, "p99_ns", samples_ns[count * 99 / 100]);
+	bench_report(name, param, "p999_ns", samples_ns[count * 999 / 1000]);
+}
+
+// Latency percentiles include the cost of reading the clock so it is reported
+// for reference
+static void
+bench_timer_overhead(void) {
+	enum { NUM_SAMPLES = 100000 };
+	static uint32_t samples[NUM_SAMPLES];
+	for (size_t i = 0; i < NUM_SAMPLES; ++i) {
+		uint64_t start = bench_now();
+		samples[i] = (uint32_t)(bench_now() - start);
+	}
+	bench_report_percentiles("timer", "", samples, NUM_SAMPLES);
+}
+
+// Usage: bench [filter...]
+// Only benchmarks whose name contains one of the filters are run.
+int main(int argc, const char* argv[]) {
+	bench_timer_overhead();
+
+	AUTOLIST_FOREACH(itr, bench) {
+		const autolist_entry_t* entry = *itr;
+		const bench_t* bench = entry->value_addr;
+
+		bool selected = argc <= 1;
+		for (int i = 1; i < argc; ++i) {
+			if (strstr(bench->name, argv[i]) != NULL) {
+				selected = true;
+				break;
+			}
+		}
+
+		if (selected) {
+			bench->run();
+		}
+	}
+
+	return 0;
+}
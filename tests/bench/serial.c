@@ -0,0 +1,158 @@
+#define BSERIAL_MEM
+#include "bench.h"
+#include "../bserial/record.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SERIAL_NUM_RECORDS 10000
+
+typedef enum {
+	SERIAL_SHAPE_RECORD,
+	SERIAL_SHAPE_TABLE,
+} serial_shape_t;
+
+typedef struct {
+	original_t* records;
+	original_t* read_records;
+	bserial_mem_out_t mem_out;
+	void* ctx_mem;
+	bserial_ctx_config_t ctx_config;
+} serial_workload_t;
+
+static bserial_status_t
+serial_records(bserial_ctx_t* ctx, original_t* records, serial_shape_t shape) {
+	if (shape == SERIAL_SHAPE_TABLE) {
+		uint64_t len = SERIAL_NUM_RECORDS;
+		BSERIAL_CHECK_STATUS(bserial_table(ctx, &len));
+		if (len != SERIAL_NUM_RECORDS) { return BSERIAL_MALFORMED; }
+	}
+
+	for (int i = 0; i < SERIAL_NUM_RECORDS; ++i) {
+		BSERIAL_CHECK_STATUS(serialize_original(ctx, &records[i]));
+	}
+
+	return BSERIAL_OK;
+}
+
+static double
+serial_write(serial_workload_t* workload, serial_shape_t shape) {
+	// Keep the buffer from the previous run
+	workload->mem_out.len = 0;
+	bserial_ctx_t* ctx = bserial_make_ctx(
+		workload->ctx_mem, workload->ctx_config,
+		NULL, &workload->mem_out.bserial
+	);
+
+	uint64_t start = bench_now();
+	bserial_status_t status = serial_records(ctx, workload->records, shape);
+	uint64_t time = bench_now() - start;
+
+	if (status != BSERIAL_OK) {
+		fprintf(stderr, "Serialization failed: %d\n", status);
+		abort();
+	}
+
+	return (double)time;
+}
+
+static double
+serial_read(serial_workload_t* workload, serial_shape_t shape) {
+	memset(workload->read_records, 0, sizeof(original_t) * SERIAL_NUM_RECORDS);
+
+	bserial_mem_in_t mem_in;
+	bserial_in_t* in = bserial_mem_init_in(&mem_in, workload->mem_out.mem, workload->mem_out.len);
+	bserial_ctx_t* ctx = bserial_make_ctx(workload->ctx_mem, workload->ctx_config, in, NULL);
+
+	uint64_t start = bench_now();
+	bserial_status_t status = serial_records(ctx, workload->read_records, shape);
+	uint64_t time = bench_now() - start;
+
+	if (
+		status != BSERIAL_OK
+		|| memcmp(workload->records, workload->read_records, sizeof(original_t) * SERIAL_NUM_RECORDS) != 0
+	) {
+		fprintf(stderr, "Deserialization failed: %d\n", status);
+		abort();
+	}
+
+	return (double)time;
+}
+
+static void
+serial_report(const char* name, const char* param, double* samples, double bytes) {
+	double ns = bench_median(samples, BENCH_RUNS);
+	bench_report(name, param, "mb_per_s", bytes / ns * 1000.0);
+	bench_report(name, param, "ns_per_record", ns / SERIAL_NUM_RECORDS);
+}
+
+BENCH(bserial) {
+	serial_workload_t workload = {
+		.ctx_config = {
+			.max_depth = 8,
+			.max_num_symbols = 64,
+			.max_symbol_len = 32,
+			.max_record_fields = 32,
+		},
+	};
+	workload.records = calloc(SERIAL_NUM_RECORDS, sizeof(original_t));
+	workload.read_records = calloc(SERIAL_NUM_RECORDS, sizeof(original_t));
+	workload.ctx_mem = malloc(bserial_ctx_mem_size(workload.ctx_config));
+	bserial_mem_init_out(&workload.mem_out, NULL);
+
+	for (int i = 0; i < SERIAL_NUM_RECORDS; ++i) {
+		original_t* rec = &workload.records[i];
+		rec->num = i * 7919;
+		snprintf(rec->str, sizeof(rec->str), "Record number %d", i);
+		rec->array_len = i % 8;
+		for (int j = 0; j < rec->array_len; ++j) {
+			rec->array[j] = i - j * 1000;
+		}
+		rec->vec2f = (vec2f_t){ (float)i * 0.5f, -(float)i };
+		rec->table_len = (i + 3) % 8;
+		for (int j = 0; j < rec->table_len; ++j) {
+			rec->table[j] = (vec2f_t){ (float)j, (float)(i + j) };
+		}
+	}
+
+	const serial_shape_t shapes[] = { SERIAL_SHAPE_RECORD, SERIAL_SHAPE_TABLE };
+	const char* shape_names[] = { "record", "table" };
+	char param[64];
+
+	for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); ++i) {
+		serial_shape_t shape = shapes[i];
+		double write_samples[BENCH_RUNS];
+		double read_samples[BENCH_RUNS];
+
+		// Warm up so that the output buffer is already grown
+		serial_write(&workload, shape);
+		for (int run = 0; run < BENCH_RUNS; ++run) {
+			write_samples[run] = serial_write(&workload, shape);
+			read_samples[run] = serial_read(&workload, shape);
+		}
+
+		double bytes = (double)workload.mem_out.len;
+		snprintf(param, sizeof(param), "shape=%s records=%d", shape_names[i], SERIAL_NUM_RECORDS);
+		bench_report("bserial", param, "encoded_bytes", bytes);
+		serial_report("bserial.serialize", param, write_samples, bytes);
+		serial_report("bserial.deserialize", param, read_samples, bytes);
+	}
+
+	// Copying the in-memory representation is the upper bound
+	{
+		double samples[BENCH_RUNS];
+		for (int run = 0; run < BENCH_RUNS; ++run) {
+			uint64_t start = bench_now();
+			memcpy(workload.read_records, workload.records, sizeof(original_t) * SERIAL_NUM_RECORDS);
+			samples[run] = (double)(bench_now() - start);
+			bench_sink += (uint64_t)workload.read_records[run].num;
+		}
+
+		snprintf(param, sizeof(param), "records=%d", SERIAL_NUM_RECORDS);
+		serial_report("baseline_memcpy", param, samples, (double)(sizeof(original_t) * SERIAL_NUM_RECORDS));
+	}
+
+	free(workload.mem_out.mem);
+	free(workload.ctx_mem);
+	free(workload.read_records);
+	free(workload.records);
+}
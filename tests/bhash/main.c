@@ -3,8 +3,17 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#ifndef __STDC_NO_THREADS__
+#include <threads.h>
+#include <stdatomic.h>
+#endif
+
 typedef BHASH_TABLE(int, char) table_t;
 
+BHASH_DEFINE_TYPED(int_table, int, int, BHASH_TYPED_HASH, BHASH_TYPED_EQ)
+
+typedef BHASH_CONCURRENT_TABLE(int, int) concurrent_table_t;
+
 enum {
 	BHASH_TEST_ADD,
 	BHASH_TEST_REMOVE,
@@ -12,12 +21,10 @@ enum {
 	BHASH_TEST_COUNT,
 };
 
-int main(int argc, const char* argv[]) {
-	(void)argc;
-	(void)argv;
-
+static void
+run_test(bhash_config_t config) {
 	table_t tbl;
-	bhash_init(&tbl, bhash_config_default());
+	bhash_init(&tbl, config);
 
 	// A simple boolean table to track membership of each number in [0, 10)
 	bool memberships[10] = { 0 };
@@ -105,9 +112,356 @@ int main(int argc, const char* argv[]) {
 		}
 
 		BHASH_ASSERT(size == bhash_len(&tbl), "%s: Size mismatch: %d vs %d", size, bhash_len(&tbl));
+
+		int keys[10];
+		bhash_index_t indices[10];
+		for (int j = 0; j < 10; ++j) { keys[j] = j; }
+		bhash_find_many(&tbl, keys, 10, indices);
+		for (int j = 0; j < 10; ++j) {
+			index = bhash_find(&tbl, j);
+			BHASH_ASSERT(indices[j] == index, "%s: Batch mismatch for %d", j);
+		}
+	}
+
+	bhash_cleanup(&tbl);
+}
+
+static void
+run_typed_test(bhash_config_t config) {
+	int_table_t tbl;
+	int_table_init(&tbl, config);
+
+	for (int i = 0; i < 1000; ++i) {
+		bhash_alloc_result_t result = int_table_alloc(&tbl, i);
+		assert(result.is_new);
+		tbl.keys[result.index] = i;
+		tbl.values[result.index] = i * 2;
+	}
+
+	for (int i = 0; i < 1000; i += 2) {
+		bhash_index_t index = int_table_remove(&tbl, i);
+		assert(bhash_is_valid(index));
+		BHASH_ASSERT(tbl.keys[index] == i, "%s: %d vs %d", tbl.keys[index], i);
+		bhash_validate(&tbl);
+	}
+
+	bhash_validate(&tbl);
+	BHASH_ASSERT(bhash_len(&tbl) == 500, "%s: Size mismatch: %d", bhash_len(&tbl));
+
+	for (int i = 0; i < 1000; ++i) {
+		bhash_index_t index = int_table_find(&tbl, i);
+		// Generic and specialized functions must agree
+		BHASH_ASSERT(index == bhash_find(&tbl, i), "%s: Mismatch for %d", i);
+		BHASH_ASSERT(bhash_is_valid(index) == (i % 2 == 1), "%s: Membership mismatch for %d", i);
+		if (bhash_is_valid(index)) {
+			BHASH_ASSERT(tbl.values[index] == i * 2, "%s: Value mismatch: %d vs %d", tbl.values[index], i * 2);
+			bhash_alloc_result_t result = int_table_alloc(&tbl, i);
+			assert(!result.is_new);
+			(void)result;
+		}
+	}
+
+	bhash_cleanup(&tbl);
+}
+
+static void
+run_build_test(bhash_config_t config, int n) {
+	int* keys = malloc(sizeof(int) * n);
+	int* values = malloc(sizeof(int) * n);
+	for (int i = 0; i < n; ++i) {
+		keys[i] = i * 7;
+		values[i] = i;
+	}
+
+	int_table_t tbl;
+	bhash_build(&tbl, keys, values, n, config);
+	bhash_validate(&tbl);
+	BHASH_ASSERT(bhash_len(&tbl) == n, "%s: Size mismatch: %d", bhash_len(&tbl));
+	for (int i = 0; i < n; ++i) {
+		BHASH_ASSERT(bhash_find(&tbl, keys[i]) == i, "%s: Index mismatch for %d", i);
+	}
+
+	// The table can still grow and shrink
+	for (int i = 0; i < n; ++i) {
+		int key = i * 7 + 1;
+		bhash_put(&tbl, key, i);
+	}
+	for (int i = 0; i < n; i += 2) {
+		bhash_index_t removed = bhash_remove(&tbl, keys[i]);
+		assert(bhash_is_valid(removed));
+		(void)removed;
+	}
+	bhash_validate(&tbl);
+	for (int i = 0; i < n; ++i) {
+		bhash_index_t index = bhash_find(&tbl, keys[i]);
+		BHASH_ASSERT(bhash_is_valid(index) == (i % 2 == 1), "%s: Membership mismatch for %d", i);
 	}
 
 	bhash_cleanup(&tbl);
+	free(values);
+	free(keys);
+}
+
+typedef struct {
+	char* data;
+	size_t size;
+} frozen_buf_t;
+
+static size_t
+frozen_buf_write(void* ctx, const void* buf, size_t size) {
+	frozen_buf_t* out = ctx;
+	out->data = realloc(out->data, out->size + size);
+	memcpy(out->data + out->size, buf, size);
+	out->size += size;
+	return size;
+}
+
+static void
+run_frozen_test(bhash_config_t config) {
+	int_table_t tbl;
+	bhash_init(&tbl, config);
+	for (int i = 0; i < 1000; ++i) {
+		bhash_put(&tbl, i, i * 3);
+	}
+	if (config.removable) {
+		for (int i = 0; i < 1000; i += 3) {
+			bhash_remove(&tbl, i);
+		}
+	}
+
+	frozen_buf_t buf = { 0 };
+	bool frozen_ok = bhash_freeze(&tbl, frozen_buf_write, &buf);
+	assert(frozen_ok);
+	BHASH_ASSERT(buf.size == bhash_frozen_size(&tbl), "%s: Size mismatch: %d", (int)buf.size);
+
+	int_table_t frozen;
+	bool loaded = bhash_load_frozen(&frozen, buf.data, buf.size - 1, config);
+	assert(!loaded);
+	bhash_cleanup(&frozen);
+	loaded = bhash_load_frozen(&frozen, buf.data, buf.size, config);
+	assert(loaded);
+	if (config.removable) { bhash_validate(&frozen); }
+	BHASH_ASSERT(bhash_len(&frozen) == bhash_len(&tbl), "%s: Size mismatch: %d", bhash_len(&frozen));
+	for (int i = 0; i < 1000; ++i) {
+		bhash_index_t index = bhash_find(&frozen, i);
+		BHASH_ASSERT(index == bhash_find(&tbl, i), "%s: Index mismatch for %d", i);
+		if (bhash_is_valid(index)) {
+			BHASH_ASSERT(frozen.values[index] == i * 3, "%s: Value mismatch for %d", i);
+		}
+	}
+
+	// Modifying the table copies it out of the image
+	char* image_copy = malloc(buf.size);
+	memcpy(image_copy, buf.data, buf.size);
+	for (int i = 1000; i < 2000; ++i) {
+		bhash_put(&frozen, i, i * 3);
+	}
+	if (config.removable) {
+		for (int i = 1; i < 2000; i += 3) {
+			bhash_index_t removed = bhash_remove(&frozen, i);
+			assert(bhash_is_valid(removed));
+			(void)removed;
+		}
+	}
+	if (config.removable) { bhash_validate(&frozen); }
+	assert(memcmp(image_copy, buf.data, buf.size) == 0);
+	(void)frozen_ok;
+	(void)loaded;
+
+	free(image_copy);
+	bhash_cleanup(&frozen);
+	bhash_cleanup(&tbl);
+	free(buf.data);
+}
+
+static void
+run_concurrent_test(void) {
+	concurrent_table_t tbl;
+	bhash_concurrent_init(&tbl, bhash_config_default(), 2);
+
+	// Reader 1 holds on to the initial version
+	bhash_concurrent_read_begin(&tbl, 1);
+
+	for (int i = 0; i < 1000; ++i) {
+		int value = i;
+		bhash_concurrent_put(&tbl, i, value);
+		value = i * 2;
+		bhash_concurrent_put(&tbl, i, value);
+	}
+	for (int i = 0; i < 1000; i += 2) {
+		bool removed = bhash_concurrent_remove(&tbl, i);
+		assert(removed);
+		removed = bhash_concurrent_remove(&tbl, i);
+		assert(!removed);
+		(void)removed;
+	}
+	BHASH_ASSERT(bhash_concurrent_len(&tbl) == 500, "%s: Size mismatch: %d", bhash_concurrent_len(&tbl));
+
+	for (int i = 0; i < 1000; ++i) {
+		int value = -1;
+		bool found = bhash_concurrent_get(&tbl, 0, i, &value);
+		BHASH_ASSERT(found == (i % 2 == 1), "%s: Membership mismatch for %d", i);
+		BHASH_ASSERT(bhash_concurrent_contains(&tbl, 1, i) == found, "%s: Membership mismatch for %d", i);
+		if (found) {
+			BHASH_ASSERT(value == i * 2, "%s: Value mismatch: %d vs %d", value, i * 2);
+		}
+	}
+
+	bhash_concurrent_reclaim(&tbl);
+	assert(tbl.base.retired != NULL);
+	bhash_concurrent_read_end(&tbl, 1);
+	bhash_concurrent_reclaim(&tbl);
+	assert(tbl.base.retired == NULL);
+
+	bhash_concurrent_cleanup(&tbl);
+}
+
+#ifndef __STDC_NO_THREADS__
+
+#define CONCURRENT_READERS 4
+#define CONCURRENT_STABLE_KEYS 256
+#define CONCURRENT_CHURN_KEYS 20000
+#define CONCURRENT_ROUNDS 8
+
+typedef struct {
+	concurrent_table_t* tbl;
+	atomic_bool* done;
+	bhash_index_t reader;
+} concurrent_reader_t;
+
+// Values always encode their key so a torn or stale entry is detectable
+static int
+concurrent_reader_thread(void* userdata) {
+	concurrent_reader_t* ctx = userdata;
+	concurrent_table_t* tbl = ctx->tbl;
+
+	while (!atomic_load(ctx->done)) {
+		bhash_concurrent_read_begin(tbl, ctx->reader);
+		for (int i = 0; i < CONCURRENT_STABLE_KEYS; ++i) {
+			int value = -1;
+			bool found = bhash_concurrent_get(tbl, ctx->reader, i, &value);
+			BHASH_ASSERT(found, "%s: Stable key %d is missing", i);
+			BHASH_ASSERT(value / 2 == i, "%s: Value mismatch for %d: %d", i, value);
+		}
+		bhash_concurrent_read_end(tbl, ctx->reader);
+
+		// Lookups outside of a section start their own
+		for (int i = 0; i < CONCURRENT_CHURN_KEYS; i += 97) {
+			int key = CONCURRENT_STABLE_KEYS + i;
+			int value = -1;
+			bool found = bhash_concurrent_get(tbl, ctx->reader, key, &value);
+			if (found) {
+				BHASH_ASSERT(value / 2 == key, "%s: Value mismatch for %d: %d", key, value);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void
+run_threaded_concurrent_test(void) {
+	concurrent_table_t tbl;
+	bhash_config_t config = bhash_config_default();
+	config.initial_exp = 4;
+	bhash_concurrent_init(&tbl, config, CONCURRENT_READERS);
+
+	for (int i = 0; i < CONCURRENT_STABLE_KEYS; ++i) {
+		int value = i * 2;
+		bhash_concurrent_put(&tbl, i, value);
+	}
+
+	atomic_bool done = false;
+	concurrent_reader_t readers[CONCURRENT_READERS];
+	thrd_t threads[CONCURRENT_READERS];
+	for (int i = 0; i < CONCURRENT_READERS; ++i) {
+		readers[i] = (concurrent_reader_t){ .tbl = &tbl, .done = &done, .reader = i };
+		int result = thrd_create(&threads[i], concurrent_reader_thread, &readers[i]);
+		assert(result == thrd_success);
+		(void)result;
+	}
+
+	for (int round = 0; round < CONCURRENT_ROUNDS; ++round) {
+		// Grow
+		for (int i = 0; i < CONCURRENT_CHURN_KEYS; ++i) {
+			int key = CONCURRENT_STABLE_KEYS + i;
+			int value = key * 2 + (round & 1);
+			bhash_concurrent_put(&tbl, key, value);
+		}
+
+		// Overwrite
+		for (int i = 0; i < CONCURRENT_STABLE_KEYS; ++i) {
+			int value = i * 2 + (round & 1);
+			bhash_concurrent_put(&tbl, i, value);
+		}
+
+		// Remove, the tombstones force a compacting rebuild in the next round
+		for (int i = 0; i < CONCURRENT_CHURN_KEYS; ++i) {
+			int key = CONCURRENT_STABLE_KEYS + i;
+			bool removed = bhash_concurrent_remove(&tbl, key);
+			assert(removed);
+			(void)removed;
+		}
+		BHASH_ASSERT(
+			bhash_concurrent_len(&tbl) == CONCURRENT_STABLE_KEYS,
+			"%s: Size mismatch: %d", bhash_concurrent_len(&tbl)
+		);
+		bhash_concurrent_reclaim(&tbl);
+	}
+
+	atomic_store(&done, true);
+	for (int i = 0; i < CONCURRENT_READERS; ++i) {
+		thrd_join(threads[i], NULL);
+	}
+
+	// All readers left so every replaced version can be freed
+	bhash_concurrent_reclaim(&tbl);
+	assert(tbl.base.retired == NULL);
+
+	bhash_concurrent_cleanup(&tbl);
+}
+
+#endif
+
+int main(int argc, const char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	run_test(bhash_config_default());
+
+	bhash_config_t group_config = bhash_config_default();
+	group_config.group_probe = true;
+	run_test(group_config);
+
+	bhash_config_t incremental_config = bhash_config_default();
+	incremental_config.incremental_rehash = 1;
+	run_test(incremental_config);
+	incremental_config.group_probe = true;
+	run_test(incremental_config);
+
+	run_typed_test(bhash_config_default());
+	run_typed_test(group_config);
+	run_typed_test(incremental_config);
+	incremental_config.group_probe = false;
+	incremental_config.incremental_rehash = 4;
+	run_typed_test(incremental_config);
+
+	run_build_test(bhash_config_default(), 0);
+	run_build_test(bhash_config_default(), 100);
+	run_build_test(bhash_config_default(), 70000);
+	run_build_test(group_config, 70000);
+	run_build_test(incremental_config, 70000);
+
+	run_frozen_test(bhash_config_default());
+	run_frozen_test(group_config);
+	bhash_config_t frozen_config = bhash_config_default();
+	frozen_config.removable = false;
+	run_frozen_test(frozen_config);
+
+	run_concurrent_test();
+#ifndef __STDC_NO_THREADS__
+	run_threaded_concurrent_test();
+#endif
 
 	return 0;
 }
@@ -1,73 +1,479 @@
 #define BRESMON_IMPLEMENTATION
+#define BHASH_IMPLEMENTATION
+#ifndef __STDC_NO_THREADS__
+#define BRESMON_BACKGROUND
+#endif
 #include "../../bresmon.h"
 #include <stdio.h>
-#include <signal.h>
+#include <string.h>
+#include <assert.h>
 
-static volatile sig_atomic_t should_run = 1;
+#if defined(_WIN32)
 
-#if defined(__linux__)
+#include <direct.h>
+
+static void
+make_dir(const char* path) {
+	_mkdir(path);
+}
+
+static void
+remove_dir(const char* path) {
+	_rmdir(path);
+}
 
-static void int_handler(int dummy) {
-    should_run = 0;
+static void
+sleep_ms(unsigned ms) {
+	Sleep(ms);
 }
 
-static void setup_ctrlc_handler(void) {
-	signal(SIGINT, int_handler);
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+
+static void
+make_dir(const char* path) {
+	mkdir(path, 0755);
+}
+
+static void
+remove_dir(const char* path) {
+	rmdir(path);
 }
 
-#elif defined(_WIN32)
+static void
+sleep_ms(unsigned ms) {
+	struct timespec delay = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000 };
+	nanosleep(&delay, NULL);
+}
 
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
 #endif
 
-#include <Windows.h>
+#define TEST_DIR "bresmon_test"
+// How long to keep polling before concluding that no more reloads will come
+#define SETTLE_MS 100
 
-static HANDLE main_thread = INVALID_HANDLE_VALUE;
+typedef struct {
+	int count;
+	char file[256];
+} reload_counter_t;
 
-static void WINAPI dummy_apc(ULONG_PTR ctx) {
-	(void)ctx;
+static void
+count_reload(const char* file, void* userdata) {
+	reload_counter_t* counter = userdata;
+	++counter->count;
+	snprintf(counter->file, sizeof(counter->file), "%s", file);
 }
 
-static BOOL WINAPI ctrl_handler(DWORD fdwCtrlType) {
-	should_run = 0;
-	QueueUserAPC(dummy_apc, main_thread, (ULONG_PTR)NULL);
-	CloseHandle(main_thread);
-	return TRUE;
+static void
+write_file(const char* path, const char* content) {
+	FILE* file = fopen(path, "wb");
+	assert(file != NULL);
+	fputs(content, file);
+	fclose(file);
 }
 
-static void setup_ctrlc_handler(void) {
-	main_thread = OpenThread(THREAD_ALL_ACCESS, FALSE, GetCurrentThreadId());
-	SetConsoleCtrlHandler(ctrl_handler, TRUE);
+// Poll for a while and return the number of reloads
+static int
+settle(bresmon_t* mon) {
+	int num_reloads = 0;
+	for (int i = 0; i < SETTLE_MS / 10; ++i) {
+		num_reloads += bresmon_check(mon, false);
+		sleep_ms(10);
+	}
+	return num_reloads;
 }
 
+static void
+multi_watch_test(void) {
+	make_dir(TEST_DIR "/a");
+	make_dir(TEST_DIR "/b");
+	const char* files[] = {
+		TEST_DIR "/a/one.txt",
+		TEST_DIR "/a/two.txt",
+		TEST_DIR "/a/three.txt",
+		TEST_DIR "/a/config.txt",
+		// Same name in another directory
+		TEST_DIR "/b/config.txt",
+	};
+	enum { NUM_FILES = sizeof(files) / sizeof(files[0]) };
+	for (int i = 0; i < NUM_FILES; ++i) { write_file(files[i], "initial"); }
+
+	bresmon_t* mon = bresmon_create(NULL);
+	reload_counter_t counters[NUM_FILES] = { 0 };
+	bresmon_watch_t* watches[NUM_FILES];
+	for (int i = 0; i < NUM_FILES; ++i) {
+		watches[i] = bresmon_watch(mon, files[i], count_reload, &counters[i]);
+		assert(watches[i] != NULL);
+	}
+	// A second watch of the same file shares its bucket
+	reload_counter_t duplicate_counter = { 0 };
+	bresmon_watch_t* duplicate = bresmon_watch(mon, files[0], count_reload, &duplicate_counter);
+	assert(duplicate != NULL);
+
+	// Several files in one directory and one in another
+	write_file(files[0], "changed");
+	write_file(files[2], "changed");
+	write_file(files[4], "changed");
+	// Writing twice still reloads once
+	write_file(files[2], "changed again");
+
+	int num_reloads = settle(mon);
+	assert(num_reloads == 4);
+	assert(counters[0].count == 1 && strcmp(counters[0].file, files[0]) == 0);
+	assert(counters[1].count == 0);
+	assert(counters[2].count == 1 && strcmp(counters[2].file, files[2]) == 0);
+	assert(counters[3].count == 0);
+	assert(counters[4].count == 1 && strcmp(counters[4].file, files[4]) == 0);
+	assert(duplicate_counter.count == 1);
+
+	// An unwatched file no longer reloads, its bucket neighbour still does
+	bresmon_unwatch(duplicate);
+	write_file(files[0], "changed");
+	num_reloads = settle(mon);
+	assert(num_reloads == 1);
+	assert(counters[0].count == 2);
+	assert(duplicate_counter.count == 1);
+
+#if defined(__linux__)
+	// Overflow the notification queue: every watch is reloaded exactly once
+	unsigned max_queued_events = 0;
+	FILE* limit = fopen("/proc/sys/fs/inotify/max_queued_events", "r");
+	if (limit != NULL) {
+		if (fscanf(limit, "%u", &max_queued_events) != 1) { max_queued_events = 0; }
+		fclose(limit);
+	}
+	if (max_queued_events > 0 && max_queued_events <= 1024 * 1024) {
+		for (int i = 0; i < NUM_FILES; ++i) { counters[i] = (reload_counter_t){ 0 }; }
+
+		// Alternate between files so inotify cannot merge the events
+		for (unsigned i = 0; i <= max_queued_events; ++i) {
+			write_file(files[i % 2], "overflow");
+		}
+
+		num_reloads = settle(mon);
+		assert(num_reloads == NUM_FILES);
+		for (int i = 0; i < NUM_FILES; ++i) { assert(counters[i].count == 1); }
+	}
 #endif
 
-static inline void
-reload(const char* file, void* type) {
-	printf("Reloading %s: %s\n", (char*)type, file);
+	(void)num_reloads;
+	for (int i = 0; i < NUM_FILES; ++i) { bresmon_unwatch(watches[i]); }
+	bresmon_destroy(mon);
+
+	for (int i = 0; i < NUM_FILES; ++i) { remove(files[i]); }
+	remove_dir(TEST_DIR "/a");
+	remove_dir(TEST_DIR "/b");
 }
 
-int main(int argc, const char* argv[]) {
-	(void)argc;
-	(void)argv;
+static void
+content_hash_test(void) {
+	make_dir(TEST_DIR "/hash");
+	make_dir(TEST_DIR "/hash/files");
+	make_dir(TEST_DIR "/hash/tree");
+	const char* file = TEST_DIR "/hash/files/file.txt";
+	const char* tree_file = TEST_DIR "/hash/tree/file.txt";
+	write_file(file, "initial");
 
-	bresmon_t* mon = bresmon_create(NULL);
-	bresmon_watch(mon, "mem_layout.h", reload, "header");
-	bresmon_watch(mon, "premake5.lua", reload, "script");
-
-	setup_ctrlc_handler();
-	while (should_run) {
-		int num_events = bresmon_should_reload(mon, true);
-		if (num_events > 0) {
-			printf("Received %d event(s)\n", num_events);
-			int num_reloads = bresmon_reload(mon);
-			printf("Reloaded %d resources\n", num_reloads);
+	bresmon_t* mon = bresmon_create_ex(&(bresmon_config_t){ .content_hash = true });
+	reload_counter_t counter = { 0 };
+	reload_counter_t tree_counter = { 0 };
+	bresmon_watch_t* watch = bresmon_watch(mon, file, count_reload, &counter);
+	bresmon_watch_t* tree = bresmon_watch_tree(mon, TEST_DIR "/hash/tree", count_reload, &tree_counter);
+	assert(watch != NULL && tree != NULL);
+
+	// The content of a watched file is known from the start
+	write_file(file, "initial");
+	int num_reloads = settle(mon);
+	assert(num_reloads == 0);
+	write_file(file, "changed");
+	num_reloads = settle(mon);
+	assert(num_reloads == 1);
+	write_file(file, "changed");
+	num_reloads = settle(mon);
+	assert(num_reloads == 0);
+	assert(counter.count == 1);
+
+	// Within a tree, only after the first change
+	write_file(tree_file, "initial");
+	num_reloads = settle(mon);
+	assert(num_reloads == 1);
+	write_file(tree_file, "initial");
+	num_reloads = settle(mon);
+	assert(num_reloads == 0);
+	write_file(tree_file, "changed");
+	num_reloads = settle(mon);
+	assert(num_reloads == 1);
+	assert(tree_counter.count == 2);
+
+	(void)num_reloads;
+	bresmon_unwatch(watch);
+	bresmon_unwatch(tree);
+	bresmon_destroy(mon);
+
+	remove(file);
+	remove(tree_file);
+	remove_dir(TEST_DIR "/hash/files");
+	remove_dir(TEST_DIR "/hash/tree");
+	remove_dir(TEST_DIR "/hash");
+}
+
+#if defined(__linux__)
+
+#define MAX_TREE_RELOADS 16
+
+typedef struct {
+	int count;
+	char files[MAX_TREE_RELOADS][256];
+} tree_reloads_t;
+
+static void
+record_tree_reload(const char* file, void* userdata) {
+	tree_reloads_t* reloads = userdata;
+	assert(reloads->count < MAX_TREE_RELOADS);
+	snprintf(reloads->files[reloads->count++], sizeof(reloads->files[0]), "%s", file);
+}
+
+// The callback receives real paths, compare only their end
+static inline int
+count_tree_reloads(const tree_reloads_t* reloads, const char* suffix) {
+	size_t suffix_len = strlen(suffix);
+	int count = 0;
+	for (int i = 0; i < reloads->count; ++i) {
+		size_t len = strlen(reloads->files[i]);
+		if (len >= suffix_len && strcmp(reloads->files[i] + len - suffix_len, suffix) == 0) {
+			++count;
 		}
 	}
+	return count;
+}
+
+static void
+move_dir(const char* from, const char* to) {
+	int result = rename(from, to);
+	assert(result == 0);
+	(void)result;
+}
+
+static void
+tree_test(void) {
+	make_dir(TEST_DIR "/tree");
+	make_dir(TEST_DIR "/tree/sub");
+	make_dir(TEST_DIR "/staging");
+	make_dir(TEST_DIR "/staging/a");
+	make_dir(TEST_DIR "/staging/a/b");
+	write_file(TEST_DIR "/staging/a/b/moved.txt", "initial");
+
+	bresmon_t* mon = bresmon_create(NULL);
+	tree_reloads_t reloads = { 0 };
+	bresmon_watch_t* tree = bresmon_watch_tree(mon, TEST_DIR "/tree", record_tree_reload, &reloads);
+	assert(tree != NULL);
+	assert(tree->tree->dirmons.len == 2);
+
+	// Nested directories whose files are written before they are watched
+	make_dir(TEST_DIR "/tree/new");
+	make_dir(TEST_DIR "/tree/new/nested");
+	write_file(TEST_DIR "/tree/new/nested/created.txt", "initial");
+	write_file(TEST_DIR "/tree/new/top.txt", "initial");
+	// A whole directory moved in
+	move_dir(TEST_DIR "/staging/a", TEST_DIR "/tree/sub/a");
+
+	int num_reloads = settle(mon);
+	assert(num_reloads == 3);
+	assert(count_tree_reloads(&reloads, "/tree/new/nested/created.txt") == 1);
+	assert(count_tree_reloads(&reloads, "/tree/new/top.txt") == 1);
+	assert(count_tree_reloads(&reloads, "/tree/sub/a/b/moved.txt") == 1);
+	assert(tree->tree->dirmons.len == 6);
+
+	// They are watched from now on
+	reloads.count = 0;
+	write_file(TEST_DIR "/tree/new/nested/created.txt", "changed");
+	write_file(TEST_DIR "/tree/sub/a/b/moved.txt", "changed");
+	num_reloads = settle(mon);
+	assert(num_reloads == 2);
+	assert(count_tree_reloads(&reloads, "/tree/new/nested/created.txt") == 1);
+	assert(count_tree_reloads(&reloads, "/tree/sub/a/b/moved.txt") == 1);
+
+	// A directory moved out of the tree is no longer watched
+	move_dir(TEST_DIR "/tree/sub/a", TEST_DIR "/staging/a");
+	num_reloads = settle(mon);
+	assert(num_reloads == 0);
+	assert(tree->tree->dirmons.len == 4);
+	reloads.count = 0;
+	write_file(TEST_DIR "/staging/a/b/moved.txt", "outside");
+	num_reloads = settle(mon);
+	assert(num_reloads == 0);
+	assert(reloads.count == 0);
+
+	// A deleted directory is cleaned up when inotify drops its watch
+	remove(TEST_DIR "/tree/new/nested/created.txt");
+	remove_dir(TEST_DIR "/tree/new/nested");
+	num_reloads = settle(mon);
+	assert(num_reloads == 0);
+	assert(tree->tree->dirmons.len == 3);
+
+	(void)num_reloads;
+	bresmon_unwatch(tree);
+	bresmon_destroy(mon);
+
+	remove(TEST_DIR "/tree/new/top.txt");
+	remove_dir(TEST_DIR "/tree/new");
+	remove_dir(TEST_DIR "/tree/sub");
+	remove_dir(TEST_DIR "/tree");
+	remove(TEST_DIR "/staging/a/b/moved.txt");
+	remove_dir(TEST_DIR "/staging/a/b");
+	remove_dir(TEST_DIR "/staging/a");
+	remove_dir(TEST_DIR "/staging");
+}
+
+static void
+shared_dirmon_test(void) {
+	make_dir(TEST_DIR "/shared");
+	const char* file = TEST_DIR "/shared/file.txt";
+	write_file(file, "initial");
+
+	bresmon_t* mon = bresmon_create(NULL);
+	reload_counter_t counter = { 0 };
+	tree_reloads_t reloads = { 0 };
+	bresmon_watch_t* watch = bresmon_watch(mon, file, count_reload, &counter);
+	bresmon_watch_t* tree = bresmon_watch_tree(mon, TEST_DIR "/shared", record_tree_reload, &reloads);
+	assert(watch != NULL && tree != NULL);
+	assert(tree->tree->dirmons.len == 1 && tree->tree->dirmons.items[0] == watch->dirmon);
+
+	write_file(file, "changed");
+	int num_reloads = settle(mon);
+	assert(num_reloads == 2);
+	assert(counter.count == 1);
+	assert(count_tree_reloads(&reloads, "/shared/file.txt") == 1);
+
+	// Either one can go first without disturbing the other
+	bresmon_unwatch(tree);
+	write_file(file, "changed");
+	num_reloads = settle(mon);
+	assert(num_reloads == 1);
+	assert(counter.count == 2);
+	assert(reloads.count == 1);
+
+	reloads.count = 0;
+	tree = bresmon_watch_tree(mon, TEST_DIR "/shared", record_tree_reload, &reloads);
+	assert(tree != NULL);
+	bresmon_unwatch(watch);
+	write_file(file, "changed");
+	num_reloads = settle(mon);
+	assert(num_reloads == 1);
+	assert(counter.count == 2);
+	assert(count_tree_reloads(&reloads, "/shared/file.txt") == 1);
+
+	(void)num_reloads;
+	bresmon_unwatch(tree);
+	bresmon_destroy(mon);
+
+	remove(file);
+	remove_dir(TEST_DIR "/shared");
+}
+
+#endif
+
+#ifdef BRESMON_BACKGROUND
+
+#define DEBOUNCE_MS 100
+
+static void
+background_test(void) {
+	make_dir(TEST_DIR "/bg");
+	const char* file = TEST_DIR "/bg/file.txt";
+	const char* other_file = TEST_DIR "/bg/other.txt";
+	write_file(file, "initial");
+	write_file(other_file, "initial");
+
+	bresmon_config_t config = {
+		.background = true,
+		.debounce_ms = DEBOUNCE_MS,
+	};
+	bresmon_t* mon = bresmon_create_ex(&config);
+	assert(mon->background);
+	reload_counter_t counter = { 0 };
+	bresmon_watch_t* watch = bresmon_watch(mon, file, count_reload, &counter);
+	assert(watch != NULL);
+
+	// Several writes within the debounce window coalesce into one reload
+	for (int i = 0; i < 5; ++i) {
+		write_file(file, "changed");
+		sleep_ms(10);
+	}
+	int num_ready = bresmon_should_reload(mon, true);
+	assert(num_ready == 1);
+	int num_reloads = bresmon_reload(mon);
+	assert(num_reloads == 1);
+	assert(counter.count == 1);
+
+	// Nothing else comes after the window
+	sleep_ms(2 * DEBOUNCE_MS);
+	num_reloads = bresmon_check(mon, false);
+	assert(num_reloads == 0);
+	assert(counter.count == 1);
 
-	printf("Cleaning up\n");
+	// Unwatch while the change is still in its debounce window
+	reload_counter_t other_counter = { 0 };
+	bresmon_watch_t* other_watch = bresmon_watch(mon, other_file, count_reload, &other_counter);
+	assert(other_watch != NULL);
+	write_file(file, "pending");
+	sleep_ms(DEBOUNCE_MS / 5);
+	bresmon_unwatch(watch);
+
+	// Unwatch once the change was handed over but not yet drained
+	write_file(other_file, "queued");
+	sleep_ms(2 * DEBOUNCE_MS);
+	assert(bresmon_atomic_load_ptr(&mon->queue) != NULL);
+	bresmon_unwatch(other_watch);
+
+	sleep_ms(2 * DEBOUNCE_MS);
+	num_reloads = bresmon_check(mon, false);
+	assert(num_reloads == 0);
+	assert(counter.count == 1);
+	assert(other_counter.count == 0);
+	bresmon_destroy(mon);
+
+	// Destroy while a change is pending and while one is queued
+	mon = bresmon_create_ex(&config);
+	watch = bresmon_watch(mon, file, count_reload, &counter);
+	other_watch = bresmon_watch(mon, other_file, count_reload, &other_counter);
+	write_file(other_file, "queued");
+	sleep_ms(2 * DEBOUNCE_MS);
+	write_file(file, "pending");
+	sleep_ms(DEBOUNCE_MS / 5);
 	bresmon_destroy(mon);
+	assert(counter.count == 1);
+	assert(other_counter.count == 0);
+
+	(void)num_ready;
+	(void)num_reloads;
+	remove(file);
+	remove(other_file);
+	remove_dir(TEST_DIR "/bg");
+}
+
+#endif
+
+int main(int argc, const char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	make_dir(TEST_DIR);
+
+	multi_watch_test();
+	content_hash_test();
+#if defined(__linux__)
+	tree_test();
+	shared_dirmon_test();
+#endif
+#ifdef BRESMON_BACKGROUND
+	background_test();
+#endif
+
+	remove_dir(TEST_DIR);
 
 	return 0;
 }
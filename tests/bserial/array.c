@@ -93,3 +93,125 @@ TEST(array, nested) {
 	assert(serialize_nested_array(ctx, &array2) == BSERIAL_OK);
 	assert(memcmp(&src_array, &array2, sizeof(nested_array_t)) == 0);
 }
+
+TEST(array, packed_uint) {
+	static uint64_t values[1000];
+	for (int i = 0; i < 1000; ++i) {
+		// Cover every width
+		values[i] = ((uint64_t)i * UINT64_C(0x9E3779B97F4A7C15)) >> ((i % 8) * 8);
+	}
+	values[0] = 0;
+	values[1] = UINT64_MAX;
+
+	uint64_t lens[] = { 0, 1, 63, 64, 65, 1000 };
+	int num_lens = sizeof(lens) / sizeof(lens[0]);
+	bserial_ctx_t* ctx = common_fixture.out_ctx;
+	for (int i = 0; i < num_lens; ++i) {
+		uint64_t len = lens[i];
+		assert(bserial_uint_array(ctx, values, &len) == BSERIAL_OK);
+	}
+
+	ctx = common_fixture_make_in_ctx();
+	static uint64_t values2[1000];
+	for (int i = 0; i < num_lens; ++i) {
+		memset(values2, 0, sizeof(values2));
+		uint64_t len = sizeof(values2) / sizeof(values2[0]);
+		assert(bserial_uint_array(ctx, values2, &len) == BSERIAL_OK);
+		assert(len == lens[i]);
+		assert(memcmp(values, values2, sizeof(values[0]) * len) == 0);
+	}
+}
+
+typedef struct {
+	uint64_t ids[100];
+	uint64_t num;
+} packed_record_t;
+
+static inline bserial_status_t
+serialize_packed_record(bserial_ctx_t* ctx, packed_record_t* rec, bool with_ids) {
+	BSERIAL_RECORD(ctx, rec) {
+		if (with_ids) {
+			BSERIAL_KEY(ctx, ids) {
+				uint64_t len = sizeof(rec->ids) / sizeof(rec->ids[0]);
+				BSERIAL_CHECK_STATUS(bserial_uint_array(ctx, rec->ids, &len));
+			}
+		}
+
+		BSERIAL_KEY(ctx, num) {
+			BSERIAL_CHECK_STATUS(bserial_uint(ctx, &rec->num));
+		}
+	}
+
+	return bserial_status(ctx);
+}
+
+TEST(array, packed_uint_skip) {
+	packed_record_t rec = { .num = 42 };
+	for (int i = 0; i < 100; ++i) {
+		rec.ids[i] = (uint64_t)i << (i % 64);
+	}
+
+	bserial_ctx_t* ctx = common_fixture.out_ctx;
+	assert(serialize_packed_record(ctx, &rec, true) == BSERIAL_OK);
+	assert(serialize_packed_record(ctx, &rec, true) == BSERIAL_OK);
+
+	ctx = common_fixture_make_in_ctx();
+	packed_record_t rec2 = { 0 };
+	assert(serialize_packed_record(ctx, &rec2, false) == BSERIAL_OK);
+	assert(rec2.num == rec.num);
+
+	packed_record_t rec3 = { 0 };
+	assert(serialize_packed_record(ctx, &rec3, true) == BSERIAL_OK);
+	assert(memcmp(&rec, &rec3, sizeof(rec)) == 0);
+}
+
+TEST(array, seek) {
+	packed_record_t recs[5] = { 0 };
+	uint64_t offsets[5];
+	for (int i = 0; i < 5; ++i) {
+		recs[i].num = (uint64_t)i * 10;
+		for (int j = 0; j < 100; ++j) {
+			recs[i].ids[j] = (uint64_t)(i + j);
+		}
+	}
+
+	bserial_ctx_t* ctx = common_fixture.out_ctx;
+	uint64_t len = 5;
+	assert(bserial_array(ctx, &len) == BSERIAL_OK);
+	for (uint64_t i = 0; i < len; ++i) {
+		assert(bserial_sync_point(ctx, &offsets[i]) == BSERIAL_OK);
+		assert(serialize_packed_record(ctx, &recs[i], true) == BSERIAL_OK);
+	}
+	assert(bserial_write_index(ctx, offsets, len) == BSERIAL_OK);
+
+	// Sequential read passes through the sync points
+	ctx = common_fixture_make_in_ctx();
+	assert(bserial_array(ctx, &len) == BSERIAL_OK);
+	assert(len == 5);
+	for (uint64_t i = 0; i < len; ++i) {
+		packed_record_t rec = { 0 };
+		assert(bserial_sync_point(ctx, &offsets[i]) == BSERIAL_OK);
+		assert(serialize_packed_record(ctx, &rec, true) == BSERIAL_OK);
+		assert(memcmp(&rec, &recs[i], sizeof(rec)) == 0);
+	}
+
+	uint64_t index[5];
+	uint64_t index_len = 0;
+	assert(bserial_read_index(ctx, NULL, &index_len) == BSERIAL_OK);
+	assert(index_len == 5);
+	index_len = 4;
+	assert(bserial_read_index(ctx, index, &index_len) == BSERIAL_MALFORMED);
+	ctx = common_fixture_make_in_ctx();
+	index_len = 5;
+	assert(bserial_read_index(ctx, index, &index_len) == BSERIAL_OK);
+	assert(memcmp(index, offsets, sizeof(offsets)) == 0);
+
+	// Random access in any order
+	int order[] = { 3, 0, 4, 1, 2 };
+	for (int i = 0; i < 5; ++i) {
+		packed_record_t rec = { 0 };
+		assert(bserial_seek(ctx, index[order[i]]) == BSERIAL_OK);
+		assert(serialize_packed_record(ctx, &rec, order[i] % 2 == 0) == BSERIAL_OK);
+		assert(rec.num == recs[order[i]].num);
+	}
+}
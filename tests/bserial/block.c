@@ -0,0 +1,178 @@
+#include "common.h"
+#include "record.h"
+#include <assert.h>
+#include <string.h>
+
+static suite_t block = {
+	.name = "block",
+	.init = common_fixture_init,
+	.cleanup = common_fixture_cleanup,
+};
+
+#define BLOCK_SIZE 256
+
+static size_t
+store_compress(
+	void* userdata,
+	const void* src, size_t src_size,
+	void* dst, size_t dst_capacity
+) {
+	(void)userdata;
+	(void)src;
+	(void)src_size;
+	(void)dst;
+	(void)dst_capacity;
+	return 0;
+}
+
+static void
+round_trip_with_codec(bserial_block_codec_t codec) {
+	original_t rec = {
+		.num = -69420,
+		.str = "Hello",
+		.array_len = 3,
+		.array = { 1, 2, 3 },
+
+		.table_len = 2,
+		.table = {
+			{ 1.2f, 1.3f },
+			{ 3.4f, -4.5f },
+		},
+	};
+	char* buffer = barena_malloc(&common_fixture.arena, bserial_block_buffer_size(BLOCK_SIZE));
+
+	bserial_block_out_t block_out;
+	bserial_ctx_t* out = bserial_make_ctx(
+		barena_malloc(&common_fixture.arena, bserial_ctx_mem_size(common_fixture.ctx_config)),
+		common_fixture.ctx_config,
+		NULL,
+		bserial_block_init_out(&block_out, &common_fixture.mem_out.bserial, codec, buffer, BLOCK_SIZE)
+	);
+	uint64_t len = 100;
+	assert(bserial_array(out, &len) == BSERIAL_OK);
+	for (uint64_t i = 0; i < len; ++i) {
+		assert(serialize_original(out, &rec) == BSERIAL_OK);
+	}
+	assert(bserial_block_flush(&block_out) == BSERIAL_OK);
+
+	bserial_in_t* mem_in = bserial_mem_init_in(
+		&common_fixture.mem_in,
+		common_fixture.mem_out.mem,
+		common_fixture.mem_out.len
+	);
+	bserial_block_in_t block_in;
+	bserial_ctx_t* in = bserial_make_ctx(
+		barena_malloc(&common_fixture.arena, bserial_ctx_mem_size(common_fixture.ctx_config)),
+		common_fixture.ctx_config,
+		bserial_block_init_in(&block_in, mem_in, codec, buffer, BLOCK_SIZE),
+		NULL
+	);
+	assert(bserial_array(in, &len) == BSERIAL_OK);
+	assert(len == 100);
+	for (uint64_t i = 0; i < len; ++i) {
+		original_t rec2 = { 0 };
+		// Skip most of the fields in some records
+		if (i % 3 == 0) {
+			assert(serialize_original_skip(in, &rec2, 2) == BSERIAL_OK);
+			assert(rec2.num == rec.num);
+		} else {
+			assert(serialize_original(in, &rec2) == BSERIAL_OK);
+			assert(memcmp(&rec, &rec2, sizeof(rec)) == 0);
+		}
+	}
+	assert(common_fixture.mem_in.cur == common_fixture.mem_in.end);
+}
+
+TEST(block, round_trip) {
+	round_trip_with_codec(bserial_block_lz_codec());
+}
+
+TEST(block, stored) {
+	round_trip_with_codec((bserial_block_codec_t){
+		.compress = store_compress,
+		.decompress = NULL,
+	});
+}
+
+TEST(block, skip) {
+	char blob[4000];
+	for (size_t i = 0; i < sizeof(blob); ++i) {
+		blob[i] = (char)("abcabd"[i % 6] + (i / 1000));
+	}
+	char* buffer = barena_malloc(&common_fixture.arena, bserial_block_buffer_size(BLOCK_SIZE));
+
+	bserial_block_out_t block_out;
+	bserial_ctx_t* out = bserial_make_ctx(
+		barena_malloc(&common_fixture.arena, bserial_ctx_mem_size(common_fixture.ctx_config)),
+		common_fixture.ctx_config,
+		NULL,
+		bserial_block_init_out(
+			&block_out,
+			&common_fixture.mem_out.bserial,
+			bserial_block_lz_codec(),
+			buffer, BLOCK_SIZE
+		)
+	);
+	uint64_t len = sizeof(blob);
+	uint64_t num = 42;
+	assert(bserial_blob(out, blob, &len) == BSERIAL_OK);
+	assert(bserial_uint(out, &num) == BSERIAL_OK);
+	assert(bserial_blob(out, blob, &len) == BSERIAL_OK);
+	assert(bserial_block_flush(&block_out) == BSERIAL_OK);
+	assert(common_fixture.mem_out.len < sizeof(blob));
+
+	bserial_in_t* mem_in = bserial_mem_init_in(
+		&common_fixture.mem_in,
+		common_fixture.mem_out.mem,
+		common_fixture.mem_out.len
+	);
+	bserial_block_in_t block_in;
+	bserial_in_t* in = bserial_block_init_in(&block_in, mem_in, bserial_block_lz_codec(), buffer, BLOCK_SIZE);
+
+	// Skip over the first blob then read the rest
+	uint8_t marker;
+	uint64_t value;
+	assert(bserial_read(in, &marker, 1) == BSERIAL_OK);
+	assert(bserial_read_uint(&value, in) == BSERIAL_OK);
+	assert(value == sizeof(blob));
+	assert(bserial_skip(in, sizeof(blob)) == BSERIAL_OK);
+
+	bserial_ctx_t* ctx = bserial_make_ctx(
+		barena_malloc(&common_fixture.arena, bserial_ctx_mem_size(common_fixture.ctx_config)),
+		common_fixture.ctx_config,
+		in,
+		NULL
+	);
+	char blob2[sizeof(blob)];
+	assert(bserial_uint(ctx, &value) == BSERIAL_OK);
+	assert(value == num);
+	assert(bserial_blob(ctx, blob2, &len) == BSERIAL_OK);
+	assert(memcmp(blob, blob2, sizeof(blob)) == 0);
+}
+
+TEST(block, lz_codec) {
+	bserial_block_codec_t codec = bserial_block_lz_codec();
+	uint8_t src[1000];
+	uint8_t packed[sizeof(src)];
+	uint8_t unpacked[sizeof(src)];
+	uint32_t state = 1;
+	for (size_t i = 0; i < sizeof(src); ++i) {
+		// Runs of mixed lengths
+		state = state * 1103515245u + 12345u;
+		src[i] = i % 97 < 50 ? (uint8_t)(i % 7) : (uint8_t)(state >> 24);
+	}
+
+	size_t packed_size = codec.compress(NULL, src, sizeof(src), packed, sizeof(packed));
+	assert(0 < packed_size && packed_size < sizeof(src));
+	assert(codec.decompress(NULL, packed, packed_size, unpacked, sizeof(unpacked)) == sizeof(src));
+	assert(memcmp(src, unpacked, sizeof(src)) == 0);
+
+	// Truncated input must not read or write out of bounds
+	for (size_t i = 0; i < packed_size; ++i) {
+		size_t size = codec.decompress(NULL, packed, i, unpacked, sizeof(unpacked));
+		assert(size <= sizeof(unpacked));
+	}
+
+	// Not enough capacity
+	assert(codec.compress(NULL, src, sizeof(src), packed, packed_size - 1) == 0);
+}
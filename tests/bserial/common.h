@@ -3,6 +3,8 @@
 
 #define BSERIAL_MEM
 #define BSERIAL_STDIO
+#define BSERIAL_THREADS
+#define BSERIAL_BLOCK
 #include "../../autolist.h"
 #include "../../bserial.h"
 #include "../../barena.h"
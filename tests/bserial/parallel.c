@@ -0,0 +1,148 @@
+#include "common.h"
+#include <assert.h>
+#include <string.h>
+
+static suite_t parallel = {
+	.name = "parallel",
+	.init = common_fixture_init,
+	.cleanup = common_fixture_cleanup,
+};
+
+#define NUM_CHUNKS 10
+#define CHUNK_LEN 7
+#define NUM_THREADS 3
+
+typedef struct {
+	uint64_t id;
+	int64_t delta;
+} event_t;
+
+static const char* const event_symbols[] = { "id" };
+
+static inline bserial_status_t
+serialize_event(bserial_ctx_t* ctx, event_t* event) {
+	BSERIAL_RECORD(ctx, event) {
+		BSERIAL_KEY(ctx, id) {
+			BSERIAL_CHECK_STATUS(bserial_uint(ctx, &event->id));
+		}
+
+		BSERIAL_KEY(ctx, delta) {
+			BSERIAL_CHECK_STATUS(bserial_sint(ctx, &event->delta));
+		}
+	}
+
+	return bserial_status(ctx);
+}
+
+static inline bserial_status_t
+serialize_chunk(bserial_ctx_t* ctx, event_t* events, uint64_t* len) {
+	BSERIAL_CHECK_STATUS(bserial_array(ctx, len));
+	for (uint64_t i = 0; i < *len; ++i) {
+		BSERIAL_CHECK_STATUS(serialize_event(ctx, &events[i]));
+	}
+
+	return BSERIAL_OK;
+}
+
+typedef struct {
+	event_t buffers[NUM_THREADS][CHUNK_LEN];
+	uint64_t buffer_lens[NUM_THREADS];
+	event_t events[NUM_CHUNKS * CHUNK_LEN];
+	uint64_t num_events;
+	uint64_t fail_at;
+} decode_state_t;
+
+static bserial_status_t
+decode_chunk(bserial_ctx_t* ctx, uint32_t thread_index, uint64_t chunk_index, void* userdata) {
+	(void)chunk_index;
+	decode_state_t* state = userdata;
+	state->buffer_lens[thread_index] = CHUNK_LEN;
+	return serialize_chunk(ctx, state->buffers[thread_index], &state->buffer_lens[thread_index]);
+}
+
+static bserial_status_t
+deliver_chunk(uint32_t thread_index, uint64_t chunk_index, void* userdata) {
+	decode_state_t* state = userdata;
+	if (chunk_index == state->fail_at) { return BSERIAL_MALFORMED; }
+
+	memcpy(
+		&state->events[state->num_events],
+		state->buffers[thread_index],
+		sizeof(event_t) * state->buffer_lens[thread_index]
+	);
+	state->num_events += state->buffer_lens[thread_index];
+	return BSERIAL_OK;
+}
+
+TEST(parallel, decode_chunks) {
+	event_t events[NUM_CHUNKS * CHUNK_LEN];
+	for (uint64_t i = 0; i < NUM_CHUNKS * CHUNK_LEN; ++i) {
+		events[i] = (event_t){ .id = i, .delta = (int64_t)i * -3 };
+	}
+
+	bserial_ctx_t* ctx = common_fixture.out_ctx;
+	assert(bserial_symbol_dict(ctx, event_symbols, 1) == BSERIAL_OK);
+
+	uint64_t offsets[NUM_CHUNKS];
+	for (uint64_t i = 0; i < NUM_CHUNKS; ++i) {
+		uint64_t len = CHUNK_LEN;
+		assert(bserial_sync_point(ctx, &offsets[i]) == BSERIAL_OK);
+		assert(serialize_chunk(ctx, &events[i * CHUNK_LEN], &len) == BSERIAL_OK);
+	}
+	assert(bserial_write_index(ctx, offsets, NUM_CHUNKS) == BSERIAL_OK);
+
+	ctx = common_fixture_make_in_ctx();
+	uint64_t index[NUM_CHUNKS];
+	uint64_t num_chunks = NUM_CHUNKS;
+	assert(bserial_read_index(ctx, index, &num_chunks) == BSERIAL_OK);
+	assert(num_chunks == NUM_CHUNKS);
+
+	bserial_mem_in_t mem_ins[NUM_THREADS];
+	bserial_in_t* streams[NUM_THREADS];
+	for (int i = 0; i < NUM_THREADS; ++i) {
+		streams[i] = bserial_mem_init_in(
+			&mem_ins[i],
+			common_fixture.mem_out.mem,
+			common_fixture.mem_out.len
+		);
+	}
+
+	decode_state_t* state = barena_malloc(&common_fixture.arena, sizeof(decode_state_t));
+	*state = (decode_state_t){ .fail_at = UINT64_MAX };
+	bserial_decode_chunks_options_t options = {
+		.num_threads = NUM_THREADS,
+		.ctx_config = common_fixture.ctx_config,
+		.streams = streams,
+		.symbols = event_symbols,
+		.num_symbols = 1,
+		.decode = decode_chunk,
+		.deliver = deliver_chunk,
+		.userdata = state,
+	};
+	void* mem = barena_malloc(
+		&common_fixture.arena,
+		bserial_decode_chunks_mem_size(NUM_THREADS, common_fixture.ctx_config)
+	);
+	assert(bserial_decode_chunks(mem, &options, index, num_chunks) == BSERIAL_OK);
+	assert(state->num_events == NUM_CHUNKS * CHUNK_LEN);
+	assert(memcmp(state->events, events, sizeof(events)) == 0);
+
+	// Errors stop all threads
+	*state = (decode_state_t){ .fail_at = 4 };
+	assert(bserial_decode_chunks(mem, &options, index, num_chunks) == BSERIAL_MALFORMED);
+	assert(state->num_events == 4 * CHUNK_LEN);
+	assert(memcmp(state->events, events, sizeof(event_t) * state->num_events) == 0);
+
+	// Without the dictionary, symbol references are invalid
+	options.num_symbols = 0;
+	*state = (decode_state_t){ .fail_at = UINT64_MAX };
+	assert(bserial_decode_chunks(mem, &options, index, num_chunks) == BSERIAL_MALFORMED);
+	assert(state->num_events == 0);
+
+	// There must be at least one thread
+	options.num_threads = 0;
+	bserial_status_t status = bserial_decode_chunks(mem, &options, index, num_chunks);
+	assert(status == BSERIAL_IO_ERROR);
+	assert(state->num_events == 0);
+	(void)status;
+}
@@ -56,3 +56,120 @@ TEST(stdio, round_trip) {
 		fclose(in_file);
 	}
 }
+
+static void
+buffered_round_trip(size_t buffer_size) {
+	original_t rec = {
+		.num = -69420,
+		.str = "Hello",
+		.array_len = 3,
+		.array = { 1, 2, 3 },
+
+		.table_len = 2,
+		.table = {
+			{ 1.2f, 1.3f },
+			{ 3.4f, -4.5f },
+		},
+	};
+	char* buffer = barena_malloc(&common_fixture.arena, buffer_size);
+
+	{
+		FILE* out_file = fopen("stdio.bserial", "wb");
+		assert(out_file != NULL);
+
+		bserial_stdio_out_t stdio_out;
+		bserial_ctx_t* out = bserial_make_ctx(
+			barena_malloc(&common_fixture.arena, bserial_ctx_mem_size(common_fixture.ctx_config)),
+			common_fixture.ctx_config,
+			NULL,
+			bserial_stdio_init_buffered_out(&stdio_out, out_file, buffer, buffer_size)
+		);
+		assert(serialize_original(out, &rec) == BSERIAL_OK);
+		assert(bserial_stdio_flush(&stdio_out) == BSERIAL_OK);
+		fclose(out_file);
+	}
+
+	{
+		FILE* in_file = fopen("stdio.bserial", "rb");
+		assert(in_file != NULL);
+
+		bserial_stdio_in_t stdio_in;
+		bserial_ctx_t* in = bserial_make_ctx(
+			barena_malloc(&common_fixture.arena, bserial_ctx_mem_size(common_fixture.ctx_config)),
+			common_fixture.ctx_config,
+			bserial_stdio_init_buffered_in(&stdio_in, in_file, buffer, buffer_size),
+			NULL
+		);
+
+		original_t rec2 = { 0 };
+		assert(serialize_original(in, &rec2) == BSERIAL_OK);
+
+		assert(memcmp(&rec, &rec2, sizeof(rec)) == 0);
+		fclose(in_file);
+	}
+}
+
+TEST(stdio, buffered_round_trip) {
+	// Small buffers exercise the boundaries between fast and slow paths
+	buffered_round_trip(1);
+	buffered_round_trip(3);
+	buffered_round_trip(11);
+	buffered_round_trip(4096);
+}
+
+TEST(stdio, seek) {
+	char buffer[16];
+	uint64_t offsets[100];
+
+	{
+		FILE* out_file = fopen("stdio.bserial", "wb");
+		assert(out_file != NULL);
+
+		bserial_stdio_out_t stdio_out;
+		bserial_ctx_t* out = bserial_make_ctx(
+			barena_malloc(&common_fixture.arena, bserial_ctx_mem_size(common_fixture.ctx_config)),
+			common_fixture.ctx_config,
+			NULL,
+			bserial_stdio_init_buffered_out(&stdio_out, out_file, buffer, sizeof(buffer))
+		);
+
+		uint64_t len = 100;
+		assert(bserial_array(out, &len) == BSERIAL_OK);
+		for (uint64_t i = 0; i < len; ++i) {
+			uint64_t value = i * i;
+			assert(bserial_sync_point(out, &offsets[i]) == BSERIAL_OK);
+			assert(bserial_uint(out, &value) == BSERIAL_OK);
+		}
+		assert(bserial_write_index(out, offsets, len) == BSERIAL_OK);
+		assert(bserial_stdio_flush(&stdio_out) == BSERIAL_OK);
+		fclose(out_file);
+	}
+
+	{
+		FILE* in_file = fopen("stdio.bserial", "rb");
+		assert(in_file != NULL);
+
+		bserial_stdio_in_t stdio_in;
+		bserial_ctx_t* in = bserial_make_ctx(
+			barena_malloc(&common_fixture.arena, bserial_ctx_mem_size(common_fixture.ctx_config)),
+			common_fixture.ctx_config,
+			bserial_stdio_init_buffered_in(&stdio_in, in_file, buffer, sizeof(buffer)),
+			NULL
+		);
+
+		uint64_t index[100];
+		uint64_t len = 100;
+		assert(bserial_read_index(in, index, &len) == BSERIAL_OK);
+		assert(len == 100);
+		assert(memcmp(index, offsets, sizeof(offsets)) == 0);
+
+		for (uint64_t i = 0; i < len; ++i) {
+			uint64_t element = (i * 37) % len;
+			uint64_t value;
+			assert(bserial_seek(in, index[element]) == BSERIAL_OK);
+			assert(bserial_uint(in, &value) == BSERIAL_OK);
+			assert(value == element * element);
+		}
+		fclose(in_file);
+	}
+}
@@ -168,3 +168,107 @@ TEST(table, missing_fields) {
 		barena_restore(&common_fixture.arena, snapshot);
 	}
 }
+
+#define COLUMNAR_ROWS 200
+
+typedef struct {
+	uint64_t num_rows;
+	int64_t timestamp[COLUMNAR_ROWS];
+	int64_t delta[COLUMNAR_ROWS];
+	uint64_t id[COLUMNAR_ROWS];
+	float x[COLUMNAR_ROWS];
+	double y[COLUMNAR_ROWS];
+} columnar_t;
+
+enum {
+	COLUMNAR_TIMESTAMP = 1 << 0,
+	COLUMNAR_DELTA     = 1 << 1,
+	COLUMNAR_ID        = 1 << 2,
+	COLUMNAR_X         = 1 << 3,
+	COLUMNAR_Y         = 1 << 4,
+	COLUMNAR_ALL       = (1 << 5) - 1,
+};
+
+static inline bserial_status_t
+serialize_columnar(bserial_ctx_t* ctx, columnar_t* rec, int columns) {
+	BSERIAL_RECORD(ctx, rec) {
+		if (columns & COLUMNAR_TIMESTAMP) {
+			BSERIAL_KEY(ctx, timestamp) {
+				uint64_t len = rec->num_rows;
+				BSERIAL_CHECK_STATUS(bserial_sint_column(ctx, rec->timestamp, &len, true));
+				rec->num_rows = len;
+			}
+		}
+
+		if (columns & COLUMNAR_DELTA) {
+			BSERIAL_KEY(ctx, delta) {
+				uint64_t len = rec->num_rows;
+				BSERIAL_CHECK_STATUS(bserial_sint_column(ctx, rec->delta, &len, false));
+				rec->num_rows = len;
+			}
+		}
+
+		if (columns & COLUMNAR_ID) {
+			BSERIAL_KEY(ctx, id) {
+				uint64_t len = rec->num_rows;
+				BSERIAL_CHECK_STATUS(bserial_uint_column(ctx, rec->id, &len));
+				rec->num_rows = len;
+			}
+		}
+
+		if (columns & COLUMNAR_X) {
+			BSERIAL_KEY(ctx, x) {
+				uint64_t len = rec->num_rows;
+				BSERIAL_CHECK_STATUS(bserial_f32_column(ctx, rec->x, &len));
+				rec->num_rows = len;
+			}
+		}
+
+		if (columns & COLUMNAR_Y) {
+			BSERIAL_KEY(ctx, y) {
+				uint64_t len = rec->num_rows;
+				BSERIAL_CHECK_STATUS(bserial_f64_column(ctx, rec->y, &len));
+				rec->num_rows = len;
+			}
+		}
+	}
+
+	return bserial_status(ctx);
+}
+
+TEST(table, columnar) {
+	static columnar_t rec = { .num_rows = COLUMNAR_ROWS };
+	for (int i = 0; i < COLUMNAR_ROWS; ++i) {
+		rec.timestamp[i] = INT64_C(1700000000000) + i * 16 - (i % 3);
+		rec.delta[i] = (i % 2 == 0 ? -1 : 1) * (int64_t)i * i;
+		rec.id[i] = (uint64_t)i << (i % 64);
+		rec.x[i] = (float)i * 0.5f;
+		rec.y[i] = (double)i * -0.25;
+	}
+	rec.delta[0] = INT64_MIN;
+	rec.delta[1] = INT64_MAX;
+
+	bserial_ctx_t* ctx = common_fixture.out_ctx;
+	assert(serialize_columnar(ctx, &rec, COLUMNAR_ALL) == BSERIAL_OK);
+	assert(serialize_columnar(ctx, &rec, COLUMNAR_ALL) == BSERIAL_OK);
+	assert(serialize_columnar(ctx, &rec, COLUMNAR_ALL) == BSERIAL_OK);
+
+	ctx = common_fixture_make_in_ctx();
+
+	static columnar_t rec2;
+	rec2 = (columnar_t){ .num_rows = COLUMNAR_ROWS };
+	assert(serialize_columnar(ctx, &rec2, COLUMNAR_ALL) == BSERIAL_OK);
+	assert(memcmp(&rec, &rec2, sizeof(rec)) == 0);
+
+	// Only read a few columns
+	rec2 = (columnar_t){ .num_rows = COLUMNAR_ROWS };
+	assert(serialize_columnar(ctx, &rec2, COLUMNAR_DELTA | COLUMNAR_Y) == BSERIAL_OK);
+	assert(memcmp(rec.delta, rec2.delta, sizeof(rec.delta)) == 0);
+	assert(memcmp(rec.y, rec2.y, sizeof(rec.y)) == 0);
+	assert(rec2.timestamp[1] == 0);
+	assert(rec2.id[1] == 0);
+
+	// Not enough space
+	rec2 = (columnar_t){ .num_rows = COLUMNAR_ROWS - 1 };
+	assert(serialize_columnar(ctx, &rec2, COLUMNAR_ID) == BSERIAL_MALFORMED);
+}
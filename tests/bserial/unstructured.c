@@ -57,6 +57,34 @@ TEST(unstructured, blob) {
 	assert(strncmp(str, buf, len) == 0);
 }
 
+TEST(unstructured, blob_view) {
+	bserial_ctx_t* ctx = common_fixture.out_ctx;
+	const char* str = "Hello world";
+	uint64_t len = strlen(str);
+	assert(bserial_blob_view(ctx, &str, &len) == BSERIAL_OK);
+	const char* empty = "";
+	len = 0;
+	assert(bserial_blob_view(ctx, &empty, &len) == BSERIAL_OK);
+
+	ctx = common_fixture_make_in_ctx();
+
+	const char* view = NULL;
+	assert(bserial_blob_view(ctx, &view, &len) == BSERIAL_OK);
+	assert(len == strlen(str));
+	assert(strncmp(str, view, len) == 0);
+	// The view points into the input memory
+	assert(view > common_fixture.mem_out.mem);
+	assert(view + len <= common_fixture.mem_out.mem + common_fixture.mem_out.len);
+
+	view = NULL;
+	assert(bserial_blob_view(ctx, &view, &len) == BSERIAL_OK);
+	assert(len == 0);
+	assert(view != NULL);
+
+	// Out of data
+	assert(bserial_blob_view(ctx, &view, &len) == BSERIAL_IO_ERROR);
+}
+
 static inline bserial_status_t
 write_symbol(bserial_ctx_t* ctx, const char** sym) {
 	uint64_t len = strlen(*sym);
@@ -102,3 +130,39 @@ TEST(unstructured, symbol) {
 	const char* literal = "again";
 	assert(strcmp(d, literal) == 0);
 }
+
+typedef struct {
+	bserial_in_t bserial;
+	const char* cur;
+	const char* end;
+} custom_in_t;
+
+static size_t
+custom_read(bserial_in_t* in, void* buf, size_t size) {
+	custom_in_t* custom_in = (custom_in_t*)in;
+	// Hand out at most one byte at a time
+	if (custom_in->cur == custom_in->end || size == 0) { return 0; }
+
+	memcpy(buf, custom_in->cur++, 1);
+	return 1;
+}
+
+TEST(unstructured, custom_stream) {
+	uint64_t written = 123456789;
+	bserial_status_t status = bserial_write_uint(written, &common_fixture.mem_out.bserial);
+	assert(status == BSERIAL_OK);
+
+	custom_in_t custom_in;
+	// Fields which are not set explicitly must not be left as garbage
+	memset(&custom_in, 0xff, sizeof(custom_in));
+	bserial_init_in(&custom_in.bserial, custom_read);
+	custom_in.cur = common_fixture.mem_out.mem;
+	custom_in.end = common_fixture.mem_out.mem + common_fixture.mem_out.len;
+	assert(custom_in.bserial.buf_cur == NULL && custom_in.bserial.buf_end == NULL);
+
+	uint64_t value = 0;
+	status = bserial_read_uint(&value, &custom_in.bserial);
+	assert(status == BSERIAL_OK);
+	assert(value == written);
+	(void)status;
+}
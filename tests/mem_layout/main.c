@@ -11,6 +11,68 @@ typedef struct {
     float* floats;
 } var_struct;
 
+typedef struct {
+	float x, y, z;
+} vec3;
+
+enum {
+	ENTITY_POSITION,
+	ENTITY_HEALTH,
+	ENTITY_FLAGS,
+	ENTITY_NUM_COLUMNS,
+};
+
+static int
+soa_example(void) {
+	// An entity table with one aligned array per field
+	mem_layout_column_t columns[ENTITY_NUM_COLUMNS] = {
+		[ENTITY_POSITION] = MEM_LAYOUT_COLUMN(vec3),
+		[ENTITY_HEALTH] = MEM_LAYOUT_COLUMN(float),
+		[ENTITY_FLAGS] = MEM_LAYOUT_COLUMN(uint8_t),
+	};
+	mem_layout_soa_t entities;
+	mem_layout_soa_init(&entities, columns, ENTITY_NUM_COLUMNS, MEM_LAYOUT_CACHE_LINE_SIZE, NULL);
+
+	int num_errors = 0;
+	size_t len = 0;
+	for (size_t capacity = 4; capacity <= 1024; capacity *= 4) {
+		// All columns are relocated in one go
+		if (!mem_layout_soa_resize(&entities, capacity, len)) { return 1; }
+
+		vec3* positions = mem_layout_soa_column(&entities, ENTITY_POSITION);
+		float* health = mem_layout_soa_column(&entities, ENTITY_HEALTH);
+		uint8_t* flags = mem_layout_soa_column(&entities, ENTITY_FLAGS);
+		for (size_t i = 0; i < ENTITY_NUM_COLUMNS; ++i) {
+			if ((uintptr_t)mem_layout_soa_column(&entities, i) % MEM_LAYOUT_CACHE_LINE_SIZE != 0) {
+				++num_errors;
+			}
+		}
+		for (size_t i = 0; i < len; ++i) {
+			if (positions[i].x != (float)i || health[i] != (float)(i * 2) || flags[i] != (uint8_t)i) {
+				++num_errors;
+			}
+		}
+
+		for (; len < capacity; ++len) {
+			positions[len] = (vec3){ (float)len, 0.f, 0.f };
+			health[len] = (float)(len * 2);
+			flags[len] = (uint8_t)len;
+		}
+	}
+
+	// Shrinking keeps the first elements
+	mem_layout_soa_resize(&entities, 10, len);
+	float* health = mem_layout_soa_column(&entities, ENTITY_HEALTH);
+	for (size_t i = 0; i < 10; ++i) {
+		if (health[i] != (float)(i * 2)) { ++num_errors; }
+	}
+
+	printf("SoA size = %zu, errors = %d\n", entities.size, num_errors);
+	mem_layout_soa_cleanup(&entities);
+
+	return num_errors > 0;
+}
+
 int main(int argc, const char* argv[]) {
 	(void)argc;
 	(void)argv;
@@ -56,5 +118,5 @@ int main(int argc, const char* argv[]) {
 
 	free(buffer);
 
-	return 0;
+	return soa_example();
 }
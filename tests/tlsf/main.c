@@ -25,8 +25,13 @@
 
 #define TLSF_IMPLEMENTATION
 #define TLSF_ENABLE_CHECK
+#define TLSF_ENABLE_STATS
 #include "../../tlsf.h"
 
+#ifndef __STDC_NO_THREADS__
+#include <threads.h>
+#endif
+
 #define rand() rnd_well_next(&rnd_state)
 
 static size_t PAGE;
@@ -153,6 +158,426 @@ static void large_size_test(tlsf_t *t)
     }
 }
 
+static void stats_test(void)
+{
+    tlsf_t t;
+    tlsf_init(&t, 16 * 1024 * 1024);
+
+    tlsf_stats_t stats;
+    tlsf_stats(&t, &stats);
+    assert(stats.heap_size == 0 && stats.free_count == 0);
+
+    void *a = tlsf_malloc(&t, 100);
+    void *b = tlsf_malloc(&t, 5000);
+    void *c = tlsf_malloc(&t, 100);
+    assert(a && b && c);
+    tlsf_free(&t, b);
+
+    tlsf_stats(&t, &stats);
+    assert(stats.heap_size == t.size);
+    assert(stats.used_size + stats.free_size == stats.heap_size);
+    assert(stats.free_count >= 1);
+    assert(stats.largest_free_block >= 5000);
+    assert(stats.largest_free_block <= stats.free_size);
+
+    size_t bin_count = 0, bin_size = 0;
+    for (uint32_t i = 0; i < _TLSF_FL_COUNT; ++i) {
+        for (uint32_t j = 0; j < _TLSF_SL_COUNT; ++j) {
+            bin_count += stats.bin_count[i][j];
+            bin_size += stats.bin_size[i][j];
+        }
+    }
+    assert(bin_count == stats.free_count);
+    assert(bin_size == stats.free_size);
+
+    /* Counters */
+    size_t allocs = 0, frees = 0;
+    for (uint32_t i = 0; i < _TLSF_FL_COUNT; ++i) {
+        allocs += stats.counters.alloc_count[i];
+        frees += stats.counters.free_count[i];
+    }
+    assert(allocs == 3 && frees == 1);
+    assert(stats.counters.alloc_count[0] == 2);
+    assert(stats.counters.live_size >= 200);
+    assert(stats.counters.peak_live_size >= stats.counters.live_size + 5000);
+
+    /* Growing in place and relocating both count as realloc */
+    a = tlsf_realloc(&t, a, 2000);
+    c = tlsf_realloc(&t, c, 60);
+    assert(a && c);
+    tlsf_stats(&t, &stats);
+    size_t reallocs = 0;
+    for (uint32_t i = 0; i < _TLSF_FL_COUNT; ++i)
+        reallocs += stats.counters.realloc_count[i];
+    assert(reallocs == 2);
+
+    tlsf_free(&t, a);
+    tlsf_free(&t, c);
+    tlsf_stats(&t, &stats);
+    assert(stats.counters.live_size == 0);
+    assert(stats.heap_size == 0);
+
+    tlsf_cleanup(&t);
+}
+
+static void trim_test(void)
+{
+    tlsf_t t;
+    tlsf_init(&t, 64 * 1024 * 1024);
+
+    void *a = tlsf_malloc(&t, 100);
+    char *big = tlsf_malloc(&t, 4 * 1024 * 1024);
+    void *b = tlsf_malloc(&t, 100);
+    char *mid = tlsf_malloc(&t, 64 * 1024);
+    void *c = tlsf_malloc(&t, 100);
+    assert(a && big && b && mid && c);
+    memset(big, 0xAA, 4 * 1024 * 1024);
+    memset(mid, 0xBB, 64 * 1024);
+    tlsf_free(&t, big);
+    tlsf_free(&t, mid);
+
+    /* Enough is kept to leave the heap untouched */
+    size_t untouched = tlsf_trim(&t, SIZE_MAX);
+    assert(untouched == 0);
+
+    /* Only the large block is trimmed */
+    size_t offered = tlsf_trim(&t, 64 * 1024 + 100);
+    assert(offered >= 4 * 1024 * 1024 - 2 * PAGE);
+    assert(offered <= 4 * 1024 * 1024);
+
+    /* Blocks are only offered once */
+    size_t rest = tlsf_trim(&t, 0);
+    assert(rest > 0 && rest < offered);
+    size_t again = tlsf_trim(&t, 0);
+    assert(again == 0);
+    (void) untouched;
+    (void) offered;
+    (void) rest;
+    (void) again;
+    tlsf_check(&t);
+
+    /* Trimmed blocks can be reused */
+    big = tlsf_malloc(&t, 3 * 1024 * 1024);
+    assert(big);
+    memset(big, 0xCC, 3 * 1024 * 1024);
+    for (size_t i = 0; i < 3 * 1024 * 1024; i += PAGE)
+        assert((unsigned char) big[i] == 0xCC);
+    tlsf_check(&t);
+
+    tlsf_free(&t, big);
+    tlsf_free(&t, a);
+    tlsf_free(&t, b);
+    tlsf_free(&t, c);
+    assert(t.size == 0);
+
+    tlsf_cleanup(&t);
+}
+
+static void huge_page_test(void)
+{
+    tlsf_page_mode_t modes[] = {TLSF_PAGES_TRANSPARENT_HUGE, TLSF_PAGES_HUGE};
+    for (size_t m = 0; m < ARRAY_SIZE(modes); ++m) {
+        tlsf_t t;
+        tlsf_init_ex(&t, 64 * 1024 * 1024,
+                     &(tlsf_options_t){.page_mode = modes[m], .numa_bind = true});
+
+        /* Explicit huge pages may not be configured, the rest must work */
+        assert(t.options.page_mode <= modes[m]);
+        if (t.options.page_mode != TLSF_PAGES_DEFAULT) {
+            assert(t.page_size == TLSF_HUGE_PAGE_SIZE);
+            assert((uintptr_t) t.base % TLSF_HUGE_PAGE_SIZE == 0);
+        }
+        assert(t.max_size % t.page_size == 0);
+
+        char *a = tlsf_malloc(&t, 100);
+        char *b = tlsf_malloc(&t, 3 * 1024 * 1024);
+        assert(a && b);
+        memset(b, 0xAA, 3 * 1024 * 1024);
+        assert(t.committed_size % t.page_size == 0);
+        assert(t.committed_size >= t.size);
+
+        tlsf_free(&t, b);
+        assert(t.resident_size % t.page_size == 0);
+        tlsf_free(&t, a);
+        assert(t.size == 0);
+
+        tlsf_cleanup(&t);
+    }
+}
+
+static void pool_test(void)
+{
+    /* A heap which only allocates from pools */
+    tlsf_t t;
+    tlsf_init(&t, 0);
+    void *none = tlsf_malloc(&t, 16);
+    assert(!none);
+
+    size_t pool_size = 256 * 1024;
+    size_t *mem_a = malloc(pool_size), *mem_b = malloc(pool_size);
+    assert(mem_a && mem_b);
+    void *rejected = tlsf_add_pool(&t, (char *) mem_a + 1, pool_size - 1);
+    assert(!rejected);
+    rejected = tlsf_add_pool(&t, mem_a, TLSF_POOL_OVERHEAD);
+    assert(!rejected);
+    (void) rejected;
+
+    void *pool_a = tlsf_add_pool(&t, mem_a, pool_size);
+    void *pool_b = tlsf_add_pool(&t, mem_b, pool_size);
+    assert(pool_a && pool_b);
+    tlsf_check(&t);
+
+    tlsf_stats_t stats;
+    tlsf_stats(&t, &stats);
+    assert(stats.heap_size == 2 * pool_size);
+    assert(stats.free_count == 2);
+
+    /* Both pools are used: each can only fit one of these */
+    char *a = tlsf_malloc(&t, 200 * 1024);
+    char *b = tlsf_malloc(&t, 200 * 1024);
+    assert(a && b);
+    none = tlsf_malloc(&t, 200 * 1024);
+    assert(!none);
+    bool a_in_a = a >= (char *) mem_a && a < (char *) mem_a + pool_size;
+    bool b_in_a = b >= (char *) mem_a && b < (char *) mem_a + pool_size;
+    assert(a_in_a != b_in_a);
+    (void) a_in_a;
+    (void) b_in_a;
+    memset(a, 1, 200 * 1024);
+    memset(b, 2, 200 * 1024);
+
+    /* Freeing next to a pool sentinel does not shrink anything */
+    tlsf_free(&t, a);
+    tlsf_free(&t, b);
+    tlsf_check(&t);
+    tlsf_stats(&t, &stats);
+    assert(stats.used_size == 2 * TLSF_POOL_OVERHEAD);
+    assert(stats.free_count == 2);
+
+    /* Pool memory belongs to the caller and is never offered to the OS */
+    size_t offered = tlsf_trim(&t, 0);
+    assert(offered == 0);
+    (void) offered;
+
+    tlsf_remove_pool(&t, pool_a);
+    tlsf_stats(&t, &stats);
+    assert(stats.heap_size == pool_size);
+    assert(stats.free_count == 1);
+
+    a = tlsf_malloc(&t, 1000);
+    assert(a >= (char *) mem_b && a < (char *) mem_b + pool_size);
+    tlsf_free(&t, a);
+    tlsf_remove_pool(&t, pool_b);
+    tlsf_check(&t);
+    none = tlsf_malloc(&t, 16);
+    assert(!none);
+    (void) none;
+    tlsf_cleanup(&t);
+
+    /* Pools next to a growing arena */
+    tlsf_init(&t, 16 * 1024 * 1024);
+    pool_a = tlsf_add_pool(&t, mem_a, pool_size);
+    void *p[64];
+    for (int i = 0; i < 64; ++i) {
+        p[i] = tlsf_malloc(&t, 8 * 1024);
+        assert(p[i]);
+    }
+    assert(t.size > 0);
+    for (int i = 0; i < 64; ++i)
+        tlsf_free(&t, p[i]);
+    tlsf_check(&t);
+    assert(t.size == 0);
+    tlsf_remove_pool(&t, pool_a);
+    tlsf_cleanup(&t);
+
+    free(mem_a);
+    free(mem_b);
+}
+
+#define CACHE_THREADS 4
+#define CACHE_ITEMS 20000
+
+typedef struct {
+    tlsf_shared_t *shared;
+    tlsf_cache_t cache;
+    void *items[CACHE_ITEMS];
+    void **remote_items;
+} cache_thread_t;
+
+static size_t cache_item_size(size_t i)
+{
+    /* Mostly small sizes with the occasional large one */
+    return i % 50 == 0 ? 1000 + i % 3000 : 1 + i % (TLSF_CACHE_MAX_SIZE + 8);
+}
+
+static int cache_alloc_thread(void *userdata)
+{
+    cache_thread_t *thread = userdata;
+    for (size_t i = 0; i < CACHE_ITEMS; ++i) {
+        size_t size = cache_item_size(i);
+        thread->items[i] = tlsf_cache_malloc(&thread->cache, size);
+        assert(thread->items[i]);
+        memset(thread->items[i], (int) (i & 0xff), size);
+
+        /* Churn through the local free lists */
+        if (i % 3 == 0) {
+            tlsf_cache_free(&thread->cache, thread->items[i]);
+            thread->items[i] = tlsf_cache_malloc(&thread->cache, size);
+            assert(thread->items[i]);
+            memset(thread->items[i], (int) (i & 0xff), size);
+        }
+    }
+    return 0;
+}
+
+static int cache_free_thread(void *userdata)
+{
+    cache_thread_t *thread = userdata;
+    for (size_t i = 0; i < CACHE_ITEMS; ++i) {
+        uint8_t *data = thread->remote_items[i];
+        assert(data[0] == (uint8_t) (i & 0xff));
+        if (i % 2 == 0)
+            tlsf_cache_free(&thread->cache, data);
+        else
+            tlsf_shared_free(thread->shared, data);
+    }
+    tlsf_cache_flush(&thread->cache);
+    return 0;
+}
+
+static void cache_test(void)
+{
+    tlsf_shared_t shared;
+    tlsf_shared_init(&shared, 64 * 1024 * 1024);
+
+    cache_thread_t *threads = malloc(sizeof(cache_thread_t) * CACHE_THREADS);
+    assert(threads);
+    for (int i = 0; i < CACHE_THREADS; ++i) {
+        threads[i].shared = &shared;
+        tlsf_cache_init(&threads[i].cache, &shared);
+        /* Every thread frees what its neighbour allocated */
+        threads[i].remote_items = threads[(i + 1) % CACHE_THREADS].items;
+    }
+
+#ifndef __STDC_NO_THREADS__
+    thrd_t handles[CACHE_THREADS];
+    for (int i = 0; i < CACHE_THREADS; ++i) {
+        int result =
+            thrd_create(&handles[i], cache_alloc_thread, &threads[i]);
+        assert(result == thrd_success);
+        (void) result;
+    }
+    for (int i = 0; i < CACHE_THREADS; ++i)
+        thrd_join(handles[i], NULL);
+
+    for (int i = 0; i < CACHE_THREADS; ++i) {
+        int result = thrd_create(&handles[i], cache_free_thread, &threads[i]);
+        assert(result == thrd_success);
+        (void) result;
+    }
+    for (int i = 0; i < CACHE_THREADS; ++i)
+        thrd_join(handles[i], NULL);
+#else
+    for (int i = 0; i < CACHE_THREADS; ++i)
+        cache_alloc_thread(&threads[i]);
+    for (int i = 0; i < CACHE_THREADS; ++i)
+        cache_free_thread(&threads[i]);
+#endif
+
+    /* Everything was returned so the heap is empty again */
+    tlsf_check(&shared.tlsf);
+    assert(shared.tlsf.size == 0);
+
+    free(threads);
+    tlsf_shared_cleanup(&shared);
+}
+
+#define NEIGHBOUR_ITEMS 20000
+
+typedef struct {
+    tlsf_shared_t *shared;
+    void **items;
+} neighbour_thread_t;
+
+/* Frees even items through a cache */
+static int neighbour_cache_thread(void *userdata)
+{
+    neighbour_thread_t *thread = userdata;
+    tlsf_cache_t cache;
+    tlsf_cache_init(&cache, thread->shared);
+    for (size_t i = 0; i < NEIGHBOUR_ITEMS; i += 2)
+        tlsf_cache_free(&cache, thread->items[i]);
+
+    /* Reuse what was just freed */
+    for (size_t i = 0; i < NEIGHBOUR_ITEMS; i += 2) {
+        thread->items[i] = tlsf_cache_malloc(&cache, 1 + i % 100);
+        assert(thread->items[i]);
+        memset(thread->items[i], 0xa5, 1 + i % 100);
+    }
+    for (size_t i = 0; i < NEIGHBOUR_ITEMS; i += 2)
+        tlsf_cache_free(&cache, thread->items[i]);
+
+    tlsf_cache_flush(&cache);
+    return 0;
+}
+
+/* Frees odd items straight into the heap, which updates the headers of the
+ * even items next to them.
+ */
+static int neighbour_heap_thread(void *userdata)
+{
+    neighbour_thread_t *thread = userdata;
+    for (size_t i = 1; i < NEIGHBOUR_ITEMS; i += 2) {
+        tlsf_shared_free(thread->shared, thread->items[i]);
+
+        /* Drain the queue so the frees happen now */
+        if (i % 16 == 1) {
+            void *ptr = tlsf_shared_malloc(thread->shared, 1000);
+            assert(ptr);
+            tlsf_shared_free(thread->shared, ptr);
+        }
+    }
+    return 0;
+}
+
+static void neighbour_test(void)
+{
+    tlsf_shared_t shared;
+    tlsf_shared_init(&shared, 64 * 1024 * 1024);
+
+    /* Consecutive allocations are physical neighbours */
+    void **items = malloc(sizeof(void *) * NEIGHBOUR_ITEMS);
+    assert(items);
+    for (size_t i = 0; i < NEIGHBOUR_ITEMS; ++i) {
+        items[i] = tlsf_shared_malloc(&shared, 1 + i % 100);
+        assert(items[i]);
+    }
+
+    neighbour_thread_t thread = {.shared = &shared, .items = items};
+#ifndef __STDC_NO_THREADS__
+    thrd_t cache_handle, heap_handle;
+    int result = thrd_create(&cache_handle, neighbour_cache_thread, &thread);
+    assert(result == thrd_success);
+    result = thrd_create(&heap_handle, neighbour_heap_thread, &thread);
+    assert(result == thrd_success);
+    (void) result;
+    thrd_join(cache_handle, NULL);
+    thrd_join(heap_handle, NULL);
+#else
+    neighbour_cache_thread(&thread);
+    neighbour_heap_thread(&thread);
+#endif
+
+    tlsf_cache_t cache;
+    tlsf_cache_init(&cache, &shared);
+    tlsf_cache_flush(&cache);
+    tlsf_check(&shared.tlsf);
+    assert(shared.tlsf.size == 0);
+
+    free(items);
+    tlsf_shared_cleanup(&shared);
+}
+
 int main(void)
 {
 #ifdef __linux__
@@ -165,6 +590,15 @@ int main(void)
 
     MAX_PAGES = 20 * TLSF_MAX_SIZE / PAGE;
 
+    stats_test();
+    pool_test();
+#ifdef __linux__
+    trim_test();
+    huge_page_test();
+#endif
+    cache_test();
+    neighbour_test();
+
     tlsf_t t;
     tlsf_init(&t, MAX_PAGES * PAGE);
 
@@ -1,8 +1,37 @@
 #include "resources.h"
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 int main(int argc, const char* argv[]) {
 	xincbin_data_t embedded = XINCBIN_GET(embedded);
 	printf("%.*s\n", embedded.size, embedded.data);
-	return 0;
+
+	int num_errors = 0;
+
+	xincbin_data_t aligned = XINCBIN_GET(aligned);
+#ifndef _MSC_VER
+	if ((uintptr_t)aligned.data % XINCBIN_PAGE_SIZE != 0) { ++num_errors; }
+#endif
+	if (aligned.size != embedded.size || memcmp(aligned.data, embedded.data, embedded.size) != 0) { ++num_errors; }
+
+	// Decompressed once then cached
+	xincbin_data_t decompressed = XINCBIN_DECOMPRESS(compressed);
+	if (decompressed.size != embedded.size || memcmp(decompressed.data, embedded.data, embedded.size) != 0) { ++num_errors; }
+	if (XINCBIN_DECOMPRESS(compressed).data != decompressed.data) { ++num_errors; }
+
+	// Lookup by name without a declaration
+	const xincbin_resource_t* resource = xincbin_find("compressed");
+	if (resource == NULL || xincbin_resource_get(resource).data != decompressed.data) { ++num_errors; }
+	if (xincbin_find("missing") != NULL) { ++num_errors; }
+
+	size_t cursor = 0;
+	for (const xincbin_resource_t* entry; (entry = xincbin_next(&cursor)) != NULL;) {
+		printf("%s: %u bytes\n", entry->name, xincbin_resource_get(entry).size);
+	}
+
+	XINCBIN_RELEASE(compressed);
+	printf("errors = %d\n", num_errors);
+
+	return num_errors > 0;
 }
@@ -1,6 +1,7 @@
 #ifndef XINCBIN_RESOURCES_H
 #define XINCBIN_RESOURCES_H
 
+#define XINCBIN_REGISTRY
 #include "resources.rc"
 
 #endif
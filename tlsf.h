@@ -13,6 +13,7 @@ extern "C" {
 #	define _DEFAULT_SOURCE 1
 #endif
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -55,19 +56,114 @@ extern "C" {
 #endif
 #define TLSF_MAX_SIZE (((size_t) 1 << (_TLSF_FL_MAX - 1)) - sizeof(size_t))
 
+/* Allocations smaller than this are served by a tlsf_cache_t */
+#define TLSF_CACHE_MAX_SIZE (_TLSF_SL_COUNT * sizeof(size_t))
+
+#ifndef TLSF_CACHE_BATCH
+/* Number of blocks moved at once between a tlsf_cache_t and its heap */
+#define TLSF_CACHE_BATCH 32
+#endif
+
+#ifndef TLSF_HUGE_PAGE_SIZE
+/* Size of a huge page on Linux, Windows queries GetLargePageMinimum */
+#define TLSF_HUGE_PAGE_SIZE ((size_t) 2 * 1024 * 1024)
+#endif
+
+typedef enum {
+    TLSF_PAGES_DEFAULT = 0,
+    /* Align the heap to huge pages and ask for transparent huge pages
+     * (MADV_HUGEPAGE). Windows has no equivalent and uses default pages. */
+    TLSF_PAGES_TRANSPARENT_HUGE,
+    /* Explicit huge pages (MAP_HUGETLB, MEM_LARGE_PAGES).
+     * Falls back to transparent huge pages, then default pages, when none are
+     * available.
+     * The huge pages for the whole heap are reserved up front on Linux and
+     * committed up front on Windows. */
+    TLSF_PAGES_HUGE,
+} tlsf_page_mode_t;
+
+typedef struct {
+    tlsf_page_mode_t page_mode;
+    /* Bind the memory of the heap to the NUMA node numa_node */
+    bool numa_bind;
+    unsigned numa_node;
+} tlsf_options_t;
+
+/**
+ * Usage counters, only maintained when TLSF_ENABLE_STATS is defined.
+ *
+ * Counts are indexed by the first level of the block size, i.e. the size class
+ * 0 is below 128 bytes (64 on 32-bit) and every following class doubles.
+ * A realloc which has to move the block also counts as an alloc and a free.
+ */
+typedef struct {
+    size_t alloc_count[_TLSF_FL_COUNT];
+    size_t free_count[_TLSF_FL_COUNT];
+    size_t realloc_count[_TLSF_FL_COUNT];
+    /* Sum of the sizes of all used blocks */
+    size_t live_size;
+    size_t peak_live_size;
+} tlsf_counters_t;
+
 typedef struct {
     uint32_t fl, sl[_TLSF_FL_COUNT];
     struct tlsf_block *block[_TLSF_FL_COUNT][_TLSF_SL_COUNT];
     size_t size;
+    /* Total size of the pools added with tlsf_add_pool */
+    size_t pool_size;
 
     void* base;
     size_t committed_size;
     size_t page_size;
     size_t resident_size;
     size_t max_size;
+    /* Options actually in effect after any fallback */
+    tlsf_options_t options;
+
+#ifdef TLSF_ENABLE_STATS
+    tlsf_counters_t counters;
+#endif
 } tlsf_t;
 
+/**
+ * A snapshot of the state of a heap.
+ *
+ * @see tlsf_stats
+ */
+typedef struct {
+    /* Size of the heap and all pools, including block headers */
+    size_t heap_size;
+    size_t committed_size;
+    size_t resident_size;
+    size_t max_size;
+
+    /* Used bytes, including block headers */
+    size_t used_size;
+    size_t free_size;
+    size_t free_count;
+    size_t largest_free_block;
+
+    /* Number and total size of the free blocks in each fl/sl bin */
+    uint32_t bin_count[_TLSF_FL_COUNT][_TLSF_SL_COUNT];
+    size_t bin_size[_TLSF_FL_COUNT][_TLSF_SL_COUNT];
+
+#ifdef TLSF_ENABLE_STATS
+    tlsf_counters_t counters;
+#endif
+} tlsf_stats_t;
+
+/**
+ * Initializes a heap which reserves @max_size bytes of address space.
+ * A @max_size of 0 reserves nothing and only allocates from pools.
+ */
 TLSF_API void tlsf_init(tlsf_t*, size_t max_size);
+
+/**
+ * Initializes a heap with the given page options.
+ * When huge pages are in effect, the heap grows and shrinks in steps of
+ * whole huge pages and page_size is the huge page size.
+ */
+TLSF_API void tlsf_init_ex(tlsf_t*, size_t max_size, const tlsf_options_t* options);
 TLSF_API void tlsf_cleanup(tlsf_t*);
 TLSF_API void *tlsf_aalloc(tlsf_t *, size_t, size_t);
 
@@ -78,11 +174,108 @@ TLSF_API void *tlsf_aalloc(tlsf_t *, size_t, size_t);
 TLSF_API void *tlsf_malloc(tlsf_t *, size_t size);
 TLSF_API void *tlsf_realloc(tlsf_t *, void *, size_t);
 
+/* Bytes of a pool used by its block header and sentinel */
+#define TLSF_POOL_OVERHEAD (2 * sizeof(size_t))
+
+/**
+ * Adds the memory region [mem, mem + size) as a separate pool.
+ * @mem must be aligned to sizeof(size_t) and the region must stay valid until
+ * the pool is removed.
+ * Allocations are served from the heap and all pools alike.
+ * Returns the pool handle or NULL if the region is too small or too large.
+ */
+TLSF_API void *tlsf_add_pool(tlsf_t *, void *mem, size_t size);
+
+/**
+ * Removes a pool, all of its allocations must have been freed.
+ */
+TLSF_API void tlsf_remove_pool(tlsf_t *, void *pool);
+
+/**
+ * Returns the pages inside free blocks to the OS, largest blocks first, until
+ * at most @keep_bytes of free memory are left untouched.
+ * The pages stay mapped and are faulted back in when the blocks are reused.
+ * Blocks already offered by a previous call are skipped until they are
+ * allocated, split or merged.
+ * Pools added with tlsf_add_pool are never trimmed, their memory belongs to
+ * the caller.
+ * Returns the number of bytes newly offered to the OS.
+ */
+TLSF_API size_t tlsf_trim(tlsf_t *, size_t keep_bytes);
+
 /**
  * Releases the previously allocated memory, given the pointer.
  */
 void tlsf_free(tlsf_t *, void *);
 
+/**
+ * A heap shared between threads.
+ *
+ * Allocations take a spinlock.
+ * Frees never do: they are pushed to a lock-free queue which is drained by
+ * the next allocation.
+ */
+typedef struct {
+    tlsf_t tlsf;
+    int lock;
+    void *remote_frees;
+} tlsf_shared_t;
+
+/**
+ * Per-thread front end of a tlsf_shared_t.
+ *
+ * Allocations smaller than TLSF_CACHE_MAX_SIZE are served from per-size-class
+ * free lists without any synchronization.
+ * The lists are refilled from and flushed to the shared heap in batches of
+ * TLSF_CACHE_BATCH blocks.
+ * Freed blocks are only sorted into the lists under the heap lock, since their
+ * headers may be updated by the heap when a neighbour is freed.
+ * A cache must only be used by one thread at a time but a block may be freed
+ * through any cache of the same heap.
+ */
+typedef struct {
+    tlsf_shared_t *shared;
+    void *bins[_TLSF_SL_COUNT];
+    uint32_t counts[_TLSF_SL_COUNT];
+    void *pending;
+    uint32_t num_pending;
+} tlsf_cache_t;
+
+TLSF_API void tlsf_shared_init(tlsf_shared_t *, size_t max_size);
+TLSF_API void tlsf_shared_cleanup(tlsf_shared_t *);
+TLSF_API void *tlsf_shared_malloc(tlsf_shared_t *, size_t size);
+TLSF_API void *tlsf_shared_aalloc(tlsf_shared_t *, size_t align, size_t size);
+
+/**
+ * Releases memory allocated from the shared heap or any of its caches.
+ * This is lock-free and can be called from any thread.
+ */
+TLSF_API void tlsf_shared_free(tlsf_shared_t *, void *);
+
+/**
+ * tlsf_trim for a shared heap.
+ * This takes the lock, so it can be run periodically from a housekeeping
+ * thread while other threads keep allocating.
+ */
+TLSF_API size_t tlsf_shared_trim(tlsf_shared_t *, size_t keep_bytes);
+
+TLSF_API void tlsf_cache_init(tlsf_cache_t *, tlsf_shared_t *);
+
+/**
+ * Returns all cached blocks to the shared heap.
+ * This must be called before the cache is discarded.
+ */
+TLSF_API void tlsf_cache_flush(tlsf_cache_t *);
+
+TLSF_API void *tlsf_cache_malloc(tlsf_cache_t *, size_t size);
+TLSF_API void tlsf_cache_free(tlsf_cache_t *, void *);
+
+/**
+ * Collects statistics about the heap.
+ * This walks the free lists so it costs O(number of free blocks).
+ */
+TLSF_API void tlsf_stats(tlsf_t *, tlsf_stats_t *stats);
+
 #ifdef TLSF_ENABLE_CHECK
 TLSF_API void tlsf_check(tlsf_t *);
 #else
@@ -105,28 +298,29 @@ static inline void tlsf_check(tlsf_t *t)
 #include <stdbool.h>
 #include <assert.h>
 
-static inline size_t tlsf_os_page_size(void);
-static inline void* tlsf_os_reserve(size_t size);
+/* Sets base, max_size, page_size and options, commits if it has to */
+static inline bool tlsf_os_reserve(tlsf_t* tlsf, size_t max_size, const tlsf_options_t* options);
 static inline void tlsf_os_release(void* ptr, size_t size);
-static inline bool tlsf_os_commit(void* ptr, size_t size);
+static inline bool tlsf_os_commit(tlsf_t* tlsf, void* ptr, size_t size);
 static inline void tlsf_os_offer(void* ptr, size_t size);
 
 void
 tlsf_init(tlsf_t* tlsf, size_t max_size) {
-    size_t page_size = tlsf_os_page_size();
-    max_size = max_size / page_size * page_size;
-    void* base = tlsf_os_reserve(max_size);
-    assert(base != NULL);
-
-    *tlsf = (tlsf_t){
-        .base = base,
-        .max_size = max_size,
-        .page_size = page_size,
-    };
+    tlsf_init_ex(tlsf, max_size, &(tlsf_options_t){ 0 });
+}
+
+void
+tlsf_init_ex(tlsf_t* tlsf, size_t max_size, const tlsf_options_t* options) {
+    *tlsf = (tlsf_t){ 0 };
+    bool reserved = tlsf_os_reserve(tlsf, max_size, options);
+    assert(reserved);
+    (void)reserved;
 }
 
 void tlsf_cleanup(tlsf_t* tlsf) {
-    tlsf_os_release(tlsf->base, tlsf->max_size);
+    if (tlsf->base != NULL) {
+        tlsf_os_release(tlsf->base, tlsf->max_size);
+    }
 }
 
 static inline void*
@@ -138,7 +332,7 @@ tlsf_resize(tlsf_t* tlsf, size_t size) {
         char* base = tlsf->base;
         size_t committed_size = tlsf->committed_size;
         if (size > committed_size) {
-            if (tlsf_os_commit(base + committed_size, size - committed_size)) {
+            if (tlsf_os_commit(tlsf, base + committed_size, size - committed_size)) {
                 tlsf->committed_size = size;
                 tlsf->resident_size = size;
                 return base;
@@ -161,17 +355,78 @@ tlsf_resize(tlsf_t* tlsf, size_t size) {
 
 #if defined (__linux__)
 
+#include <limits.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 
-static inline size_t
-tlsf_os_page_size(void) {
-	return (size_t)sysconf(_SC_PAGESIZE);
-}
+/* From linux/mempolicy.h */
+#define TLSF_MPOL_BIND 2
 
 static inline void*
-tlsf_os_reserve(size_t size) {
-	return mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+tlsf_os_map(size_t size, int flags) {
+	void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | flags, -1, 0);
+	return ptr != MAP_FAILED ? ptr : NULL;
+}
+
+static inline void
+tlsf_os_bind(void* ptr, size_t size, unsigned node) {
+	unsigned long mask[16] = { 0 };
+	size_t bits = sizeof(unsigned long) * CHAR_BIT;
+	if (node >= sizeof(mask) * CHAR_BIT) { return; }
+
+	mask[node / bits] = 1ul << (node % bits);
+	/* Best effort: kernels without NUMA support simply fail */
+	syscall(SYS_mbind, ptr, size, TLSF_MPOL_BIND, mask, sizeof(mask) * CHAR_BIT + 1, 0);
+}
+
+static inline bool
+tlsf_os_reserve(tlsf_t* tlsf, size_t max_size, const tlsf_options_t* options) {
+	tlsf_page_mode_t page_mode = options->page_mode;
+	size_t page_size = TLSF_HUGE_PAGE_SIZE;
+	size_t size = max_size / page_size * page_size;
+	char* base = NULL;
+
+	if (page_mode == TLSF_PAGES_HUGE) {
+		/* Without MAP_NORESERVE so that a short huge page pool fails here
+		 * instead of raising SIGBUS on first touch */
+		base = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (base == MAP_FAILED) {
+			base = NULL;
+			page_mode = TLSF_PAGES_TRANSPARENT_HUGE;
+		}
+	}
+
+	if (page_mode == TLSF_PAGES_TRANSPARENT_HUGE) {
+		/* Over-reserve so that the heap can start on a huge page boundary */
+		char* ptr = size != 0 ? tlsf_os_map(size + page_size, 0) : NULL;
+		if (ptr != NULL) {
+			base = (char*)(((uintptr_t)ptr + page_size - 1) & ~(uintptr_t)(page_size - 1));
+			if (base != ptr) { munmap(ptr, (size_t)(base - ptr)); }
+			munmap(base + size, (size_t)(ptr + page_size - base));
+			madvise(base, size, MADV_HUGEPAGE);
+		} else {
+			page_mode = TLSF_PAGES_DEFAULT;
+		}
+	}
+
+	if (page_mode == TLSF_PAGES_DEFAULT) {
+		page_size = (size_t)sysconf(_SC_PAGESIZE);
+		size = max_size / page_size * page_size;
+		if (size != 0) {
+			base = tlsf_os_map(size, 0);
+			if (base == NULL) { return false; }
+		}
+	}
+
+	if (options->numa_bind) { tlsf_os_bind(base, size, options->numa_node); }
+
+	tlsf->base = base;
+	tlsf->max_size = size;
+	tlsf->page_size = page_size;
+	tlsf->options = *options;
+	tlsf->options.page_mode = page_mode;
+	return true;
 }
 
 static inline void
@@ -180,7 +435,8 @@ tlsf_os_release(void* ptr, size_t size) {
 }
 
 static inline bool
-tlsf_os_commit(void* ptr, size_t size) {
+tlsf_os_commit(tlsf_t* tlsf, void* ptr, size_t size) {
+	(void)tlsf;
 	return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
 }
 
@@ -196,16 +452,49 @@ tlsf_os_offer(void* ptr, size_t size) {
 #endif
 #include <Windows.h>
 
-static inline size_t
-tlsf_os_page_size(void) {
-    SYSTEM_INFO si;
-    GetSystemInfo(&si);
-    return si.dwPageSize;
+static inline void*
+tlsf_os_virtual_alloc(void* ptr, size_t size, DWORD type, DWORD protect, const tlsf_options_t* options) {
+    if (options->numa_bind) {
+        return VirtualAllocExNuma(GetCurrentProcess(), ptr, size, type, protect, options->numa_node);
+    } else {
+        return VirtualAlloc(ptr, size, type, protect);
+    }
 }
 
-static inline void*
-tlsf_os_reserve(size_t size) {
-    return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+static inline bool
+tlsf_os_reserve(tlsf_t* tlsf, size_t max_size, const tlsf_options_t* options) {
+    tlsf_page_mode_t page_mode = options->page_mode;
+    size_t page_size = GetLargePageMinimum();
+    size_t size = 0;
+    void* base = NULL;
+
+    if (page_mode == TLSF_PAGES_HUGE && page_size != 0 && max_size >= page_size) {
+        /* Large pages can not be committed separately */
+        size = max_size / page_size * page_size;
+        base = tlsf_os_virtual_alloc(
+            NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, options
+        );
+        if (base != NULL) { tlsf->committed_size = size; }
+    }
+
+    if (base == NULL) {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        page_mode = TLSF_PAGES_DEFAULT;
+        page_size = si.dwPageSize;
+        size = max_size / page_size * page_size;
+        if (size != 0) {
+            base = tlsf_os_virtual_alloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS, options);
+            if (base == NULL) { return false; }
+        }
+    }
+
+    tlsf->base = base;
+    tlsf->max_size = size;
+    tlsf->page_size = page_size;
+    tlsf->options = *options;
+    tlsf->options.page_mode = page_mode;
+    return true;
 }
 
 static inline void
@@ -215,8 +504,8 @@ tlsf_os_release(void* ptr, size_t size) {
 }
 
 static inline bool
-tlsf_os_commit(void* ptr, size_t size) {
-    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+tlsf_os_commit(tlsf_t* tlsf, void* ptr, size_t size) {
+    return tlsf_os_virtual_alloc(ptr, size, MEM_COMMIT, PAGE_READWRITE, &tlsf->options) != NULL;
 }
 
 static inline void
@@ -553,6 +842,14 @@ INLINE void remove_free_block(tlsf_t *t,
     }
 }
 
+/* Free blocks larger than the minimum have room for a word after the free list
+ * links. It records whether tlsf_trim already offered the block to the OS.
+ */
+INLINE size_t *block_trimmed(tlsf_block_t *block)
+{
+    return (size_t *) (block_payload(block) + 2 * sizeof(void *));
+}
+
 /* Insert a free block into the free block list and mark the bitmaps. */
 INLINE void insert_free_block(tlsf_t *t,
                               tlsf_block_t *block,
@@ -561,6 +858,9 @@ INLINE void insert_free_block(tlsf_t *t,
 {
     tlsf_block_t *current = t->block[fl][sl];
     ASSERT(block, "cannot insert a null entry into the free list");
+    /* Every split, merge or newly freed block goes through here. */
+    if (block_size(block) > BLOCK_SIZE_MIN)
+        *block_trimmed(block) = 0;
     block->next_free = current;
     block->prev_free = 0;
     if (current)
@@ -682,6 +982,52 @@ INLINE void *block_use(tlsf_t *t, tlsf_block_t *block, size_t size)
     return block_payload(block);
 }
 
+#ifdef TLSF_ENABLE_STATS
+
+INLINE uint32_t stats_class(size_t size)
+{
+    uint32_t fl, sl;
+    mapping(size, &fl, &sl);
+    return fl;
+}
+
+INLINE void stats_add_live(tlsf_t *t, size_t size)
+{
+    t->counters.live_size += size;
+    if (t->counters.live_size > t->counters.peak_live_size)
+        t->counters.peak_live_size = t->counters.live_size;
+}
+
+INLINE void stats_alloc(tlsf_t *t, void *mem)
+{
+    size_t size = block_size(block_from_payload(mem));
+    ++t->counters.alloc_count[stats_class(size)];
+    stats_add_live(t, size);
+}
+
+INLINE void stats_free(tlsf_t *t, void *mem)
+{
+    size_t size = block_size(block_from_payload(mem));
+    ++t->counters.free_count[stats_class(size)];
+    t->counters.live_size -= size;
+}
+
+INLINE void stats_realloc(tlsf_t *t, void *mem, size_t old_size)
+{
+    size_t size = block_size(block_from_payload(mem));
+    ++t->counters.realloc_count[stats_class(size)];
+    t->counters.live_size -= old_size;
+    stats_add_live(t, size);
+}
+
+#define TLSF_STATS(x) x
+
+#else
+
+#define TLSF_STATS(x)
+
+#endif
+
 INLINE void check_sentinel(tlsf_block_t *block)
 {
     (void) block;
@@ -713,6 +1059,14 @@ static bool arena_grow(tlsf_t *t, size_t size)
     return true;
 }
 
+/* Pools have sentinels too, only the one at the end of the arena shrinks it. */
+INLINE bool block_is_arena_last(tlsf_t *t, tlsf_block_t *block)
+{
+    tlsf_block_t *next = block_next(block);
+    return !block_size(next) && t->size &&
+           (char *) next == (char *) t->base + t->size - 2 * BLOCK_OVERHEAD;
+}
+
 static void arena_shrink(tlsf_t *t, tlsf_block_t *block)
 {
     check_sentinel(block_next(block));
@@ -753,7 +1107,9 @@ void *tlsf_malloc(tlsf_t *t, size_t size)
     tlsf_block_t *block = block_find_free(t, size);
     if (UNLIKELY(!block))
         return NULL;
-    return block_use(t, block, size);
+    void *mem = block_use(t, block, size);
+    TLSF_STATS(stats_alloc(t, mem));
+    return mem;
 }
 
 void *tlsf_aalloc(tlsf_t *t, size_t align, size_t size)
@@ -778,7 +1134,9 @@ void *tlsf_aalloc(tlsf_t *t, size_t align, size_t size)
 
     char *mem = align_ptr(block_payload(block) + sizeof(tlsf_block_t), align);
     block = block_ltrim_free(t, block, (size_t) (mem - block_payload(block)));
-    return block_use(t, block, adjust);
+    mem = block_use(t, block, adjust);
+    TLSF_STATS(stats_alloc(t, mem));
+    return mem;
 }
 
 void tlsf_free(tlsf_t *t, void *mem)
@@ -786,6 +1144,8 @@ void tlsf_free(tlsf_t *t, void *mem)
     if (UNLIKELY(!mem))
         return;
 
+    TLSF_STATS(stats_free(t, mem));
+
     tlsf_block_t *block = block_from_payload(mem);
     ASSERT(!block_is_free(block), "block already marked as free");
 
@@ -793,7 +1153,7 @@ void tlsf_free(tlsf_t *t, void *mem)
     block = block_merge_prev(t, block);
     block = block_merge_next(t, block);
 
-    if (UNLIKELY(!block_size(block_next(block))))
+    if (UNLIKELY(block_is_arena_last(t, block)))
         arena_shrink(t, block);
     else
         block_insert(t, block);
@@ -829,6 +1189,8 @@ void *tlsf_realloc(tlsf_t *t, void *mem, size_t size)
             if (dst) {
                 memcpy(dst, mem, avail);
                 tlsf_free(t, mem);
+                TLSF_STATS(++t->counters.realloc_count[stats_class(
+                    block_size(block_from_payload(dst)))]);
             }
             return dst;
         }
@@ -839,9 +1201,447 @@ void *tlsf_realloc(tlsf_t *t, void *mem, size_t size)
 
     /* Trim the resulting block and return the original pointer. */
     block_rtrim_used(t, block, size);
+    TLSF_STATS(stats_realloc(t, mem, avail));
+    return mem;
+}
+
+void *tlsf_add_pool(tlsf_t *t, void *mem, size_t size)
+{
+    if (UNLIKELY((size_t) mem % ALIGN_SIZE || size < TLSF_POOL_OVERHEAD))
+        return NULL;
+
+    size_t free_size = (size - TLSF_POOL_OVERHEAD) & ~(ALIGN_SIZE - 1);
+    if (UNLIKELY(free_size < BLOCK_SIZE_MIN || free_size > BLOCK_SIZE_MAX))
+        return NULL;
+
+    /* The prev field is outside of the pool and never used as the first block
+     * has no previous block.
+     */
+    tlsf_block_t *block = to_block((char *) mem - BLOCK_OVERHEAD);
+    block->header = free_size | BLOCK_BIT_FREE;
+    block_insert(t, block);
+
+    tlsf_block_t *sentinel = block_link_next(block);
+    sentinel->header = BLOCK_BIT_PREV_FREE;
+    check_sentinel(sentinel);
+
+    t->pool_size += free_size + TLSF_POOL_OVERHEAD;
     return mem;
 }
 
+void tlsf_remove_pool(tlsf_t *t, void *pool)
+{
+    tlsf_block_t *block = to_block((char *) pool - BLOCK_OVERHEAD);
+    ASSERT(block_is_free(block), "pool still has allocations");
+    ASSERT(!block_size(block_next(block)), "pool still has allocations");
+
+    block_remove(t, block);
+    t->pool_size -= block_size(block) + TLSF_POOL_OVERHEAD;
+}
+
+void tlsf_stats(tlsf_t *t, tlsf_stats_t *stats)
+{
+    *stats = (tlsf_stats_t){
+        .heap_size = t->size + t->pool_size,
+        .committed_size = t->committed_size,
+        .resident_size = t->resident_size,
+        .max_size = t->max_size,
+    };
+
+    for (uint32_t fl_map = t->fl; fl_map; fl_map &= fl_map - 1) {
+        uint32_t i = bitmap_ffs(fl_map);
+        for (uint32_t sl_map = t->sl[i]; sl_map; sl_map &= sl_map - 1) {
+            uint32_t j = bitmap_ffs(sl_map);
+            for (tlsf_block_t *block = t->block[i][j]; block;
+                 block = block->next_free) {
+                size_t size = block_size(block);
+                ++stats->bin_count[i][j];
+                stats->bin_size[i][j] += size;
+                if (size > stats->largest_free_block)
+                    stats->largest_free_block = size;
+            }
+            stats->free_count += stats->bin_count[i][j];
+            stats->free_size += stats->bin_size[i][j];
+        }
+    }
+
+    stats->used_size = stats->heap_size - stats->free_size;
+
+#ifdef TLSF_ENABLE_STATS
+    stats->counters = t->counters;
+#endif
+}
+
+/* Offer the page-aligned interior of a free block, return the offered size. */
+static size_t block_trim(tlsf_t *t, tlsf_block_t *block)
+{
+    /* Keep the free list links, the trimmed flag and the prev pointer of the
+     * next block.
+     */
+    size_t begin = align_up((size_t) block_payload(block) + 3 * sizeof(void *),
+                            t->page_size);
+    size_t end = (size_t) block_next(block) / t->page_size * t->page_size;
+    if (end <= begin)
+        return 0;
+    tlsf_os_offer((void *) begin, end - begin);
+    *block_trimmed(block) = 1;
+    return end - begin;
+}
+
+/* Whether a free block may still hold pages that were never offered.
+ * Pools belong to the caller and are never offered.
+ */
+INLINE bool block_needs_trim(tlsf_t *t, tlsf_block_t *block)
+{
+    char *base = t->base;
+    if ((char *) block < base || (char *) block >= base + t->size)
+        return false;
+    return block_size(block) <= BLOCK_SIZE_MIN || !*block_trimmed(block);
+}
+
+size_t tlsf_trim(tlsf_t *t, size_t keep_bytes)
+{
+    size_t free_size = 0;
+    for (uint32_t fl_map = t->fl; fl_map; fl_map &= fl_map - 1) {
+        uint32_t i = bitmap_ffs(fl_map);
+        for (uint32_t sl_map = t->sl[i]; sl_map; sl_map &= sl_map - 1) {
+            uint32_t j = bitmap_ffs(sl_map);
+            for (tlsf_block_t *block = t->block[i][j]; block;
+                 block = block->next_free) {
+                if (block_needs_trim(t, block))
+                    free_size += block_size(block);
+            }
+        }
+    }
+
+    /* Walk the bins from the largest size down. */
+    size_t offered = 0;
+    for (uint32_t i = FL_COUNT; i-- > 0 && free_size > keep_bytes;) {
+        if (!(t->fl & (1U << i)))
+            continue;
+        for (uint32_t j = SL_COUNT; j-- > 0 && free_size > keep_bytes;) {
+            for (tlsf_block_t *block = t->block[i][j];
+                 block && free_size > keep_bytes; block = block->next_free) {
+                if (!block_needs_trim(t, block))
+                    continue;
+                offered += block_trim(t, block);
+                free_size -= block_size(block);
+            }
+        }
+    }
+    return offered;
+}
+
+/* Thread caching front end */
+
+_Static_assert(TLSF_CACHE_MAX_SIZE == BLOCK_SIZE_SMALL,
+               "cache size classes must match the small blocks");
+
+#ifdef _MSC_VER
+
+INLINE int tlsf_atomic_exchange_lock(int *lock)
+{
+    return (int) _InterlockedExchange((volatile long *) lock, 1);
+}
+
+INLINE int tlsf_atomic_load_lock(int *lock)
+{
+    return *(volatile int *) lock;
+}
+
+INLINE void tlsf_atomic_release_lock(int *lock)
+{
+    _InterlockedExchange((volatile long *) lock, 0);
+}
+
+INLINE void *tlsf_atomic_load_ptr(void **ptr)
+{
+    return *(void *volatile *) ptr;
+}
+
+INLINE bool tlsf_atomic_cas_ptr(void **ptr, void *expected, void *desired)
+{
+    return _InterlockedCompareExchangePointer(ptr, desired, expected) ==
+           expected;
+}
+
+INLINE void *tlsf_atomic_exchange_ptr(void **ptr, void *value)
+{
+    return _InterlockedExchangePointer(ptr, value);
+}
+
+#define TLSF_PAUSE() YieldProcessor()
+
+#else
+
+INLINE int tlsf_atomic_exchange_lock(int *lock)
+{
+    return __atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE);
+}
+
+INLINE int tlsf_atomic_load_lock(int *lock)
+{
+    return __atomic_load_n(lock, __ATOMIC_RELAXED);
+}
+
+INLINE void tlsf_atomic_release_lock(int *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+INLINE void *tlsf_atomic_load_ptr(void **ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+INLINE bool tlsf_atomic_cas_ptr(void **ptr, void *expected, void *desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, true,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+INLINE void *tlsf_atomic_exchange_ptr(void **ptr, void *value)
+{
+    return __atomic_exchange_n(ptr, value, __ATOMIC_ACQUIRE);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TLSF_PAUSE() __builtin_ia32_pause()
+#else
+#define TLSF_PAUSE() ((void) 0)
+#endif
+
+#endif
+
+/* Cached and queued blocks are linked through their first word. */
+INLINE void *free_list_next(void *ptr)
+{
+    return *(void **) ptr;
+}
+
+INLINE void free_list_set_next(void *ptr, void *next)
+{
+    *(void **) ptr = next;
+}
+
+INLINE uint32_t cache_class(size_t size)
+{
+    return (uint32_t) (size >> ALIGN_SHIFT);
+}
+
+static void shared_lock(tlsf_shared_t *shared)
+{
+    while (tlsf_atomic_exchange_lock(&shared->lock)) {
+        while (tlsf_atomic_load_lock(&shared->lock))
+            TLSF_PAUSE();
+    }
+}
+
+static void shared_unlock(tlsf_shared_t *shared)
+{
+    tlsf_atomic_release_lock(&shared->lock);
+}
+
+/* Push a linked list of blocks to the remote free queue. */
+static void shared_push_frees(tlsf_shared_t *shared, void *first, void *last)
+{
+    void *head;
+    do {
+        head = tlsf_atomic_load_ptr(&shared->remote_frees);
+        free_list_set_next(last, head);
+    } while (!tlsf_atomic_cas_ptr(&shared->remote_frees, head, first));
+}
+
+/* Release a linked list of blocks. The lock must be held. */
+static void shared_free_list(tlsf_shared_t *shared, void *ptr)
+{
+    while (ptr) {
+        void *next = free_list_next(ptr);
+        tlsf_free(&shared->tlsf, ptr);
+        ptr = next;
+    }
+}
+
+/* Release all queued blocks. The lock must be held. */
+static void shared_drain_frees(tlsf_shared_t *shared)
+{
+    shared_free_list(shared,
+                     tlsf_atomic_exchange_ptr(&shared->remote_frees, NULL));
+}
+
+void tlsf_shared_init(tlsf_shared_t *shared, size_t max_size)
+{
+    *shared = (tlsf_shared_t){0};
+    tlsf_init(&shared->tlsf, max_size);
+}
+
+void tlsf_shared_cleanup(tlsf_shared_t *shared)
+{
+    tlsf_cleanup(&shared->tlsf);
+}
+
+void *tlsf_shared_malloc(tlsf_shared_t *shared, size_t size)
+{
+    shared_lock(shared);
+    shared_drain_frees(shared);
+    void *ptr = tlsf_malloc(&shared->tlsf, size);
+    shared_unlock(shared);
+    return ptr;
+}
+
+void *tlsf_shared_aalloc(tlsf_shared_t *shared, size_t align, size_t size)
+{
+    shared_lock(shared);
+    shared_drain_frees(shared);
+    void *ptr = tlsf_aalloc(&shared->tlsf, align, size);
+    shared_unlock(shared);
+    return ptr;
+}
+
+void tlsf_shared_free(tlsf_shared_t *shared, void *mem)
+{
+    if (UNLIKELY(!mem))
+        return;
+
+    shared_push_frees(shared, mem, mem);
+}
+
+size_t tlsf_shared_trim(tlsf_shared_t *shared, size_t keep_bytes)
+{
+    shared_lock(shared);
+    shared_drain_frees(shared);
+    size_t offered = tlsf_trim(&shared->tlsf, keep_bytes);
+    shared_unlock(shared);
+    return offered;
+}
+
+void tlsf_cache_init(tlsf_cache_t *cache, tlsf_shared_t *shared)
+{
+    *cache = (tlsf_cache_t){.shared = shared};
+}
+
+/* Move freed blocks to the list of their size class.
+ * The lock must be held: a header can change when its neighbour is freed.
+ */
+static void cache_sort_pending(tlsf_cache_t *cache)
+{
+    tlsf_shared_t *shared = cache->shared;
+    void *ptr = cache->pending;
+    cache->pending = NULL;
+    cache->num_pending = 0;
+
+    while (ptr) {
+        void *next = free_list_next(ptr);
+
+        /* A block may be bigger than requested when it could not be split. */
+        size_t size = block_size(block_from_payload(ptr));
+        uint32_t size_class = cache_class(size);
+        if (size >= BLOCK_SIZE_SMALL ||
+            cache->counts[size_class] >= 2 * TLSF_CACHE_BATCH) {
+            tlsf_free(&shared->tlsf, ptr);
+        } else {
+            free_list_set_next(ptr, cache->bins[size_class]);
+            cache->bins[size_class] = ptr;
+            ++cache->counts[size_class];
+        }
+
+        ptr = next;
+    }
+}
+
+void tlsf_cache_flush(tlsf_cache_t *cache)
+{
+    tlsf_shared_t *shared = cache->shared;
+
+    shared_lock(shared);
+    shared_drain_frees(shared);
+    shared_free_list(shared, cache->pending);
+    for (uint32_t i = 0; i < SL_COUNT; ++i)
+        shared_free_list(shared, cache->bins[i]);
+    shared_unlock(shared);
+
+    cache->pending = NULL;
+    cache->num_pending = 0;
+    for (uint32_t i = 0; i < SL_COUNT; ++i) {
+        cache->bins[i] = NULL;
+        cache->counts[i] = 0;
+    }
+}
+
+/* Allocate a batch of blocks of the given size class in one critical section. */
+static void *cache_refill(tlsf_cache_t *cache, uint32_t size_class)
+{
+    tlsf_shared_t *shared = cache->shared;
+    size_t size = (size_t) size_class << ALIGN_SHIFT;
+    void *head = NULL;
+    uint32_t count = 0;
+
+    shared_lock(shared);
+    shared_drain_frees(shared);
+
+    /* Blocks freed through this cache may already cover the request. */
+    cache_sort_pending(cache);
+    if (cache->bins[size_class]) {
+        shared_unlock(shared);
+        head = cache->bins[size_class];
+        cache->bins[size_class] = free_list_next(head);
+        --cache->counts[size_class];
+        return head;
+    }
+
+    for (; count < TLSF_CACHE_BATCH; ++count) {
+        void *ptr = tlsf_malloc(&shared->tlsf, size);
+        if (!ptr)
+            break;
+        free_list_set_next(ptr, head);
+        head = ptr;
+    }
+    shared_unlock(shared);
+
+    if (!head)
+        return NULL;
+
+    cache->bins[size_class] = free_list_next(head);
+    cache->counts[size_class] = count - 1;
+    return head;
+}
+
+void *tlsf_cache_malloc(tlsf_cache_t *cache, size_t size)
+{
+    size = adjust_size(size, ALIGN_SIZE);
+    if (size >= BLOCK_SIZE_SMALL)
+        return tlsf_shared_malloc(cache->shared, size);
+
+    uint32_t size_class = cache_class(size);
+    void *ptr = cache->bins[size_class];
+    if (UNLIKELY(!ptr))
+        return cache_refill(cache, size_class);
+
+    cache->bins[size_class] = free_list_next(ptr);
+    --cache->counts[size_class];
+    return ptr;
+}
+
+void tlsf_cache_free(tlsf_cache_t *cache, void *mem)
+{
+    if (UNLIKELY(!mem))
+        return;
+
+    /* The header is not read here, see cache_sort_pending. */
+    free_list_set_next(mem, cache->pending);
+    cache->pending = mem;
+
+    /* Sort a batch at once. Blocks beyond the list limit go back to the heap.
+     */
+    if (UNLIKELY(++cache->num_pending >= TLSF_CACHE_BATCH)) {
+        tlsf_shared_t *shared = cache->shared;
+        shared_lock(shared);
+        shared_drain_frees(shared);
+        cache_sort_pending(cache);
+        shared_unlock(shared);
+    }
+}
+
 #ifdef TLSF_ENABLE_CHECK
 #include <stdio.h>
 #include <stdlib.h>
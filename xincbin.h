@@ -288,9 +288,12 @@
             INCBIN_STYLE_IDENT(SIZE))
 
 #  define INCBIN_COMMON(TYPE, NAME, FILENAME, TERMINATOR) \
+    INCBIN_COMMON_ALIGNED(TYPE, NAME, FILENAME, TERMINATOR, INCBIN_ALIGN_HOST)
+
+#  define INCBIN_COMMON_ALIGNED(TYPE, NAME, FILENAME, TERMINATOR, ALIGN_DATA) \
     __asm__(INCBIN_SECTION \
             INCBIN_GLOBAL_LABELS(NAME, DATA) \
-            INCBIN_ALIGN_HOST \
+            ALIGN_DATA \
             INCBIN_MANGLE INCBIN_STRINGIZE(INCBIN_PREFIX) #NAME INCBIN_STYLE_STRING(DATA) ":\n" \
             INCBIN_MACRO " \"" FILENAME "\"\n" \
                 TERMINATOR \
@@ -307,24 +310,210 @@
             ".text\n" \
     )
 
+/**
+ * @brief Page size used by @ref XINCBIN_PAGE_ALIGNED.
+ *
+ * XINCBIN_PAGE_SHIFT must be overridden along with it.
+ */
+#ifndef XINCBIN_PAGE_SIZE
+#  if defined(__APPLE__) && defined(__aarch64__)
+#    define XINCBIN_PAGE_SIZE 16384
+#    define XINCBIN_PAGE_SHIFT 14
+#  else
+#    define XINCBIN_PAGE_SIZE 4096
+#    define XINCBIN_PAGE_SHIFT 12
+#  endif
+#endif
+
+#ifdef __GNUC__
+#  define XINCBIN_ALIGN_PAGE ".balign " INCBIN_STRINGIZE(XINCBIN_PAGE_SIZE) "\n"
+#elif defined(INCBIN_ARM)
+#  define XINCBIN_ALIGN_PAGE ".align " INCBIN_STRINGIZE(XINCBIN_PAGE_SHIFT) "\n"
+#else
+#  define XINCBIN_ALIGN_PAGE ".align " INCBIN_STRINGIZE(XINCBIN_PAGE_SIZE) "\n"
+#endif
+
 typedef struct xincbin_data_s {
     unsigned int size;
     const unsigned char* data;
 } xincbin_data_t;
 
+/**
+ * @brief Decompressed copy of an @ref XINCBIN_COMPRESSED resource.
+ *
+ * It is created on first use by @ref XINCBIN_DECOMPRESS.
+ */
+typedef struct xincbin_cache_s {
+    void* block;
+} xincbin_cache_t;
+
+#define XINCBIN_CACHE(NAME) \
+    INCBIN_CONCATENATE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME), _cache)
+
+/**
+ * @brief Get the decompressed content of an @ref XINCBIN_COMPRESSED resource.
+ *
+ * The resource must be a LZ4 frame (e.g: `lz4 -9 file file.lz4`).
+ * It is decompressed on the first call and cached until
+ * @ref XINCBIN_RELEASE.
+ * Concurrent calls are safe.
+ * An empty @ref xincbin_data_t is returned if the data is malformed.
+ */
+#define XINCBIN_DECOMPRESS(NAME) xincbin_decompress(&XINCBIN_CACHE(NAME), XINCBIN_GET(NAME))
+
+/**
+ * @brief Free the cached content of an @ref XINCBIN_COMPRESSED resource.
+ *
+ * This must not race with @ref XINCBIN_DECOMPRESS or with the use of its
+ * result.
+ */
+#define XINCBIN_RELEASE(NAME) xincbin_release(&XINCBIN_CACHE(NAME))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+xincbin_data_t
+xincbin_decompress(xincbin_cache_t* cache, xincbin_data_t compressed);
+
+void
+xincbin_release(xincbin_cache_t* cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef XINCBIN_REGISTRY
+
+#include "autolist.h"
+
+/**
+ * @brief An entry in the registry of all resources.
+ *
+ * Define `XINCBIN_REGISTRY` before including xincbin.h everywhere to register
+ * every resource in an autolist.h list.
+ */
+typedef struct xincbin_resource_s {
+    //! The name given to XINCBIN
+    const char* name;
+#ifdef _MSC_VER
+    const char* rc_name;
+#else
+    const unsigned char* data;
+    const unsigned int* size;
+#endif
+    //! NULL unless the resource is compressed
+    xincbin_cache_t* cache;
+} xincbin_resource_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Find a resource given its name.
+ *
+ * @return The resource or NULL if it does not exist.
+ */
+const xincbin_resource_t*
+xincbin_find(const char* name);
+
+/**
+ * @brief Iterate over all resources.
+ *
+ * @code
+ * size_t cursor = 0;
+ * for (const xincbin_resource_t* resource; (resource = xincbin_next(&cursor)) != NULL;) { }
+ * @endcode
+ *
+ * @param cursor Position of the iteration, starting from 0.
+ * @return The next resource or NULL at the end.
+ */
+const xincbin_resource_t*
+xincbin_next(size_t* cursor);
+
+/**
+ * @brief Get the content of a resource, decompressing it when needed.
+ */
+xincbin_data_t
+xincbin_resource_get(const xincbin_resource_t* resource);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* AUTOLIST_ENTRY pastes its argument so it has to be expanded first */
+#define XINCBIN__AUTOLIST_ENTRY(ITEM_NAME) \
+    AUTOLIST_ENTRY(xincbin, const xincbin_resource_t, ITEM_NAME)
+
+#ifdef _MSC_VER
+#  define XINCBIN__REGISTER(NAME, CACHE) \
+    XINCBIN__AUTOLIST_ENTRY(INCBIN_CONCATENATE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME), _resource)) = { \
+        .name = #NAME, \
+        .rc_name = INCBIN_STRINGIZE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME)), \
+        .cache = CACHE, \
+    };
+#else
+#  define XINCBIN__REGISTER(NAME, CACHE) \
+    XINCBIN__AUTOLIST_ENTRY(INCBIN_CONCATENATE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME), _resource)) = { \
+        .name = #NAME, \
+        .data = INCBIN_CONCATENATE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME), INCBIN_STYLE_IDENT(DATA)), \
+        .size = &INCBIN_CONCATENATE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME), INCBIN_STYLE_IDENT(SIZE)), \
+        .cache = CACHE, \
+    };
+#endif
+
+#else
+#  define XINCBIN__REGISTER(NAME, CACHE)
+#endif
+
+/**
+ * @def XINCBIN_PAGE_ALIGNED(NAME, FILENAME)
+ * @brief Same as XINCBIN but the data starts on a page boundary.
+ *
+ * This allows `madvise` or mapping the data directly.
+ * Resources are not page aligned with MSVC.
+ */
+
+/**
+ * @def XINCBIN_COMPRESSED(NAME, FILENAME)
+ * @brief Same as XINCBIN for a LZ4 compressed file.
+ *
+ * @see XINCBIN_DECOMPRESS
+ */
+
 #ifdef _MSC_VER
 #	ifdef XINCBIN_IMPLEMENTATION
-#		define XINCBIN(NAME, FILENAME) const char* INCBIN_CONCATENATE(INCBIN_PREFIX, NAME) = INCBIN_STRINGIZE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME));
+#		define XINCBIN(NAME, FILENAME) const char* INCBIN_CONCATENATE(INCBIN_PREFIX, NAME) = INCBIN_STRINGIZE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME)); \
+			XINCBIN__REGISTER(NAME, NULL)
+#		define XINCBIN_COMPRESSED(NAME, FILENAME) const char* INCBIN_CONCATENATE(INCBIN_PREFIX, NAME) = INCBIN_STRINGIZE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME)); \
+			xincbin_cache_t XINCBIN_CACHE(NAME); \
+			XINCBIN__REGISTER(NAME, &XINCBIN_CACHE(NAME))
 #	else
 #		define XINCBIN(NAME, FILENAME) INCBIN_EXTERNAL const char* INCBIN_CONCATENATE(INCBIN_PREFIX, NAME);
+#		define XINCBIN_COMPRESSED(NAME, FILENAME) INCBIN_EXTERNAL const char* INCBIN_CONCATENATE(INCBIN_PREFIX, NAME); \
+			INCBIN_EXTERNAL xincbin_cache_t XINCBIN_CACHE(NAME);
 #	endif
+#	define XINCBIN_PAGE_ALIGNED(NAME, FILENAME) XINCBIN(NAME, FILENAME)
 #	define XINCBIN_GET(NAME) xincbin_get(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME))
 	INCBIN_EXTERNAL xincbin_data_t xincbin_get(const char* name);
 #else
 #	ifdef XINCBIN_IMPLEMENTATION
-#		define XINCBIN(NAME, FILENAME) INCBIN_COMMON(unsigned char, NAME, FILENAME,);
+#		define XINCBIN(NAME, FILENAME) INCBIN_EXTERN(unsigned char, NAME); \
+			INCBIN_COMMON(unsigned char, NAME, FILENAME,); \
+			XINCBIN__REGISTER(NAME, NULL)
+#		define XINCBIN_PAGE_ALIGNED(NAME, FILENAME) INCBIN_EXTERN(unsigned char, NAME); \
+			INCBIN_COMMON_ALIGNED(unsigned char, NAME, FILENAME,, XINCBIN_ALIGN_PAGE); \
+			XINCBIN__REGISTER(NAME, NULL)
+#		define XINCBIN_COMPRESSED(NAME, FILENAME) INCBIN_EXTERN(unsigned char, NAME); \
+			INCBIN_COMMON(unsigned char, NAME, FILENAME,); \
+			xincbin_cache_t XINCBIN_CACHE(NAME); \
+			XINCBIN__REGISTER(NAME, &XINCBIN_CACHE(NAME))
 #	else
 #		define XINCBIN(NAME, FILENAME) INCBIN_EXTERN(unsigned char, NAME);
+#		define XINCBIN_PAGE_ALIGNED(NAME, FILENAME) INCBIN_EXTERN(unsigned char, NAME);
+#		define XINCBIN_COMPRESSED(NAME, FILENAME) INCBIN_EXTERN(unsigned char, NAME); \
+			INCBIN_EXTERNAL xincbin_cache_t XINCBIN_CACHE(NAME);
 #	endif
 #	define XINCBIN_GET(NAME) (xincbin_data_t){ \
 		.size = INCBIN_CONCATENATE(INCBIN_CONCATENATE(INCBIN_PREFIX, NAME), INCBIN_STYLE_IDENT(SIZE)), \
@@ -335,12 +524,249 @@ typedef struct xincbin_data_s {
 #else // RC_INVOKED
 
 #define XINCBIN(NAME, FILENAME) INCBIN_CONCATENATE(INCBIN_PREFIX, NAME) RCDATA FILENAME
+#define XINCBIN_PAGE_ALIGNED(NAME, FILENAME) XINCBIN(NAME, FILENAME)
+#define XINCBIN_COMPRESSED(NAME, FILENAME) XINCBIN(NAME, FILENAME)
 
 #endif
 
 #endif // Include guard
 
-#ifdef XINCBIN_IMPLEMENTATION
+#if defined(XINCBIN_IMPLEMENTATION) && !defined(XINCBIN__IMPLEMENTED)
+// Every resource header is included in the same source file
+#define XINCBIN__IMPLEMENTED
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifndef XINCBIN_REALLOC
+#	ifdef BLIB_REALLOC
+#		define XINCBIN_REALLOC BLIB_REALLOC
+#	else
+#		define XINCBIN_REALLOC(ptr, size, ctx) xincbin__libc_realloc(ptr, size, ctx)
+#		define XINCBIN_USE_LIBC_REALLOC
+#	endif
+#endif
+
+#ifndef XINCBIN_MAX_ALIGN_TYPE
+#	ifdef _MSC_VER
+#		define XINCBIN_MAX_ALIGN_TYPE double
+#	else
+#		define XINCBIN_MAX_ALIGN_TYPE max_align_t
+#	endif
+#endif
+
+#ifdef XINCBIN_USE_LIBC_REALLOC
+
+#include <stdlib.h>
+
+static inline void*
+xincbin__libc_realloc(void* ptr, size_t size, void* ctx) {
+	(void)ctx;
+	if (size > 0) {
+		return realloc(ptr, size);
+	} else {
+		free(ptr);
+		return NULL;
+	}
+}
+
+#endif
+
+#ifdef _MSC_VER
+
+#include <intrin.h>
+
+static inline void*
+xincbin__atomic_load_ptr(void* ptr) {
+	return _InterlockedCompareExchangePointer((void* volatile*)ptr, NULL, NULL);
+}
+
+static inline void*
+xincbin__atomic_cas_ptr(void* ptr, void* expected, void* desired) {
+	return _InterlockedCompareExchangePointer((void* volatile*)ptr, desired, expected);
+}
+
+#else
+
+static inline void*
+xincbin__atomic_load_ptr(void* ptr) {
+	return __atomic_load_n((void**)ptr, __ATOMIC_ACQUIRE);
+}
+
+// Returns the previous value
+static inline void*
+xincbin__atomic_cas_ptr(void* ptr, void* expected, void* desired) {
+	__atomic_compare_exchange_n(
+		(void**)ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE
+	);
+	return expected;
+}
+
+#endif
+
+typedef struct xincbin__block_s {
+	unsigned int size;
+	_Alignas(XINCBIN_MAX_ALIGN_TYPE) unsigned char data[];
+} xincbin__block_t;
+
+#define XINCBIN__LZ4_INVALID SIZE_MAX
+
+static inline uint32_t
+xincbin__read_u32(const unsigned char* ptr) {
+	return (uint32_t)ptr[0]
+		| (uint32_t)ptr[1] << 8
+		| (uint32_t)ptr[2] << 16
+		| (uint32_t)ptr[3] << 24;
+}
+
+// Returns false when the length goes past the end of the block
+static inline bool
+xincbin__lz4_length(const unsigned char** ptr, const unsigned char* end, size_t* length) {
+	if (*length != 15) { return true; }
+
+	unsigned char byte;
+	do {
+		if (*ptr >= end) { return false; }
+		byte = *(*ptr)++;
+		*length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+// Decodes a LZ4 block after out_len bytes of output.
+// Only the size is computed when out is NULL.
+static size_t
+xincbin__lz4_block(
+	const unsigned char* in,
+	size_t in_size,
+	unsigned char* out,
+	size_t out_len,
+	size_t out_capacity
+) {
+	const unsigned char* end = in + in_size;
+	while (in < end) {
+		unsigned char token = *in++;
+
+		size_t literal_len = token >> 4;
+		if (!xincbin__lz4_length(&in, end, &literal_len)) { return XINCBIN__LZ4_INVALID; }
+		if ((size_t)(end - in) < literal_len) { return XINCBIN__LZ4_INVALID; }
+		if (out != NULL) {
+			if (out_capacity - out_len < literal_len) { return XINCBIN__LZ4_INVALID; }
+			memcpy(out + out_len, in, literal_len);
+		}
+		in += literal_len;
+		out_len += literal_len;
+
+		// The last sequence has no match
+		if (in == end) { break; }
+
+		if (end - in < 2) { return XINCBIN__LZ4_INVALID; }
+		size_t offset = (size_t)in[0] | (size_t)in[1] << 8;
+		in += 2;
+		if (offset == 0 || offset > out_len) { return XINCBIN__LZ4_INVALID; }
+
+		size_t match_len = token & 15;
+		if (!xincbin__lz4_length(&in, end, &match_len)) { return XINCBIN__LZ4_INVALID; }
+		match_len += 4;
+		if (out != NULL) {
+			if (out_capacity - out_len < match_len) { return XINCBIN__LZ4_INVALID; }
+			// The match can overlap with its own output
+			const unsigned char* match = out + out_len - offset;
+			for (size_t i = 0; i < match_len; ++i) {
+				out[out_len + i] = match[i];
+			}
+		}
+		out_len += match_len;
+	}
+
+	return out_len;
+}
+
+// Decodes a LZ4 frame, dictionaries are not supported.
+// Only the size is computed when out is NULL.
+static size_t
+xincbin__lz4_frame(
+	const unsigned char* in,
+	size_t in_size,
+	unsigned char* out,
+	size_t out_capacity
+) {
+	const unsigned char* end = in + in_size;
+	if (in_size < 7 || xincbin__read_u32(in) != 0x184D2204) { return XINCBIN__LZ4_INVALID; }
+
+	unsigned char flags = in[4];
+	if ((flags >> 6) != 1 || (flags & 0x01)) { return XINCBIN__LZ4_INVALID; }
+	bool block_checksum = flags & 0x10;
+	bool content_size = flags & 0x08;
+	bool content_checksum = flags & 0x04;
+
+	// Magic, flags, block descriptor, content size and header checksum
+	in += 4 + 2 + (content_size ? 8 : 0) + 1;
+
+	size_t out_len = 0;
+	while (true) {
+		if (end - in < 4) { return XINCBIN__LZ4_INVALID; }
+		uint32_t block_size = xincbin__read_u32(in);
+		in += 4;
+		if (block_size == 0) { break; }
+
+		bool uncompressed = block_size & 0x80000000u;
+		block_size &= 0x7FFFFFFFu;
+		if ((size_t)(end - in) < block_size) { return XINCBIN__LZ4_INVALID; }
+
+		if (uncompressed) {
+			if (out != NULL) {
+				if (out_capacity - out_len < block_size) { return XINCBIN__LZ4_INVALID; }
+				memcpy(out + out_len, in, block_size);
+			}
+			out_len += block_size;
+		} else {
+			// Linked blocks work as is since the output is contiguous
+			out_len = xincbin__lz4_block(in, block_size, out, out_len, out_capacity);
+			if (out_len == XINCBIN__LZ4_INVALID) { return XINCBIN__LZ4_INVALID; }
+		}
+
+		in += block_size + (block_checksum ? 4 : 0);
+	}
+
+	if (content_checksum && end - in < 4) { return XINCBIN__LZ4_INVALID; }
+
+	return out_len;
+}
+
+xincbin_data_t
+xincbin_decompress(xincbin_cache_t* cache, xincbin_data_t compressed) {
+	xincbin__block_t* block = xincbin__atomic_load_ptr(&cache->block);
+	if (block == NULL) {
+		size_t size = xincbin__lz4_frame(compressed.data, compressed.size, NULL, 0);
+		if (size == XINCBIN__LZ4_INVALID || size > UINT_MAX) { return (xincbin_data_t){ 0 }; }
+
+		block = XINCBIN_REALLOC(NULL, sizeof(xincbin__block_t) + size, NULL);
+		if (block == NULL) { return (xincbin_data_t){ 0 }; }
+		block->size = (unsigned int)size;
+		xincbin__lz4_frame(compressed.data, compressed.size, block->data, size);
+
+		// Another thread may have been faster
+		xincbin__block_t* existing = xincbin__atomic_cas_ptr(&cache->block, NULL, block);
+		if (existing != NULL) {
+			XINCBIN_REALLOC(block, 0, NULL);
+			block = existing;
+		}
+	}
+
+	return (xincbin_data_t){
+		.size = block->size,
+		.data = block->data,
+	};
+}
+
+void
+xincbin_release(xincbin_cache_t* cache) {
+	XINCBIN_REALLOC(cache->block, 0, NULL);
+	cache->block = NULL;
+}
 
 #ifdef _MSC_VER
 
@@ -373,4 +799,49 @@ xincbin_data_t xincbin_get(const char* name) {
 
 #endif
 
+#ifdef XINCBIN_REGISTRY
+
+AUTOLIST_DECLARE(xincbin)
+
+const xincbin_resource_t*
+xincbin_find(const char* name) {
+	AUTOLIST_FOREACH(itr, xincbin) {
+		const xincbin_resource_t* resource = (*itr)->value_addr;
+		if (strcmp(resource->name, name) == 0) { return resource; }
+	}
+
+	return NULL;
+}
+
+const xincbin_resource_t*
+xincbin_next(size_t* cursor) {
+	// Walk like AUTOLIST_FOREACH, the section bounds are separate objects
+	for (
+		const autolist_entry_t* const* itr = AUTOLIST_BEGIN(xincbin) + *cursor;
+		itr != AUTOLIST_END(xincbin);
+		++itr
+	) {
+		++*cursor;
+		if (*itr != NULL) { return (*itr)->value_addr; }
+	}
+
+	return NULL;
+}
+
+xincbin_data_t
+xincbin_resource_get(const xincbin_resource_t* resource) {
+#ifdef _MSC_VER
+	xincbin_data_t data = xincbin_get(resource->rc_name);
+#else
+	xincbin_data_t data = {
+		.size = *resource->size,
+		.data = resource->data,
+	};
+#endif
+
+	return resource->cache != NULL ? xincbin_decompress(resource->cache, data) : data;
+}
+
+#endif
+
 #endif